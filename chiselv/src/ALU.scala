@@ -1,7 +1,7 @@
 package chiselv
 
 import chisel3._
-import chisel3.util.{is, switch}
+import chisel3.util.{Cat, Fill, PopCount, PriorityEncoder, Reverse, is, switch}
 import chiselv.Instruction._
 
 class ALUPort(bitWidth: Int = 32) extends Bundle {
@@ -17,6 +17,16 @@ class ALU(bitWidth: Int = 32) extends Module {
   // For RV32I the shift amount is 5 bits, for RV64I is 6 bits
   val shamt = (if (bitWidth == 32) 5 else if (bitWidth == 64) 6 else 0) - 1
 
+  // Operands are sign-extended by one bit so all the multiplies share one signed multiplier
+  val aSigned = io.inst.isOneOf(MULH, MULHSU)
+  val bSigned = io.inst === MULH
+  val mulA    = Cat(aSigned && io.a(bitWidth - 1), io.a).asSInt
+  val mulB    = Cat(bSigned && io.b(bitWidth - 1), io.b).asSInt
+  val product = (mulA * mulB).asUInt
+
+  // Byte lanes, least significant first, for orc.b and rev8
+  val bytes = Seq.tabulate(bitWidth / 8)(i => io.a(8 * i + 7, 8 * i))
+
   switch(io.inst) {
     // Arithmetic
     is(ADD, ADDI)(out := io.a + io.b)
@@ -32,6 +42,38 @@ class ALU(bitWidth: Int = 32) extends Module {
     // Compare
     is(SLT, SLTI)(out   := Mux(io.a.asSInt < io.b.asSInt, 1.U, 0.U)) // Signed
     is(SLTU, SLTIU)(out := Mux(io.a < io.b, 1.U, 0.U))
+    // Multiply, a single bitWidth x bitWidth product that synthesis maps to DSP blocks
+    is(MUL)(out    := product(bitWidth - 1, 0))
+    is(MULH)(out   := product(2 * bitWidth - 1, bitWidth))
+    is(MULHSU)(out := product(2 * bitWidth - 1, bitWidth))
+    is(MULHU)(out  := product(2 * bitWidth - 1, bitWidth))
+    // Address generation (Zba)
+    is(SH1ADD)(out := (io.a << 1) + io.b)
+    is(SH2ADD)(out := (io.a << 2) + io.b)
+    is(SH3ADD)(out := (io.a << 3) + io.b)
+    // Logical with negate (Zbb)
+    is(ANDN)(out := io.a & ~io.b)
+    is(ORN)(out  := io.a | ~io.b)
+    is(XNOR)(out := ~(io.a ^ io.b))
+    // Bit count (Zbb), a zero input counts all the bits
+    is(CLZ)(out  := Mux(io.a === 0.U, bitWidth.U, PriorityEncoder(Reverse(io.a))))
+    is(CTZ)(out  := Mux(io.a === 0.U, bitWidth.U, PriorityEncoder(io.a)))
+    is(CPOP)(out := PopCount(io.a))
+    // Integer minimum and maximum (Zbb)
+    is(MAX)(out  := Mux(io.a.asSInt < io.b.asSInt, io.b, io.a)) // Signed
+    is(MAXU)(out := Mux(io.a < io.b, io.b, io.a))
+    is(MIN)(out  := Mux(io.a.asSInt < io.b.asSInt, io.a, io.b)) // Signed
+    is(MINU)(out := Mux(io.a < io.b, io.a, io.b))
+    // Sign and zero extension (Zbb)
+    is(SEXTB)(out := Cat(Fill(bitWidth - 8, io.a(7)), io.a(7, 0)))
+    is(SEXTH)(out := Cat(Fill(bitWidth - 16, io.a(15)), io.a(15, 0)))
+    is(ZEXTH)(out := io.a(15, 0))
+    // Rotates (Zbb)
+    is(ROL)(out       := io.a.rotateLeft(io.b(shamt, 0)))
+    is(ROR, RORI)(out := io.a.rotateRight(io.b(shamt, 0)))
+    // Byte granular operations (Zbb)
+    is(ORCB)(out := Cat(bytes.reverse.map(b => Fill(8, b.orR))))
+    is(REV8)(out := Cat(bytes))
     // Auxiliary
     is(EQ)(out   := Mux(io.a === io.b, 1.U, 0.U))
     is(NEQ)(out  := Mux(io.a =/= io.b, 1.U, 0.U))
@@ -0,0 +1,64 @@
+package chiselv
+
+import chisel3._
+import chisel3.util.{Decoupled, Mux1H, Valid, isPow2, log2Ceil}
+
+// A device on the MMIO bus, aligned to its power of two size. The id tells software what it is (see Syscon).
+case class BusDevice(name: String, id: Int, base: Long, size: Long) {
+  require(isPow2(size) && base % size == 0, s"$name must be aligned to its size")
+}
+
+class BusRequest(bitWidth: Int = 32) extends Bundle {
+  val address = UInt(bitWidth.W) // Offset in the device
+  val write   = Bool()
+  val data    = UInt(bitWidth.W) // Store value in its low bits
+}
+
+/**
+ * Device side of the bus. A request is taken when valid and ready are high,
+ * the device answers it with resp.valid in the same or a later cycle, with
+ * the loaded value for reads. The master waits for the answer before the
+ * next request, so a slow device only holds the access that reaches it.
+ */
+class BusPort(bitWidth: Int = 32) extends Bundle {
+  val req  = Flipped(Decoupled(new BusRequest(bitWidth)))
+  val resp = Valid(UInt(bitWidth.W))
+}
+
+// A device module for the SOC device list
+abstract class BusSlave(bitWidth: Int = 32) extends Module {
+  val bus = IO(new BusPort(bitWidth))
+}
+
+object BusInterconnect {
+  // One-hot device select of an address, all zero if no device has it
+  def decode(devices: Seq[BusDevice], address: UInt): UInt = VecInit(devices.map { d =>
+    val bits = log2Ceil(d.size)
+    address(address.getWidth - 1, bits) === (d.base >> bits).U
+  }).asUInt
+}
+
+/**
+ * Routes the requests of MemoryIOManager to the devices. The master gives
+ * the select of the request (see decode), computed a cycle ahead and
+ * registered when it can so the address compare is off the access path.
+ * Accesses to no device are answered at once, reading 0.
+ */
+class BusInterconnect(bitWidth: Int = 32, devices: Seq[BusDevice]) extends Module {
+  val io = IO(new Bundle {
+    val master  = new BusPort(bitWidth)
+    val select  = Input(UInt(devices.size.W))
+    val devices = Vec(devices.size, Flipped(new BusPort(bitWidth)))
+  })
+
+  for ((d, i) <- devices.zipWithIndex) {
+    io.devices(i).req.valid        := io.master.req.valid && io.select(i)
+    io.devices(i).req.bits         := io.master.req.bits
+    io.devices(i).req.bits.address := io.master.req.bits.address(log2Ceil(d.size) - 1, 0)
+  }
+
+  val hit = io.select.orR
+  io.master.req.ready  := !hit || Mux1H(io.select, io.devices.map(_.req.ready))
+  io.master.resp.valid := Mux(hit, Mux1H(io.select, io.devices.map(_.resp.valid)), io.master.req.valid)
+  io.master.resp.bits  := Mux(hit, Mux1H(io.select, io.devices.map(_.resp.bits)), 0.U)
+}
@@ -0,0 +1,64 @@
+package chiselv
+
+import chisel3._
+import chisel3.util.{Cat, Counter, is, switch}
+
+class CLINTPort(bitWidth: Int = 32) extends Bundle {
+  val Address     = Input(UInt(16.W))
+  val DataOut     = Output(UInt(bitWidth.W))
+  val DataIn      = Input(UInt(bitWidth.W))
+  val WriteEnable = Input(Bool())
+}
+
+/**
+ * Core local interruptor with the SiFive CLINT register layout at 0x0200_0000:
+ * msip at 0x0000, mtimecmp at 0x4000 and mtime at 0xBFF8, 64 bit registers as
+ * two words, low word first. mtime runs free from reset, one tick every
+ * tickCycles core clocks, and software may write it. The timer interrupt is
+ * pending while mtime >= mtimecmp, mtimecmp resets to all ones so nothing is
+ * pending until software sets it. The time CSR reads mtime.
+ */
+class CLINT(bitWidth: Int = 32, tickCycles: Int = 1) extends Module {
+  require(tickCycles >= 1, "mtime ticks at most once per clock")
+
+  val io = IO(new CLINTPort(bitWidth))
+  // What the hart sees: mtime for the time CSR and the levels of the MTIP and MSIP bits of mip
+  val hart = IO(new Bundle {
+    val mtime             = Output(UInt(64.W))
+    val timerInterrupt    = Output(Bool())
+    val softwareInterrupt = Output(Bool())
+  })
+
+  val msip     = RegInit(false.B)
+  val mtime    = RegInit(0.U(64.W))
+  val mtimecmp = RegInit(~0.U(64.W))
+
+  val tick = if (tickCycles == 1) true.B else Counter(true.B, tickCycles)._2
+  when(tick) {
+    mtime := mtime + 1.U
+  }
+
+  // Software writes win over the tick
+  when(io.WriteEnable) {
+    switch(io.Address) {
+      is(0x0000.U)(msip := io.DataIn(0))
+      is(0x4000.U)(mtimecmp := Cat(mtimecmp(63, 32), io.DataIn))
+      is(0x4004.U)(mtimecmp := Cat(io.DataIn, mtimecmp(31, 0)))
+      is(0xbff8.U)(mtime := Cat(mtime(63, 32), io.DataIn))
+      is(0xbffc.U)(mtime := Cat(io.DataIn, mtime(31, 0)))
+    }
+  }
+
+  io.DataOut := 0.U
+  switch(io.Address) {
+    is(0x0000.U)(io.DataOut := msip)
+    is(0x4000.U)(io.DataOut := mtimecmp(31, 0))
+    is(0x4004.U)(io.DataOut := mtimecmp(63, 32))
+    is(0xbff8.U)(io.DataOut := mtime(31, 0))
+    is(0xbffc.U)(io.DataOut := mtime(63, 32))
+  }
+
+  hart.mtime             := mtime
+  hart.timerInterrupt    := mtime >= mtimecmp
+  hart.softwareInterrupt := msip
+}
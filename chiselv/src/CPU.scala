@@ -0,0 +1,37 @@
+package chiselv
+
+import chisel3._
+import chisel3.experimental.Analog
+
+class CPUPort(
+    bitWidth:       Int = 32,
+    dataMemorySize: Int = 1 * 1024,
+    numGPIO:        Int = 8,
+    busDevices:     Int = 0,
+  ) extends Bundle {
+  val GPIO0External = Analog(numGPIO.W) // GPIO external port
+
+  val UART0Port          = Flipped(new UARTPort) // UART0 data port
+  val SysconPort         = Flipped(new SysconPort(bitWidth))
+  // The whole PC, instructions come from the ROM or the flash XIP window
+  val instructionMemPort = Flipped(new InstructionMemPort(bitWidth, scala.math.pow(2, bitWidth).toLong))
+  val dataMemPort        = Flipped(new MemoryPortDual(bitWidth, dataMemorySize))
+  val dataCachePort      = Flipped(new DCachePort(bitWidth)) // External RAM
+  val bus                = Vec(busDevices, Flipped(new BusPort(bitWidth))) // Devices of the SOC on the MMIO bus
+}
+
+/**
+ * What SOC, the tests and the simulation harness see of a core. Both cores
+ * keep the same instance names for these so the hierarchical paths into them
+ * do not depend on which one was generated.
+ */
+abstract class CPUCore extends Module {
+  val io:              CPUPort
+  val registerBank:    RegisterBank
+  val PC:              ProgramCounter
+  val memoryIOManager: MemoryIOManager
+
+  // High on the cycles an instruction retires and its address, for the harness instret count and profiler
+  val retire:   Bool
+  val retirePC: UInt
+}
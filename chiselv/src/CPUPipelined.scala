@@ -0,0 +1,434 @@
+package chiselv
+
+import chisel3._
+import chisel3.util.{Cat, Fill, MuxCase, is, switch}
+import chiselv.Instruction._
+
+// Everything an instruction carries down the pipeline, the same bundle is used for the ID/EX, EX/MEM and
+// MEM/WB registers and the fields a stage does not need are optimized away.
+class PipelineStage(bitWidth: Int = 32) extends Bundle {
+  val valid       = Bool()              // 0 => Bubble
+  val pc          = UInt(bitWidth.W)
+  val op          = UInt(bitWidth.W)    // Instruction word, expanded when compressed
+  val compressed  = Bool()              // The next instruction is at pc + 2
+  val inst        = Instruction()
+  val rd          = UInt(5.W)
+  val rs1         = UInt(5.W)
+  val rs2         = UInt(5.W)
+  val imm         = SInt(bitWidth.W)
+  val toALU       = Bool()
+  val branch      = Bool()
+  val use_imm     = Bool()
+  val jump        = Bool()
+  val is_load     = Bool()
+  val is_store    = Bool()
+  val writesRd    = Bool()
+  val rs1Data     = UInt(bitWidth.W)    // Operands, forwarded in EX
+  val rs2Data     = UInt(bitWidth.W)
+  val result      = UInt(bitWidth.W)    // Value for rd, the loaded data after MEM
+  val address     = UInt(bitWidth.W)    // Load/store address
+  val nextPC      = UInt(bitWidth.W)
+  val branchTaken = Bool()
+}
+
+/**
+ * Classic five stage (IF/ID/EX/MEM/WB) pipelined RV32IMC core (plus Zba and Zbb), a drop-in
+ * replacement for CPUSingleCycle selected with the SOC `pipelined` parameter.
+ *
+ *   - IF reads the instruction memory at the PC, which is predicted as PC + 2
+ *     for compressed instructions and PC + 4 for the others. While the
+ *     instruction cache refills a line, or a jump lands on a 32 bit
+ *     instruction that crosses two words, it inserts bubbles.
+ *   - ID decodes and reads the register bank, bypassing the value written back
+ *     in the same cycle.
+ *   - EX runs the ALU or the divider and resolves branches and jumps. A taken
+ *     one redirects the PC and flushes the two younger instructions in IF/ID
+ *     and ID/EX. The operands are forwarded from MEM and WB.
+ *   - MEM accesses the MemoryIOManager. Stores take a single cycle and loads
+ *     hand their address to the RAM from EX so the data is ready in MEM, a
+ *     load that could not (eg. the previous store wrote the same word) stalls
+ *     the whole pipeline for a cycle like in the single cycle core. The MMIO
+ *     bus device is decoded from the same EX address and registered, a slow
+ *     device holds IF to MEM until it answers.
+ *   - WB writes the register bank and accesses the CSRs, so the counters see
+ *     instructions in order and only when they retire. Traps (ECALL, EBREAK
+ *     and interrupts) and MRET are taken here: they flush IF to MEM, cancel
+ *     the access in MEM and redirect the fetch, ahead of any EX redirect.
+ *
+ * Loads and CSR reads only have their result in WB, an instruction in ID that
+ * needs it waits one cycle (load-use hazard). A divide holds IF to EX until
+ * its result is ready while the older instructions drain, WFI until an
+ * interrupt enabled in mie is pending.
+ */
+class CPUPipelined(
+    cpuFrequency:   Int,
+    entryPoint:     Long,
+    bitWidth:       Int = 32,
+    dataMemorySize: Int = 1 * 1024,
+    numGPIO:        Int = 8,
+    timerTick:      Int = 1,
+    extDevices:     Seq[BusDevice] = Seq(),
+  ) extends CPUCore {
+  val io = IO(new CPUPort(bitWidth, dataMemorySize, numGPIO, extDevices.size))
+
+  // Instantiate and initialize the Register Bank, writes come from WB and never stall
+  val registerBank = Module(new RegisterBank(bitWidth))
+  registerBank.io.writeEnable := false.B
+  registerBank.io.regwr_addr  := 0.U
+  registerBank.io.regwr_data  := 0.U
+  registerBank.io.stall       := false.B
+
+  // Instantiate and initialize the Program Counter, the address being fetched
+  val PC = Module(new ProgramCounter(bitWidth, entryPoint))
+  PC.io.writeEnable := false.B
+  PC.io.dataIn      := 0.U
+  PC.io.writeAdd    := false.B
+
+  // Instantiate and initialize the ALU
+  val ALU = Module(new ALU(bitWidth))
+  ALU.io.inst := ERR_INST
+  ALU.io.a    := 0.U
+  ALU.io.b    := 0.U
+
+  // Instantiate and initialize the iterative Divider (RV32M)
+  val divider = Module(new Divider(bitWidth))
+  divider.io.inst := ERR_INST
+  divider.io.a    := 0.U
+  divider.io.b    := 0.U
+
+  // Instantiate and initialize the Instruction Decoder
+  val decoder = Module(new Decoder(bitWidth))
+  decoder.io.op := 0.U
+
+  // Instantiate the fetch aligner, takes halfword aligned and compressed (RV32C) instructions from the word wide
+  // instruction memory
+  val fetchAligner = Module(new FetchAligner(bitWidth))
+  fetchAligner.io.mem <> io.instructionMemPort
+
+  // Instantiate and initialize the Memory IO Manager, the MMIO bus select is decoded in EX and registered
+  val memoryIOManager = Module(new MemoryIOManager(bitWidth, dataMemorySize, extDevices, registeredDecode = true))
+  memoryIOManager.io.MemoryIOPort.readRequest   := false.B
+  memoryIOManager.io.MemoryIOPort.writeRequest  := false.B
+  memoryIOManager.io.MemoryIOPort.readAddr      := 0.U
+  memoryIOManager.io.MemoryIOPort.writeAddr     := 0.U
+  memoryIOManager.io.MemoryIOPort.writeData     := 0.U
+  memoryIOManager.io.MemoryIOPort.dataSize      := 0.U
+  memoryIOManager.io.MemoryIOPort.writeMask     := 0.U
+  memoryIOManager.io.MemoryIOPort.readAhead     := false.B
+  memoryIOManager.io.MemoryIOPort.readAheadAddr := 0.U
+  // Connect MMIO to the devices
+  memoryIOManager.io.DataMemPort <> io.dataMemPort
+  memoryIOManager.io.DCachePort <> io.dataCachePort
+  memoryIOManager.io.UART0Port <> io.UART0Port
+  memoryIOManager.io.SysconPort <> io.SysconPort
+  memoryIOManager.io.ExtBus <> io.bus
+
+  // Instantiate and connect GPIO
+  val GPIO0 = Module(new GPIO(bitWidth, numGPIO))
+  memoryIOManager.io.GPIO0Port <> GPIO0.io.GPIOPort
+  if (numGPIO > 0) {
+    GPIO0.io.externalPort <> io.GPIO0External
+  }
+
+  // Instantiate and connect the Timer
+  val timer0 = Module(new Timer(bitWidth, cpuFrequency))
+  memoryIOManager.io.Timer0Port <> timer0.io
+
+  // Instantiate and connect the CLINT (mtime, mtimecmp)
+  val clint = Module(new CLINT(bitWidth, timerTick))
+  memoryIOManager.io.CLINTPort <> clint.io
+
+  // Instantiate and connect the DMA controller
+  val dma = Module(new DMA(bitWidth))
+  memoryIOManager.io.DMAPort <> dma.io
+
+  // Instantiate the CSR file (counters and traps), accessed from WB
+  val CSR = Module(new CSRFile(bitWidth))
+
+  // --------------- Pipeline Registers --------------- //
+  val bubble = 0.U.asTypeOf(new PipelineStage(bitWidth))
+  val ifid   = RegInit(bubble) // Only valid, pc, op and compressed are used
+  val idex   = RegInit(bubble)
+  val exmem  = RegInit(bubble)
+  val memwb  = RegInit(bubble)
+
+  // --------------- Pipeline Control --------------- //
+  val memStall = memoryIOManager.io.stall // Holds IF to MEM
+  val wfiStall = WireDefault(false.B)
+  val exStall  = memStall || divider.io.busy || wfiStall
+  val loadUse  = WireDefault(false.B)
+  val idStall  = exStall || loadUse
+  val redirect = WireDefault(false.B) // Taken branch or jump in EX
+  val target   = WireDefault(0.U(bitWidth.W))
+  val trap     = WireDefault(false.B) // Trap or MRET in WB
+  val trapPC   = WireDefault(0.U(bitWidth.W))
+
+  // ----- WB ----- //
+  val csrInsts = Seq(CSRRW, CSRRS, CSRRC, CSRRWI, CSRRSI, CSRRCI)
+  val isCSR    = memwb.inst.isOneOf(csrInsts)
+  val wbData   = Mux(isCSR, CSR.io.dataOut, memwb.result)
+  val wbRd     = Mux(memwb.valid && memwb.writesRd, memwb.rd, 0.U)
+
+  // CSR Operations, rd gets the value before the write. A cycle without a retiring instruction counts as a stall.
+  CSR.io.inst        := Mux(memwb.valid, memwb.inst, ERR_INST)
+  CSR.io.address     := memwb.imm(11, 0)
+  CSR.io.dataIn      := Mux(memwb.use_imm, memwb.rs1, memwb.rs1Data)
+  CSR.io.stall       := !memwb.valid
+  CSR.io.branchTaken := memwb.valid && memwb.branchTaken
+  CSR.io.load        := memwb.valid && memwb.is_load
+  CSR.io.store       := memwb.valid && memwb.is_store
+  CSR.io.mtime       := clint.hart.mtime
+  CSR.io.interrupts := Interrupt.lines(
+    Interrupt.software -> clint.hart.softwareInterrupt,
+    Interrupt.timer    -> clint.hart.timerInterrupt,
+    Interrupt.uartRx   -> !io.UART0Port.rxEmpty,
+    Interrupt.uartTx   -> io.UART0Port.txInterrupt,
+    Interrupt.gpio     -> GPIO0.io.interrupt,
+    Interrupt.dma      -> dma.interrupt,
+  )
+
+  // ECALL and EBREAK trap with mepc pointing at them. Interrupts are taken when an instruction retires and
+  // return to the one that follows it, CSR accesses and MRET are not interrupted.
+  val exception = memwb.valid && memwb.inst.isOneOf(ECALL, EBREAK)
+  val interrupt = memwb.valid && CSR.io.interrupt && !memwb.inst.isOneOf(Seq(ECALL, EBREAK, MRET) ++ csrInsts)
+  CSR.io.trap := exception || interrupt
+  CSR.io.trapCause := MuxCase(
+    CSR.io.cause,
+    Seq(
+      (exception && memwb.inst === ECALL)  -> TrapCause.ecall.U,
+      (exception && memwb.inst === EBREAK) -> TrapCause.breakpoint.U,
+    ),
+  )
+  CSR.io.trapPC := Mux(exception, memwb.pc, memwb.nextPC)
+  CSR.io.mret   := memwb.valid && memwb.inst === MRET
+  trap          := CSR.io.trap || CSR.io.mret
+  trapPC        := Mux(CSR.io.mret, CSR.io.mepc, CSR.io.trapVector)
+
+  registerBank.io.writeEnable := wbRd =/= 0.U
+  registerBank.io.regwr_addr  := wbRd
+  registerBank.io.regwr_data  := wbData
+
+  val retire   = dontTouch(WireDefault(memwb.valid))
+  val retirePC = dontTouch(WireDefault(memwb.pc))
+
+  // ----- IF ----- //
+  // A fetch that is not ready (instruction cache refill) sends a bubble down and keeps the PC
+  val fetchReady = fetchAligner.io.core.ready
+  val compressed = fetchAligner.io.core.compressed
+  fetchAligner.io.core.pc    := PC.io.PC
+  fetchAligner.io.core.fetch := !trap && !redirect && !idStall
+
+  when(trap) {
+    PC.io.writeEnable := true.B
+    PC.io.dataIn      := trapPC
+    ifid.valid        := false.B
+  }.elsewhen(redirect) {
+    PC.io.writeEnable := true.B
+    PC.io.dataIn      := target
+    ifid.valid        := false.B
+  }.elsewhen(!idStall) {
+    PC.io.writeEnable := fetchReady
+    PC.io.dataIn      := Mux(compressed, PC.io.PC2, PC.io.PC4)
+    ifid.valid        := fetchReady
+    ifid.pc           := PC.io.PC
+    ifid.op           := fetchAligner.io.core.inst
+    ifid.compressed   := compressed
+  }
+
+  // ----- ID ----- //
+  decoder.io.op            := ifid.op
+  registerBank.io.rs1_addr := decoder.io.rs1
+  registerBank.io.rs2_addr := decoder.io.rs2
+
+  // The register bank is written at the end of WB, bypass it for the instruction reading it now
+  def bypass(rs: UInt, value: UInt) = Mux(rs =/= 0.U && rs === wbRd, wbData, value)
+
+  val id = Wire(new PipelineStage(bitWidth))
+  id.valid    := ifid.valid
+  id.pc       := ifid.pc
+  id.op       := ifid.op
+  id.inst     := decoder.io.inst
+  id.rd       := decoder.io.rd
+  id.rs1      := decoder.io.rs1
+  id.rs2      := decoder.io.rs2
+  id.imm      := decoder.io.imm
+  id.toALU    := decoder.io.toALU
+  id.branch   := decoder.io.branch
+  id.use_imm  := decoder.io.use_imm
+  id.jump     := decoder.io.jump
+  id.is_load  := decoder.io.is_load
+  id.is_store := decoder.io.is_store
+  id.writesRd := decoder.io.toALU || decoder.io.jump || decoder.io.is_load ||
+    decoder.io.inst.isOneOf(Seq(LUI, AUIPC, DIV, DIVU, REM, REMU) ++ csrInsts)
+  id.rs1Data     := bypass(decoder.io.rs1, registerBank.io.rs1)
+  id.rs2Data     := bypass(decoder.io.rs2, registerBank.io.rs2)
+  id.result      := 0.U
+  id.address     := 0.U
+  id.nextPC      := 0.U
+  id.branchTaken := false.B
+  id.compressed  := ifid.compressed
+
+  // Load-use hazard: a load or CSR read in EX has no result to forward until it reaches WB.
+  // The register fields are compared even for formats that do not read them, costing at most a cycle.
+  val lateResult = idex.valid && idex.writesRd && idex.rd =/= 0.U && (idex.is_load || idex.inst.isOneOf(csrInsts))
+  loadUse := ifid.valid && lateResult && (idex.rd === decoder.io.rs1 || idex.rd === decoder.io.rs2)
+
+  when(trap || redirect) {
+    idex.valid := false.B
+  }.elsewhen(!exStall) {
+    idex       := id
+    idex.valid := id.valid && !loadUse
+  }
+
+  // ----- EX ----- //
+  // Forward from the newest older instruction still in the pipeline
+  def forward(rs: UInt, value: UInt) = MuxCase(
+    value,
+    Seq(
+      (rs =/= 0.U && exmem.valid && exmem.writesRd && exmem.rd === rs) -> exmem.result,
+      (rs =/= 0.U && rs === wbRd)                                      -> wbData,
+    ),
+  )
+  val rs1 = forward(idex.rs1, idex.rs1Data)
+  val rs2 = forward(idex.rs2, idex.rs2Data)
+
+  // While EX holds, keep the forwarded operands as the instructions providing them leave the pipeline
+  when(exStall) {
+    idex.rs1Data := rs1
+    idex.rs2Data := rs2
+  }
+
+  val ex = WireDefault(idex)
+  ex.rs1Data := rs1
+  ex.rs2Data := rs2
+  ex.nextPC  := idex.pc + Mux(idex.compressed, 2.U, 4.U)
+
+  // ALU Operations
+  when(idex.toALU) {
+    ALU.io.inst := idex.inst
+    ALU.io.a    := rs1
+    ALU.io.b    := Mux(idex.use_imm, idex.imm.asUInt, rs2)
+    ex.result   := ALU.io.x
+  }
+
+  // WFI holds EX until an enabled interrupt is pending
+  wfiStall := idex.valid && idex.inst === WFI && !CSR.io.wakeup
+
+  // Divide Operations, the divider holds EX until the result is ready. A trap flushes a busy divide from EX.
+  divider.io.kill := trap || redirect
+  when(idex.valid && idex.inst.isOneOf(DIV, DIVU, REM, REMU)) {
+    divider.io.inst := idex.inst
+    divider.io.a    := rs1
+    divider.io.b    := rs2
+    ex.result       := divider.io.x
+  }
+
+  // Branch Operations
+  when(idex.branch) {
+    ALU.io.a := rs1
+    ALU.io.b := rs2
+    switch(idex.inst) {
+      is(BEQ)(ALU.io.inst  := EQ)
+      is(BNE)(ALU.io.inst  := NEQ)
+      is(BLT)(ALU.io.inst  := SLT)
+      is(BGE)(ALU.io.inst  := GTE)
+      is(BLTU)(ALU.io.inst := SLTU)
+      is(BGEU)(ALU.io.inst := GTEU)
+    }
+    when(ALU.io.x === 1.U) {
+      ex.branchTaken := true.B
+      ex.nextPC      := (idex.pc.asSInt + idex.imm).asUInt
+    }
+  }
+
+  // Jump Operations, rd gets the next instruction address
+  when(idex.jump) {
+    ALU.io.inst := ADD
+    ALU.io.a    := idex.pc
+    ALU.io.b    := Mux(idex.compressed, 2.U, 4.U)
+    ex.result   := ALU.io.x
+    when(idex.inst === JAL) {
+      ex.nextPC := (idex.pc.asSInt + idex.imm).asUInt
+    }
+    when(idex.inst === JALR) {
+      ex.nextPC := Cat((rs1 + idex.imm.asUInt)(31, 1), 0.U)
+    }
+  }
+
+  // LUI
+  when(idex.inst === LUI) {
+    ex.result := idex.imm.asUInt
+  }
+
+  // AUIPC
+  when(idex.inst === AUIPC) {
+    ALU.io.inst := ADD
+    ALU.io.a    := idex.pc
+    ALU.io.b    := idex.imm.asUInt
+    ex.result   := ALU.io.x
+  }
+
+  // Loads & Stores, use the ALU to get the resulting address
+  when(idex.is_load || idex.is_store) {
+    ALU.io.inst := ADD
+    ALU.io.a    := rs1
+    ALU.io.b    := idex.imm.asUInt
+    ex.address  := ALU.io.x
+  }
+
+  // Hand the load address to the RAM a cycle early so the load does not stall in MEM, loads and stores also
+  // have their MMIO bus device decoded from it
+  memoryIOManager.io.MemoryIOPort.readAhead     := idex.valid && idex.is_load
+  memoryIOManager.io.MemoryIOPort.readAheadAddr := ex.address
+
+  // Predicted PC + 2 or 4, a taken branch or jump redirects the fetch once EX moves on
+  when(idex.valid && !exStall && (ex.branchTaken || idex.jump)) {
+    redirect := true.B
+    target   := ex.nextPC
+  }
+
+  when(!memStall) {
+    exmem       := ex
+    exmem.valid := idex.valid && !exStall
+  }
+  when(trap) {
+    exmem.valid := false.B
+  }
+
+  // ----- MEM ----- //
+  val dataSize = WireDefault(0.U(2.W)) // Data size, 1 = byte, 2 = halfword, 3 = word
+  switch(exmem.inst) {
+    is(LW, SW)(dataSize      := 3.U)
+    is(LH, LHU, SH)(dataSize := 2.U)
+    is(LB, LBU, SB)(dataSize := 1.U)
+  }
+  // The instruction in MEM does not access memory when the one in WB traps
+  memoryIOManager.io.MemoryIOPort.readRequest  := exmem.valid && exmem.is_load && !trap
+  memoryIOManager.io.MemoryIOPort.writeRequest := exmem.valid && exmem.is_store && !trap
+  memoryIOManager.io.MemoryIOPort.readAddr     := exmem.address
+  memoryIOManager.io.MemoryIOPort.writeAddr    := exmem.address
+  memoryIOManager.io.MemoryIOPort.dataSize     := dataSize
+
+  // Stores
+  memoryIOManager.io.MemoryIOPort.writeData := MuxCase(
+    exmem.rs2Data,
+    Seq(
+      (dataSize === 2.U) -> Cat(Fill(16, 0.U), exmem.rs2Data(15, 0)),
+      (dataSize === 1.U) -> Cat(Fill(24, 0.U), exmem.rs2Data(7, 0)),
+    ),
+  )
+
+  // Loads
+  val readData = memoryIOManager.io.MemoryIOPort.readData
+  val loaded   = WireDefault(readData)
+  switch(exmem.inst) {
+    is(LH)(loaded  := Cat(Fill(16, readData(15)), readData(15, 0)))
+    is(LHU)(loaded := Cat(Fill(16, 0.U), readData(15, 0)))
+    is(LB)(loaded  := Cat(Fill(24, readData(7)), readData(7, 0)))
+    is(LBU)(loaded := Cat(Fill(24, 0.U), readData(7, 0)))
+  }
+
+  memwb        := exmem
+  memwb.valid  := exmem.valid && !memStall && !trap
+  memwb.result := Mux(exmem.is_load, loaded, exmem.result)
+}
@@ -1,26 +1,19 @@
 package chiselv
 
 import chisel3._
-import chisel3.experimental.Analog
-import chisel3.util.{Cat, Fill, is, switch}
+import chisel3.util.{Cat, Fill, MuxCase, is, switch}
 import chiselv.Instruction._
 
 class CPUSingleCycle(
-    cpuFrequency:          Int,
-    entryPoint:            Long,
-    bitWidth:              Int = 32,
-    instructionMemorySize: Int = 1 * 1024,
-    dataMemorySize:        Int = 1 * 1024,
-    numGPIO:               Int = 8,
-  ) extends Module {
-  val io = IO(new Bundle {
-    val GPIO0External = Analog(numGPIO.W) // GPIO external port
-
-    val UART0Port          = Flipped(new UARTPort) // UART0 data port
-    val SysconPort         = Flipped(new SysconPort(bitWidth))
-    val instructionMemPort = Flipped(new InstructionMemPort(bitWidth, instructionMemorySize))
-    val dataMemPort        = Flipped(new MemoryPortDual(bitWidth, dataMemorySize))
-  })
+    cpuFrequency:   Int,
+    entryPoint:     Long,
+    bitWidth:       Int = 32,
+    dataMemorySize: Int = 1 * 1024,
+    numGPIO:        Int = 8,
+    timerTick:      Int = 1,
+    extDevices:     Seq[BusDevice] = Seq(),
+  ) extends CPUCore {
+  val io = IO(new CPUPort(bitWidth, dataMemorySize, numGPIO, extDevices.size))
 
   val stall = WireDefault(false.B)
 
@@ -42,23 +35,39 @@ class CPUSingleCycle(
   ALU.io.a    := 0.U
   ALU.io.b    := 0.U
 
+  // Instantiate and initialize the iterative Divider (RV32M)
+  val divider = Module(new Divider(bitWidth))
+  divider.io.inst := ERR_INST
+  divider.io.a    := 0.U
+  divider.io.b    := 0.U
+  divider.io.kill := false.B // Traps wait for the divide to finish
+
   // Instantiate and initialize the Instruction Decoder
   val decoder = Module(new Decoder(bitWidth))
   decoder.io.op := 0.U
 
-  // Instantiate and initialize the Memory IO Manager
-  val memoryIOManager = Module(new MemoryIOManager(bitWidth, dataMemorySize))
-  memoryIOManager.io.MemoryIOPort.readRequest  := false.B
-  memoryIOManager.io.MemoryIOPort.writeRequest := false.B
-  memoryIOManager.io.MemoryIOPort.readAddr     := 0.U
-  memoryIOManager.io.MemoryIOPort.writeAddr    := 0.U
-  memoryIOManager.io.MemoryIOPort.writeData    := 0.U
-  memoryIOManager.io.MemoryIOPort.dataSize     := 0.U
-  memoryIOManager.io.MemoryIOPort.writeMask    := 0.U
+  // Instantiate the fetch aligner, takes halfword aligned and compressed (RV32C) instructions from the word wide
+  // instruction memory
+  val fetchAligner = Module(new FetchAligner(bitWidth))
+  fetchAligner.io.mem <> io.instructionMemPort
+
+  // Instantiate and initialize the Memory IO Manager, the MMIO bus is decoded in the cycle of the access
+  val memoryIOManager = Module(new MemoryIOManager(bitWidth, dataMemorySize, extDevices))
+  memoryIOManager.io.MemoryIOPort.readRequest   := false.B
+  memoryIOManager.io.MemoryIOPort.writeRequest  := false.B
+  memoryIOManager.io.MemoryIOPort.readAddr      := 0.U
+  memoryIOManager.io.MemoryIOPort.writeAddr     := 0.U
+  memoryIOManager.io.MemoryIOPort.writeData     := 0.U
+  memoryIOManager.io.MemoryIOPort.dataSize      := 0.U
+  memoryIOManager.io.MemoryIOPort.writeMask     := 0.U
+  memoryIOManager.io.MemoryIOPort.readAhead     := false.B
+  memoryIOManager.io.MemoryIOPort.readAheadAddr := 0.U
   // Connect MMIO to the devices
   memoryIOManager.io.DataMemPort <> io.dataMemPort
+  memoryIOManager.io.DCachePort <> io.dataCachePort
   memoryIOManager.io.UART0Port <> io.UART0Port
   memoryIOManager.io.SysconPort <> io.SysconPort
+  memoryIOManager.io.ExtBus <> io.bus
 
   // Instantiate and connect GPIO
   val GPIO0 = Module(new GPIO(bitWidth, numGPIO))
@@ -71,24 +80,62 @@ class CPUSingleCycle(
   val timer0 = Module(new Timer(bitWidth, cpuFrequency))
   memoryIOManager.io.Timer0Port <> timer0.io
 
+  // Instantiate and connect the CLINT (mtime, mtimecmp)
+  val clint = Module(new CLINT(bitWidth, timerTick))
+  memoryIOManager.io.CLINTPort <> clint.io
+
+  // Instantiate and connect the DMA controller
+  val dma = Module(new DMA(bitWidth))
+  memoryIOManager.io.DMAPort <> dma.io
+
+  // Instantiate and initialize the CSR file (counters and traps)
+  val CSR         = Module(new CSRFile(bitWidth))
+  val branchTaken = WireDefault(false.B)
+  CSR.io.inst        := decoder.io.inst
+  CSR.io.address     := decoder.io.imm(11, 0)
+  CSR.io.dataIn      := 0.U
+  CSR.io.stall       := stall
+  CSR.io.branchTaken := branchTaken && !stall
+  CSR.io.load        := decoder.io.is_load && !stall
+  CSR.io.store       := decoder.io.is_store && !stall
+  CSR.io.mtime       := clint.hart.mtime
+  CSR.io.interrupts := Interrupt.lines(
+    Interrupt.software -> clint.hart.softwareInterrupt,
+    Interrupt.timer    -> clint.hart.timerInterrupt,
+    Interrupt.uartRx   -> !io.UART0Port.rxEmpty,
+    Interrupt.uartTx   -> io.UART0Port.txInterrupt,
+    Interrupt.gpio     -> GPIO0.io.interrupt,
+    Interrupt.dma      -> dma.interrupt,
+  )
+  CSR.io.trap      := false.B
+  CSR.io.trapCause := 0.U
+  CSR.io.trapPC    := 0.U
+  CSR.io.mret      := false.B
+
   // --------------- CPU Control --------------- //
-  // State of the CPU Stall
-  stall := memoryIOManager.io.stall
+  // State of the CPU Stall, the instruction cache holds the fetch while it refills a line from flash and WFI
+  // waits for an enabled interrupt. A jump to a 32 bit instruction that crosses two words also waits a cycle.
+  stall := memoryIOManager.io.stall || divider.io.busy || !fetchAligner.io.core.ready ||
+    (decoder.io.inst === WFI && !CSR.io.wakeup)
+  // Address of the instruction that follows this one, where an interrupt taken after it returns to
+  val compressed = fetchAligner.io.core.compressed
+  val nextPC     = WireDefault(Mux(compressed, PC.io.PC2, PC.io.PC4))
   when(!stall) {
     // If CPU is stalled, do not advance PC
     PC.io.writeEnable := true.B
-    PC.io.dataIn      := PC.io.PC4
+    PC.io.dataIn      := Mux(compressed, PC.io.PC2, PC.io.PC4)
   }
 
+  // Every instruction retires in the cycle it leaves the stall
+  val retire   = dontTouch(WireDefault(!stall))
+  val retirePC = dontTouch(WireDefault(PC.io.PC))
+
   // Connect PC output to instruction memory
-  when(io.instructionMemPort.ready) {
-    io.instructionMemPort.readAddr := PC.io.PC
-  }.otherwise(
-    io.instructionMemPort.readAddr := DontCare
-  )
+  fetchAligner.io.core.pc    := PC.io.PC
+  fetchAligner.io.core.fetch := !stall
 
-  // Connect the instruction memory to the decoder
-  decoder.io.op := io.instructionMemPort.readData
+  // Connect the instruction memory to the decoder, a nop (addi x0, x0, 0) while the fetch is not ready
+  decoder.io.op := Mux(fetchAligner.io.core.ready, fetchAligner.io.core.inst, 0x13.U)
 
   // Connect the decoder output to register bank inputs
   registerBank.io.regwr_addr := decoder.io.rd
@@ -111,6 +158,16 @@ class CPUSingleCycle(
     registerBank.io.regwr_data  := ALU.io.x
   }
 
+  // Divide Operations, the divider stalls the core until the result is ready
+  when(decoder.io.inst.isOneOf(DIV, DIVU, REM, REMU)) {
+    divider.io.inst := decoder.io.inst
+    divider.io.a    := registerBank.io.rs1
+    divider.io.b    := registerBank.io.rs2
+
+    registerBank.io.writeEnable := true.B
+    registerBank.io.regwr_data  := divider.io.x
+  }
+
   // Branch Operations
   when(decoder.io.branch) {
     ALU.io.a := registerBank.io.rs1
@@ -124,9 +181,11 @@ class CPUSingleCycle(
       is(BGEU)(ALU.io.inst := GTEU)
     }
     when(ALU.io.x === 1.U) {
+      branchTaken       := true.B
       PC.io.writeEnable := true.B
       PC.io.writeAdd    := true.B
       PC.io.dataIn      := decoder.io.imm.asUInt
+      nextPC            := PC.io.PC + decoder.io.imm.asUInt
     }
   }
 
@@ -137,7 +196,7 @@ class CPUSingleCycle(
     // Use the ALU to get the result
     ALU.io.inst                := ADD
     ALU.io.a                   := PC.io.PC
-    ALU.io.b                   := 4.U
+    ALU.io.b                   := Mux(compressed, 2.U, 4.U)
     registerBank.io.regwr_data := ALU.io.x
 
     PC.io.writeEnable := true.B
@@ -145,13 +204,16 @@ class CPUSingleCycle(
       // Set PC to jump address
       PC.io.writeAdd := true.B
       PC.io.dataIn   := decoder.io.imm.asUInt
+      nextPC         := PC.io.PC + decoder.io.imm.asUInt
     }
     when(decoder.io.inst === JALR) {
       // Set PC to jump address
-      PC.io.dataIn := Cat(
+      val target = Cat(
         (registerBank.io.rs1 + decoder.io.imm.asUInt)(31, 1),
         0.U,
       )
+      PC.io.dataIn := target
+      nextPC       := target
     }
   }
 
@@ -171,6 +233,15 @@ class CPUSingleCycle(
     registerBank.io.regwr_data := ALU.io.x
   }
 
+  // CSR Operations, rd gets the value before the write
+  when(decoder.io.inst.isOneOf(CSRRW, CSRRS, CSRRC, CSRRWI, CSRRSI, CSRRCI)) {
+    // The immediate variants take the zero-extended rs1 field
+    CSR.io.dataIn := Mux(decoder.io.use_imm, decoder.io.rs1, registerBank.io.rs1)
+
+    registerBank.io.writeEnable := true.B
+    registerBank.io.regwr_data  := CSR.io.dataOut
+  }
+
   // Loads & Stores
   when(decoder.io.is_load || decoder.io.is_store) {
     // Use the ALU to get the resulting address
@@ -249,4 +320,29 @@ class CPUSingleCycle(
     memoryIOManager.io.MemoryIOPort.dataSize  := dataSize
     memoryIOManager.io.MemoryIOPort.writeData := dataOut
   }
+
+  // --------------- Traps --------------- //
+  // ECALL and EBREAK trap with mepc pointing at them. Interrupts are taken when an instruction retires and
+  // return to the one that follows it, CSR accesses and trap instructions are not interrupted so software
+  // sees mstatus and mepc change only through its own writes.
+  val exception     = decoder.io.inst.isOneOf(ECALL, EBREAK)
+  val interruptible = !decoder.io.inst.isOneOf(ECALL, EBREAK, MRET, CSRRW, CSRRS, CSRRC, CSRRWI, CSRRSI, CSRRCI)
+  CSR.io.trap      := !stall && (exception || (CSR.io.interrupt && interruptible))
+  CSR.io.trapCause := MuxCase(
+    CSR.io.cause,
+    Seq(
+      (decoder.io.inst === ECALL)  -> TrapCause.ecall.U,
+      (decoder.io.inst === EBREAK) -> TrapCause.breakpoint.U,
+    ),
+  )
+  CSR.io.trapPC    := Mux(exception, PC.io.PC, nextPC)
+  CSR.io.mret      := !stall && decoder.io.inst === MRET
+
+  when(CSR.io.mret) {
+    PC.io.dataIn := CSR.io.mepc
+  }
+  when(CSR.io.trap) {
+    PC.io.writeAdd := false.B
+    PC.io.dataIn   := CSR.io.trapVector
+  }
 }
@@ -0,0 +1,202 @@
+package chiselv
+
+import chisel3._
+import chisel3.util.{Cat, MuxCase, MuxLookup, PriorityMux}
+import chiselv.Instruction._
+
+// CSR addresses from the RISC-V privileged spec
+object CSRAddress {
+  val mstatus       = 0x300
+  val mie           = 0x304
+  val mtvec         = 0x305
+  val mcountinhibit = 0x320
+  val mscratch      = 0x340
+  val mepc          = 0x341
+  val mcause        = 0x342
+  val mip           = 0x344
+  val mcycle        = 0xb00
+  val minstret      = 0xb02
+  val mhpmcounter3  = 0xb03
+  val mcycleh       = 0xb80
+  val minstreth     = 0xb82
+  val mhpmcounter3h = 0xb83
+  val cycle         = 0xc00
+  val time          = 0xc01
+  val instret       = 0xc02
+  val hpmcounter3   = 0xc03
+  val cycleh        = 0xc80
+  val timeh         = 0xc81
+  val instreth      = 0xc82
+  val hpmcounter3h  = 0xc83
+}
+
+// Interrupt numbers, their mip/mie bit and mcause. UART0, GPIO0 and the DMA use local interrupts as there is no PLIC.
+object Interrupt {
+  val software = 3
+  val timer    = 7
+  val uartRx   = 16 // RX FIFO not empty
+  val uartTx   = 17 // TX FIFO below the watermark
+  val gpio     = 18 // GPIO edge pending
+  val dma      = 19 // DMA transfer done
+
+  // Taken in this order when several are pending
+  val priority = Seq(software, timer, uartRx, uartTx, gpio, dma)
+  val mask     = priority.map(1L << _).reduce(_ | _)
+
+  // mip value of the interrupt lines
+  def lines(sources: (Int, Bool)*): UInt = sources.map { case (i, line) => line.asUInt << i }.reduce(_ | _)
+}
+
+// mcause of the synchronous traps
+object TrapCause {
+  val breakpoint = 3
+  val ecall      = 11
+}
+
+class CSRFilePort(bitWidth: Int = 32) extends Bundle {
+  val inst    = Input(Instruction())      // CSR instruction, anything else does not access the CSRs
+  val address = Input(UInt(12.W))         // CSR address
+  val dataIn  = Input(UInt(bitWidth.W))   // rs1 value or zero-extended immediate
+  val dataOut = Output(UInt(bitWidth.W))  // CSR value before the write, goes to rd
+  val stall   = Input(Bool())             // 1 => Stall, 0 => Run
+  // Counter events, only for instructions that retire this cycle
+  val branchTaken = Input(Bool())
+  val load        = Input(Bool())
+  val store       = Input(Bool())
+  val mtime       = Input(UInt(64.W)) // From the CLINT, read through time
+  // Traps, the core raises trap or mret for the instruction that retires this cycle
+  val interrupts = Input(UInt(bitWidth.W))  // Interrupt lines, read through mip
+  val trap       = Input(Bool())            // Save mepc and mcause, disable interrupts
+  val trapCause  = Input(UInt(bitWidth.W))  // mcause of the trap
+  val trapPC     = Input(UInt(bitWidth.W))  // mepc of the trap
+  val mret       = Input(Bool())            // Restore the interrupt enable
+  val interrupt  = Output(Bool())           // An enabled interrupt is pending and mstatus.MIE is set
+  val cause      = Output(UInt(bitWidth.W)) // mcause of the highest priority enabled interrupt
+  val wakeup     = Output(Bool())           // An interrupt enabled in mie is pending, ends WFI even with MIE clear
+  val trapVector = Output(UInt(bitWidth.W)) // Handler address for trapCause
+  val mepc       = Output(UInt(bitWidth.W)) // Return address for mret
+}
+
+/**
+ * Zicsr/Zicntr counters: 64 bit cycle, time and instret plus the
+ * mhpmcounter3-6 event counters (3: stall cycles, 4: taken branches, 5: loads,
+ * 6: stores). The machine counters (mcycle, minstret, mhpmcounterN) are
+ * writable and can be stopped with mcountinhibit, the user counters (cycle,
+ * time, instret, hpmcounterN) are read-only views. Time reads the CLINT
+ * mtime (Syscon reports its frequency).
+ *
+ * Machine mode traps: mstatus (MIE, MPIE, MPP hardwired to M), mie, mip,
+ * mtvec (direct or vectored), mscratch, mepc and mcause. Unimplemented CSRs
+ * read as 0 and ignore writes.
+ */
+class CSRFile(bitWidth: Int = 32) extends Module {
+  val io = IO(new CSRFilePort(bitWidth))
+
+  // Counter index (the low bits of the CSR address and the mcountinhibit bit) and its event
+  val events = Seq(
+    0 -> true.B,         // cycle
+    2 -> !io.stall,      // instret
+    3 -> io.stall,       // stall cycles
+    4 -> io.branchTaken, // taken branches
+    5 -> io.load,        // loads
+    6 -> io.store,       // stores
+  )
+  val counters      = events.map { case (i, _) => i -> RegInit(0.U(64.W)) }.toMap
+  val mcountinhibit = RegInit(0.U(bitWidth.W))
+
+  val mstatusMIE  = RegInit(false.B)
+  val mstatusMPIE = RegInit(false.B)
+  val mie         = RegInit(0.U(bitWidth.W))
+  val mtvec       = RegInit(0.U(bitWidth.W))
+  val mscratch    = RegInit(0.U(bitWidth.W))
+  val mepc        = RegInit(0.U(bitWidth.W))
+  val mcause      = RegInit(0.U(bitWidth.W))
+  val mip         = io.interrupts & Interrupt.mask.U
+  val mstatus     = Cat(3.U(2.W), 0.U(3.W), mstatusMPIE, 0.U(3.W), mstatusMIE, 0.U(3.W))
+
+  val readMap = Seq(
+    CSRAddress.mstatus       -> mstatus,
+    CSRAddress.mie           -> mie,
+    CSRAddress.mtvec         -> mtvec,
+    CSRAddress.mscratch      -> mscratch,
+    CSRAddress.mepc          -> mepc,
+    CSRAddress.mcause        -> mcause,
+    CSRAddress.mip           -> mip,
+    CSRAddress.mcountinhibit -> mcountinhibit,
+    CSRAddress.time          -> io.mtime(31, 0),
+    CSRAddress.timeh         -> io.mtime(63, 32),
+  ) ++ counters.toSeq.flatMap { case (i, counter) =>
+    Seq(
+      (CSRAddress.mcycle + i)  -> counter(31, 0),
+      (CSRAddress.mcycleh + i) -> counter(63, 32),
+      (CSRAddress.cycle + i)   -> counter(31, 0),
+      (CSRAddress.cycleh + i)  -> counter(63, 32),
+    )
+  }
+  io.dataOut := MuxLookup(io.address, 0.U)(readMap.map { case (addr, value) => addr.U -> value })
+
+  // CSRRS/CSRRC with x0 (or a zero immediate) only read the CSR
+  val isWrite = io.inst.isOneOf(CSRRW, CSRRWI) ||
+    (io.inst.isOneOf(CSRRS, CSRRC, CSRRSI, CSRRCI) && io.dataIn =/= 0.U)
+  val write = isWrite && !io.stall
+  val writeData = MuxCase(
+    io.dataIn,
+    Seq(
+      io.inst.isOneOf(CSRRS, CSRRSI) -> (io.dataOut | io.dataIn),
+      io.inst.isOneOf(CSRRC, CSRRCI) -> (io.dataOut & ~io.dataIn),
+    ),
+  )
+
+  events.foreach { case (i, event) =>
+    val counter = counters(i)
+    when(event && !mcountinhibit(i)) {
+      counter := counter + 1.U
+    }
+    // Software writes win over the increment
+    when(write && io.address === (CSRAddress.mcycle + i).U) {
+      counter := Cat(counter(63, 32), writeData)
+    }
+    when(write && io.address === (CSRAddress.mcycleh + i).U) {
+      counter := Cat(writeData, counter(31, 0))
+    }
+  }
+
+  when(write && io.address === CSRAddress.mcountinhibit.U) {
+    mcountinhibit := writeData & events.map { case (i, _) => (1L << i).U }.reduce(_ | _)
+  }
+
+  when(write && io.address === CSRAddress.mstatus.U) {
+    mstatusMIE  := writeData(3)
+    mstatusMPIE := writeData(7)
+  }
+  when(write && io.address === CSRAddress.mie.U)(mie := writeData & Interrupt.mask.U)
+  when(write && io.address === CSRAddress.mtvec.U)(mtvec := Cat(writeData(bitWidth - 1, 2), 0.U(1.W), writeData(0)))
+  when(write && io.address === CSRAddress.mscratch.U)(mscratch := writeData)
+  when(write && io.address === CSRAddress.mepc.U)(mepc := Cat(writeData(bitWidth - 1, 1), 0.U(1.W)))
+  when(write && io.address === CSRAddress.mcause.U)(mcause := writeData)
+
+  // Traps save the return address and stack the interrupt enable, mret pops it
+  when(io.trap) {
+    mepc        := Cat(io.trapPC(bitWidth - 1, 1), 0.U(1.W))
+    mcause      := io.trapCause
+    mstatusMPIE := mstatusMIE
+    mstatusMIE  := false.B
+  }.elsewhen(io.mret) {
+    mstatusMIE  := mstatusMPIE
+    mstatusMPIE := true.B
+  }
+  io.mepc := mepc
+
+  val pending = mip & mie
+  io.wakeup    := pending.orR
+  io.interrupt := io.wakeup && mstatusMIE
+  io.cause     := Cat(1.U(1.W), PriorityMux(Interrupt.priority.map(i => pending(i) -> i.U((bitWidth - 1).W))))
+
+  // Vectored mode sends interrupts to base + 4 * cause, exceptions always go to base
+  val trapBase = Cat(mtvec(bitWidth - 1, 2), 0.U(2.W))
+  io.trapVector := Mux(
+    mtvec(0) && io.trapCause(bitWidth - 1),
+    trapBase + Cat(io.trapCause(4, 0), 0.U(2.W)),
+    trapBase,
+  )
+}
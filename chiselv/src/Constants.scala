@@ -12,10 +12,21 @@ object Instruction extends ChiselEnum {
   BEQ, BNE, BLT, BGE, BLTU, BGEU,              // Branches
   JAL, JALR,                                   // Jump & Link
   FENCE, FENCEI,                               // Sync
-  ECALL, EBREAK,                               // Environment
+  ECALL, EBREAK, MRET, WFI,                    // Environment and trap return
   CSRRW, CSRRS, CSRRC, CSRRWI, CSRRSI, CSRRCI, // CSR
   LB, LH, LBU, LHU, LW,                        // Loads
   SB, SH, SW,                                  // Stores
+  // RV32M
+  MUL, MULH, MULHSU, MULHU,                    // Multiply
+  DIV, DIVU, REM, REMU,                        // Divide
+  // Zba and Zbb
+  SH1ADD, SH2ADD, SH3ADD,                      // Address generation
+  ANDN, ORN, XNOR,                             // Logical with negate
+  CLZ, CTZ, CPOP,                              // Bit count
+  MAX, MAXU, MIN, MINU,                        // Integer minimum and maximum
+  SEXTB, SEXTH, ZEXTH,                         // Sign and zero extension
+  ROL, ROR, RORI,                              // Rotates
+  ORCB, REV8,                                  // Byte granular operations
   EQ, NEQ, GTE, GTEU                           // Not instructions but auxiliaries
   = Value
 }
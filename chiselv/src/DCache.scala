@@ -0,0 +1,221 @@
+package chiselv
+
+import chisel3._
+import chisel3.util.{Cat, Mux1H, is, log2Ceil, switch}
+
+// Core side of the data cache, decoded by MemoryIOManager
+class DCachePort(bitWidth: Int = 32) extends Bundle {
+  val read      = Input(Bool())
+  val write     = Input(Bool())
+  val address   = Input(UInt(28.W)) // Offset in the 0x4000_0000 - 0x4FFF_FFFF window
+  val writeData = Input(UInt(bitWidth.W))
+  val writeMask = Input(UInt((bitWidth / 8).W))
+  val readData  = Output(UInt(bitWidth.W))
+  val ready     = Output(Bool()) // 1 => The access completes in this cycle
+  val control   = new DCacheControlPort(bitWidth)
+}
+
+// Control and counter registers at 0x3000_5000
+class DCacheControlPort(bitWidth: Int = 32) extends Bundle {
+  val Address     = Input(UInt(8.W))
+  val DataOut     = Output(UInt(bitWidth.W))
+  val DataIn      = Input(UInt(bitWidth.W))
+  val WriteEnable = Input(Bool())
+}
+
+object DCacheState extends ChiselEnum {
+  val idle, writeback, fill, flush = Value
+}
+
+/**
+ * Write-back, write-allocate data cache in front of the external RAM. Direct
+ * mapped or two way set associative (LRU replacement), hits complete in the
+ * same cycle like the on-chip RAM. A miss writes the victim line back if it is
+ * dirty, then fills the whole line, ready stays low until the access hits.
+ * Software writes the dirty lines back (flush) before another master reads
+ * the memory and drops the lines (invalidate) after one wrote it.
+ */
+class DCache(
+    bitWidth:    Int = 32,
+    windowBytes: Long = 32 * 1024 * 1024,
+    sizeBytes:   Int = 4 * 1024,
+    lineBytes:   Int = 32,
+    ways:        Int = 2,
+  ) extends Module {
+  require(ways == 1 || ways == 2, "The data cache is direct mapped or two way set associative")
+  val lineWords = lineBytes / (bitWidth / 8)
+  val sets      = sizeBytes / lineBytes / ways
+  require(sets > 1 && (sets & (sets - 1)) == 0, "The cache must have a power of two number of sets")
+  require(lineWords > 1 && (lineWords & (lineWords - 1)) == 0, "Lines must be a power of two words")
+
+  val io = IO(new Bundle {
+    val cpu  = new DCachePort(bitWidth)
+    val dram = Flipped(new DRAMPort(bitWidth, log2Ceil(windowBytes)))
+  })
+
+  val offsetBits = log2Ceil(lineBytes)
+  val indexBits  = log2Ceil(sets)
+  val address    = io.cpu.address(log2Ceil(windowBytes) - 1, 0)
+  val index      = address(offsetBits + indexBits - 1, offsetBits)
+  val tag        = address(address.getWidth - 1, offsetBits + indexBits)
+  val word       = address(offsetBits - 1, 2)
+
+  val data  = Seq.fill(ways)(Mem(sets * lineWords, Vec(bitWidth / 8, UInt(8.W))))
+  val tags  = Seq.fill(ways)(Mem(sets, UInt(tag.getWidth.W)))
+  val valid = Seq.fill(ways)(RegInit(VecInit(Seq.fill(sets)(false.B))))
+  val dirty = Seq.fill(ways)(RegInit(VecInit(Seq.fill(sets)(false.B))))
+  val lru   = RegInit(VecInit(Seq.fill(sets)(false.B))) // Way to replace next
+
+  val state   = RegInit(DCacheState.idle)
+  val idle    = state === DCacheState.idle
+  val access  = io.cpu.read || io.cpu.write
+  val wayHits = (0 until ways).map(w => valid(w)(index) && tags(w).read(index) === tag)
+  val hit     = wayHits.reduce(_ || _)
+
+  io.cpu.readData := Mux1H(wayHits, data.map(_.read(Cat(index, word)).asUInt))
+  io.cpu.ready    := hit && idle
+
+  // Stores write their bytes into the line and mark it dirty
+  when(io.cpu.write && hit && idle) {
+    for (w <- 0 until ways) {
+      when(wayHits(w)) {
+        data(w).write(Cat(index, word), io.cpu.writeData.asTypeOf(Vec(bitWidth / 8, UInt(8.W))), io.cpu.writeMask.asBools)
+        dirty(w)(index) := true.B
+      }
+    }
+  }
+
+  // The line being written back or filled, the DRAM takes the request of each state once
+  val lineIndex    = RegInit(0.U(indexBits.W))
+  val lineWay      = RegInit(0.U(1.W))
+  val lineWord     = RegInit(0.U(log2Ceil(lineWords).W))
+  val writebackTag = RegInit(0.U(tag.getWidth.W))
+  val fillTag      = RegInit(0.U(tag.getWidth.W))
+  val requested    = RegInit(false.B)
+  val flushing     = RegInit(false.B) // The write back is part of a flush, go back to it
+  def select[T <: Data](way: UInt, values: Seq[T]) = Mux1H((0 until ways).map(w => way === w.U), values)
+
+  val victim =
+    if (ways == 1) 0.U
+    else Mux(!valid(0)(index), 0.U, Mux(!valid(1)(index), 1.U, lru(index).asUInt))
+  val miss = access && !hit && idle
+
+  // The victim is dropped right away, its data stays until the write back is done
+  when(miss) {
+    lineIndex    := index
+    lineWay      := victim
+    lineWord     := 0.U
+    writebackTag := select(victim, tags.map(_.read(index)))
+    fillTag      := tag
+    state := Mux(
+      select(victim, (0 until ways).map(w => valid(w)(index) && dirty(w)(index))),
+      DCacheState.writeback,
+      DCacheState.fill,
+    )
+    for (w <- 0 until ways) {
+      when(victim === w.U) {
+        valid(w)(index) := false.B
+        dirty(w)(index) := false.B
+        tags(w).write(index, tag)
+      }
+    }
+  }
+
+  val writingBack = state === DCacheState.writeback
+  io.dram.request   := (writingBack || state === DCacheState.fill) && !requested
+  io.dram.write     := writingBack
+  io.dram.address   := Cat(Mux(writingBack, writebackTag, fillTag), lineIndex, 0.U(offsetBits.W))
+  io.dram.writeData := select(lineWay, data.map(_.read(Cat(lineIndex, lineWord)).asUInt))
+  when(io.dram.request && io.dram.idle) {
+    requested := true.B
+  }
+
+  val lastWord   = lineWord === (lineWords - 1).U
+  val writebacks = RegInit(0.U(32.W))
+  when(writingBack && io.dram.writeNext) {
+    lineWord := lineWord + 1.U
+    when(lastWord) {
+      requested  := false.B
+      writebacks := writebacks + 1.U
+      state      := Mux(flushing, DCacheState.flush, DCacheState.fill)
+    }
+  }
+
+  when(state === DCacheState.fill && io.dram.readValid) {
+    lineWord := lineWord + 1.U
+    for (w <- 0 until ways) {
+      when(lineWay === w.U) {
+        data(w).write(Cat(lineIndex, lineWord), io.dram.readData.asTypeOf(Vec(bitWidth / 8, UInt(8.W))))
+        when(lastWord) {
+          valid(w)(lineIndex) := true.B
+        }
+      }
+    }
+    when(lastWord) {
+      requested := false.B
+      state     := DCacheState.idle
+      if (ways > 1) lru(lineIndex) := !lineWay.asBool
+    }
+  }
+
+  // Flush walks every line and writes back the dirty ones, then drops them all when asked to invalidate too
+  val flushLine  = RegInit(0.U((indexBits + log2Ceil(ways) + 1).W))
+  val invalidate = RegInit(false.B)
+  def invalidateAll() =
+    for (w <- 0 until ways) {
+      valid(w).foreach(_ := false.B)
+      dirty(w).foreach(_ := false.B)
+    }
+
+  when(state === DCacheState.flush) {
+    val flushIndex = flushLine(indexBits - 1, 0)
+    val flushWay   = if (ways == 1) 0.U else flushLine(indexBits)
+    when(flushLine === (sets * ways).U) {
+      when(invalidate)(invalidateAll())
+      flushing := false.B
+      state    := DCacheState.idle
+    }.elsewhen(select(flushWay, (0 until ways).map(w => valid(w)(flushIndex) && dirty(w)(flushIndex)))) {
+      lineIndex    := flushIndex
+      lineWay      := flushWay
+      lineWord     := 0.U
+      writebackTag := select(flushWay, tags.map(_.read(flushIndex)))
+      state        := DCacheState.writeback
+      for (w <- 0 until ways) {
+        when(flushWay === w.U)(dirty(w)(flushIndex) := false.B)
+      }
+    }
+    flushLine := flushLine + 1.U
+  }
+
+  // Counters, a hit only counts when the access completes
+  val hits   = RegInit(0.U(32.W))
+  val misses = RegInit(0.U(32.W))
+  when(access && hit && idle) {
+    hits := hits + 1.U
+    if (ways > 1) lru(index) := !wayHits(1)
+  }
+  when(miss) {
+    misses := misses + 1.U
+  }
+
+  // Control registers, commands are only taken while idle
+  val control = io.cpu.control
+  when(control.WriteEnable && control.Address === 0x00.U && idle) {
+    when(control.DataIn(0)) {
+      flushLine  := 0.U
+      flushing   := true.B
+      invalidate := control.DataIn(1)
+      state      := DCacheState.flush
+    }.elsewhen(control.DataIn(1)) {
+      invalidateAll()
+    }
+  }
+  control.DataOut := 0.U
+  switch(control.Address) {
+    is(0x00.U)(control.DataOut := !idle)
+    is(0x04.U)(control.DataOut := hits)
+    is(0x08.U)(control.DataOut := misses)
+    is(0x0c.U)(control.DataOut := writebacks)
+    is(0x10.U)(control.DataOut := lineBytes.U)
+  }
+}
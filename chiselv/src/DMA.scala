@@ -0,0 +1,202 @@
+package chiselv
+
+import chisel3._
+import chisel3.util.{Cat, Decoupled, Fill, MuxLookup, PriorityEncoder, is, log2Ceil, switch}
+
+// RAM access of the DMA, granted by MemoryIOManager in the cycles the core does not use the port
+class DMARAMPort(bitWidth: Int = 32) extends Bundle {
+  val readRequest  = Output(Bool())
+  val readAddr     = Output(UInt(bitWidth.W))
+  val readGrant    = Input(Bool())
+  val readData     = Input(UInt(bitWidth.W)) // Word read the cycle after a granted request
+  val writeRequest = Output(Bool())
+  val writeAddr    = Output(UInt(bitWidth.W))
+  val writeData    = Output(UInt(bitWidth.W))
+  val writeMask    = Output(UInt((bitWidth / 8).W))
+  val writeGrant   = Input(Bool())
+}
+
+class DMAPort(bitWidth: Int = 32) extends Bundle {
+  // Channel registers at 0x3000_4000
+  val Address     = Input(UInt(12.W))
+  val DataOut     = Output(UInt(bitWidth.W))
+  val DataIn      = Input(UInt(bitWidth.W))
+  val WriteEnable = Input(Bool())
+  // Bus master side, the UART0 FIFOs are shared with the core the same way as the RAM
+  val ram    = new DMARAMPort(bitWidth)
+  val uartTx = Decoupled(UInt(8.W))
+  val uartRx = Flipped(Decoupled(UInt(8.W)))
+}
+
+// Transfer directions (CTRL bits 1:0)
+object DMAMode {
+  val ramToRam  = 0
+  val ramToUart = 1
+  val uartToRam = 2
+}
+
+/**
+ * DMA controller for the on-chip RAM and UART0. Each channel copies COUNT
+ * elements of 1, 2 or 4 bytes from SRC to DST, adding the (signed) strides
+ * to the addresses after each one, so a zero stride keeps reading or writing
+ * the same word. UART transfers move the low byte of each element.
+ *
+ * Channel n registers at n * 0x20:
+ *   0x00 SRC, 0x04 DST, 0x08 COUNT (elements left), 0x0C SRC stride,
+ *   0x10 DST stride, 0x14 CTRL [8: start, 4: interrupt on completion,
+ *   3:2 element size (0 byte, 1 halfword, 2 word), 1:0 mode (DMAMode)],
+ *   0x18 STATUS [1: done (write 1 to clear), 0: busy].
+ *
+ * The busy channels take turns one element at a time. The RAM read and write
+ * ports and the UART FIFOs are only used in the cycles the core leaves them
+ * free, so a copy moves up to one element per cycle while the core runs code
+ * that does not access RAM. Addresses are RAM offsets, other regions are not
+ * reachable. Software must not touch a buffer while a channel uses it.
+ */
+class DMA(bitWidth: Int = 32, channels: Int = 2) extends Module {
+  val io        = IO(new DMAPort(bitWidth))
+  val interrupt = IO(Output(Bool())) // A channel with the completion interrupt enabled is done
+  val chanBits  = log2Ceil(channels).max(1)
+
+  val src       = RegInit(VecInit(Seq.fill(channels)(0.U(bitWidth.W))))
+  val dst       = RegInit(VecInit(Seq.fill(channels)(0.U(bitWidth.W))))
+  val count     = RegInit(VecInit(Seq.fill(channels)(0.U(bitWidth.W))))
+  val srcStride = RegInit(VecInit(Seq.fill(channels)(0.U(bitWidth.W))))
+  val dstStride = RegInit(VecInit(Seq.fill(channels)(0.U(bitWidth.W))))
+  val ctrl      = RegInit(VecInit(Seq.fill(channels)(0.U(5.W))))
+  val active    = RegInit(VecInit(Seq.fill(channels)(false.B)))
+  val done      = RegInit(VecInit(Seq.fill(channels)(false.B)))
+
+  def mode(c: UInt) = ctrl(c)(1, 0)
+  def size(c: UInt) = ctrl(c)(3, 2)
+
+  // Element being written: read from the RAM last cycle (data in readData) or held until the write is granted
+  val wValid  = RegInit(false.B)
+  val wFresh  = RegInit(false.B) // The data is on readData this cycle
+  val wChan   = RegInit(0.U(chanBits.W))
+  val wData   = RegInit(0.U(bitWidth.W))
+  val wSrcOff = RegInit(0.U(2.W))
+  val wDst    = RegInit(0.U(bitWidth.W))
+  val wSize   = RegInit(0.U(2.W))
+  val wToUart = RegInit(false.B)
+
+  // Element value, right aligned
+  val readShifted = io.ram.readData >> Cat(wSrcOff, 0.U(3.W))
+  val element = Mux(
+    wFresh,
+    MuxLookup(wSize, readShifted)(Seq(0.U -> readShifted(7, 0), 1.U -> readShifted(15, 0))),
+    wData,
+  )
+
+  // Write it to the UART TX FIFO or to its byte lanes in RAM
+  val wOffset = wDst(1, 0)
+  io.uartTx.valid := wValid && wToUart
+  io.uartTx.bits  := element(7, 0)
+
+  io.ram.writeRequest := wValid && !wToUart
+  io.ram.writeAddr    := wDst
+  io.ram.writeData    := element
+  io.ram.writeMask    := "b1111".U
+  switch(wSize) {
+    is(0.U) {
+      io.ram.writeData := Fill(4, element(7, 0))
+      io.ram.writeMask := 1.U << wOffset
+    }
+    is(1.U) {
+      io.ram.writeData := Fill(2, element(15, 0))
+      io.ram.writeMask := Mux(wOffset(1), "b1100".U, "b0011".U)
+    }
+  }
+  val written = Mux(wToUart, io.uartTx.ready, io.ram.writeGrant)
+  when(wValid && !written) {
+    wData  := element
+    wFresh := false.B
+  }
+  when(wValid && written) {
+    wValid := false.B
+  }
+
+  // Next element, from the busy channel after the last one served that has its source ready. A byte for the UART
+  // is only read while the TX FIFO has room, so a full FIFO does not hold up the other channels.
+  val stageFree = !wValid || written
+  val ready = VecInit((0 until channels).map { c =>
+    val fromUart = mode(c.U) === DMAMode.uartToRam.U
+    val toUart   = mode(c.U) === DMAMode.ramToUart.U
+    active(c) && count(c) =/= 0.U && stageFree && Mux(fromUart, io.uartRx.valid, io.ram.readGrant) &&
+    (!toUart || io.uartTx.ready && !(wValid && wToUart))
+  })
+  val last      = RegInit(0.U(chanBits.W))
+  val afterLast = VecInit((0 until channels).map(c => ready(c) && c.U > last))
+  val issue     = ready.asUInt.orR
+  val chan      = Mux(afterLast.asUInt.orR, PriorityEncoder(afterLast.asUInt), PriorityEncoder(ready.asUInt))
+  val fromUart  = mode(chan) === DMAMode.uartToRam.U
+
+  io.ram.readRequest := issue && !fromUart
+  io.ram.readAddr    := src(chan)
+  io.uartRx.ready    := issue && fromUart
+
+  when(issue) {
+    last        := chan
+    wValid      := true.B
+    wFresh      := !fromUart
+    wChan       := chan
+    wData       := io.uartRx.bits
+    wSrcOff     := src(chan)(1, 0)
+    wDst        := dst(chan)
+    wSize       := size(chan)
+    wToUart     := mode(chan) === DMAMode.ramToUart.U
+    src(chan)   := src(chan) + srcStride(chan)
+    dst(chan)   := dst(chan) + dstStride(chan)
+    count(chan) := count(chan) - 1.U
+  }
+
+  // A channel is done once its last element is written
+  for (c <- 0 until channels) {
+    val inFlight = (wValid && !written && wChan === c.U) || (issue && chan === c.U)
+    when(active(c) && count(c) === 0.U && !inFlight) {
+      active(c) := false.B
+      done(c)   := true.B
+    }
+  }
+
+  // Registers, a start while the channel is busy is ignored
+  val regChan = io.Address(chanBits + 4, 5)
+  val reg     = io.Address(4, 0)
+  val inRange = io.Address(11, 5) < channels.U
+  when(io.WriteEnable && inRange) {
+    switch(reg) {
+      is(0x00.U)(src(regChan)       := io.DataIn)
+      is(0x04.U)(dst(regChan)       := io.DataIn)
+      is(0x08.U)(count(regChan)     := io.DataIn)
+      is(0x0c.U)(srcStride(regChan) := io.DataIn)
+      is(0x10.U)(dstStride(regChan) := io.DataIn)
+      is(0x14.U) {
+        when(!active(regChan)) {
+          ctrl(regChan) := io.DataIn(4, 0)
+          when(io.DataIn(8)) {
+            active(regChan) := true.B
+            done(regChan)   := false.B
+          }
+        }
+      }
+      is(0x18.U) {
+        when(io.DataIn(1))(done(regChan) := false.B)
+      }
+    }
+  }
+
+  io.DataOut := 0.U
+  when(inRange) {
+    switch(reg) {
+      is(0x00.U)(io.DataOut := src(regChan))
+      is(0x04.U)(io.DataOut := dst(regChan))
+      is(0x08.U)(io.DataOut := count(regChan))
+      is(0x0c.U)(io.DataOut := srcStride(regChan))
+      is(0x10.U)(io.DataOut := dstStride(regChan))
+      is(0x14.U)(io.DataOut := ctrl(regChan))
+      is(0x18.U)(io.DataOut := Cat(done(regChan), active(regChan)))
+    }
+  }
+
+  interrupt := (0 until channels).map(c => done(c) && ctrl(c)(4)).reduce(_ || _)
+}
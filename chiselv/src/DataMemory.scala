@@ -30,7 +30,8 @@ class DualPortRAM(
     println(s"  Addr Width: " + io.readAddress.getWidth + " bit")
   }
 
-  val mem = SyncReadMem(words, UInt(bitWidth.W))
+  // One byte lane per writeMask bit so stores write only their bytes, without reading the word first
+  val mem = SyncReadMem(words, Vec(bitWidth / 8, UInt(8.W)))
 
   // Divide memory address by 4 to get the word due to pc+4 addressing
   val readAddress  = io.readAddress >> 2
@@ -41,9 +42,9 @@ class DualPortRAM(
     loadMemoryFromFileInline(mem, memoryFile)
   }
 
-  io.readData := mem.read(readAddress)
+  io.readData := mem.read(readAddress).asUInt
 
   when(io.writeEnable === true.B) {
-    mem.write(writeAddress, io.writeData)
+    mem.write(writeAddress, io.writeData.asTypeOf(Vec(bitWidth / 8, UInt(8.W))), io.writeMask.asBools)
   }
 }
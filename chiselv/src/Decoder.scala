@@ -71,6 +71,8 @@ class Decoder(bitWidth: Int = 32) extends Module {
         // Environment
         BitPat("b00000000000000000000000001110011")  -> List(INST_I,   ECALL, false.B,   false.B, false.B,   false.B, false.B,  false.B),
         BitPat("b00000000000100000000000001110011")  -> List(INST_I,  EBREAK, false.B,   false.B, false.B,   false.B, false.B,  false.B),
+        BitPat("b00110000001000000000000001110011")  -> List(INST_I,    MRET, false.B,   false.B, false.B,   false.B, false.B,  false.B),
+        BitPat("b00010000010100000000000001110011")  -> List(INST_I,     WFI, false.B,   false.B, false.B,   false.B, false.B,  false.B),
         // CSR
         BitPat("b?????????????????001?????1110011")  -> List(INST_I,   CSRRW, false.B,   false.B, false.B,   false.B, false.B,  false.B),
         BitPat("b?????????????????010?????1110011")  -> List(INST_I,   CSRRS, false.B,   false.B, false.B,   false.B, false.B,  false.B),
@@ -88,6 +90,44 @@ class Decoder(bitWidth: Int = 32) extends Module {
         BitPat("b?????????????????000?????0100011")  -> List(INST_S,      SB, false.B,   false.B, true.B,    false.B, false.B,   true.B),
         BitPat("b?????????????????001?????0100011")  -> List(INST_S,      SH, false.B,   false.B, true.B,    false.B, false.B,   true.B),
         BitPat("b?????????????????010?????0100011")  -> List(INST_S,      SW, false.B,   false.B, true.B,    false.B, false.B,   true.B),
+        // Multiply (RV32M)
+        BitPat("b0000001??????????000?????0110011")  -> List(INST_R,     MUL,  true.B,   false.B, false.B,   false.B, false.B,  false.B),
+        BitPat("b0000001??????????001?????0110011")  -> List(INST_R,    MULH,  true.B,   false.B, false.B,   false.B, false.B,  false.B),
+        BitPat("b0000001??????????010?????0110011")  -> List(INST_R,  MULHSU,  true.B,   false.B, false.B,   false.B, false.B,  false.B),
+        BitPat("b0000001??????????011?????0110011")  -> List(INST_R,   MULHU,  true.B,   false.B, false.B,   false.B, false.B,  false.B),
+        // Divide (RV32M), executed by the iterative divider instead of the ALU
+        BitPat("b0000001??????????100?????0110011")  -> List(INST_R,     DIV, false.B,   false.B, false.B,   false.B, false.B,  false.B),
+        BitPat("b0000001??????????101?????0110011")  -> List(INST_R,    DIVU, false.B,   false.B, false.B,   false.B, false.B,  false.B),
+        BitPat("b0000001??????????110?????0110011")  -> List(INST_R,     REM, false.B,   false.B, false.B,   false.B, false.B,  false.B),
+        BitPat("b0000001??????????111?????0110011")  -> List(INST_R,    REMU, false.B,   false.B, false.B,   false.B, false.B,  false.B),
+        // Address generation (Zba)
+        BitPat("b0010000??????????010?????0110011")  -> List(INST_R,  SH1ADD,  true.B,   false.B, false.B,   false.B, false.B,  false.B),
+        BitPat("b0010000??????????100?????0110011")  -> List(INST_R,  SH2ADD,  true.B,   false.B, false.B,   false.B, false.B,  false.B),
+        BitPat("b0010000??????????110?????0110011")  -> List(INST_R,  SH3ADD,  true.B,   false.B, false.B,   false.B, false.B,  false.B),
+        // Logical with negate (Zbb)
+        BitPat("b0100000??????????111?????0110011")  -> List(INST_R,    ANDN,  true.B,   false.B, false.B,   false.B, false.B,  false.B),
+        BitPat("b0100000??????????110?????0110011")  -> List(INST_R,     ORN,  true.B,   false.B, false.B,   false.B, false.B,  false.B),
+        BitPat("b0100000??????????100?????0110011")  -> List(INST_R,    XNOR,  true.B,   false.B, false.B,   false.B, false.B,  false.B),
+        // Bit count (Zbb)
+        BitPat("b011000000000?????001?????0010011")  -> List(INST_I,     CLZ,  true.B,   false.B, true.B,    false.B, false.B,  false.B),
+        BitPat("b011000000001?????001?????0010011")  -> List(INST_I,     CTZ,  true.B,   false.B, true.B,    false.B, false.B,  false.B),
+        BitPat("b011000000010?????001?????0010011")  -> List(INST_I,    CPOP,  true.B,   false.B, true.B,    false.B, false.B,  false.B),
+        // Integer minimum and maximum (Zbb)
+        BitPat("b0000101??????????110?????0110011")  -> List(INST_R,     MAX,  true.B,   false.B, false.B,   false.B, false.B,  false.B),
+        BitPat("b0000101??????????111?????0110011")  -> List(INST_R,    MAXU,  true.B,   false.B, false.B,   false.B, false.B,  false.B),
+        BitPat("b0000101??????????100?????0110011")  -> List(INST_R,     MIN,  true.B,   false.B, false.B,   false.B, false.B,  false.B),
+        BitPat("b0000101??????????101?????0110011")  -> List(INST_R,    MINU,  true.B,   false.B, false.B,   false.B, false.B,  false.B),
+        // Sign and zero extension (Zbb)
+        BitPat("b011000000100?????001?????0010011")  -> List(INST_I,   SEXTB,  true.B,   false.B, true.B,    false.B, false.B,  false.B),
+        BitPat("b011000000101?????001?????0010011")  -> List(INST_I,   SEXTH,  true.B,   false.B, true.B,    false.B, false.B,  false.B),
+        BitPat("b000010000000?????100?????0110011")  -> List(INST_R,   ZEXTH,  true.B,   false.B, false.B,   false.B, false.B,  false.B),
+        // Rotates (Zbb)
+        BitPat("b0110000??????????001?????0110011")  -> List(INST_R,     ROL,  true.B,   false.B, false.B,   false.B, false.B,  false.B),
+        BitPat("b0110000??????????101?????0110011")  -> List(INST_R,     ROR,  true.B,   false.B, false.B,   false.B, false.B,  false.B),
+        BitPat("b0110000??????????101?????0010011")  -> List(INST_I,    RORI,  true.B,   false.B, true.B,    false.B, false.B,  false.B),
+        // Byte granular operations (Zbb)
+        BitPat("b001010000111?????101?????0010011")  -> List(INST_I,    ORCB,  true.B,   false.B, true.B,    false.B, false.B,  false.B),
+        BitPat("b011010011000?????101?????0010011")  -> List(INST_I,    REV8,  true.B,   false.B, true.B,    false.B, false.B,  false.B),
       )
     ) // format: on
 
@@ -0,0 +1,88 @@
+package chiselv
+
+import chisel3._
+import chisel3.util.{Cat, Fill, log2Ceil}
+import chiselv.Instruction._
+
+class DividerPort(bitWidth: Int = 32) extends Bundle {
+  val inst = Input(Instruction())      // DIV, DIVU, REM or REMU, anything else keeps the divider idle
+  val a    = Input(UInt(bitWidth.W))   // Dividend (rs1), must be held while busy
+  val b    = Input(UInt(bitWidth.W))   // Divisor (rs2), must be held while busy
+  val kill = Input(Bool())             // 1 => Abandon the divide in progress, the core flushed it
+  val x    = Output(UInt(bitWidth.W))  // Quotient or remainder, valid when busy drops
+  val busy = Output(Bool())            // 1 => Stall the core, 0 => Result ready
+}
+
+/**
+ * Iterative restoring divider for the RV32M divide instructions. It computes
+ * one quotient bit per cycle on the operand magnitudes and fixes the signs at
+ * the end, so a divide stalls the core for bitWidth cycles plus the cycle that
+ * retires it. Division by zero and the signed overflow case (-2^(bitWidth-1) /
+ * -1) return the results defined by the spec without stalling. A divide
+ * flushed while busy (a trap taken in the pipelined core) is killed so the
+ * next one starts from its own operands.
+ */
+class Divider(bitWidth: Int = 32) extends Module {
+  val io = IO(new DividerPort(bitWidth))
+
+  val isDivide = io.inst.isOneOf(DIV, DIVU, REM, REMU)
+  val signed   = io.inst.isOneOf(DIV, REM)
+  val isRem    = io.inst.isOneOf(REM, REMU)
+
+  val aNeg     = signed && io.a(bitWidth - 1)
+  val bNeg     = signed && io.b(bitWidth - 1)
+  val aMag     = Mux(aNeg, 0.U - io.a, io.a)
+  val bMag     = Mux(bNeg, 0.U - io.b, io.b)
+  val minInt   = (BigInt(1) << (bitWidth - 1)).U(bitWidth.W)
+  val byZero   = io.b === 0.U
+  val overflow = signed && io.a === minInt && io.b.andR
+  val special  = byZero || overflow
+
+  val running   = RegInit(false.B)
+  val done      = RegInit(false.B)
+  val count     = RegInit(0.U(log2Ceil(bitWidth).W))
+  val quotient  = RegInit(0.U(bitWidth.W))
+  val remainder = RegInit(0.U(bitWidth.W))
+
+  // Shift the next dividend bit into the partial remainder and subtract the divisor when it fits.
+  // The first step runs in the cycle the divide is issued, straight from the operands.
+  val dividend = Mux(running, quotient, aMag)
+  val partial  = Cat(Mux(running, remainder, 0.U), dividend(bitWidth - 1))
+  val fits     = partial >= bMag
+  val nextRem  = Mux(fits, partial - bMag, partial)(bitWidth - 1, 0)
+  val nextQuo  = Cat(dividend(bitWidth - 2, 0), fits)
+  when(io.kill) {
+    running := false.B
+    done    := false.B
+  }.elsewhen(running) {
+    remainder := nextRem
+    quotient  := nextQuo
+    count     := count - 1.U
+    when(count === 1.U) {
+      running := false.B
+      done    := true.B
+    }
+  }.elsewhen(done) {
+    // The core retires the divide in this cycle
+    done := false.B
+  }.elsewhen(isDivide && !special) {
+    running   := true.B
+    count     := (bitWidth - 1).U
+    remainder := nextRem
+    quotient  := nextQuo
+  }
+
+  val result = Mux(
+    isRem,
+    Mux(aNeg, 0.U - remainder, remainder),
+    Mux(aNeg ^ bNeg, 0.U - quotient, quotient),
+  )
+  val specialResult = Mux(
+    byZero,
+    Mux(isRem, io.a, Fill(bitWidth, 1.U)),
+    Mux(isRem, 0.U, minInt),
+  )
+
+  io.x    := Mux(special, specialResult, result)
+  io.busy := isDivide && !special && !done
+}
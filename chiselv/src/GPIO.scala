@@ -10,6 +10,13 @@ class GPIOPort(bitWidth: Int = 32) extends Bundle {
   val directionOut   = Output(UInt(bitWidth.W))
   val writeValue     = Input(Bool())
   val writeDirection = Input(Bool())
+  // Edge interrupts: the enabled edges set their pin in pending until software writes a 1 to it
+  val risingOut      = Output(UInt(bitWidth.W))
+  val fallingOut     = Output(UInt(bitWidth.W))
+  val pendingOut     = Output(UInt(bitWidth.W))
+  val writeRising    = Input(Bool())
+  val writeFalling   = Input(Bool())
+  val clearPending   = Input(Bool())
   val stall          = Output(Bool()) // >1 => Stall, 0 => Run
 }
 
@@ -21,6 +28,7 @@ class GPIO(bitWidth: Int = 32, numGPIO: Int = 8) extends Module {
   val io = IO(new Bundle {
     val GPIOPort     = new GPIOPort(bitWidth)
     val externalPort = Analog(numGPIO.W)
+    val interrupt    = Output(Bool()) // An edge is pending
   })
 
   val GPIO      = RegInit(0.U(bitWidth.W))
@@ -48,6 +56,27 @@ class GPIO(bitWidth: Int = 32, numGPIO: Int = 8) extends Module {
   when(io.GPIOPort.writeDirection) {
     direction := io.GPIOPort.dataIn
   }
+
+  // Edge detection on the pin values, outputs included
+  val rising    = RegInit(0.U(bitWidth.W))
+  val falling   = RegInit(0.U(bitWidth.W))
+  val pending   = RegInit(0.U(bitWidth.W))
+  val lastValue = RegNext(io.GPIOPort.valueOut, 0.U)
+  val edges     = (io.GPIOPort.valueOut & ~lastValue & rising) | (~io.GPIOPort.valueOut & lastValue & falling)
+
+  io.GPIOPort.risingOut  := rising
+  io.GPIOPort.fallingOut := falling
+  io.GPIOPort.pendingOut := pending
+  io.interrupt           := pending.orR
+
+  when(io.GPIOPort.writeRising) {
+    rising := io.GPIOPort.dataIn
+  }
+  when(io.GPIOPort.writeFalling) {
+    falling := io.GPIOPort.dataIn
+  }
+  // A new edge wins over clearing its pin
+  pending := (pending & ~Mux(io.GPIOPort.clearPending, io.GPIOPort.dataIn, 0.U)) | edges
 }
 
 class GPIOInOut(numGPIO: Int) extends BlackBox with HasBlackBoxInline {
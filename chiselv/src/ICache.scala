@@ -0,0 +1,108 @@
+package chiselv
+
+import chisel3._
+import chisel3.util.{Cat, Mux1H, log2Ceil}
+
+/**
+ * Read-only instruction cache in front of the SPI flash for the XIP window.
+ * Direct mapped or two way set associative (LRU replacement), hits return the
+ * word in the same cycle like the ROM. A miss refills the whole line from the
+ * flash, ready stays low until the word is in the cache. Counts the fetches
+ * that hit and the line refills.
+ */
+class ICache(
+    bitWidth:    Int = 32,
+    windowBytes: Long = 16 * 1024 * 1024,
+    flashOffset: Long = 0,
+    sizeBytes:   Int = 4 * 1024,
+    lineBytes:   Int = 32,
+    ways:        Int = 2,
+  ) extends Module {
+  require(ways == 1 || ways == 2, "The instruction cache is direct mapped or two way set associative")
+  val lineWords = lineBytes / (bitWidth / 8)
+  val sets      = sizeBytes / lineBytes / ways
+  require(sets > 1 && (sets & (sets - 1)) == 0, "The cache must have a power of two number of sets")
+  require(lineWords > 1 && (lineWords & (lineWords - 1)) == 0, "Lines must be a power of two words")
+  require(windowBytes <= (1L << 24), "The flash is read with 24 bit addresses")
+
+  val io = IO(new Bundle {
+    val fetch  = new InstructionMemPort(bitWidth, windowBytes)
+    val enable = Input(Bool()) // The fetch address is in the window
+    val flash  = Flipped(new FlashReadPort(bitWidth))
+    val hits   = Output(UInt(32.W))
+    val misses = Output(UInt(32.W))
+  })
+
+  val offsetBits = log2Ceil(lineBytes)
+  val indexBits  = log2Ceil(sets)
+  val address    = io.fetch.readAddr
+  val index      = address(offsetBits + indexBits - 1, offsetBits)
+  val tag        = address(address.getWidth - 1, offsetBits + indexBits)
+  val word       = address(offsetBits - 1, 2)
+
+  val data  = Seq.fill(ways)(Mem(sets * lineWords, UInt(bitWidth.W)))
+  val tags  = Seq.fill(ways)(Mem(sets, UInt(tag.getWidth.W)))
+  val valid = Seq.fill(ways)(RegInit(VecInit(Seq.fill(sets)(false.B))))
+  val lru   = RegInit(VecInit(Seq.fill(sets)(false.B))) // Way to replace next
+
+  val wayHits = (0 until ways).map(w => valid(w)(index) && tags(w).read(index) === tag)
+  val hit     = wayHits.reduce(_ || _)
+
+  io.fetch.readData := Mux1H(wayHits, data.map(_.read(Cat(index, word))))
+  io.fetch.ready    := hit
+
+  // Line refill, the line is invalid until its last word arrives
+  val filling   = RegInit(false.B)
+  val fillIndex = RegInit(0.U(indexBits.W))
+  val fillWay   = RegInit(0.U(1.W))
+  val fillWord  = RegInit(0.U(log2Ceil(lineWords).W))
+  val victim =
+    if (ways == 1) 0.U
+    else Mux(!valid(0)(index), 0.U, Mux(!valid(1)(index), 1.U, lru(index).asUInt))
+  val miss = io.enable && !hit && !filling && io.flash.idle
+
+  io.flash.request := miss
+  io.flash.address := flashOffset.U(24.W) + Cat(address(address.getWidth - 1, offsetBits), 0.U(offsetBits.W))
+
+  when(miss) {
+    filling   := true.B
+    fillIndex := index
+    fillWay   := victim
+    fillWord  := 0.U
+    for (w <- 0 until ways) {
+      when(victim === w.U) {
+        valid(w)(index) := false.B
+        tags(w).write(index, tag)
+      }
+    }
+  }
+
+  when(filling && io.flash.valid) {
+    fillWord := fillWord + 1.U
+    for (w <- 0 until ways) {
+      when(fillWay === w.U) {
+        data(w).write(Cat(fillIndex, fillWord), io.flash.data)
+        when(fillWord === (lineWords - 1).U) {
+          valid(w)(fillIndex) := true.B
+        }
+      }
+    }
+    when(fillWord === (lineWords - 1).U) {
+      filling := false.B
+      if (ways > 1) lru(fillIndex) := !fillWay.asBool
+    }
+  }
+
+  // Counters, a hit only counts when the core takes the word
+  val hits   = RegInit(0.U(32.W))
+  val misses = RegInit(0.U(32.W))
+  when(io.enable && io.fetch.fetch && hit) {
+    hits := hits + 1.U
+    if (ways > 1) lru(index) := !wayHits(1)
+  }
+  when(miss) {
+    misses := misses + 1.U
+  }
+  io.hits   := hits
+  io.misses := misses
+}
@@ -7,7 +7,8 @@ import chisel3.util.log2Ceil
 class InstructionMemPort(val bitWidth: Int, val sizeBytes: Long) extends Bundle {
   val readAddr = Input(UInt(log2Ceil(sizeBytes).W))
   val readData = Output(UInt(bitWidth.W))
-  val ready    = Output(Bool())
+  val ready    = Output(Bool())  // 0 => Stall the fetch, readData is not valid
+  val fetch    = Input(Bool())   // The core takes readData this cycle, for the instruction cache counters
 }
 
 class InstructionMemory(
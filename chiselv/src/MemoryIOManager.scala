@@ -1,29 +1,63 @@
 package chiselv
 
 import chisel3._
-import chisel3.util.{Cat, Fill, is, log2Ceil, switch}
+import chisel3.util.{Cat, Fill, RegEnable, is, log2Ceil, switch}
 
 /* Memory Map
  *
  * 0x0000_0000 - 0x0000_00FF: Reserved
  * 0x0000_0100 - 0x0000_0FFF: Debug
  * 0x0000_1000 - 0x0000_1FFF: Syscon
+ *                 0x38 (Has flash XIP window Read)
+ *                 0x3C (External RAM size Read)
+ *                 0x40 (Exit status Read/Write) [(code << 1) | 1]
+ *                 0x44 (CLINT mtime frequency Read)
+ *                 0x48 (Instruction cache hits Read)
+ *                 0x4C (Instruction cache misses Read)
+ *                 0x50 (Number of bus devices Read)
+ *                 0x100 + 0x10 * n (Bus device n: id, +0x04 base, +0x08 size Read)
  * 0x0000_2000 - 0x0000_FFFF: Reserved
  * 0x0003_0000 - 0x0003_FFFF: ROM (64KB)
- * 0x0001_0000 - 0x2FFF_FFFF: Reserved
+ * 0x0001_0000 - 0x01FF_FFFF: Reserved
+ * 0x0200_0000 - 0x0200_FFFF: CLINT (see CLINT)
+ *                 0x0000 (msip Read/Write) [software interrupt pending]
+ *                 0x4000 (mtimecmp Read/Write, 0x4004 high word)
+ *                 0xBFF8 (mtime Read/Write, 0xBFFC high word)
+ * 0x0201_0000 - 0x1FFF_FFFF: Reserved
+ * 0x2000_0000 - 0x20FF_FFFF: SPI flash XIP window, instruction fetch only (see SOC and ICache)
+ * 0x2100_0000 - 0x2FFF_FFFF: Reserved
  * 0x3000_0000 - 0x3000_0FFF: UART0
  *                 0x00 (TX Write)
  *                 0x04 (RX Read)
  *                 0x0C (Status Read) [txFull|rxFull|txEmpty|rxEmpty]
  *                 0x10 (Clock Divisor Read/Write)
+ *                 0x14 (TX FIFO level Read) [bytes waiting to be sent]
+ *                 0x18 (RX FIFO level Read) [bytes waiting to be read]
+ *                 0x1C (FIFO size Read) [entries in each FIFO]
+ *                 0x20 (TX watermark Write) [TX interrupt while fewer bytes wait, 0 disables]
  * 0x3000_1000 - 0x3000_1FFF: GPIO0
  *                 0x00 (direction - 0: input, 1: output)
  *                 0x04 (value     - 0: low, 1: high)
- * 0x3000_2000 - 0x3000_2FFF: PWM0
+ *                 0x08 (rising edge interrupt enable)
+ *                 0x0C (falling edge interrupt enable)
+ *                 0x10 (edge pending - write 1 to clear)
+ * 0x3000_2000 - 0x3000_2FFF: PWM0 (not implemented, reads as 0)
  * 0x3000_3000 - 0x3000_3FFF: Timer0
  *                 0x00 (32 bit value in miliseconds)
- * 0x3000_4000 - 0x3FFF_FFFF: Reserved
- * 0x4000_0000 - 0x4FFF_FFFF: Reserved
+ * 0x3000_4000 - 0x3000_4FFF: DMA (see DMA), channel n at n * 0x20
+ *                 0x00 (Source Read/Write), 0x04 (Destination Read/Write)
+ *                 0x08 (Count Read/Write) [elements left]
+ *                 0x0C (Source stride Read/Write), 0x10 (Destination stride Read/Write)
+ *                 0x14 (Control Read/Write) [start|..|irq|size(2)|mode(2)]
+ *                 0x18 (Status Read) [done|busy], (Write) [done: 1 to clear]
+ * 0x3000_5000 - 0x3000_5FFF: Data cache
+ *                 0x00 (Control Write) [invalidate|flush], (Status Read) [busy]
+ *                 0x04 (Hits Read)
+ *                 0x08 (Misses Read)
+ *                 0x0C (Write backs Read)
+ *                 0x10 (Line size Read)
+ * 0x3000_6000 - 0x3FFF_FFFF: Reserved, devices added by the SOC (see BusDevice)
+ * 0x4000_0000 - 0x4FFF_FFFF: External SDRAM through the data cache (see SOC and DCache)
  * 0x5000_0000 - 0x7000_0000: Reserved
  * 0x8000_0000 - 0x8FFF_FFFF: On-chip memory RAM
  * 0x9000_0000 - 0x9FFF_FFFF: Reserved
@@ -38,9 +72,40 @@ class MMIOPort(val bitWidth: Int, val addressSize: Long) extends Bundle {
   val writeData    = Input(UInt(bitWidth.W))
   val writeMask    = Input(UInt((bitWidth / 8).W))
   val dataSize     = Input(UInt(2.W))
+  // Address of the next load, given a cycle before its readRequest when the core knows it. A RAM load whose
+  // address was read ahead has its data ready without a stall.
+  val readAhead     = Input(Bool())
+  val readAheadAddr = Input(UInt(log2Ceil(addressSize).W))
 }
 
-class MemoryIOManager(bitWidth: Int = 32, sizeBytes: Long = 1024) extends Module {
+object MemoryIOManager {
+  // Devices of the core on the MMIO bus, the SOC adds its own after these (see Syscon for the device table)
+  val devices = Seq(
+    BusDevice("syscon", 1, 0x0000_1000L, 0x1000),
+    BusDevice("clint", 2, 0x0200_0000L, 0x1_0000),
+    BusDevice("uart0", 3, 0x3000_0000L, 0x1000),
+    BusDevice("gpio0", 4, 0x3000_1000L, 0x1000),
+    BusDevice("timer0", 5, 0x3000_3000L, 0x1000),
+    BusDevice("dma", 6, 0x3000_4000L, 0x1000),
+    BusDevice("dcache", 7, 0x3000_5000L, 0x1000),
+  )
+}
+
+/**
+ * Loads and stores of the core. RAM and the external RAM have their own ports,
+ * everything else goes over the MMIO bus (see BusInterconnect) to the devices
+ * of the core and the extra ones of the SOC in extDevices. With
+ * registeredDecode the bus select is decoded from readAheadAddr, which must
+ * then hold the address of the next access a cycle ahead (the pipelined core
+ * gives its EX address), otherwise from the address of the access. An access
+ * stalls until its device answers, the devices of the core answer at once.
+ */
+class MemoryIOManager(
+    bitWidth:         Int = 32,
+    sizeBytes:        Long = 1024,
+    extDevices:       Seq[BusDevice] = Seq(),
+    registeredDecode: Boolean = false,
+  ) extends Module {
   val io = IO(new Bundle {
     val MemoryIOPort = new MMIOPort(bitWidth, scala.math.pow(2, bitWidth).toLong)
     val GPIO0Port    = Flipped(new GPIOPort(bitWidth))
@@ -48,6 +113,10 @@ class MemoryIOManager(bitWidth: Int = 32, sizeBytes: Long = 1024) extends Module
     val UART0Port    = Flipped(new UARTPort)
     val DataMemPort  = Flipped(new MemoryPortDual(bitWidth, sizeBytes))
     val SysconPort   = Flipped(new SysconPort(bitWidth))
+    val CLINTPort    = Flipped(new CLINTPort(bitWidth))
+    val DCachePort   = Flipped(new DCachePort(bitWidth))
+    val DMAPort      = Flipped(new DMAPort(bitWidth))
+    val ExtBus       = Vec(extDevices.size, Flipped(new BusPort(bitWidth))) // Devices of the SOC
     val stall        = Output(Bool())
   })
 
@@ -59,6 +128,9 @@ class MemoryIOManager(bitWidth: Int = 32, sizeBytes: Long = 1024) extends Module
   io.GPIO0Port.dataIn         := 0.U
   io.GPIO0Port.writeValue     := false.B
   io.GPIO0Port.writeDirection := false.B
+  io.GPIO0Port.writeRising    := false.B
+  io.GPIO0Port.writeFalling   := false.B
+  io.GPIO0Port.clearPending   := false.B
 
   io.Timer0Port.dataIn      := 0.U
   io.Timer0Port.writeEnable := false.B
@@ -68,6 +140,8 @@ class MemoryIOManager(bitWidth: Int = 32, sizeBytes: Long = 1024) extends Module
   io.UART0Port.rxQueue.ready      := false.B
   io.UART0Port.clockDivisor.bits  := 0.U
   io.UART0Port.clockDivisor.valid := false.B
+  io.UART0Port.txWatermark.bits   := 0.U
+  io.UART0Port.txWatermark.valid  := false.B
 
   io.DataMemPort.writeEnable  := false.B
   io.DataMemPort.writeData    := 0.U
@@ -76,7 +150,21 @@ class MemoryIOManager(bitWidth: Int = 32, sizeBytes: Long = 1024) extends Module
   io.DataMemPort.dataSize     := 0.U
   io.DataMemPort.writeMask    := 0.U
 
-  io.SysconPort.Address := 0.U
+  io.SysconPort.Address     := 0.U
+  io.SysconPort.DataIn      := 0.U
+  io.SysconPort.WriteEnable := false.B
+
+  io.CLINTPort.Address     := 0.U
+  io.CLINTPort.DataIn      := 0.U
+  io.CLINTPort.WriteEnable := false.B
+
+  io.DCachePort.control.Address     := 0.U
+  io.DCachePort.control.DataIn      := 0.U
+  io.DCachePort.control.WriteEnable := false.B
+
+  io.DMAPort.Address     := 0.U
+  io.DMAPort.DataIn      := 0.U
+  io.DMAPort.WriteEnable := false.B
 
   // Stall Management
   val stallLatency = WireDefault(0.U(4.W))
@@ -87,175 +175,293 @@ class MemoryIOManager(bitWidth: Int = 32, sizeBytes: Long = 1024) extends Module
     DACK - 1.U,
     Mux(io.MemoryIOPort.readRequest || io.MemoryIOPort.writeRequest, stallLatency, 0.U),
   )
-  io.stall := (io.MemoryIOPort.readRequest || io.MemoryIOPort.writeRequest) && DACK =/= 1.U && stallEnable
+  // The external RAM stalls until the data cache has the line, the MMIO bus until the device answers
+  def isRAM(address: UInt)  = address(31, 28) === 0x8.U
+  def isDRAM(address: UInt) = address(31, 28) === 0x4.U
+  def isMMIO(address: UInt) = !isRAM(address) && !isDRAM(address)
+  val dramRead  = io.MemoryIOPort.readRequest && isDRAM(readAddress)
+  val dramWrite = io.MemoryIOPort.writeRequest && isDRAM(writeAddress)
+  val mmioRead  = io.MemoryIOPort.readRequest && isMMIO(readAddress)
+  val mmioWrite = io.MemoryIOPort.writeRequest && isMMIO(writeAddress)
+  val mmioWait  = WireDefault(false.B)
+  io.stall := (io.MemoryIOPort.readRequest || io.MemoryIOPort.writeRequest) && DACK =/= 1.U && stallEnable ||
+    (dramRead || dramWrite) && !io.DCachePort.ready || mmioWait
 
-  /* --- Syscon --- */
-  when(readAddress(31, 12) === 0x0000_1L.U && io.MemoryIOPort.readRequest) {
-    io.SysconPort.Address := readAddress(11, 0)
-    dataOut               := io.SysconPort.DataOut
+  // Read ahead, the RAM read port is free unless a load still has to present its own address. A store to the
+  // same word in that cycle makes the data read stale, the load then takes the normal path.
+  val readAheadAddr = io.MemoryIOPort.readAheadAddr
+  val readPending   = io.MemoryIOPort.readRequest && isRAM(readAddress) && DACK =/= 1.U
+  val readAheadHit  = WireDefault(false.B)
+  val readingAhead  = io.MemoryIOPort.readAhead && isRAM(readAheadAddr) && !(readPending && !readAheadHit)
+  val dmaWrite      = io.DMAPort.ram.writeRequest && io.DMAPort.ram.writeGrant
+  val storeConflict = io.MemoryIOPort.writeRequest && writeAddress(31, 2) === readAheadAddr(31, 2) ||
+    dmaWrite && io.DMAPort.ram.writeAddr(31, 2) === readAheadAddr(31, 2)
+  val readAheadDone = RegNext(readingAhead && !storeConflict, false.B)
+  val readAheadWord = RegNext(readAheadAddr(31, 2))
+  readAheadHit := readAheadDone && readAheadWord === readAddress(31, 2)
+
+  /* --- MMIO bus --- */
+  val devices     = MemoryIOManager.devices ++ extDevices
+  val bus         = Module(new BusInterconnect(bitWidth, devices))
+  val mmioAddress = Mux(mmioWrite, writeAddress, readAddress)
+  val select      = BusInterconnect.decode(devices, if (registeredDecode) readAheadAddr else mmioAddress)
+  bus.io.select := (if (registeredDecode) RegEnable(select, 0.U, !io.stall) else select)
+
+  // The request goes out once, the access waits until the device answers it
+  val accepted = RegInit(false.B)
+  bus.io.master.req.valid        := (mmioRead || mmioWrite) && !accepted
+  bus.io.master.req.bits.address := mmioAddress
+  bus.io.master.req.bits.write   := mmioWrite
+  bus.io.master.req.bits.data    := io.MemoryIOPort.writeData
+  when(bus.io.master.resp.valid) {
+    accepted := false.B
+  }.elsewhen(bus.io.master.req.fire) {
+    accepted := true.B
+  }
+  mmioWait := (mmioRead || mmioWrite) && !bus.io.master.resp.valid
+  when(mmioRead)(dataOut := bus.io.master.resp.bits)
+
+  for ((port, i) <- io.ExtBus.zipWithIndex) {
+    port <> bus.io.devices(MemoryIOManager.devices.size + i)
   }
 
+  // The register ports of the core devices take the access in the cycle of the request
+  def device(name: String) = {
+    val port = bus.io.devices(devices.indexWhere(_.name == name))
+    port.req.ready  := true.B
+    port.resp.valid := port.req.valid
+    port.resp.bits  := 0.U
+    port
+  }
+  def isRead(port: BusPort)  = port.req.valid && !port.req.bits.write
+  def isWrite(port: BusPort) = port.req.valid && port.req.bits.write
+
+  /* --- Syscon --- */
+  val syscon = device("syscon")
+  io.SysconPort.Address     := syscon.req.bits.address(11, 0)
+  io.SysconPort.DataIn      := syscon.req.bits.data
+  io.SysconPort.WriteEnable := isWrite(syscon)
+  syscon.resp.bits          := io.SysconPort.DataOut
+
+  /* --- CLINT --- */
+  val clint = device("clint")
+  io.CLINTPort.Address     := clint.req.bits.address(15, 0)
+  io.CLINTPort.DataIn      := clint.req.bits.data
+  io.CLINTPort.WriteEnable := isWrite(clint)
+  clint.resp.bits          := io.CLINTPort.DataOut
+
   /* --- UART0 --- */
-  when(readAddress(31, 12) === 0x3000_0L.U || writeAddress(31, 12) === 0x3000_0L.U) {
-    // Reads
-    when(io.MemoryIOPort.readRequest) {
-      when(readAddress(7, 0) === 0x04.U) {
-        /* RX */
-        when(io.UART0Port.rxQueue.valid) {
-          io.UART0Port.rxQueue.ready := true.B
-          dataOut                    := io.UART0Port.rxQueue.bits
-        }
+  val uart    = device("uart0")
+  val uartReg = uart.req.bits.address(7, 0)
+  // Reads
+  when(isRead(uart)) {
+    when(uartReg === 0x04.U) {
+      /* RX */
+      when(io.UART0Port.rxQueue.valid) {
+        io.UART0Port.rxQueue.ready := true.B
+        uart.resp.bits             := io.UART0Port.rxQueue.bits
       }
-        /* Status */
-        .elsewhen(readAddress(7, 0) === 0x0c.U) {
-          dataOut := Cat(io.UART0Port.txFull, io.UART0Port.rxFull, io.UART0Port.txEmpty, io.UART0Port.rxEmpty)
-        }
-        /* Invalid */
-        .otherwise(dataOut := 0.U)
     }
-    // Writes (TX)
-    when(io.MemoryIOPort.writeRequest) {
-      when(writeAddress(7, 0) === 0x00.U) {
-        /* TX */
-        io.UART0Port.txQueue.valid := true.B
-        io.UART0Port.txQueue.bits  := io.MemoryIOPort.writeData(7, 0)
+      /* Status */
+      .elsewhen(uartReg === 0x0c.U) {
+        uart.resp.bits := Cat(io.UART0Port.txFull, io.UART0Port.rxFull, io.UART0Port.txEmpty, io.UART0Port.rxEmpty)
       }
-        /* clock divisor */
-        .elsewhen(writeAddress(7, 0) === 0x10.U) {
-          io.UART0Port.clockDivisor.valid := true.B
-          io.UART0Port.clockDivisor.bits  := io.MemoryIOPort.writeData(7, 0)
-        }
+      /* FIFO levels, so software can check the free space once per burst */
+      .elsewhen(uartReg === 0x14.U)(uart.resp.bits := io.UART0Port.txCount)
+      .elsewhen(uartReg === 0x18.U)(uart.resp.bits := io.UART0Port.rxCount)
+      .elsewhen(uartReg === 0x1c.U)(uart.resp.bits := io.UART0Port.fifoLength)
+  }
+  // Writes
+  when(isWrite(uart)) {
+    when(uartReg === 0x00.U) {
+      /* TX */
+      io.UART0Port.txQueue.valid := true.B
+      io.UART0Port.txQueue.bits  := uart.req.bits.data(7, 0)
     }
+      /* clock divisor */
+      .elsewhen(uartReg === 0x10.U) {
+        io.UART0Port.clockDivisor.valid := true.B
+        io.UART0Port.clockDivisor.bits  := uart.req.bits.data(7, 0)
+      }
+      /* TX watermark */
+      .elsewhen(uartReg === 0x20.U) {
+        io.UART0Port.txWatermark.valid := true.B
+        io.UART0Port.txWatermark.bits  := uart.req.bits.data(15, 0)
+      }
   }
 
-  // GPIO0
-  when(readAddress(31, 12) === 0x3000_1L.U || writeAddress(31, 12) === 0x3000_1L.U) {
-    // Reads
-    when(io.MemoryIOPort.readRequest) {
-      // -- Direction
-      when(readAddress(7, 0) === 0x00.U) {
-        dataOut := io.GPIO0Port.directionOut
-      }
-        // -- Value
-        .elsewhen(readAddress(7, 0) === 0x04.U) {
-          dataOut := io.GPIO0Port.valueOut
-        }
-        .otherwise(dataOut := 0.U)
+  /* --- GPIO0 --- */
+  val gpio    = device("gpio0")
+  val gpioReg = gpio.req.bits.address(7, 0)
+  // Reads
+  when(isRead(gpio)) {
+    // -- Direction
+    when(gpioReg === 0x00.U) {
+      gpio.resp.bits := io.GPIO0Port.directionOut
     }
-    // Writes
-    when(io.MemoryIOPort.writeRequest) {
-      // -- Direction
-      when(writeAddress(7, 0) === 0x00.U) {
-        io.GPIO0Port.writeDirection := io.MemoryIOPort.writeRequest
+      // -- Value
+      .elsewhen(gpioReg === 0x04.U) {
+        gpio.resp.bits := io.GPIO0Port.valueOut
       }
-        // -- Value
-        .elsewhen(writeAddress(7, 0) === 0x04.U) {
-          io.GPIO0Port.writeValue := io.MemoryIOPort.writeRequest
-        }
-      io.GPIO0Port.dataIn := io.MemoryIOPort.writeData
-    }
-
+      // -- Edge interrupts
+      .elsewhen(gpioReg === 0x08.U)(gpio.resp.bits := io.GPIO0Port.risingOut)
+      .elsewhen(gpioReg === 0x0c.U)(gpio.resp.bits := io.GPIO0Port.fallingOut)
+      .elsewhen(gpioReg === 0x10.U)(gpio.resp.bits := io.GPIO0Port.pendingOut)
   }
-
-  /* --- PWM0 --- */
-  when(readAddress(31, 12) === 0x3000_2L.U || writeAddress(31, 12) === 0x3000_2L.U) {
-    dataOut := 0.U
+  // Writes
+  when(isWrite(gpio)) {
+    // -- Direction
+    when(gpioReg === 0x00.U) {
+      io.GPIO0Port.writeDirection := true.B
+    }
+      // -- Value
+      .elsewhen(gpioReg === 0x04.U) {
+        io.GPIO0Port.writeValue := true.B
+      }
+      // -- Edge interrupts
+      .elsewhen(gpioReg === 0x08.U)(io.GPIO0Port.writeRising := true.B)
+      .elsewhen(gpioReg === 0x0c.U)(io.GPIO0Port.writeFalling := true.B)
+      .elsewhen(gpioReg === 0x10.U)(io.GPIO0Port.clearPending := true.B)
+    io.GPIO0Port.dataIn := gpio.req.bits.data
   }
 
   /* --- Timer0 --- */
-  when(readAddress(31, 12) === 0x3000_3L.U || writeAddress(31, 12) === 0x3000_3L.U) {
-    when(io.MemoryIOPort.writeRequest) {
-      io.Timer0Port.writeEnable := io.MemoryIOPort.writeRequest
-      io.Timer0Port.dataIn      := io.MemoryIOPort.writeData
+  val timer = device("timer0")
+  io.Timer0Port.writeEnable := isWrite(timer)
+  io.Timer0Port.dataIn      := timer.req.bits.data
+  timer.resp.bits           := io.Timer0Port.dataOut
+
+  /* --- DMA --- */
+  val dma = device("dma")
+  io.DMAPort.Address     := dma.req.bits.address(11, 0)
+  io.DMAPort.DataIn      := dma.req.bits.data
+  io.DMAPort.WriteEnable := isWrite(dma)
+  dma.resp.bits          := io.DMAPort.DataOut
+
+  /* --- Data cache control --- */
+  val dcache = device("dcache")
+  io.DCachePort.control.Address     := dcache.req.bits.address(7, 0)
+  io.DCachePort.control.DataIn      := dcache.req.bits.data
+  io.DCachePort.control.WriteEnable := isWrite(dcache)
+  dcache.resp.bits                  := io.DCachePort.control.DataOut
+
+  /* --- Data Memory and external RAM --- */
+  // Stores place their bytes in the word with the byte enables, loads pick theirs out of it
+  val dataToWrite = WireDefault(0.U(bitWidth.W))
+  val writeMask   = WireDefault(0.U(4.W))
+  switch(io.MemoryIOPort.dataSize) {
+    is(3.U) { // Write word
+      dataToWrite := io.MemoryIOPort.writeData
+      writeMask   := "b1111".U
+    }
+    is(2.U) { // Write halfword
+      switch(writeAddress(1).asUInt) {
+        is(1.U) { // Write half word 1
+          dataToWrite := Cat(io.MemoryIOPort.writeData(15, 0).asUInt, Fill(16, 0.U))
+          writeMask   := "b1100".U
+        }
+        is(0.U) { // Write half word 0
+          dataToWrite := Cat(Fill(16, 0.U), io.MemoryIOPort.writeData(15, 0).asUInt)
+          writeMask   := "b0011".U
+        }
+      }
     }
-    when(io.MemoryIOPort.readRequest) {
-      dataOut := io.Timer0Port.dataOut
+    is(1.U) { // Write byte
+      switch(writeAddress(1, 0)) {
+        is(3.U) { // Write byte 3
+          dataToWrite := Cat(io.MemoryIOPort.writeData(7, 0).asUInt, Fill(24, 0.U))
+          writeMask   := "b1000".U
+        }
+        is(2.U) { // Write byte 2
+          dataToWrite := Cat(Fill(8, 0.U), io.MemoryIOPort.writeData(7, 0).asUInt, Fill(16, 0.U))
+          writeMask   := "b0100".U
+        }
+        is(1.U) { // Write byte 2
+          dataToWrite := Cat(Fill(16, 0.U), io.MemoryIOPort.writeData(7, 0).asUInt, Fill(8, 0.U))
+          writeMask   := "b0010".U
+        }
+        is(0.U) { // Write byte 0
+          dataToWrite := Cat(Fill(24, 0.U), io.MemoryIOPort.writeData(7, 0).asUInt)
+          writeMask   := "b0001".U
+        }
+      }
     }
   }
-
-  /* --- Data Memory --- */
-  when(readAddress(31, 28) === 0x8.U || writeAddress(31, 28) === 0x8.U) {
-    // Stall core for 1 cycle
-    stallLatency               := 1.U
-    stallEnable                := true.B
-    io.DataMemPort.readAddress := Cat(Fill(4, 0.U), readAddress(27, 0))
-
+  val loadWord = Mux(isDRAM(readAddress), io.DCachePort.readData, io.DataMemPort.readData)
+  when(isRAM(readAddress) || isDRAM(readAddress)) {
     switch(io.MemoryIOPort.dataSize) {
-      is(3.U)(dataOut := io.DataMemPort.readData) // Read word
+      is(3.U)(dataOut := loadWord) // Read word
       is(2.U) { // Read halfword
-        switch(io.DataMemPort.readAddress(1).asUInt) {
-          is(1.U)(dataOut := Cat(Fill(16, 0.U), io.DataMemPort.readData(31, 16).asUInt)) // Read half word 1
-          is(0.U)(dataOut := Cat(Fill(16, 0.U), io.DataMemPort.readData(15, 0).asUInt))  // Read half word 0
+        switch(readAddress(1).asUInt) {
+          is(1.U)(dataOut := Cat(Fill(16, 0.U), loadWord(31, 16).asUInt)) // Read half word 1
+          is(0.U)(dataOut := Cat(Fill(16, 0.U), loadWord(15, 0).asUInt))  // Read half word 0
         }
       }
-      is(1.U) { // Write byte
-        switch(io.DataMemPort.readAddress(1, 0)) {
-          is(3.U)(dataOut := Cat(Fill(24, 0.U), io.DataMemPort.readData(31, 24).asUInt)) // Read byte 3
-          is(2.U)(dataOut := Cat(Fill(24, 0.U), io.DataMemPort.readData(23, 16).asUInt)) // Read byte 2
-          is(1.U)(dataOut := Cat(Fill(24, 0.U), io.DataMemPort.readData(15, 8).asUInt))  // Read byte 1
-          is(0.U)(dataOut := Cat(Fill(24, 0.U), io.DataMemPort.readData(7, 0).asUInt))   // Read byte 0
+      is(1.U) { // Read byte
+        switch(readAddress(1, 0)) {
+          is(3.U)(dataOut := Cat(Fill(24, 0.U), loadWord(31, 24).asUInt)) // Read byte 3
+          is(2.U)(dataOut := Cat(Fill(24, 0.U), loadWord(23, 16).asUInt)) // Read byte 2
+          is(1.U)(dataOut := Cat(Fill(24, 0.U), loadWord(15, 8).asUInt))  // Read byte 1
+          is(0.U)(dataOut := Cat(Fill(24, 0.U), loadWord(7, 0).asUInt))   // Read byte 0
         }
       }
     }
+  }
 
-    when(io.MemoryIOPort.writeRequest) {
-      when(!io.stall) {
-        val dataToWrite = WireDefault(0.U(bitWidth.W))
-        val writeMask   = WireDefault(0.U(4.W))
-
-        io.DataMemPort.writeAddress := Cat(Fill(4, 0.U), writeAddress(27, 0))
-        io.DataMemPort.writeEnable  := io.MemoryIOPort.writeRequest
-
-        switch(io.MemoryIOPort.dataSize) {
-          is(3.U) { // Write word
-            dataToWrite := io.MemoryIOPort.writeData
-            writeMask   := "b1111".U
-          }
-          is(2.U) { // Write halfword
-            switch(io.DataMemPort.writeAddress(1).asUInt) {
-              is(1.U) { // Write half word 1
-                dataToWrite := Cat(io.MemoryIOPort.writeData(15, 0).asUInt, Fill(16, 0.U))
-                writeMask   := "b1100".U
-              }
-              is(0.U) { // Write half word 0
-                dataToWrite := Cat(Fill(16, 0.U), io.MemoryIOPort.writeData(15, 0).asUInt)
-                writeMask   := "b0011".U
-              }
-            }
-          }
-          is(1.U) { // Write byte
-            switch(io.DataMemPort.writeAddress(1, 0)) {
-              is(3.U) { // Write byte 3
-                dataToWrite := Cat(io.MemoryIOPort.writeData(7, 0).asUInt, Fill(24, 0.U))
-                writeMask   := "b1000".U
-              }
-              is(2.U) { // Write byte 2
-                dataToWrite := Cat(Fill(8, 0.U), io.MemoryIOPort.writeData(7, 0).asUInt, Fill(16, 0.U))
-                writeMask   := "b0100".U
-              }
-              is(1.U) { // Write byte 2
-                dataToWrite := Cat(Fill(16, 0.U), io.MemoryIOPort.writeData(7, 0).asUInt, Fill(8, 0.U))
-                writeMask   := "b0010".U
-              }
-              is(0.U) { // Write byte 0
-                dataToWrite := Cat(Fill(24, 0.U), io.MemoryIOPort.writeData(7, 0).asUInt)
-                writeMask   := "b0001".U
-              }
-            }
-          }
-        }
+  when(isRAM(readAddress) || isRAM(writeAddress)) {
+    // Stall core for 1 cycle on loads, unless the address was read ahead
+    when(io.MemoryIOPort.readRequest && !readAheadHit) {
+      stallLatency := 1.U
+      stallEnable  := true.B
+    }
+    io.DataMemPort.readAddress := Cat(Fill(4, 0.U), readAddress(27, 0))
 
-        val dataIn = Cat(
-          Mux(writeMask(3), dataToWrite(3 * 8 + 7, 3 * 8), io.DataMemPort.readData(3 * 8 + 7, 3 * 8)),
-          Mux(writeMask(2), dataToWrite(2 * 8 + 7, 2 * 8), io.DataMemPort.readData(2 * 8 + 7, 2 * 8)),
-          Mux(writeMask(1), dataToWrite(1 * 8 + 7, 1 * 8), io.DataMemPort.readData(1 * 8 + 7, 1 * 8)),
-          Mux(writeMask(0), dataToWrite(0 * 8 + 7, 0 * 8), io.DataMemPort.readData(0 * 8 + 7, 0 * 8)),
-        )
-        io.DataMemPort.writeData := dataIn
-        dataOut                  := dataIn
-      }
+    // Stores write their bytes with the RAM byte enables in a single cycle
+    when(io.MemoryIOPort.writeRequest) {
+      io.DataMemPort.writeAddress := Cat(Fill(4, 0.U), writeAddress(27, 0))
+      io.DataMemPort.writeEnable  := io.MemoryIOPort.writeRequest
+      io.DataMemPort.writeData    := dataToWrite
+      io.DataMemPort.writeMask    := writeMask
     }
   }
 
+  // The external RAM goes through the data cache, hits complete in the same cycle
+  io.DCachePort.read      := dramRead
+  io.DCachePort.write     := dramWrite
+  io.DCachePort.address   := Mux(dramWrite, writeAddress(27, 0), readAddress(27, 0))
+  io.DCachePort.writeData := dataToWrite
+  io.DCachePort.writeMask := writeMask
+
+  // The RAM read port takes the read ahead address when the current load does not need it
+  when(readingAhead) {
+    io.DataMemPort.readAddress := Cat(Fill(4, 0.U), readAheadAddr(27, 0))
+  }
+
+  // The DMA gets the RAM ports and the UART0 FIFOs in the cycles the core does not use them
+  val uartTxWrite = isWrite(uart) && uartReg === 0x00.U
+  val uartRxRead  = isRead(uart) && uartReg === 0x04.U
+  io.DMAPort.ram.readGrant  := !readPending && !readingAhead
+  io.DMAPort.ram.readData   := io.DataMemPort.readData
+  io.DMAPort.ram.writeGrant := !(io.MemoryIOPort.writeRequest && isRAM(writeAddress))
+  when(io.DMAPort.ram.readRequest && io.DMAPort.ram.readGrant) {
+    io.DataMemPort.readAddress := Cat(Fill(4, 0.U), io.DMAPort.ram.readAddr(27, 0))
+  }
+  when(dmaWrite) {
+    io.DataMemPort.writeAddress := Cat(Fill(4, 0.U), io.DMAPort.ram.writeAddr(27, 0))
+    io.DataMemPort.writeEnable  := true.B
+    io.DataMemPort.writeData    := io.DMAPort.ram.writeData
+    io.DataMemPort.writeMask    := io.DMAPort.ram.writeMask
+  }
+  io.DMAPort.uartTx.ready := io.UART0Port.txQueue.ready && !uartTxWrite
+  when(io.DMAPort.uartTx.valid && !uartTxWrite) {
+    io.UART0Port.txQueue.valid := true.B
+    io.UART0Port.txQueue.bits  := io.DMAPort.uartTx.bits
+  }
+  io.DMAPort.uartRx.valid := io.UART0Port.rxQueue.valid && !uartRxRead
+  io.DMAPort.uartRx.bits  := io.UART0Port.rxQueue.bits
+  when(io.DMAPort.uartRx.ready && !uartRxRead) {
+    io.UART0Port.rxQueue.ready := true.B
+  }
+
   io.MemoryIOPort.readData := dataOut
 }
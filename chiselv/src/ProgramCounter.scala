@@ -5,6 +5,7 @@ import chisel3._
 class PCPort(bitWidth: Int = 32) extends Bundle {
   val dataIn      = Input(UInt(bitWidth.W))
   val PC          = Output(UInt(bitWidth.W))
+  val PC2         = Output(UInt(bitWidth.W)) // Next to a compressed instruction
   val PC4         = Output(UInt(bitWidth.W))
   val writeEnable = Input(Bool())
   val writeAdd    = Input(Bool()) // 1 => Add dataIn to PC, 0 => Set dataIn to PC
@@ -17,6 +18,7 @@ class ProgramCounter(regWidth: Int = 32, entryPoint: Long = 0) extends Module {
   when(io.writeEnable) {
     pc := Mux(io.writeAdd, (pc.asSInt + io.dataIn.asSInt).asUInt, io.dataIn)
   }
+  io.PC2 := pc + 2.U
   io.PC4 := pc + 4.U
   io.PC  := pc
 }
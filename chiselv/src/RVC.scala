@@ -0,0 +1,169 @@
+package chiselv
+
+import chisel3._
+import chisel3.util.{Cat, Fill, MuxCase, MuxLookup, is, switch}
+
+/**
+ * Expands a 16 bit RV32C instruction to the RV32I one it stands for, so the
+ * Decoder only sees 32 bit encodings. The floating point loads and stores,
+ * the RV64 encodings and the reserved ones (eg. C.ADDI4SPN with a zero
+ * immediate and the all zero halfword) expand to 0, which is illegal.
+ */
+class RVCExpander extends Module {
+  val io = IO(new Bundle {
+    val in  = Input(UInt(16.W))
+    val out = Output(UInt(32.W))
+  })
+  val c       = io.in
+  val illegal = 0.U(32.W)
+
+  // Register fields, the 3 bit ones address x8 to x15
+  val zero = 0.U(5.W)
+  val ra   = 1.U(5.W)
+  val sp   = 2.U(5.W)
+  val rd   = c(11, 7)
+  val rs2  = c(6, 2)
+  val rdP  = Cat(1.U(2.W), c(4, 2))
+  val rs1P = Cat(1.U(2.W), c(9, 7))
+
+  // Immediates, sign extended to the width of the 32 bit format
+  val imm6    = Cat(Fill(7, c(12)), c(6, 2))
+  val nzImm6  = Cat(c(12), c(6, 2)) =/= 0.U
+  val jOffset = Cat(Fill(10, c(12)), c(8), c(10, 9), c(6), c(7), c(2), c(11), c(5, 3), 0.U(1.W))
+  val bOffset = Cat(Fill(5, c(12)), c(6, 5), c(2), c(11, 10), c(4, 3), 0.U(1.W))
+  val lwImm   = Cat(c(5), c(12, 10), c(6), 0.U(2.W))
+
+  def rType(funct7: Int, rs2: UInt, rs1: UInt, funct3: Int, rd: UInt) =
+    Cat(funct7.U(7.W), rs2, rs1, funct3.U(3.W), rd, "b0110011".U(7.W))
+  def iType(imm: UInt, rs1: UInt, funct3: Int, rd: UInt, opcode: String) =
+    Cat(imm.pad(12)(11, 0), rs1, funct3.U(3.W), rd, opcode.U(7.W))
+  def sw(imm: UInt, rs2: UInt, rs1: UInt) = {
+    val i = imm.pad(12)
+    Cat(i(11, 5), rs2, rs1, 2.U(3.W), i(4, 0), "b0100011".U(7.W))
+  }
+  def bType(offset: UInt, rs1: UInt, funct3: Int) =
+    Cat(offset(12), offset(10, 5), zero, rs1, funct3.U(3.W), offset(4, 1), offset(11), "b1100011".U(7.W))
+  def jal(offset: UInt, rd: UInt) =
+    Cat(offset(20), offset(10, 1), offset(11), offset(19, 12), rd, "b1101111".U(7.W))
+
+  val opImm = "b0010011"
+  val load  = "b0000011"
+  val jalr  = "b1100111"
+
+  io.out := illegal
+  switch(Cat(c(15, 13), c(1, 0))) {
+    // Quadrant 0
+    is("b000_00".U) { // C.ADDI4SPN
+      val imm = Cat(c(10, 7), c(12, 11), c(5), c(6), 0.U(2.W))
+      io.out := Mux(imm === 0.U, illegal, iType(imm, sp, 0, rdP, opImm))
+    }
+    is("b010_00".U)(io.out := iType(lwImm, rs1P, 2, rdP, load)) // C.LW
+    is("b110_00".U)(io.out := sw(lwImm, rdP, rs1P))             // C.SW
+
+    // Quadrant 1
+    is("b000_01".U)(io.out := iType(imm6, rd, 0, rd, opImm))   // C.ADDI, C.NOP
+    is("b001_01".U)(io.out := jal(jOffset, ra))                // C.JAL
+    is("b010_01".U)(io.out := iType(imm6, zero, 0, rd, opImm)) // C.LI
+    is("b011_01".U) {
+      val addi16sp = iType(Cat(Fill(3, c(12)), c(4, 3), c(5), c(2), c(6), 0.U(4.W)), sp, 0, sp, opImm)
+      val lui      = Cat(Fill(15, c(12)), c(6, 2), rd, "b0110111".U(7.W))
+      io.out := Mux(!nzImm6, illegal, Mux(rd === 2.U, addi16sp, lui)) // C.ADDI16SP, C.LUI
+    }
+    is("b100_01".U) {
+      // Shift amounts over 31 are RV64 only, as are C.SUBW and C.ADDW
+      val arith = MuxLookup(c(6, 5), illegal)(
+        Seq(
+          0.U -> rType(0x20, rdP, rs1P, 0, rs1P), // C.SUB
+          1.U -> rType(0x00, rdP, rs1P, 4, rs1P), // C.XOR
+          2.U -> rType(0x00, rdP, rs1P, 6, rs1P), // C.OR
+          3.U -> rType(0x00, rdP, rs1P, 7, rs1P), // C.AND
+        )
+      )
+      io.out := MuxLookup(c(11, 10), illegal)(
+        Seq(
+          0.U -> Mux(c(12), illegal, iType(c(6, 2), rs1P, 5, rs1P, opImm)),                     // C.SRLI
+          1.U -> Mux(c(12), illegal, iType(Cat(0x20.U(7.W), c(6, 2)), rs1P, 5, rs1P, opImm)), // C.SRAI
+          2.U -> iType(imm6, rs1P, 7, rs1P, opImm),                                             // C.ANDI
+          3.U -> Mux(c(12), illegal, arith),
+        )
+      )
+    }
+    is("b101_01".U)(io.out := jal(jOffset, zero))      // C.J
+    is("b110_01".U)(io.out := bType(bOffset, rs1P, 0)) // C.BEQZ
+    is("b111_01".U)(io.out := bType(bOffset, rs1P, 1)) // C.BNEZ
+
+    // Quadrant 2
+    is("b000_10".U)(io.out := Mux(c(12), illegal, iType(c(6, 2), rd, 1, rd, opImm))) // C.SLLI
+    is("b010_10".U) { // C.LWSP
+      val imm = Cat(c(3, 2), c(12), c(6, 4), 0.U(2.W))
+      io.out := Mux(rd === 0.U, illegal, iType(imm, sp, 2, rd, load))
+    }
+    is("b100_10".U) {
+      io.out := MuxCase(
+        rType(0x00, rs2, rd, 0, rd), // C.ADD
+        Seq(
+          (!c(12) && rs2 === 0.U)     -> Mux(rd === 0.U, illegal, iType(0.U, rd, 0, zero, jalr)), // C.JR
+          (!c(12))                    -> rType(0x00, rs2, zero, 0, rd),                           // C.MV
+          (rd === 0.U && rs2 === 0.U) -> "h00100073".U(32.W),                                     // C.EBREAK
+          (rs2 === 0.U)               -> iType(0.U, rd, 0, ra, jalr),                             // C.JALR
+        ),
+      )
+    }
+    is("b110_10".U)(io.out := sw(Cat(c(8, 7), c(12, 9), 0.U(2.W)), rs2, sp)) // C.SWSP
+  }
+}
+
+class FetchPort(bitWidth: Int = 32) extends Bundle {
+  val pc         = Input(UInt(bitWidth.W))
+  val fetch      = Input(Bool())            // The core takes the instruction this cycle
+  val inst       = Output(UInt(bitWidth.W)) // 32 bit instruction, expanded when compressed
+  val compressed = Output(Bool())           // 1 => The next instruction is at pc + 2
+  val ready      = Output(Bool())           // 0 => Stall the fetch, inst is not valid
+}
+
+/**
+ * Takes the instruction at a halfword aligned PC from the word wide
+ * instruction memory. A compressed instruction is read from its word and
+ * expanded. A 32 bit one in the upper half of a word continues in the next
+ * word: its first half is kept from the word the previous instruction was
+ * read from, so sequential code still fetches one instruction per cycle.
+ * Only a jump to such an instruction waits a cycle to read both words.
+ */
+class FetchAligner(bitWidth: Int = 32) extends Module {
+  val io = IO(new Bundle {
+    val core = new FetchPort(bitWidth)
+    val mem  = Flipped(new InstructionMemPort(bitWidth, scala.math.pow(2, bitWidth).toLong))
+  })
+
+  val upper    = io.core.pc(1)
+  val wordAddr = Cat(io.core.pc(bitWidth - 1, 2), 0.U(2.W))
+
+  // Upper half of the last word an instruction was taken from
+  val bufValid = RegInit(false.B)
+  val bufAddr  = RegInit(0.U(bitWidth.W))
+  val bufHalf  = RegInit(0.U(16.W))
+  val crossing = upper && bufValid && bufAddr === wordAddr && bufHalf(1, 0) === 3.U
+
+  val readAddr = Mux(crossing, wordAddr + 4.U, wordAddr)
+  io.mem.readAddr := readAddr
+  io.mem.fetch    := io.core.fetch
+
+  val word     = io.mem.readData
+  val half     = Mux(upper, word(31, 16), word(15, 0))
+  val expander = Module(new RVCExpander)
+  expander.io.in := half
+
+  val compressed = !crossing && half(1, 0) =/= 3.U
+  // A 32 bit instruction in the upper half without its first half kept, read that word first
+  val fill = upper && !crossing && !compressed
+
+  io.core.inst       := MuxCase(word, Seq(crossing -> Cat(word(15, 0), bufHalf), compressed -> expander.io.out))
+  io.core.compressed := compressed
+  io.core.ready      := io.mem.ready && !fill
+
+  when(io.mem.ready && (fill || io.core.fetch)) {
+    bufValid := true.B
+    bufAddr  := readAddr
+    bufHalf  := word(31, 16)
+  }
+}
@@ -30,19 +30,23 @@ class RVFIPort extends Bundle {
   val mem_wdata = Output(UInt(32.W))
 }
 
+// A core exposing the instructions it retires through RVFI
+trait RVFIInterface {
+  val rvfi: RVFIPort
+}
+
 class RVFICPUWrapper(
-    cpuFrequency:          Int = 50000000,
-    bitWidth:              Int = 32,
-    instructionMemorySize: Int = 64 * 1024,
-    dataMemorySize:        Int = 64 * 1024,
+    cpuFrequency:   Int = 50000000,
+    bitWidth:       Int = 32,
+    dataMemorySize: Int = 64 * 1024,
   ) extends CPUSingleCycle(
-      cpuFrequency          = cpuFrequency,
-      entryPoint            = 0x0,
-      bitWidth              = bitWidth,
-      instructionMemorySize = instructionMemorySize,
-      dataMemorySize        = dataMemorySize,
-      numGPIO               = 0,
-    ) {
+      cpuFrequency   = cpuFrequency,
+      entryPoint     = 0x0,
+      bitWidth       = bitWidth,
+      dataMemorySize = dataMemorySize,
+      numGPIO        = 0,
+    )
+    with RVFIInterface {
   val rvfi = IO(new RVFIPort) // RVFI interface for RISCV-Formal
 
   // RVFI Interface
@@ -55,8 +59,8 @@ class RVFICPUWrapper(
   val rvfi_intr = RegInit(false.B)
   val rvfi_mode = RegInit(3.U(2.W))
 
-  val rvfi_mem_size_mask = WireDefault(0.U(2.W))
-  switch(memoryIOManager.io.DataMemPort.dataSize) {
+  val rvfi_mem_size_mask = WireDefault(0.U(4.W))
+  switch(memoryIOManager.io.MemoryIOPort.dataSize) {
     is(1.U)(rvfi_mem_size_mask := 1.U)
     is(2.U)(rvfi_mem_size_mask := 3.U)
     is(3.U)(rvfi_mem_size_mask := 15.U)
@@ -78,11 +82,12 @@ class RVFICPUWrapper(
   rvfi.rd_addr   := registerBank.io.regwr_addr
   rvfi.rd_wdata  := registerBank.io.regwr_data
 
+  // The PC input holds the next PC of a retiring instruction, including jumps, traps and MRET
   rvfi.pc_rdata := PC.io.PC
   rvfi.pc_wdata := Mux(
     PC.io.writeAdd,
     (PC.io.PC.asSInt + PC.io.dataIn.asSInt).asUInt,
-    PC.io.PC4,
+    PC.io.dataIn,
   )
 
   rvfi.mem_addr  := Mux(decoder.io.is_load || decoder.io.is_store, ALU.io.x, 0.U)
@@ -103,9 +108,68 @@ class RVFICPUWrapper(
   rvfi.ixl  := 1.U
 }
 
+// The pipelined core retires instructions from WB. As in RVFICPUWrapper, valid is registered and the other
+// signals describe the instruction in WB before the clock edge.
+class RVFIPipelinedWrapper(
+    cpuFrequency:   Int = 50000000,
+    bitWidth:       Int = 32,
+    dataMemorySize: Int = 64 * 1024,
+  ) extends CPUPipelined(
+      cpuFrequency   = cpuFrequency,
+      entryPoint     = 0x0,
+      bitWidth       = bitWidth,
+      dataMemorySize = dataMemorySize,
+      numGPIO        = 0,
+    )
+    with RVFIInterface {
+  val rvfi = IO(new RVFIPort) // RVFI interface for RISCV-Formal
+
+  val rvfi_valid = RegInit(false.B)
+  val rvfi_order = RegInit(0.U(64.W))
+
+  val rvfi_mem_size_mask = WireDefault(0.U(4.W))
+  switch(memwb.inst) {
+    is(Instruction.LB, Instruction.LBU, Instruction.SB)(rvfi_mem_size_mask := 1.U)
+    is(Instruction.LH, Instruction.LHU, Instruction.SH)(rvfi_mem_size_mask := 3.U)
+    is(Instruction.LW, Instruction.SW)(rvfi_mem_size_mask                  := 15.U)
+  }
+
+  rvfi_valid := !reset.asBool && memwb.valid
+  when(rvfi_valid) {
+    rvfi_order := rvfi_order + 1.U
+  }
+  rvfi.valid := rvfi_valid
+  rvfi.order := rvfi_order
+  rvfi.insn  := memwb.op
+
+  rvfi.rs1_addr  := memwb.rs1
+  rvfi.rs1_rdata := memwb.rs1Data
+  rvfi.rs2_addr  := memwb.rs2
+  rvfi.rs2_rdata := memwb.rs2Data
+  rvfi.rd_addr   := memwb.rd
+  rvfi.rd_wdata  := wbData
+
+  rvfi.pc_rdata := memwb.pc
+  rvfi.pc_wdata := Mux(trap, trapPC, memwb.nextPC)
+
+  rvfi.mem_addr  := Mux(memwb.is_load || memwb.is_store, memwb.address, 0.U)
+  rvfi.mem_rdata := Mux(memwb.is_load, memwb.result, 0.U)
+  rvfi.mem_rmask := Mux(memwb.is_load, rvfi_mem_size_mask, 0.U)
+
+  rvfi.mem_wdata := Mux(memwb.is_store, memwb.rs2Data, 0.U)
+  rvfi.mem_wmask := Mux(memwb.is_store, rvfi_mem_size_mask, 0.U)
+
+  rvfi.mode := 3.U
+  rvfi.trap := memwb.valid && memwb.inst === Instruction.ERR_INST
+  rvfi.halt := false.B
+  rvfi.intr := false.B
+  rvfi.ixl  := 1.U
+}
+
 // This is the Topmodule used in RISCV-Formal
 class RVFI(
-    bitWidth: Int = 32
+    bitWidth:  Int = 32,
+    pipelined: Boolean = false,
   ) extends Module {
   val io = IO(new Bundle {
     val imem_addr  = Output(UInt(bitWidth.W))
@@ -116,13 +180,14 @@ class RVFI(
     val dmem_raddr = Output(UInt(bitWidth.W))
     val dmem_waddr = Output(UInt(bitWidth.W))
     val dmem_wdata = Output(UInt(bitWidth.W))
+    val dmem_wmask = Output(UInt((bitWidth / 8).W))
     val dmem_wen   = Output(Bool())
   })
   val rvfi = IO(new RVFIPort) // RVFI interface for RISCV-Formal
 
   // Instantiate the wrapped CPU with RVFI interface
-  val CPU = Module(
-    new RVFICPUWrapper(bitWidth)
+  val CPU: CPUCore with RVFIInterface = Module(
+    if (pipelined) new RVFIPipelinedWrapper(bitWidth) else new RVFICPUWrapper(bitWidth)
   )
 
   // Initialize unused IO
@@ -133,8 +198,17 @@ class RVFI(
   CPU.io.UART0Port.txEmpty       := true.B
   CPU.io.UART0Port.rxFull        := false.B
   CPU.io.UART0Port.rxQueue.valid := false.B
+  CPU.io.UART0Port.rxCount       := 0.U
+  CPU.io.UART0Port.txCount       := 0.U
+  CPU.io.UART0Port.fifoLength    := 0.U
+  CPU.io.UART0Port.txInterrupt   := false.B
   CPU.io.SysconPort.DataOut      := 0.U
 
+  // No external RAM
+  CPU.io.dataCachePort.readData        := 0.U
+  CPU.io.dataCachePort.ready           := true.B
+  CPU.io.dataCachePort.control.DataOut := 0.U
+
   // Connect RVFI port
   rvfi <> CPU.rvfi
 
@@ -146,6 +220,7 @@ class RVFI(
   // Connect data memory
   io.dmem_waddr := CPU.io.dataMemPort.writeAddress
   io.dmem_wdata := CPU.io.dataMemPort.writeData
+  io.dmem_wmask := CPU.io.dataMemPort.writeMask
   io.dmem_wen   := CPU.io.dataMemPort.writeEnable
 
   io.dmem_raddr               := CPU.io.dataMemPort.readAddress
@@ -154,10 +229,13 @@ class RVFI(
 
 object RVFI {
   @main
-  def run(@arg(short = 'c', doc = "Chisel arguments") chiselArgs: Leftover[String]) =
+  def run(
+      @arg(short = 'p', doc = "Five stage pipelined core") pipelined: Boolean = false,
+      @arg(short = 'c', doc = "Chisel arguments") chiselArgs:         Leftover[String],
+    ) =
     // Generate SystemVerilog
     ChiselStage.emitSystemVerilogFile(
-      new RVFI,
+      new RVFI(pipelined = pipelined),
       chiselArgs.value.toArray,
       Array(
         // Removes debug information from the generated Verilog
@@ -0,0 +1,243 @@
+package chiselv
+
+import chisel3._
+import chisel3.util.{Cat, is, log2Ceil, switch}
+
+// External SDR SDRAM mapped at 0x4000_0000 behind the data cache, see SOC
+case class SDRAMConfig(
+    rowBits:    Int = 13,         // 13 row, 9 column bits and 4 banks of 16 bit words => 32 MB, like the ULX3S
+    colBits:    Int = 9,
+    casLatency: Int = 2,
+    tRP:        Double = 20,      // Timings in ns, converted to clocks at the core frequency
+    tRCD:       Double = 20,
+    tRFC:       Double = 70,
+    tWR:        Double = 15,
+    tREFI:      Double = 7800,    // 8192 refreshes every 64 ms
+    powerUp:    Double = 200000,  // Wait after power up before the init sequence
+    cacheSize:  Int = 4 * 1024,   // Data cache bytes
+    lineBytes:  Int = 32,
+    ways:       Int = 2,          // 1 => Direct mapped, 2 => Two way set associative
+  ) {
+  def sizeBytes: Long = 2L << (rowBits + colBits + 2)
+}
+
+// SDRAM pins, the clock comes from the PLL (phase shifted on boards where the pads need it)
+class SDRAMPort extends Bundle {
+  val cke   = Output(Bool())
+  val csn   = Output(Bool())
+  val rasn  = Output(Bool())
+  val casn  = Output(Bool())
+  val wen   = Output(Bool())
+  val ba    = Output(UInt(2.W))
+  val addr  = Output(UInt(13.W))
+  val dqm   = Output(UInt(2.W))
+  val dqOut = Output(UInt(16.W))
+  val dqOE  = Output(Bool()) // 1 => Drive DQ
+  val dqIn  = Input(UInt(16.W))
+}
+
+// Line transfers between a cache and the memory controller
+class DRAMPort(bitWidth: Int = 32, addressBits: Int = 25) extends Bundle {
+  val request   = Input(Bool())              // Starts a line transfer, taken while idle
+  val write     = Input(Bool())              // 1 => Writes the line from writeData
+  val address   = Input(UInt(addressBits.W)) // Byte address of the line
+  val writeData = Input(UInt(bitWidth.W))
+  val writeNext = Output(Bool())             // writeData was sent, present the next word of the line
+  val readData  = Output(UInt(bitWidth.W))
+  val readValid = Output(Bool())             // 1 => readData holds the next word of the line
+  val idle      = Output(Bool())
+}
+
+object SDRAMState extends ChiselEnum {
+  val powerUp, initPrecharge, initRefresh, loadMode, idle, refresh, read, write, recover = Value
+}
+
+/**
+ * SDR SDRAM controller for 16 bit parts, moving whole cache lines. Each line
+ * opens its row, goes out in back to back bursts of 8 and closes the row with
+ * the auto precharge of the last burst, so every transfer starts from idle
+ * banks. Refreshes are issued between transfers. The pins are registered, a
+ * read burst is sampled casLatency + 1 clocks after its command left.
+ */
+class SDRAMController(bitWidth: Int = 32, clockFreq: Long, config: SDRAMConfig = SDRAMConfig()) extends Module {
+  require(bitWidth == 32, "Words are moved as two 16 bit beats")
+  require(config.lineBytes % 16 == 0, "Lines are moved in bursts of 8 half words")
+  require(config.rowBits <= 13 && config.colBits <= 10, "A10 selects the auto precharge")
+  require(config.casLatency == 2 || config.casLatency == 3)
+
+  val addressBits = log2Ceil(config.sizeBytes)
+  val io = IO(new Bundle {
+    val line  = new DRAMPort(bitWidth, addressBits)
+    val sdram = new SDRAMPort
+  })
+
+  def clocks(ns: Double) = math.max(1, math.ceil(ns * clockFreq / 1e9).toInt)
+  val tRP       = clocks(config.tRP)
+  val tRCD      = clocks(config.tRCD)
+  val tRFC      = clocks(config.tRFC)
+  val tWR       = clocks(config.tWR)
+  val tMRD      = 2
+  val lineBeats = config.lineBytes / 2
+
+  // Commands as {CS#, RAS#, CAS#, WE#}
+  val NOP       = "b0111".U(4.W)
+  val ACTIVE    = "b0011".U(4.W)
+  val READ      = "b0101".U(4.W)
+  val WRITE     = "b0100".U(4.W)
+  val PRECHARGE = "b0010".U(4.W)
+  val REFRESH   = "b0001".U(4.W)
+  val LOADMODE  = "b0000".U(4.W)
+  // Burst length 8, sequential, CAS latency, burst writes
+  val modeRegister = (config.casLatency << 4) | 3
+
+  val timerMax  = Seq(clocks(config.powerUp), tRP, tRCD, tRFC, tWR + tRP, 8).max
+  val state     = RegInit(SDRAMState.powerUp)
+  val timer     = RegInit((clocks(config.powerUp) - 1).U(log2Ceil(timerMax).W))
+  val command   = RegInit(NOP)
+  val bank      = RegInit(0.U(2.W))
+  val address   = RegInit(0.U(13.W))
+  val dqm       = RegInit("b11".U(2.W)) // High until the init sequence is done
+  val dqOut     = RegInit(0.U(16.W))
+  val dqOE      = RegInit(false.B)
+  val refreshes = RegInit(0.U(1.W))    // Init refreshes left after the current one
+  command := NOP
+
+  // Auto refresh every tREFI, issued by the next idle cycle
+  val refreshTimer = RegInit((clocks(config.tREFI) - 1).U(log2Ceil(clocks(config.tREFI)).W))
+  val refreshDue   = RegInit(false.B)
+
+  // The line being moved, the commands go out every 8 clocks for seamless bursts
+  val halfword = io.line.address >> 1
+  val column   = Reg(UInt(config.colBits.W))
+  val bursts   = RegInit(0.U(log2Ceil(lineBeats / 8 + 1).W))  // READ/WRITE commands left
+  val beats    = RegInit(0.U(log2Ceil(lineBeats + 1).W))      // Beats left, even ones are the low half of a word
+  val slots    = RegInit(0.U(3.W))                            // Beats left in the current burst after this one
+  val burst    = WireDefault(false.B)                         // A READ or WRITE goes out
+  val slot     = burst || slots =/= 0.U
+  when(burst)(slots := 7.U).elsewhen(slots =/= 0.U)(slots := slots - 1.U)
+
+  switch(state) {
+    is(SDRAMState.powerUp) {
+      when(timer =/= 0.U)(timer := timer - 1.U).otherwise {
+        command := PRECHARGE
+        address := (1 << 10).U // All banks
+        timer   := (tRP - 1).U
+        state   := SDRAMState.initPrecharge
+      }
+    }
+    is(SDRAMState.initPrecharge) {
+      when(timer =/= 0.U)(timer := timer - 1.U).otherwise {
+        command   := REFRESH
+        timer     := (tRFC - 1).U
+        refreshes := 1.U
+        state     := SDRAMState.initRefresh
+      }
+    }
+    is(SDRAMState.initRefresh) {
+      when(timer =/= 0.U)(timer := timer - 1.U)
+        .elsewhen(refreshes =/= 0.U) {
+          command   := REFRESH
+          timer     := (tRFC - 1).U
+          refreshes := 0.U
+        }
+        .otherwise {
+          command := LOADMODE
+          bank    := 0.U
+          address := modeRegister.U
+          timer   := (tMRD - 1).U
+          state   := SDRAMState.loadMode
+        }
+    }
+    is(SDRAMState.loadMode) {
+      when(timer =/= 0.U)(timer := timer - 1.U).otherwise {
+        dqm   := 0.U
+        state := SDRAMState.idle
+      }
+    }
+    is(SDRAMState.idle) {
+      when(refreshDue) {
+        command    := REFRESH
+        timer      := (tRFC - 1).U
+        refreshDue := false.B
+        state      := SDRAMState.refresh
+      }.elsewhen(io.line.request) {
+        command := ACTIVE
+        bank    := halfword(config.colBits + 1, config.colBits)
+        address := halfword(config.colBits + config.rowBits + 1, config.colBits + 2)
+        column  := halfword(config.colBits - 1, 0)
+        bursts  := (lineBeats / 8).U
+        beats   := lineBeats.U
+        timer   := (tRCD - 1).U
+        state   := Mux(io.line.write, SDRAMState.write, SDRAMState.read)
+      }
+    }
+    is(SDRAMState.refresh, SDRAMState.recover) {
+      when(timer =/= 0.U)(timer := timer - 1.U).otherwise(state := SDRAMState.idle)
+    }
+    is(SDRAMState.read, SDRAMState.write) {
+      when(timer =/= 0.U)(timer := timer - 1.U).elsewhen(bursts =/= 0.U) {
+        command := Mux(state === SDRAMState.write, WRITE, READ)
+        // The last burst closes the row
+        address := Cat(bursts === 1.U, column.pad(10))
+        column  := column + 8.U
+        bursts  := bursts - 1.U
+        timer   := 7.U
+        burst   := true.B
+      }
+    }
+  }
+
+  refreshTimer := refreshTimer - 1.U
+  when(refreshTimer === 0.U) {
+    refreshTimer := (clocks(config.tREFI) - 1).U
+    refreshDue   := true.B
+  }
+
+  // Writes drive a beat in each slot of their bursts, the cache moves to the next word after the high half
+  val writing = slot && state === SDRAMState.write
+  dqOE := writing
+  when(writing) {
+    dqOut := Mux(beats(0), io.line.writeData(31, 16), io.line.writeData(15, 0))
+    beats := beats - 1.U
+    when(beats === 1.U) {
+      state := SDRAMState.recover
+      timer := (tWR + tRP - 1).U
+    }
+  }
+  io.line.writeNext := writing && beats(0)
+
+  // Reads sample a beat casLatency + 1 clocks after each slot of their bursts
+  val readPipe  = RegInit(0.U((config.casLatency + 1).W))
+  val lowHalf   = Reg(UInt(16.W))
+  val readData  = RegInit(0.U(bitWidth.W))
+  val readValid = RegInit(false.B)
+  readPipe  := Cat(readPipe(config.casLatency - 1, 0), slot && state === SDRAMState.read)
+  readValid := false.B
+  when(readPipe(config.casLatency)) {
+    beats := beats - 1.U
+    when(beats(0)) {
+      readData  := Cat(io.sdram.dqIn, lowHalf)
+      readValid := true.B
+    }.otherwise {
+      lowHalf := io.sdram.dqIn
+    }
+    when(beats === 1.U) {
+      state := SDRAMState.recover
+      timer := (tRP - 1).U
+    }
+  }
+  io.line.readData  := readData
+  io.line.readValid := readValid
+  io.line.idle      := state === SDRAMState.idle && !refreshDue
+
+  io.sdram.cke   := true.B
+  io.sdram.csn   := command(3)
+  io.sdram.rasn  := command(2)
+  io.sdram.casn  := command(1)
+  io.sdram.wen   := command(0)
+  io.sdram.ba    := bank
+  io.sdram.addr  := address
+  io.sdram.dqm   := dqm
+  io.sdram.dqOut := dqOut
+  io.sdram.dqOE  := dqOE
+}
@@ -2,6 +2,7 @@ package chiselv
 
 import chisel3._
 import chisel3.experimental.Analog
+import chisel3.util.log2Ceil
 
 class SOC(
     cpuFrequency:          Int,
@@ -12,11 +13,20 @@ class SOC(
     memoryFile:            String = "",
     ramFile:               String = "",
     numGPIO:               Int = 8,
+    simConsole:            Boolean = false,
+    pipelined:             Boolean = false,
+    flash:                 Option[FlashConfig] = None,
+    sdram:                 Option[SDRAMConfig] = None,
+    timerTick:             Int = 1,
+    devices:               Seq[(BusDevice, () => BusSlave)] = Seq(),
   ) extends Module {
   val io = IO(new Bundle {
     val led0            = Output(Bool())     // LED 0 is the heartbeat
     val GPIO0External   = Analog(numGPIO.W)  // GPIO external port
     val UART0SerialPort = new UARTSerialPort // UART0 serial port
+    val UART0SimPort    = if (simConsole) Some(new UARTSimPort) else None // UART0 simulation console
+    val FLASH           = if (flash.isDefined) Some(new SPIFlashPort) else None // SPI flash for XIP
+    val SDRAM           = if (sdram.isDefined) Some(new SDRAMPort) else None    // External RAM
   })
 
   // Heartbeat LED - Keep on if reached an error
@@ -26,6 +36,7 @@ class SOC(
   // Instantiate and initialize the Instruction memory
   val instructionMemory = Module(new InstructionMemory(bitWidth, instructionMemorySize, memoryFile))
   instructionMemory.io.readAddr := 0.U
+  instructionMemory.io.fetch    := false.B
 
   // Instantiate and initialize the Data memory
   val dataMemory = Module(new DualPortRAM(bitWidth, dataMemorySize, ramFile))
@@ -39,20 +50,85 @@ class SOC(
   // Instantiate and connect the UART
   val fifoLength  = 128
   val rxOverclock = 16
-  val UART0       = Module(new Uart(fifoLength, rxOverclock))
+  val UART0       = Module(new Uart(fifoLength, rxOverclock, simConsole))
   UART0.io.serialPort <> io.UART0SerialPort
+  io.UART0SimPort.foreach(_ <> UART0.io.simPort.get)
+
+  // Devices on the MMIO bus of the core besides its own
+  val extDevices = devices.map(_._1)
 
   // Instantiate the Syscon Module
-  val syscon = Module(new Syscon(32, cpuFrequency, numGPIO, entryPoint, instructionMemorySize, dataMemorySize))
+  val syscon = Module(
+    new Syscon(
+      32,
+      cpuFrequency,
+      numGPIO,
+      entryPoint,
+      instructionMemorySize,
+      dataMemorySize,
+      flash.isDefined,
+      sdram.map(_.sizeBytes).getOrElse(0L),
+      timerTick,
+      MemoryIOManager.devices ++ extDevices,
+    )
+  )
+  syscon.icache.hits   := 0.U
+  syscon.icache.misses := 0.U
 
-  // Instantiate our core
-  val core = Module(
-    new CPUSingleCycle(cpuFrequency, entryPoint, bitWidth, instructionMemorySize, dataMemorySize, numGPIO)
+  // Instantiate our core, the five stage pipeline or the single cycle one
+  val core: CPUCore = Module(
+    if (pipelined)
+      new CPUPipelined(cpuFrequency, entryPoint, bitWidth, dataMemorySize, numGPIO, timerTick, extDevices)
+    else
+      new CPUSingleCycle(cpuFrequency, entryPoint, bitWidth, dataMemorySize, numGPIO, timerTick, extDevices)
   )
 
   // Connect the core to the devices
-  core.io.instructionMemPort <> instructionMemory.io
+  val fetch = core.io.instructionMemPort
+  instructionMemory.io.readAddr := fetch.readAddr(log2Ceil(instructionMemorySize) - 1, 0)
+  fetch.readData                := instructionMemory.io.readData
+  fetch.ready                   := instructionMemory.io.ready
+
+  // Instructions in 0x2000_0000 - 0x20FF_FFFF execute in place from the SPI flash through the instruction cache
+  flash.foreach { config =>
+    val flashWindow = 16 * 1024 * 1024
+    val spiFlash    = Module(new SPIFlash(bitWidth, config.lineBytes / (bitWidth / 8), config.quad))
+    val icache = Module(
+      new ICache(bitWidth, flashWindow, config.offset, config.cacheSize, config.lineBytes, config.ways)
+    )
+    val inWindow = fetch.readAddr(31, 24) === 0x20.U
+    icache.io.fetch.readAddr := fetch.readAddr(log2Ceil(flashWindow) - 1, 0)
+    icache.io.fetch.fetch    := fetch.fetch && inWindow
+    icache.io.enable         := inWindow
+    icache.io.flash <> spiFlash.io.read
+    spiFlash.io.spi <> io.FLASH.get
+    when(inWindow) {
+      fetch.readData := icache.io.fetch.readData
+      fetch.ready    := icache.io.fetch.ready
+    }
+    syscon.icache.hits   := icache.io.hits
+    syscon.icache.misses := icache.io.misses
+  }
+
   core.io.dataMemPort <> dataMemory.io
+
+  // Data in 0x4000_0000 - 0x4FFF_FFFF goes through the data cache to the SDRAM, reads as 0 without one
+  core.io.dataCachePort.readData        := 0.U
+  core.io.dataCachePort.ready           := true.B
+  core.io.dataCachePort.control.DataOut := 0.U
+  sdram.foreach { config =>
+    val controller = Module(new SDRAMController(bitWidth, cpuFrequency, config))
+    val dcache     = Module(new DCache(bitWidth, config.sizeBytes, config.cacheSize, config.lineBytes, config.ways))
+    dcache.io.cpu <> core.io.dataCachePort
+    dcache.io.dram <> controller.io.line
+    controller.io.sdram <> io.SDRAM.get
+  }
+
+  // Extra devices on the MMIO bus of the core
+  for (((_, device), port) <- devices.zip(core.io.bus)) {
+    port <> Module(device()).bus
+  }
+
   core.io.UART0Port <> UART0.io.dataPort
   core.io.SysconPort <> syscon.io
   if (numGPIO > 0) {
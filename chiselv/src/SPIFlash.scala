@@ -0,0 +1,121 @@
+package chiselv
+
+import chisel3._
+import chisel3.util.{Cat, is, log2Ceil, switch}
+
+// External flash mapped at 0x2000_0000 for execute in place, see SOC
+case class FlashConfig(
+    offset:    Long = 0x10_0000, // Flash address seen at the start of the window, skips the FPGA bitstream
+    quad:      Boolean = true,   // Fast Read Quad Output (0x6B), needs the flash QE bit. Read Data (0x03) if false
+    cacheSize: Int = 4 * 1024,   // Instruction cache bytes
+    lineBytes: Int = 32,
+    ways:      Int = 2,          // 1 => Direct mapped, 2 => Two way set associative
+  )
+
+class SPIFlashPort extends Bundle {
+  val sclk    = Output(Bool())
+  val csn     = Output(Bool())
+  val dataOut = Output(UInt(4.W)) // IO3 to IO0, IO0 is MOSI and IO2/IO3 are WP#/HOLD# in single SPI mode
+  val dataOE  = Output(UInt(4.W)) // 1 => Drive the line
+  val dataIn  = Input(UInt(4.W))  // IO1 is MISO in single SPI mode
+}
+
+class FlashReadPort(bitWidth: Int = 32) extends Bundle {
+  val request = Input(Bool())     // Starts reading a line, only while idle
+  val address = Input(UInt(24.W)) // Flash byte address of the line
+  val data    = Output(UInt(bitWidth.W))
+  val valid   = Output(Bool())    // 1 => data holds the next word of the line
+  val idle    = Output(Bool())
+}
+
+object FlashState extends ChiselEnum {
+  val idle, command, dummy, data = Value
+}
+
+/**
+ * SPI flash read controller. Each request reads lineWords words with a
+ * single read command, SCLK runs at half the core clock (SPI mode 0). The
+ * command and the address go out on IO0, the data comes back on IO1 or, in
+ * quad mode, on IO0-IO3 after 8 dummy clocks. Words are assembled little
+ * endian as the bytes arrive in address order.
+ */
+class SPIFlash(bitWidth: Int = 32, lineWords: Int = 8, quad: Boolean = true) extends Module {
+  val io = IO(new Bundle {
+    val read = new FlashReadPort(bitWidth)
+    val spi  = new SPIFlashPort
+  })
+
+  val command       = if (quad) 0x6b else 0x03
+  val dummyClocks   = if (quad) 8 else 0
+  val dataLines     = if (quad) 4 else 1
+  val clocksPerWord = bitWidth / dataLines
+
+  val state   = RegInit(FlashState.idle)
+  val sclk    = RegInit(false.B)
+  val clocks  = RegInit(0.U(6.W))                       // SCLK periods left in the state
+  val words   = RegInit(0.U(log2Ceil(lineWords + 1).W)) // Words left in the line
+  val shifter = RegInit(0.U(32.W))                      // Command and address out, data in
+  val sampled = if (quad) io.spi.dataIn else io.spi.dataIn(1)
+
+  // Everything moves at the end of the SCLK high half: the flash sampled IO0 on the rising edge and drives the
+  // next data on the falling edge that follows
+  val endOfClock = sclk
+  val lastClock  = clocks === 1.U
+  val wordDone   = WireDefault(false.B)
+
+  switch(state) {
+    is(FlashState.idle) {
+      when(io.read.request) {
+        state   := FlashState.command
+        clocks  := 32.U
+        words   := lineWords.U
+        shifter := Cat(command.U(8.W), io.read.address)
+      }
+    }
+    is(FlashState.command) {
+      when(endOfClock) {
+        clocks  := clocks - 1.U
+        shifter := shifter << 1
+        when(lastClock) {
+          state  := (if (quad) FlashState.dummy else FlashState.data)
+          clocks := (if (quad) dummyClocks else clocksPerWord).U
+        }
+      }
+    }
+    is(FlashState.dummy) {
+      when(endOfClock) {
+        clocks := clocks - 1.U
+        when(lastClock) {
+          state  := FlashState.data
+          clocks := clocksPerWord.U
+        }
+      }
+    }
+    is(FlashState.data) {
+      when(endOfClock) {
+        clocks  := clocks - 1.U
+        shifter := Cat(shifter(31 - dataLines, 0), sampled)
+        when(lastClock) {
+          wordDone := true.B
+          clocks   := clocksPerWord.U
+          words    := words - 1.U
+          when(words === 1.U) {
+            state := FlashState.idle
+          }
+        }
+      }
+    }
+  }
+  sclk := state =/= FlashState.idle && !sclk
+
+  io.spi.sclk    := sclk
+  io.spi.csn     := state === FlashState.idle
+  io.spi.dataOut := Cat("b11".U(2.W), 0.U(1.W), shifter(31))
+  // In quad mode the flash drives all four lines from the dummy clocks on, WP#/HOLD# are otherwise held high
+  io.spi.dataOE := Mux(state.isOneOf(FlashState.dummy, FlashState.data) && quad.B, 0.U, "b1101".U)
+
+  // The first byte read is the lowest address
+  io.read.valid := RegNext(wordDone, false.B)
+  io.read.data  := Cat(shifter(7, 0), shifter(15, 8), shifter(23, 16), shifter(31, 24))
+  io.read.idle  := state === FlashState.idle
+}
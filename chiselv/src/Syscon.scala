@@ -4,8 +4,10 @@ import chisel3._
 import chisel3.util.{is, switch}
 
 class SysconPort(val bitWidth: Int) extends Bundle {
-  val Address = Input(UInt(12.W))
-  val DataOut = Output(UInt(bitWidth.W))
+  val Address     = Input(UInt(12.W))
+  val DataOut     = Output(UInt(bitWidth.W))
+  val DataIn      = Input(UInt(bitWidth.W))
+  val WriteEnable = Input(Bool())
 }
 
 class Syscon(
@@ -15,11 +17,28 @@ class Syscon(
     bootAddr:  Long,
     romSize:   Int,
     ramSize:   Int,
+    hasFlash:  Boolean = false,
+    sdramSize: Long = 0,
+    timerTick: Int = 1,
+    devices:   Seq[BusDevice] = Seq(),
   ) extends Module {
+  require(devices.size <= 0xf0, "The device table ends at 0xFFC")
   val io = IO(new SysconPort(bitWidth))
+  // Instruction cache counters of the flash XIP window
+  val icache = IO(new Bundle {
+    val hits   = Input(UInt(32.W))
+    val misses = Input(UInt(32.W))
+  })
 
   val dataOut = WireDefault(0.U(bitWidth.W))
 
+  // Exit status written by software as (code << 1) | 1 (tohost style). The
+  // Verilator harness watches this register to end the simulation.
+  val exitStatus = RegInit(0.U(bitWidth.W))
+  when(io.WriteEnable && io.Address === 0x40L.U) {
+    exitStatus := io.DataIn
+  }
+
   switch(io.Address) {
     is(0x0L.U)(dataOut := 0xbaad_cafeL.U)
     // Clock frequency - (0x0000_1008)
@@ -40,6 +59,27 @@ class Syscon(
     is(0x30L.U)(dataOut := romSize.asUInt)
     // RAM Size - (0x0000_1034)
     is(0x34L.U)(dataOut := ramSize.asUInt)
+    // Has flash XIP window - (0x0000_1038)
+    is(0x38L.U)(dataOut := hasFlash.B)
+    // External RAM size, 0 without one - (0x0000_103C)
+    is(0x3cL.U)(dataOut := sdramSize.U)
+    // Exit status - (0x0000_1040)
+    is(0x40L.U)(dataOut := exitStatus)
+    // CLINT mtime frequency - (0x0000_1044)
+    is(0x44L.U)(dataOut := (clockFreq / timerTick).U)
+    // Instruction cache hits - (0x0000_1048)
+    is(0x48L.U)(dataOut := icache.hits)
+    // Instruction cache misses (line refills) - (0x0000_104C)
+    is(0x4cL.U)(dataOut := icache.misses)
+    // Number of devices on the MMIO bus - (0x0000_1050)
+    is(0x50L.U)(dataOut := devices.size.U)
+  }
+  // MMIO bus device table, id, base and size of each device - (0x0000_1100 + 0x10 * n)
+  for ((device, n) <- devices.zipWithIndex) {
+    val entry = 0x100 + 0x10 * n
+    when(io.Address === entry.U)(dataOut := device.id.U)
+    when(io.Address === (entry + 4).U)(dataOut := device.base.U)
+    when(io.Address === (entry + 8).U)(dataOut := device.size.U)
   }
 
   io.DataOut := dataOut
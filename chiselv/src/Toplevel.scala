@@ -10,11 +10,18 @@ class Toplevel(
     board:        String,
     invReset:     Boolean = true,
     cpuFrequency: Int,
+    simConsole:   Boolean = false,
+    pipelined:    Boolean = false,
+    xip:          Boolean = false,
+    sdram:        Boolean = false,
   ) extends Module {
   val io = FlatIO(new Bundle {
-    val led0  = Output(Bool())     // LED 0 is the heartbeat
-    val UART0 = new UARTSerialPort // UART 0
-    val GPIO0 = Analog(8.W)        // GPIO 0
+    val led0     = Output(Bool())     // LED 0 is the heartbeat
+    val UART0    = new UARTSerialPort // UART 0
+    val GPIO0    = Analog(8.W)        // GPIO 0
+    val UART0Sim = if (simConsole) Some(new UARTSimPort) else None // UART 0 simulation console
+    val FLASH    = if (xip) Some(new SPIFlashPort) else None // SPI flash, needs IO buffers and pins on boards
+    val SDRAM    = if (sdram) Some(new SDRAMPort) else None    // SDRAM, needs DQ buffers, pins and its clock
   })
 
   // Instantiate PLL module based on board
@@ -41,6 +48,10 @@ class Toplevel(
           memoryFile            = "progload.mem",
           ramFile               = "progload-RAM.mem",
           numGPIO               = numGPIO,
+          simConsole            = simConsole,
+          pipelined             = pipelined,
+          flash                 = if (xip) Some(FlashConfig()) else None,
+          sdram                 = if (sdram) Some(SDRAMConfig()) else None,
         )
       )
 
@@ -48,6 +59,9 @@ class Toplevel(
     io.led0 <> SOC.io.led0
     io.GPIO0 <> SOC.io.GPIO0External
     io.UART0 <> SOC.io.UART0SerialPort
+    io.UART0Sim.foreach(_ <> SOC.io.UART0SimPort.get)
+    io.FLASH.foreach(_ <> SOC.io.FLASH.get)
+    io.SDRAM.foreach(_ <> SOC.io.SDRAM.get)
   }
 }
 
@@ -59,11 +73,15 @@ object Toplevel {
       @arg(short = 'b', doc = "FPGA Board to use") board:                 String = "bypass",
       @arg(short = 'r', doc = "FPGA Board have inverted reset") invreset: Boolean = false,
       @arg(short = 'f', doc = "CPU Frequency to run core") cpufreq:       Int = 50000000,
+      @arg(short = 's', doc = "Add UART0 sim console") simconsole:        Boolean = false,
+      @arg(short = 'p', doc = "Five stage pipelined core") pipelined:     Boolean = false,
+      @arg(short = 'x', doc = "Execute in place from SPI flash") xip:     Boolean = false,
+      @arg(short = 'd', doc = "External SDRAM with a data cache") sdram:  Boolean = false,
       @arg(short = 'c', doc = "Chisel arguments") chiselArgs:             Leftover[String],
     ) =
     // Generate SystemVerilog
     ChiselStage.emitSystemVerilogFile(
-      new Toplevel(board, invreset, cpufreq),
+      new Toplevel(board, invreset, cpufreq, simconsole, pipelined, xip, sdram),
       chiselArgs.value.toArray,
       Array(
         // Removes debug information from the generated Verilog
@@ -19,6 +19,10 @@ import chisel3.util._
  * introduced by oversampling might be significant. Eg at 10MHz, 115200 baud,
  * 16x oversampling we have almost 8% error and the UART fails to work.
  *
+ * For simulation the UART can be generated with simConsole, which adds a
+ * port that moves bytes straight in and out of the FIFOs when enabled, so the
+ * harness does not need to (de)serialize every bit at the baud rate.
+ *
  * This file has been created by Anton Blanchard on Chiselwatt repository at:
  * https://github.com/antonblanchard/chiselwatt
  */
@@ -35,13 +39,25 @@ class UARTPort extends Bundle {
   val txEmpty      = Output(Bool())
   val rxFull       = Output(Bool())
   val txFull       = Output(Bool())
+  val rxCount      = Output(UInt(16.W)) // Bytes waiting in the RX FIFO
+  val txCount      = Output(UInt(16.W)) // Bytes waiting in the TX FIFO
+  val fifoLength   = Output(UInt(16.W)) // Entries in each FIFO
   val clockDivisor = Flipped(Valid(UInt(8.W)))
+  val txWatermark  = Flipped(Valid(UInt(16.W))) // TX interrupt level
+  val txInterrupt  = Output(Bool())             // TX FIFO holds fewer bytes than the watermark
+}
+
+class UARTSimPort extends Bundle {
+  val enable = Input(Bool())                   // Bypass the serial line
+  val tx     = Valid(UInt(8.W))                // Byte dequeued from the TX FIFO
+  val rx     = Flipped(Decoupled(UInt(8.W)))  // Byte to enqueue in the RX FIFO
 }
 
-class Uart(val fifoLength: Int, val rxOverclock: Int) extends Module {
+class Uart(val fifoLength: Int, val rxOverclock: Int, val simConsole: Boolean = false) extends Module {
   val io = IO(new Bundle {
     val serialPort = new UARTSerialPort
     val dataPort   = new UARTPort
+    val simPort    = if (simConsole) Some(new UARTSimPort) else None
   })
 
   require(isPow2(rxOverclock))
@@ -54,6 +70,12 @@ class Uart(val fifoLength: Int, val rxOverclock: Int) extends Module {
     clockDivisor := io.dataPort.clockDivisor.bits
   }
 
+  // The TX interrupt asks for more bytes once the FIFO drains below the watermark, 0 disables it
+  val txWatermark = RegInit(0.U(16.W))
+  when(io.dataPort.txWatermark.valid) {
+    txWatermark := io.dataPort.txWatermark.bits
+  }
+
   val txQueue = Module(new Queue(UInt(8.W), fifoLength))
   val rxQueue = Module(new Queue(UInt(8.W), fifoLength))
 
@@ -62,6 +84,11 @@ class Uart(val fifoLength: Int, val rxOverclock: Int) extends Module {
   io.dataPort.rxFull  := rxQueue.io.count === fifoLength.U
   io.dataPort.txFull  := txQueue.io.count === fifoLength.U
 
+  io.dataPort.rxCount     := rxQueue.io.count
+  io.dataPort.txCount     := txQueue.io.count
+  io.dataPort.fifoLength  := fifoLength.U
+  io.dataPort.txInterrupt := txQueue.io.count < txWatermark
+
   val uartEnabled = clockDivisor.orR
 
   when(uartEnabled) {
@@ -212,6 +239,23 @@ class Uart(val fifoLength: Int, val rxOverclock: Int) extends Module {
     }
   }
 
+  /* Simulation console, takes over both FIFOs from the serial state machines */
+  io.simPort.foreach { sim =>
+    sim.tx.valid := false.B
+    sim.tx.bits  := txQueue.io.deq.bits
+    sim.rx.ready := false.B
+    when(sim.enable) {
+      tx                   := 1.U
+      txState              := sTxIdle
+      txQueue.io.deq.ready := true.B
+      sim.tx.valid         := txQueue.io.deq.valid
+
+      rxQueue.io.enq.valid := sim.rx.valid
+      rxQueue.io.enq.bits  := sim.rx.bits
+      sim.rx.ready         := rxQueue.io.enq.ready
+    }
+  }
+
   rxQueue.io.deq <> io.dataPort.rxQueue
   txQueue.io.enq <> io.dataPort.txQueue
 }
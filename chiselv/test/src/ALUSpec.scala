@@ -76,6 +76,81 @@ class ALUSpec extends AnyFlatSpec with ChiselScalatestTester with should.Matcher
   it should "SLTIU" in {
     testCycle(SLTIU)
   }
+  it should "MUL" in {
+    testCycle(MUL)
+  }
+  it should "MULH" in {
+    testCycle(MULH)
+  }
+  it should "MULHSU" in {
+    testCycle(MULHSU)
+  }
+  it should "MULHU" in {
+    testCycle(MULHU)
+  }
+  it should "SH1ADD" in {
+    testCycle(SH1ADD)
+  }
+  it should "SH2ADD" in {
+    testCycle(SH2ADD)
+  }
+  it should "SH3ADD" in {
+    testCycle(SH3ADD)
+  }
+  it should "ANDN" in {
+    testCycle(ANDN)
+  }
+  it should "ORN" in {
+    testCycle(ORN)
+  }
+  it should "XNOR" in {
+    testCycle(XNOR)
+  }
+  it should "CLZ" in {
+    testCycle(CLZ)
+  }
+  it should "CTZ" in {
+    testCycle(CTZ)
+  }
+  it should "CPOP" in {
+    testCycle(CPOP)
+  }
+  it should "MAX" in {
+    testCycle(MAX)
+  }
+  it should "MAXU" in {
+    testCycle(MAXU)
+  }
+  it should "MIN" in {
+    testCycle(MIN)
+  }
+  it should "MINU" in {
+    testCycle(MINU)
+  }
+  it should "SEXTB" in {
+    testCycle(SEXTB)
+  }
+  it should "SEXTH" in {
+    testCycle(SEXTH)
+  }
+  it should "ZEXTH" in {
+    testCycle(ZEXTH)
+  }
+  it should "ROL" in {
+    testCycle(ROL)
+  }
+  it should "ROR" in {
+    testCycle(ROR)
+  }
+  it should "RORI" in {
+    testCycle(RORI)
+  }
+  it should "ORCB" in {
+    testCycle(ORCB)
+  }
+  it should "REV8" in {
+    testCycle(REV8)
+  }
   it should "EQ" in {
     testCycle(EQ)
   }
@@ -105,6 +180,30 @@ class ALUSpec extends AnyFlatSpec with ChiselScalatestTester with should.Matcher
       case SLL | SLLI   => a.toInt << b.toInt
       case SLT | SLTI   => if (a.toInt < b.toInt) 1 else 0
       case SLTU | SLTIU => if (a.to32Bit < b.to32Bit) 1 else 0
+      case MUL          => BigInt(a.toInt) * BigInt(b.toInt)
+      case MULH         => (BigInt(a.toInt) * BigInt(b.toInt)) >> 32
+      case MULHSU       => (BigInt(a.toInt) * b.to32Bit) >> 32
+      case MULHU        => (a.to32Bit * b.to32Bit) >> 32
+      case SH1ADD       => (a << 1) + b
+      case SH2ADD       => (a << 2) + b
+      case SH3ADD       => (a << 3) + b
+      case ANDN         => a & ~b
+      case ORN          => a | ~b
+      case XNOR         => ~(a ^ b)
+      case CLZ          => Integer.numberOfLeadingZeros(a.toInt)
+      case CTZ          => Integer.numberOfTrailingZeros(a.toInt)
+      case CPOP         => Integer.bitCount(a.toInt)
+      case MAX          => a.toInt max b.toInt
+      case MAXU         => a.to32Bit max b.to32Bit
+      case MIN          => a.toInt min b.toInt
+      case MINU         => a.to32Bit min b.to32Bit
+      case SEXTB        => a.toByte.toInt
+      case SEXTH        => a.toShort.toInt
+      case ZEXTH        => a & 0xffff
+      case ROL          => Integer.rotateLeft(a.toInt, b.toInt)
+      case ROR | RORI   => Integer.rotateRight(a.toInt, b.toInt)
+      case ORCB         => (0 until 32 by 8).map(i => if (((a >> i) & 0xff) != 0) BigInt(0xff) << i else BigInt(0)).sum
+      case REV8         => Integer.reverseBytes(a.toInt)
       case EQ           => if (a.to32Bit == b.to32Bit) 1 else 0
       case NEQ          => if (a.to32Bit != b.to32Bit) 1 else 0
       case GTE          => if (a.toInt >= b.toInt) 1 else 0
@@ -0,0 +1,64 @@
+package chiselv
+
+import chisel3._
+import chiseltest._
+import org.scalatest._
+
+import flatspec._
+import matchers._
+
+class BusDecodeWrapper(devices: Seq[BusDevice]) extends Module {
+  val address = IO(Input(UInt(32.W)))
+  val select  = IO(Output(UInt(devices.size.W)))
+  select := BusInterconnect.decode(devices, address)
+}
+
+class BusSpec extends AnyFlatSpec with ChiselScalatestTester with should.Matchers {
+  val devices = Seq(BusDevice("uart", 1, 0x3000_0000L, 0x1000), BusDevice("clint", 2, 0x0200_0000L, 0x1_0000))
+
+  it should "decode the device of an address" in {
+    test(new BusDecodeWrapper(devices)) { c =>
+      c.address.poke(0x3000_0014L)
+      c.select.peekInt() should be(1)
+      c.address.poke(0x0200_bff8L)
+      c.select.peekInt() should be(2)
+      c.address.poke(0x3000_1000L)
+      c.select.peekInt() should be(0)
+    }
+  }
+  it should "pass a request to the selected device and wait for its answer" in {
+    test(new BusInterconnect(32, devices)) { c =>
+      c.io.select.poke(2)
+      c.io.master.req.valid.poke(true)
+      c.io.master.req.bits.address.poke(0x0200_4004L)
+      c.io.master.req.bits.write.poke(true)
+      c.io.master.req.bits.data.poke(0x1234)
+      c.io.devices(0).req.ready.poke(true)
+      c.io.devices(1).req.ready.poke(false)
+      c.io.devices(0).req.valid.peekBoolean() should be(false)
+      c.io.devices(1).req.valid.peekBoolean() should be(true)
+      c.io.devices(1).req.bits.address.peekInt() should be(0x4004)
+      c.io.devices(1).req.bits.data.peekInt() should be(0x1234)
+      c.io.master.req.ready.peekBoolean() should be(false)
+      c.io.devices(1).req.ready.poke(true)
+      c.io.master.req.ready.peekBoolean() should be(true)
+      c.io.master.resp.valid.peekBoolean() should be(false)
+      c.io.devices(1).resp.valid.poke(true)
+      c.io.devices(1).resp.bits.poke(0x5678)
+      c.io.master.resp.valid.peekBoolean() should be(true)
+      c.io.master.resp.bits.peekInt() should be(0x5678)
+    }
+  }
+  it should "answer accesses to no device with 0" in {
+    test(new BusInterconnect(32, devices)) { c =>
+      c.io.select.poke(0)
+      c.io.master.req.valid.poke(true)
+      c.io.devices(0).resp.valid.poke(true)
+      c.io.devices(0).resp.bits.poke(0x5678)
+      c.io.devices(0).req.valid.peekBoolean() should be(false)
+      c.io.master.req.ready.peekBoolean() should be(true)
+      c.io.master.resp.valid.peekBoolean() should be(true)
+      c.io.master.resp.bits.peekInt() should be(0)
+    }
+  }
+}
@@ -0,0 +1,77 @@
+package chiselv
+
+import chiseltest._
+import org.scalatest._
+
+import flatspec._
+import matchers._
+
+class CLINTSpec extends AnyFlatSpec with ChiselScalatestTester with should.Matchers {
+
+  def write(c: CLINT, address: Int, data: Long): Unit = {
+    c.io.Address.poke(address)
+    c.io.DataIn.poke(data)
+    c.io.WriteEnable.poke(true)
+    c.clock.step()
+    c.io.WriteEnable.poke(false)
+  }
+
+  def read(c: CLINT, address: Int): BigInt = {
+    c.io.Address.poke(address)
+    c.io.DataOut.peekInt()
+  }
+
+  it should "count mtime every clock" in {
+    test(new CLINT(32)) { c =>
+      c.clock.step(10)
+      read(c, 0xbff8) should be(10)
+      c.hart.mtime.peekInt() should be(10)
+    }
+  }
+  it should "count mtime once per tick" in {
+    test(new CLINT(32, tickCycles = 25)) { c =>
+      c.clock.step(24)
+      read(c, 0xbff8) should be(0)
+      c.clock.step()
+      read(c, 0xbff8) should be(1)
+      c.clock.step(50)
+      read(c, 0xbff8) should be(3)
+    }
+  }
+  it should "write mtime and carry into the high word" in {
+    test(new CLINT(32)) { c =>
+      write(c, 0xbffc, 2)
+      write(c, 0xbff8, 0xffff_fffeL)
+      c.clock.step(2)
+      read(c, 0xbff8) should be(0)
+      read(c, 0xbffc) should be(3)
+      c.hart.mtime.peekInt() should be(0x3_0000_0000L)
+    }
+  }
+  it should "raise the timer interrupt while mtime >= mtimecmp" in {
+    test(new CLINT(32)) { c =>
+      c.hart.timerInterrupt.peekBoolean() should be(false)
+      read(c, 0x4000) should be(0xffff_ffffL)
+      read(c, 0x4004) should be(0xffff_ffffL)
+      write(c, 0x4004, 0)
+      write(c, 0x4000, 20) // mtime is 2
+      c.clock.step(17)
+      c.hart.timerInterrupt.peekBoolean() should be(false)
+      c.clock.step()
+      c.hart.timerInterrupt.peekBoolean() should be(true)
+      c.clock.step(5)
+      c.hart.timerInterrupt.peekBoolean() should be(true)
+      write(c, 0x4000, 100)
+      c.hart.timerInterrupt.peekBoolean() should be(false)
+    }
+  }
+  it should "set and clear the software interrupt with msip" in {
+    test(new CLINT(32)) { c =>
+      write(c, 0x0000, 1)
+      read(c, 0x0000) should be(1)
+      c.hart.softwareInterrupt.peekBoolean() should be(true)
+      write(c, 0x0000, 0)
+      c.hart.softwareInterrupt.peekBoolean() should be(false)
+    }
+  }
+}
@@ -0,0 +1,384 @@
+package chiselv
+
+import chiseltest._
+import chiseltest.experimental._
+import com.carlosedp.riscvassembler.RISCVAssembler
+import org.scalatest._
+
+import flatspec._
+import matchers._
+
+// Extend the SOC module to add the observer for sub-module signals
+class CPUPipelinedWrapper(memoryFile: String) extends SOC(
+      cpuFrequency          = 25000000,
+      entryPoint            = 0,
+      bitWidth              = 32,
+      instructionMemorySize = 1 * 1024,
+      dataMemorySize        = 1 * 1024,
+      memoryFile            = memoryFile,
+      numGPIO               = 0,
+      pipelined             = true,
+    ) {
+  val registers    = expose(core.registerBank.regs)
+  val retire       = expose(core.retire)
+  val retirePC     = expose(core.retirePC)
+  val stall        = expose(core.memoryIOManager.io.stall)
+  val memWrite     = expose(core.memoryIOManager.io.MemoryIOPort.writeRequest)
+  val memWriteAddr = expose(core.memoryIOManager.io.MemoryIOPort.writeAddr)
+  val memWriteData = expose(core.memoryIOManager.io.MemoryIOPort.writeData)
+}
+
+// The pipelined core runs the same programs as CPUSingleCycle, checked by their results since the cycle
+// an instruction writes back differs
+class CPUPipelinedSpec
+    extends AnyFlatSpec
+    with ChiselScalatestTester
+    with BeforeAndAfterEach
+    with BeforeAndAfterAll
+    with should.Matchers {
+  var memoryfile: os.Path = _
+  val tmpdir = os.pwd / "tmphex"
+
+  override def beforeAll(): Unit =
+    os.makeDir.all(tmpdir)
+  override def afterAll(): Unit =
+    scala.util.Try(os.remove(tmpdir))
+  override def beforeEach(): Unit =
+    memoryfile = tmpdir / (scala.util.Random.alphanumeric.filter(_.isLetter).take(15).mkString + ".hex")
+  override def afterEach(): Unit =
+    os.remove.all(memoryfile)
+
+  def fileDut(memoryFile: String) =
+    test(new CPUPipelinedWrapper(memoryFile)).withAnnotations(Seq(WriteVcdAnnotation))
+
+  def defaultDut(prog: String) = {
+    os.write(memoryfile, RISCVAssembler.fromString(prog))
+    fileDut(memoryfile.relativeTo(os.pwd).toString)
+  }
+
+  // For instructions the assembler does not support, one hex word per line
+  def hexDut(words: Seq[Long]) = {
+    os.write(memoryfile, words.map(w => f"$w%08x").mkString("", "\n", "\n"))
+    fileDut(memoryfile.relativeTo(os.pwd).toString)
+  }
+
+  // Steps until n instructions retired, returns the cycles it took
+  def runUntilRetired(c: CPUPipelinedWrapper, n: Int): Int = {
+    var cycles  = 0
+    var retired = 0
+    while (retired < n) {
+      if (c.retire.peekBoolean()) retired += 1
+      c.clock.step(1)
+      cycles += 1
+    }
+    cycles
+  }
+
+  // Steps the given cycles, returns the (address, data) of the stores done
+  def collectStores(c: CPUPipelinedWrapper, cycles: Int): Seq[(BigInt, BigInt)] =
+    (0 until cycles).flatMap { _ =>
+      val store =
+        if (c.memWrite.peekBoolean() && !c.stall.peekBoolean())
+          Some((c.memWriteAddr.peekInt(), c.memWriteData.peekInt()))
+        else None
+      c.clock.step(1)
+      store
+    }
+
+  it should "retire one dependent instruction per cycle with forwarding" in {
+    fileDut("./gcc/test/test_addi.mem") { c =>
+      c.clock.setTimeout(0)
+      // Four cycles to fill the pipeline, then every addi uses the result of the previous one
+      runUntilRetired(c, 31) should be(31 + 4)
+      val results = List.fill(8)(List(1000, 3000, 2000, 0)).flatten
+      for ((i, r) <- 1 until 32 zip results)
+        c.registers(i).peekInt() should be(r)
+    }
+  }
+
+  it should "load program and end with 25 (0x19) in mem address 100 (0x64)" in {
+    fileDut("./gcc/test/test_book.mem") { c =>
+      c.clock.setTimeout(0)
+      val stores = collectStores(c, 60)
+      stores should be(Seq((BigInt(0x80000000L), BigInt(7)), (BigInt(0x80000064L), BigInt(25))))
+      c.registers(2).peekInt() should be(25)
+      c.registers(3).peekInt() should be(0x44)
+      c.registers(5).peekInt() should be(11)
+      c.registers(7).peekInt() should be(7)
+      c.registers(9).peekInt() should be(18)
+    }
+  }
+
+  it should "loop thru ascii table writing to 0x3000_0000 region" in {
+    fileDut("./gcc/test/test_ascii.mem") { c =>
+      c.clock.setTimeout(0)
+      val stores = collectStores(c, 94 * 5 + 20)
+      stores.map(_._1).distinct should be(Seq(BigInt(0x30000000L)))
+      stores.map(_._2) should be((33 until 127).map(BigInt(_)))
+    }
+  }
+
+  it should "stall on load-use hazards and forward store data" in {
+    val prog = """
+      lui x1, 0x80000
+      addi x2, x0, 5
+      addi x3, x2, 7
+      add x4, x3, x2
+      sub x5, x4, x3
+      sw x5, 0(x1)
+      lw x6, 0(x1)
+      add x7, x6, x6
+      sw x7, 4(x1)
+      lw x8, 4(x1)
+      sw x8, 8(x1)
+      lw x9, 8(x1)
+      lb x10, 8(x1)
+      addi x11, x10, 1
+      jal x0, 0
+      """
+    defaultDut(prog) { c =>
+      c.clock.setTimeout(0)
+      runUntilRetired(c, 14)
+      Seq(2 -> 5, 3 -> 12, 4 -> 17, 5 -> 5, 6 -> 5, 7 -> 10, 8 -> 10, 9 -> 10, 10 -> 10, 11 -> 11).foreach {
+        case (reg, value) => c.registers(reg).peekInt() should be(value)
+      }
+    }
+  }
+
+  it should "not stall on stores and on loads read ahead from EX" in {
+    val prog = """
+      lui x1, 0x80000
+      addi x2, x0, 7
+      sw x2, 0(x1)
+      sh x2, 4(x1)
+      sb x2, 8(x1)
+      lw x3, 0(x1)
+      lhu x4, 4(x1)
+      lbu x5, 8(x1)
+      add x6, x3, x4
+      jal x0, 0
+      """
+    defaultDut(prog) { c =>
+      c.clock.setTimeout(0)
+      runUntilRetired(c, 9) should be(9 + 4)
+      Seq(3 -> 7, 4 -> 7, 5 -> 7, 6 -> 14).foreach { case (reg, value) =>
+        c.registers(reg).peekInt() should be(value)
+      }
+    }
+  }
+
+  it should "flush the instructions fetched after taken branches and jumps" in {
+    val prog = """
+      addi x1, x0, 3
+      addi x2, x0, 0
+      addi x2, x2, 1
+      bne x2, x1, -4
+      addi x3, x0, 1
+      jal x4, +12
+      addi x5, x0, 99
+      addi x5, x0, 98
+      auipc x6, 0
+      jalr x7, x6, 16
+      addi x8, x0, 97
+      addi x9, x0, 96
+      addi x10, x0, 1
+      jal x0, 0
+      """
+    defaultDut(prog) { c =>
+      c.clock.setTimeout(0)
+      // addi, addi, 3 x (addi, bne), addi, jal, auipc, jalr, addi and the final jal looping
+      val retired = Seq.fill(40) {
+        val pc = if (c.retire.peekBoolean()) Some(c.retirePC.peekInt()) else None
+        c.clock.step(1)
+        pc
+      }.flatten
+      retired.take(14) should be(Seq(0, 4, 8, 12, 8, 12, 8, 12, 16, 20, 32, 36, 48, 52).map(BigInt(_)))
+      retired.drop(14).distinct should be(Seq(BigInt(52)))
+      Seq(2 -> 3, 3 -> 1, 4 -> 24, 5 -> 0, 6 -> 32, 7 -> 40, 8 -> 0, 9 -> 0, 10 -> 1).foreach {
+        case (reg, value) => c.registers(reg).peekInt() should be(value)
+      }
+    }
+  }
+
+  it should "forward RV32M and CSR results" in {
+    val prog = Seq(
+      0xff900093L, // addi x1, x0, -7
+      0x00300113L, // addi x2, x0, 3
+      0x022081b3L, // mul x3, x1, x2
+      0x00318233L, // add x4, x3, x3
+      0x0220c2b3L, // div x5, x1, x2
+      0x00128313L, // addi x6, x5, 1
+      0x0220e3b3L, // rem x7, x1, x2
+      0x02538433L, // mul x8, x7, x5
+      0xc02024f3L, // csrrs x9, instret, x0
+      0x00048513L, // addi x10, x9, 0
+      0x0000006fL, // jal x0, 0
+    )
+    hexDut(prog) { c =>
+      c.clock.setTimeout(0)
+      // Each divide holds the pipeline for 32 cycles and the addi waits a cycle for the CSR read
+      runUntilRetired(c, 10) should be(10 + 4 + 2 * 32 + 1)
+      c.registers(3).peekInt() should be(0xffffffebL)
+      c.registers(4).peekInt() should be(0xffffffd6L)
+      c.registers(5).peekInt() should be(0xfffffffeL)
+      c.registers(6).peekInt() should be(0xffffffffL)
+      c.registers(7).peekInt() should be(0xffffffffL)
+      c.registers(8).peekInt() should be(2)
+      c.registers(9).peekInt() should be(8) // Eight instructions retired before
+      c.registers(10).peekInt() should be(8)
+    }
+  }
+
+  it should "trap on ECALL and return with MRET" in {
+    val prog = Seq(
+      0x04000093L, // addi x1, x0, 0x40
+      0x30509073L, // csrrw x0, mtvec, x1
+      0x00000073L, // ecall
+      0x00700193L, // addi x3, x0, 7
+      0x0000006fL, // jal x0, 0
+    ) ++ Seq.fill(11)(0x00000013L) ++ Seq(
+      0x34202173L, // csrrs x2, mcause, x0 (handler at 0x40)
+      0x34102273L, // csrrs x4, mepc, x0
+      0x00420213L, // addi x4, x4, 4
+      0x34121073L, // csrrw x0, mepc, x4
+      0x30200073L, // mret
+    )
+    hexDut(prog) { c =>
+      c.clock.setTimeout(0)
+      c.clock.step(40)
+      c.registers(2).peekInt() should be(TrapCause.ecall)
+      c.registers(4).peekInt() should be(0x0c)
+      c.registers(3).peekInt() should be(7)
+      c.registers(1).peekInt() should be(0x40)
+    }
+  }
+
+  it should "restart a divide flushed by an interrupt" in {
+    val prog = Seq(
+      0x04000093L, // addi x1, x0, 0x40
+      0x30509073L, // csrrw x0, mtvec, x1
+      0x020002b7L, // lui x5, 0x2000 (CLINT msip)
+      0x00800393L, // addi x7, x0, 8
+      0x3043a073L, // csrrs x0, mie, x7
+      0x30046073L, // csrrsi x0, mstatus, 8
+      0x06400513L, // addi x10, x0, 100
+      0x00700593L, // addi x11, x0, 7
+      0x00100313L, // addi x6, x0, 1
+      0x0062a023L, // sw x6, 0(x5)
+      0x02b55633L, // divu x12, x10, x11 (busy in EX when the sw retires and the interrupt is taken)
+      0x00100813L, // addi x16, x0, 1
+      0x0000006fL, // jal x0, 0
+    ) ++ Seq.fill(3)(0x00000013L) ++ Seq(
+      0x34202173L, // csrrs x2, mcause, x0 (handler at 0x40)
+      0x34102273L, // csrrs x4, mepc, x0
+      0x0002a023L, // sw x0, 0(x5)
+      0x3e800713L, // addi x14, x0, 1000
+      0x00300793L, // addi x15, x0, 3
+      0x02f756b3L, // divu x13, x14, x15
+      0x30200073L, // mret
+    )
+    hexDut(prog) { c =>
+      c.clock.setTimeout(0)
+      c.clock.step(200)
+      c.registers(2).peekInt() should be(0x8000_0000L + Interrupt.software)
+      c.registers(4).peekInt() should be(0x28) // The divide was flushed and runs again after the handler
+      c.registers(13).peekInt() should be(333)
+      c.registers(12).peekInt() should be(14)
+      c.registers(16).peekInt() should be(1)
+    }
+  }
+
+  it should "sleep in WFI until the CLINT timer interrupt" in {
+    val prog = Seq(
+      0x04000093L, // addi x1, x0, 0x40
+      0x30509073L, // csrrw x0, mtvec, x1
+      0x020042b7L, // lui x5, 0x2004 (CLINT mtimecmp)
+      0x0002a223L, // sw x0, 4(x5)
+      0x03200313L, // addi x6, x0, 50
+      0x0062a023L, // sw x6, 0(x5)
+      0x08000393L, // addi x7, x0, 0x80
+      0x3043a073L, // csrrs x0, mie, x7
+      0x30046073L, // csrrsi x0, mstatus, 8
+      0x10500073L, // wfi
+      0x00700193L, // addi x3, x0, 7
+      0x0000006fL, // jal x0, 0
+    ) ++ Seq.fill(4)(0x00000013L) ++ Seq(
+      0x34202173L, // csrrs x2, mcause, x0 (handler at 0x40)
+      0x34102273L, // csrrs x4, mepc, x0
+      0xfff00413L, // addi x8, x0, -1
+      0x0082a023L, // sw x8, 0(x5)
+      0x30200073L, // mret
+    )
+    hexDut(prog) { c =>
+      c.clock.setTimeout(0)
+      c.clock.step(40)
+      c.registers(2).peekInt() should be(0)
+      c.registers(3).peekInt() should be(0) // The addi after the WFI is held in ID
+      c.clock.step(60)
+      c.registers(2).peekInt() should be(0x8000_0000L + Interrupt.timer)
+      c.registers(4).peekInt() should be(0x28)
+      c.registers(3).peekInt() should be(7)
+    }
+  }
+
+  it should "skip a compressed EBREAK in the default trap handler" in {
+    val prog = Seq(
+      0x04000093L, // addi x1, x0, 0x40
+      0x30509073L, // csrrw x0, mtvec, x1
+      0x419d9002L, // c.ebreak; c.li x3, 7
+      0x0001a001L, // c.j 0; c.nop
+    ) ++ Seq.fill(12)(0x00010001L) ++ Seq(
+      0x34202573L, // csrrs x10, mcause, x0 (handler at 0x40, as _trap_entry in crt.s)
+      0x341025f3L, // csrrs x11, mepc, x0
+      0x00c000efL, // jal x1, 0x54 (trap_dispatch)
+      0x34151073L, // csrrw x0, mepc, x10
+      0x30200073L, // mret
+      0x02054363L, // blt x10, x0, 0x7a (default trap_dispatch in crt.s)
+      0x00300293L, // addi x5, x0, 3
+      0x00550663L, // beq x10, x5, 0x68
+      0x00458593L, // addi x11, x11, 4
+      0x0160006fL, // jal x0, 0x7a
+      0x006002efL, // jal x5, 0x6e
+      0x03179002L, // c.ebreak (never runs); auipc x6, 0 (low half)
+      0x03330000L, // (high half); sub x6, x6, x5 (low half)
+      0x85b34053L, // (high half); add x11, x11, x6 (low half)
+      0x85130065L, // (high half); addi x10, x11, 0 (low half)
+      0x80670005L, // (high half); jalr x0, 0(x1) (low half)
+      0x00010000L, // (high half); c.nop
+    )
+    hexDut(prog) { c =>
+      c.clock.setTimeout(0)
+      c.clock.step(80)
+      c.registers(6).peekInt() should be(2) // The size of the c.ebreak
+      c.registers(10).peekInt() should be(0x0a)
+      c.registers(3).peekInt() should be(7)
+    }
+  }
+
+  it should "run compressed instructions and 32 bit ones crossing two words" in {
+    val prog = Seq(
+      0x0085557dL, // c.li x10, -1; c.addi x1, 1
+      0x00500113L, // addi x2, x0, 5
+      0x01930085L, // c.addi x1, 1; addi x3, x0, 7 (low half)
+      0x28010070L, // (high half); c.jal +16
+      0x06300293L, // addi x5, x0, 99
+      0x06300293L, // addi x5, x0, 99
+      0x06300293L, // addi x5, x0, 99
+      0x02130001L, // c.nop; addi x4, x0, 9 (low half)
+      0xa0010090L, // (high half); c.j 0
+    )
+    hexDut(prog) { c =>
+      c.clock.setTimeout(0)
+      val retired = Seq.fill(20) {
+        val pc = if (c.retire.peekBoolean()) Some(c.retirePC.peekInt()) else None
+        c.clock.step(1)
+        pc
+      }.flatten
+      retired.take(8) should be(Seq(0x00, 0x02, 0x04, 0x08, 0x0a, 0x0e, 0x1e, 0x22).map(BigInt(_)))
+      Seq(1 -> 0x10, 2 -> 5, 3 -> 7, 4 -> 9, 5 -> 0).foreach {
+        case (reg, value) => c.registers(reg).peekInt() should be(value)
+      }
+      c.registers(10).peekInt() should be(0xffffffffL)
+    }
+  }
+}
@@ -26,7 +26,7 @@ class CPUSingleCycleWrapperApps(memoryFile: String) extends SOC(
 }
 
 class CPUSingleCycleAppsSpec extends AnyFlatSpec with ChiselScalatestTester with should.Matchers {
-  val writeLatency = 2
+  val writeLatency = 1
   val readLatency  = 1
 
   def defaultDut(memoryfile: String) =
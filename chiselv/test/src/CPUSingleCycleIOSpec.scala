@@ -185,4 +185,26 @@ class CPUSingleCycleIOSpec
       c.registers(3).peekInt() should be(2)
     }
   }
+
+  it should "read the UART0 FIFO levels" in {
+    val prog = """
+    main:   lui x1, 0x30000
+            addi x2, x0, 65
+            sw x2, 0(x1)
+            sw x2, 0(x1)
+            lw x3, 20(x1)
+            lw x4, 24(x1)
+            lw x5, 28(x1)
+    """
+    defaultDut(prog) { c =>
+      c.clock.setTimeout(0)
+      c.clock.step(4) // lui, addi and two bytes to TX, the UART is not enabled so they stay queued
+      c.clock.step(1)
+      c.registers(3).peekInt() should be(2) // TX level
+      c.clock.step(1)
+      c.registers(4).peekInt() should be(0) // RX level
+      c.clock.step(1)
+      c.registers(5).peekInt() should be(128) // FIFO size
+    }
+  }
 }
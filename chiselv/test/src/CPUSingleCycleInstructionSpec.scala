@@ -33,7 +33,7 @@ class CPUSingleCycleInstructionSpec
     with BeforeAndAfterAll
     with should.Matchers {
   val memReadLatency  = 1
-  val memWriteLatency = 1
+  val memWriteLatency = 0
   var memoryfile: os.Path = _
   val tmpdir = os.pwd / "tmphex"
 
@@ -58,6 +58,12 @@ class CPUSingleCycleInstructionSpec
       )
   }
 
+  // For instructions the assembler does not support, one hex word per line
+  def hexDut(words: Seq[Long]) = {
+    os.write(memoryfile, words.map(w => f"$w%08x").mkString("", "\n", "\n"))
+    test(new CPUSingleCycleInstWrapper(memoryfile.relativeTo(os.pwd).toString))
+  }
+
   it should "validate ADD/ADDI instructions" in {
     val prog = """
     addi x1, x1, 1
@@ -501,4 +507,208 @@ class CPUSingleCycleInstructionSpec
       c.clock.step(5) // Paddding
     }
   }
+
+  it should "validate CSR counter instructions" in {
+    val prog = Seq(
+      0x00100093L, // addi x1, x0, 1
+      0xc0202173L, // csrrs x2, instret, x0
+      0xc00021f3L, // csrrs x3, cycle, x0
+      0xb0009073L, // csrrw x0, mcycle, x1
+      0xb0002273L, // csrrs x4, mcycle, x0
+      0x3200d073L, // csrrwi x0, mcountinhibit, 1
+      0xb00022f3L, // csrrs x5, mcycle, x0
+      0xb0002373L, // csrrs x6, mcycle, x0
+      0xc82023f3L, // csrrs x7, instreth, x0
+    )
+    hexDut(prog) { c =>
+      c.clock.step(1)
+      c.registers(1).peekInt() should be(1)
+      c.clock.step(1)
+      c.registers(2).peekInt() should be(1) // One instruction retired before
+      c.clock.step(1)
+      c.registers(3).peekInt() should be(2)
+      c.clock.step(2)
+      c.registers(4).peekInt() should be(1) // Written by the csrrw
+      c.clock.step(2)
+      c.registers(5).peekInt() should be(3)
+      c.clock.step(1)
+      c.registers(6).peekInt() should be(3) // Stopped by mcountinhibit
+      c.clock.step(1)
+      c.registers(7).peekInt() should be(0)
+    }
+  }
+
+  it should "validate RV32M multiply and divide instructions" in {
+    val prog = Seq(
+      0xff900093L, // addi x1, x0, -7
+      0x00300113L, // addi x2, x0, 3
+      0x022081b3L, // mul x3, x1, x2
+      0x02209233L, // mulh x4, x1, x2
+      0x0220b2b3L, // mulhu x5, x1, x2
+      0x0220c333L, // div x6, x1, x2
+      0x0220e3b3L, // rem x7, x1, x2
+      0x0200d433L, // divu x8, x1, x0
+      0x0200e4b3L, // rem x9, x1, x0
+    )
+    hexDut(prog) { c =>
+      c.clock.setTimeout(0)
+      c.clock.step(2)
+      c.clock.step(1)
+      c.registers(3).peekInt() should be(0xffffffebL)
+      c.clock.step(1)
+      c.registers(4).peekInt() should be(0xffffffffL)
+      c.clock.step(1)
+      c.registers(5).peekInt() should be(2)
+      // The divider stalls the core for 32 cycles
+      c.clock.step(32)
+      c.pc.peekInt() should be(0x14)
+      c.registers(6).peekInt() should be(0)
+      c.clock.step(1)
+      c.registers(6).peekInt() should be(0xfffffffeL)
+      c.clock.step(33)
+      c.registers(7).peekInt() should be(0xffffffffL)
+      // Division by zero does not stall
+      c.clock.step(1)
+      c.registers(8).peekInt() should be(0xffffffffL)
+      c.clock.step(1)
+      c.registers(9).peekInt() should be(0xfffffff9L)
+    }
+  }
+
+  it should "trap on ECALL and return with MRET" in {
+    val prog = Seq(
+      0x04000093L, // addi x1, x0, 0x40
+      0x30509073L, // csrrw x0, mtvec, x1
+      0x00000073L, // ecall
+      0x00700193L, // addi x3, x0, 7
+      0x0000006fL, // jal x0, 0
+    ) ++ Seq.fill(11)(0x00000013L) ++ Seq(
+      0x34202173L, // csrrs x2, mcause, x0 (handler at 0x40)
+      0x34102273L, // csrrs x4, mepc, x0
+      0x00420213L, // addi x4, x4, 4
+      0x34121073L, // csrrw x0, mepc, x4
+      0x30200073L, // mret
+    )
+    hexDut(prog) { c =>
+      c.clock.step(3)
+      c.pc.peekInt() should be(0x40)
+      c.clock.step(5)
+      c.pc.peekInt() should be(0x0c)
+      c.registers(2).peekInt() should be(TrapCause.ecall)
+      c.registers(4).peekInt() should be(0x0c)
+      c.clock.step(1)
+      c.registers(3).peekInt() should be(7)
+    }
+  }
+
+  it should "sleep in WFI until the CLINT timer interrupt" in {
+    val prog = Seq(
+      0x04000093L, // addi x1, x0, 0x40
+      0x30509073L, // csrrw x0, mtvec, x1
+      0x020042b7L, // lui x5, 0x2004 (CLINT mtimecmp)
+      0x0002a223L, // sw x0, 4(x5)
+      0x03200313L, // addi x6, x0, 50
+      0x0062a023L, // sw x6, 0(x5)
+      0x08000393L, // addi x7, x0, 0x80
+      0x3043a073L, // csrrs x0, mie, x7
+      0x30046073L, // csrrsi x0, mstatus, 8
+      0x10500073L, // wfi
+      0x00700193L, // addi x3, x0, 7
+      0x0000006fL, // jal x0, 0
+    ) ++ Seq.fill(4)(0x00000013L) ++ Seq(
+      0x34202173L, // csrrs x2, mcause, x0 (handler at 0x40)
+      0x34102273L, // csrrs x4, mepc, x0
+      0xfff00413L, // addi x8, x0, -1
+      0x0082a023L, // sw x8, 0(x5)
+      0x30200073L, // mret
+    )
+    hexDut(prog) { c =>
+      c.clock.setTimeout(0)
+      c.clock.step(30)
+      c.pc.peekInt() should be(0x24)
+      c.registers(2).peekInt() should be(0)
+      c.clock.step(50)
+      c.registers(2).peekInt() should be(0x8000_0000L + Interrupt.timer)
+      c.registers(4).peekInt() should be(0x28) // Returns after the WFI
+      c.registers(3).peekInt() should be(7)
+      c.pc.peekInt() should be(0x2c)
+    }
+  }
+
+  it should "skip a compressed EBREAK in the default trap handler" in {
+    val prog = Seq(
+      0x04000093L, // addi x1, x0, 0x40
+      0x30509073L, // csrrw x0, mtvec, x1
+      0x419d9002L, // c.ebreak; c.li x3, 7
+      0x0001a001L, // c.j 0; c.nop
+    ) ++ Seq.fill(12)(0x00010001L) ++ Seq(
+      0x34202573L, // csrrs x10, mcause, x0 (handler at 0x40, as _trap_entry in crt.s)
+      0x341025f3L, // csrrs x11, mepc, x0
+      0x00c000efL, // jal x1, 0x54 (trap_dispatch)
+      0x34151073L, // csrrw x0, mepc, x10
+      0x30200073L, // mret
+      0x02054363L, // blt x10, x0, 0x7a (default trap_dispatch in crt.s)
+      0x00300293L, // addi x5, x0, 3
+      0x00550663L, // beq x10, x5, 0x68
+      0x00458593L, // addi x11, x11, 4
+      0x0160006fL, // jal x0, 0x7a
+      0x006002efL, // jal x5, 0x6e
+      0x03179002L, // c.ebreak (never runs); auipc x6, 0 (low half)
+      0x03330000L, // (high half); sub x6, x6, x5 (low half)
+      0x85b34053L, // (high half); add x11, x11, x6 (low half)
+      0x85130065L, // (high half); addi x10, x11, 0 (low half)
+      0x80670005L, // (high half); jalr x0, 0(x1) (low half)
+      0x00010000L, // (high half); c.nop
+    )
+    hexDut(prog) { c =>
+      c.clock.setTimeout(0)
+      c.clock.step(40)
+      c.registers(6).peekInt() should be(2) // The size of the c.ebreak
+      c.registers(10).peekInt() should be(0x0a)
+      c.registers(3).peekInt() should be(7)
+      c.pc.peekInt() should be(0x0c)
+    }
+  }
+
+  it should "run compressed instructions and 32 bit ones crossing two words" in {
+    val prog = Seq(
+      0x0085557dL, // c.li x10, -1; c.addi x1, 1
+      0x00500113L, // addi x2, x0, 5
+      0x01930085L, // c.addi x1, 1; addi x3, x0, 7 (low half)
+      0x28010070L, // (high half); c.jal +16
+      0x06300293L, // addi x5, x0, 99
+      0x06300293L, // addi x5, x0, 99
+      0x06300293L, // addi x5, x0, 99
+      0x02130001L, // c.nop; addi x4, x0, 9 (low half)
+      0xa0010090L, // (high half); c.j 0
+    )
+    hexDut(prog) { c =>
+      c.clock.step(1)
+      c.registers(10).peekInt() should be(0xffffffffL)
+      c.pc.peekInt() should be(0x02)
+      c.clock.step(1)
+      c.registers(1).peekInt() should be(1)
+      c.clock.step(1)
+      c.registers(2).peekInt() should be(5)
+      c.pc.peekInt() should be(0x08)
+      c.clock.step(1)
+      c.registers(1).peekInt() should be(2)
+      c.pc.peekInt() should be(0x0a)
+      c.clock.step(1) // Its first half was read with the c.addi
+      c.registers(3).peekInt() should be(7)
+      c.pc.peekInt() should be(0x0e)
+      c.clock.step(1)
+      c.registers(1).peekInt() should be(0x10) // Links to pc + 2
+      c.pc.peekInt() should be(0x1e)
+      c.clock.step(1) // Jumped to a crossing instruction, waits a cycle for its first half
+      c.pc.peekInt() should be(0x1e)
+      c.registers(4).peekInt() should be(0)
+      c.clock.step(1)
+      c.registers(4).peekInt() should be(9)
+      c.pc.peekInt() should be(0x22)
+      c.clock.step(1)
+      c.pc.peekInt() should be(0x22)
+      c.registers(5).peekInt() should be(0)
+    }
+  }
 }
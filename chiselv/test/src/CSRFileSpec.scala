@@ -0,0 +1,185 @@
+package chiselv
+
+import chiseltest._
+import org.scalatest._
+
+import Instruction._
+import flatspec._
+import matchers._
+
+class CSRFileSpec extends AnyFlatSpec with ChiselScalatestTester with should.Matchers {
+
+  def defaultDut =
+    test(new CSRFile(32)).withAnnotations(
+      Seq(
+        // WriteVcdAnnotation
+      )
+    )
+
+  def read(c: CSRFile, address: Int): BigInt = {
+    c.io.inst.poke(CSRRS)
+    c.io.address.poke(address)
+    c.io.dataIn.poke(0)
+    c.io.dataOut.peekInt()
+  }
+
+  it should "count cycles and retired instructions" in {
+    defaultDut { c =>
+      c.io.inst.poke(ERR_INST)
+      c.clock.step(10)
+      read(c, CSRAddress.cycle) should be(10)
+      read(c, CSRAddress.mcycle) should be(10)
+      read(c, CSRAddress.instret) should be(10)
+      c.io.stall.poke(true)
+      c.clock.step(5)
+      c.io.stall.poke(false)
+      read(c, CSRAddress.cycle) should be(15)
+      read(c, CSRAddress.instret) should be(10)
+      read(c, CSRAddress.hpmcounter3) should be(5)
+    }
+  }
+  it should "count branch, load and store events" in {
+    defaultDut { c =>
+      c.io.inst.poke(ERR_INST)
+      c.io.branchTaken.poke(true)
+      c.clock.step(3)
+      c.io.branchTaken.poke(false)
+      c.io.load.poke(true)
+      c.clock.step(2)
+      c.io.load.poke(false)
+      c.io.store.poke(true)
+      c.clock.step()
+      c.io.store.poke(false)
+      read(c, CSRAddress.hpmcounter3 + 1) should be(3)
+      read(c, CSRAddress.mhpmcounter3 + 2) should be(2)
+      read(c, CSRAddress.hpmcounter3 + 3) should be(1)
+    }
+  }
+  it should "write the machine counters and carry into the high half" in {
+    defaultDut { c =>
+      c.io.inst.poke(CSRRW)
+      c.io.address.poke(CSRAddress.mcycle)
+      c.io.dataIn.poke(0xffff_fffeL)
+      c.io.dataOut.peekInt() should be(0)
+      c.clock.step()
+      c.io.inst.poke(ERR_INST)
+      c.clock.step(2)
+      read(c, CSRAddress.cycle) should be(0)
+      read(c, CSRAddress.cycleh) should be(1)
+      read(c, CSRAddress.mcycleh) should be(1)
+    }
+  }
+  it should "not write the read-only user counters" in {
+    defaultDut { c =>
+      c.io.inst.poke(CSRRW)
+      c.io.address.poke(CSRAddress.instret)
+      c.io.dataIn.poke(100)
+      c.clock.step()
+      read(c, CSRAddress.instret) should be(1)
+    }
+  }
+  it should "set and clear bits with CSRRS and CSRRC" in {
+    defaultDut { c =>
+      c.io.inst.poke(CSRRSI)
+      c.io.address.poke(CSRAddress.mcountinhibit)
+      c.io.dataIn.poke(0x5) // Stop cycle and instret
+      c.clock.step()
+      read(c, CSRAddress.mcountinhibit) should be(0x5)
+      c.io.inst.poke(ERR_INST)
+      c.clock.step(10)
+      read(c, CSRAddress.cycle) should be(1)
+      read(c, CSRAddress.instret) should be(1)
+      c.io.mtime.poke(11)
+      read(c, CSRAddress.time) should be(11)
+      c.io.inst.poke(CSRRC)
+      c.io.address.poke(CSRAddress.mcountinhibit)
+      c.io.dataIn.poke(0x1) // Restart cycle
+      c.clock.step()
+      c.io.inst.poke(ERR_INST)
+      c.clock.step(2)
+      read(c, CSRAddress.mcountinhibit) should be(0x4)
+      read(c, CSRAddress.cycle) should be(3)
+      read(c, CSRAddress.instret) should be(1)
+    }
+  }
+  it should "read time from the CLINT mtime" in {
+    defaultDut { c =>
+      c.io.mtime.poke(0x1_2345_6789L)
+      read(c, CSRAddress.time) should be(0x2345_6789)
+      read(c, CSRAddress.timeh) should be(1)
+      c.io.inst.poke(CSRRW)
+      c.io.address.poke(CSRAddress.time)
+      c.io.dataIn.poke(5)
+      c.clock.step()
+      read(c, CSRAddress.time) should be(0x2345_6789)
+    }
+  }
+  it should "save mepc and mcause on a trap and restore MIE with mret" in {
+    defaultDut { c =>
+      c.io.inst.poke(CSRRSI)
+      c.io.address.poke(CSRAddress.mstatus)
+      c.io.dataIn.poke(0x8) // MIE
+      c.clock.step()
+      read(c, CSRAddress.mstatus) should be(0x1808)
+      c.io.inst.poke(CSRRW)
+      c.io.address.poke(CSRAddress.mtvec)
+      c.io.dataIn.poke(0x100)
+      c.clock.step()
+      c.io.inst.poke(ERR_INST)
+      c.io.trap.poke(true)
+      c.io.trapCause.poke(TrapCause.ecall)
+      c.io.trapPC.poke(0x44)
+      c.io.trapVector.peekInt() should be(0x100)
+      c.clock.step()
+      c.io.trap.poke(false)
+      read(c, CSRAddress.mepc) should be(0x44)
+      read(c, CSRAddress.mcause) should be(TrapCause.ecall)
+      read(c, CSRAddress.mstatus) should be(0x1880) // MPIE set, MIE cleared
+      c.io.mepc.peekInt() should be(0x44)
+      c.io.inst.poke(ERR_INST)
+      c.io.mret.poke(true)
+      c.clock.step()
+      c.io.mret.poke(false)
+      read(c, CSRAddress.mstatus) should be(0x1888)
+    }
+  }
+  it should "raise the highest priority enabled interrupt and vector to it" in {
+    defaultDut { c =>
+      c.io.interrupts.poke((1L << Interrupt.timer) | (1L << Interrupt.uartRx))
+      read(c, CSRAddress.mip) should be((1L << Interrupt.timer) | (1L << Interrupt.uartRx))
+      c.io.wakeup.peekBoolean() should be(false)
+      c.io.inst.poke(CSRRW)
+      c.io.address.poke(CSRAddress.mie)
+      c.io.dataIn.poke(0xffff_ffffL)
+      c.clock.step()
+      read(c, CSRAddress.mie) should be(Interrupt.mask)
+      // Pending and enabled in mie wakes up WFI, the interrupt also needs mstatus.MIE
+      c.io.wakeup.peekBoolean() should be(true)
+      c.io.interrupt.peekBoolean() should be(false)
+      c.io.inst.poke(CSRRWI)
+      c.io.address.poke(CSRAddress.mstatus)
+      c.io.dataIn.poke(0x8)
+      c.clock.step()
+      c.io.interrupt.peekBoolean() should be(true)
+      c.io.cause.peekInt() should be(0x8000_0000L + Interrupt.timer)
+      c.io.interrupts.poke(1L << Interrupt.uartRx)
+      c.io.cause.peekInt() should be(0x8000_0000L + Interrupt.uartRx)
+      // Vectored mode
+      c.io.inst.poke(CSRRW)
+      c.io.address.poke(CSRAddress.mtvec)
+      c.io.dataIn.poke(0x201)
+      c.clock.step()
+      c.io.trapCause.poke(0x8000_0000L + Interrupt.uartRx)
+      c.io.trapVector.peekInt() should be(0x200 + 4 * Interrupt.uartRx)
+      c.io.trapCause.poke(TrapCause.breakpoint)
+      c.io.trapVector.peekInt() should be(0x200)
+    }
+  }
+  it should "read unimplemented CSRs as zero" in {
+    defaultDut { c =>
+      c.clock.step(5)
+      read(c, 0x343) should be(0) // mtval
+      read(c, CSRAddress.hpmcounter3 + 10) should be(0)
+    }
+  }
+}
@@ -0,0 +1,209 @@
+package chiselv
+
+import scala.collection.mutable
+
+import chisel3._
+import chiseltest._
+import org.scalatest._
+
+import flatspec._
+import matchers._
+
+// The data cache with its SDRAM controller, as connected in SOC
+class DCacheSDRAM(ways: Int, config: SDRAMConfig) extends Module {
+  val io = IO(new Bundle {
+    val cpu   = new DCachePort(32)
+    val sdram = new SDRAMPort
+  })
+  val dcache     = Module(new DCache(32, config.sizeBytes, sizeBytes = 256, lineBytes = 32, ways = ways))
+  val controller = Module(new SDRAMController(32, 50000000, config))
+  io.cpu <> dcache.io.cpu
+  dcache.io.dram <> controller.io.line
+  io.sdram <> controller.io.sdram
+}
+
+// Behavioural SDRAM answering the commands on the pins, like verilator/sdram.cpp
+class SDRAMModel(colBits: Int, casLatency: Int) {
+  val mem       = mutable.Map[Long, Int]() // Half words
+  val open      = Array.fill(4)(-1)        // Open row of each bank
+  val readBeats = mutable.Map[Long, Long]() // Call that returns a beat -> half word address
+  var writeBase = 0L
+  var writeBeat = 8
+  var calls     = 0L
+  var mode      = -1
+  var refreshes = 0
+  var errors    = 0
+
+  def initial(a: Long): Int = ((a * 13 + (a >> 4)) & 0xffff).toInt
+  def read(a: Long):    Int = mem.getOrElse(a, initial(a))
+  def word(byteAddr: Long): BigInt = BigInt(read(byteAddr / 2)) | BigInt(read(byteAddr / 2 + 1)) << 16
+
+  def cycle(cmd: Int, ba: Int, addr: Int, dq: Int, dqOE: Boolean): Int = {
+    if (writeBeat < 8) {
+      if (dqOE) mem(writeBase + writeBeat) = dq
+      writeBeat += 1
+    }
+    cmd match {
+      case 0x3 => // ACTIVE
+        if (open(ba) >= 0) errors += 1
+        open(ba) = addr
+      case 0x5 | 0x4 => // READ, WRITE
+        if (open(ba) < 0 || mode < 0) errors += 1
+        val base = (open(ba).toLong << (colBits + 2)) | (ba.toLong << colBits) | (addr & ((1 << colBits) - 1))
+        if (cmd == 0x5) {
+          for (j <- 0 until 8) readBeats(calls + casLatency + j) = base + j
+        } else {
+          mem(base) = dq
+          writeBase = base
+          writeBeat = 1
+        }
+        if ((addr >> 10 & 1) == 1) open(ba) = -1
+      case 0x2 => // PRECHARGE
+        if ((addr >> 10 & 1) == 1) open.indices.foreach(open(_) = -1) else open(ba) = -1
+      case 0x1 => // REFRESH
+        if (open.exists(_ >= 0)) errors += 1
+        refreshes += 1
+      case 0x0 => // LOAD MODE REGISTER
+        mode = addr
+      case _ =>
+    }
+    val out = readBeats.remove(calls).map(read).getOrElse(0)
+    calls += 1
+    out
+  }
+}
+
+class DCacheSpec extends AnyFlatSpec with ChiselScalatestTester with should.Matchers {
+  val config = SDRAMConfig(rowBits = 4, colBits = 8, powerUp = 200, tREFI = 2000)
+
+  def step(c: DCacheSDRAM, sdram: SDRAMModel, cycles: Int = 1): Unit =
+    for (_ <- 0 until cycles) {
+      c.clock.step()
+      val s   = c.io.sdram
+      val cmd = Seq(s.csn, s.rasn, s.casn, s.wen).map(_.peekInt().toInt).reduce(_ << 1 | _)
+      val dq = sdram.cycle(
+        cmd,
+        s.ba.peekInt().toInt,
+        s.addr.peekInt().toInt,
+        s.dqOut.peekInt().toInt,
+        s.dqOE.peekBoolean(),
+      )
+      s.dqIn.poke(dq.U)
+    }
+
+  // Reads or writes addr, returns the cycles until the cache had the line
+  def access(c: DCacheSDRAM, sdram: SDRAMModel, addr: Long, write: Option[Long] = None): Int = {
+    c.io.cpu.address.poke(addr.U)
+    c.io.cpu.read.poke(write.isEmpty.B)
+    c.io.cpu.write.poke(write.isDefined.B)
+    c.io.cpu.writeData.poke(write.getOrElse(0L).U)
+    c.io.cpu.writeMask.poke("b1111".U)
+    var cycles = 0
+    while (!c.io.cpu.ready.peekBoolean()) {
+      step(c, sdram)
+      cycles += 1
+      cycles should be < 2000
+    }
+    val data = c.io.cpu.readData.peekInt()
+    step(c, sdram)
+    c.io.cpu.read.poke(false.B)
+    c.io.cpu.write.poke(false.B)
+    if (write.isEmpty) data should be(sdram.word(addr))
+    cycles
+  }
+
+  def control(c: DCacheSDRAM, sdram: SDRAMModel, command: Int): Unit = {
+    c.io.cpu.control.Address.poke(0x00.U)
+    c.io.cpu.control.DataIn.poke(command.U)
+    c.io.cpu.control.WriteEnable.poke(true.B)
+    step(c, sdram)
+    c.io.cpu.control.WriteEnable.poke(false.B)
+    var cycles = 0
+    while (c.io.cpu.control.DataOut.peekInt() != 0) {
+      step(c, sdram)
+      cycles += 1
+      cycles should be < 2000
+    }
+  }
+
+  def counter(c: DCacheSDRAM, register: Int): BigInt = {
+    c.io.cpu.control.Address.poke(register.U)
+    c.io.cpu.control.DataOut.peekInt()
+  }
+
+  it should "initialize the SDRAM and refresh it while idle" in {
+    test(new DCacheSDRAM(2, config)) { c =>
+      val sdram = new SDRAMModel(config.colBits, config.casLatency)
+      step(c, sdram, 400)
+      sdram.mode should be(0x23) // CAS latency 2, burst length 8
+      sdram.refreshes should be > 2
+      sdram.errors should be(0)
+    }
+  }
+
+  it should "fill a line on a miss and hit afterwards" in {
+    test(new DCacheSDRAM(2, config)) { c =>
+      val sdram = new SDRAMModel(config.colBits, config.casLatency)
+      access(c, sdram, 0x1008) should be > 0
+      for (addr <- 0x1000 until 0x1020 by 4)
+        access(c, sdram, addr) should be(0)
+      counter(c, 0x04) should be(9)
+      counter(c, 0x08) should be(1)
+      sdram.errors should be(0)
+    }
+  }
+
+  it should "write back a dirty line when it is replaced" in {
+    test(new DCacheSDRAM(2, config)) { c =>
+      val sdram = new SDRAMModel(config.colBits, config.casLatency)
+      // 4 sets of two 32 byte lines, these all map to set 0
+      access(c, sdram, 0x004, Some(0x1234_5678)) should be > 0
+      access(c, sdram, 0x080) should be > 0
+      sdram.word(0x004) should not be 0x1234_5678
+      access(c, sdram, 0x100) should be > 0 // Replaces 0x000
+      sdram.word(0x004) should be(0x1234_5678)
+      counter(c, 0x0c) should be(1)
+      access(c, sdram, 0x004) should be > 0
+      access(c, sdram, 0x080) should be > 0 // Replaces the clean 0x100
+      counter(c, 0x0c) should be(1)
+      sdram.errors should be(0)
+    }
+  }
+
+  it should "write the bytes of a store with its mask" in {
+    test(new DCacheSDRAM(1, config)) { c =>
+      val sdram = new SDRAMModel(config.colBits, config.casLatency)
+      access(c, sdram, 0x040, Some(0xaabb_ccddL))
+      c.io.cpu.address.poke(0x040.U)
+      c.io.cpu.write.poke(true.B)
+      c.io.cpu.writeData.poke(0x1100_0000L.U)
+      c.io.cpu.writeMask.poke("b1000".U)
+      step(c, sdram)
+      c.io.cpu.write.poke(false.B)
+      c.io.cpu.read.poke(true.B)
+      c.io.cpu.readData.peekInt() should be(0x11bb_ccddL)
+    }
+  }
+
+  it should "flush the dirty lines and invalidate them through the control register" in {
+    test(new DCacheSDRAM(2, config)) { c =>
+      val sdram = new SDRAMModel(config.colBits, config.casLatency)
+      val lines = Seq(0x000, 0x020, 0x0a0, 0x1e0)
+      for ((addr, i) <- lines.zipWithIndex)
+        access(c, sdram, addr + 8, Some(0xcafe_0000L + i))
+      access(c, sdram, 0x300) // Clean line
+      control(c, sdram, 1)    // Flush
+      for ((addr, i) <- lines.zipWithIndex)
+        sdram.word(addr + 8) should be(0xcafe_0000L + i)
+      counter(c, 0x0c) should be(lines.length)
+      // Still cached and clean
+      access(c, sdram, 0x008) should be(0)
+      control(c, sdram, 1)
+      counter(c, 0x0c) should be(lines.length)
+      control(c, sdram, 2) // Invalidate
+      access(c, sdram, 0x008) should be > 0
+      counter(c, 0x10) should be(32)
+      sdram.errors should be(0)
+    }
+  }
+}
@@ -0,0 +1,129 @@
+package chiselv
+
+import scala.collection.mutable
+
+import chiseltest._
+import org.scalatest._
+
+import flatspec._
+import matchers._
+
+class DMASpec extends AnyFlatSpec with ChiselScalatestTester with should.Matchers {
+  val ctrl   = 0x14
+  val status = 0x18
+  val start  = 1 << 8
+  val irq    = 1 << 4
+
+  def write(c: DMA, address: Int, data: Long): Unit = {
+    c.io.Address.poke(address)
+    c.io.DataIn.poke(data)
+    c.io.WriteEnable.poke(true)
+    c.clock.step()
+    c.io.WriteEnable.poke(false)
+  }
+
+  def read(c: DMA, address: Int): BigInt = {
+    c.io.Address.poke(address)
+    c.io.DataOut.peekInt()
+  }
+
+  def setup(c: DMA, channel: Int, src: Long, dst: Long, count: Int, srcStride: Int, dstStride: Int): Unit = {
+    val base = channel * 0x20
+    write(c, base + 0x00, src)
+    write(c, base + 0x04, dst)
+    write(c, base + 0x08, count)
+    write(c, base + 0x0c, srcStride & 0xffff_ffffL)
+    write(c, base + 0x10, dstStride & 0xffff_ffffL)
+  }
+
+  // Word addressed RAM with the one cycle read latency of DualPortRAM, UART FIFOs as Scala queues
+  class Bus(val ram: Array[Long]) {
+    val tx         = mutable.ArrayBuffer[Int]()
+    val rx         = mutable.Queue[Int]()
+    var txReady    = true
+    private var rd = Option.empty[Long]
+
+    def cycle(c: DMA): Unit = {
+      c.io.ram.readGrant.poke(true)
+      c.io.ram.writeGrant.poke(true)
+      c.io.ram.readData.poke(rd.map(a => ram(((a & 0xffff) >> 2).toInt)).getOrElse(0L))
+      c.io.uartTx.ready.poke(txReady)
+      c.io.uartRx.valid.poke(rx.nonEmpty)
+      c.io.uartRx.bits.poke(rx.headOption.getOrElse(0))
+      if (c.io.ram.writeRequest.peekBoolean()) {
+        val word = ((c.io.ram.writeAddr.peekInt().toLong & 0xffff) >> 2).toInt
+        val data = c.io.ram.writeData.peekInt().toLong
+        val mask = c.io.ram.writeMask.peekInt().toInt
+        for (b <- 0 until 4 if (mask & (1 << b)) != 0) {
+          ram(word) = ram(word) & ~(0xffL << (8 * b)) | data & (0xffL << (8 * b))
+        }
+      }
+      if (txReady && c.io.uartTx.valid.peekBoolean()) tx += c.io.uartTx.bits.peekInt().toInt
+      if (c.io.uartRx.ready.peekBoolean()) rx.dequeue()
+      rd = if (c.io.ram.readRequest.peekBoolean()) Some(c.io.ram.readAddr.peekInt().toLong) else None
+      c.clock.step()
+    }
+
+    // Cycles until the channel is done
+    def run(c: DMA, channel: Int, limit: Int = 200): Int = {
+      var cycles = 0
+      while ((read(c, channel * 0x20 + status) & 2) == 0) {
+        cycles should be < limit
+        cycle(c)
+        cycles += 1
+      }
+      cycles
+    }
+  }
+
+  it should "copy RAM words at one word per cycle" in {
+    test(new DMA(32)) { c =>
+      val bus = new Bus(Array.tabulate(64)(i => if (i < 16) 0x1111_0000L + i else 0L))
+      setup(c, 0, 0x8000_0000L, 0x8000_0080L, 16, 4, 4)
+      write(c, ctrl, start | (2 << 2))
+      read(c, status) should be(1)
+      bus.run(c, 0) should be <= 18
+      read(c, status) should be(2)
+      read(c, 0x08) should be(0)
+      bus.ram.slice(32, 48) should be(bus.ram.slice(0, 16))
+      write(c, status, 2)
+      read(c, status) should be(0)
+    }
+  }
+  it should "gather bytes with a source stride" in {
+    test(new DMA(32)) { c =>
+      val bus = new Bus(Array.tabulate(64)(i => if (i < 8) (i + 1) * 0x0101_0101L else 0L))
+      setup(c, 0, 0x8000_0001L, 0x8000_0081L, 8, 4, 1)
+      write(c, ctrl, start)
+      bus.run(c, 0)
+      bus.ram(32) should be(0x0302_0100L)
+      bus.ram(33) should be(0x0706_0504L)
+      bus.ram(34) should be(0x0000_0008L)
+    }
+  }
+  it should "send RAM to the UART and receive from it with both channels" in {
+    test(new DMA(32)) { c =>
+      val bus = new Bus(Array.fill(64)(0L))
+      bus.ram(0) = 0x6c6c_6548L // "Hell"
+      bus.ram(1) = 0x0000_006fL // "o"
+      bus.rx ++= Seq(0x61, 0x62, 0x63)
+      bus.txReady = false
+      setup(c, 0, 0x8000_0000L, 0, 5, 1, 0)
+      setup(c, 1, 0x3000_0004L, 0x8000_0040L, 3, 0, 2)
+      write(c, ctrl, start | irq | DMAMode.ramToUart)
+      write(c, 0x20 + ctrl, start | irq | (1 << 2) | DMAMode.uartToRam)
+      for (_ <- 0 until 10) bus.cycle(c)
+      bus.tx should be(empty)
+      read(c, status) should be(1)
+      c.interrupt.peekBoolean() should be(true) // Channel 1 is done
+      bus.ram(16) should be(0x0062_0061L)
+      bus.ram(17) should be(0x0000_0063L)
+      bus.txReady = true
+      bus.run(c, 0)
+      bus.tx.map(_.toChar).mkString should be("Hello")
+      write(c, status, 2)
+      write(c, 0x20 + status, 2)
+      c.interrupt.peekBoolean() should be(false)
+    }
+  }
+}
@@ -290,6 +290,67 @@ class DecoderSpec extends AnyFlatSpec with ChiselScalatestTester with should.Mat
     }
   }
 
+  behavior of "Decoder - Multiply/Divide"
+
+  // The assembler only knows RV32I, these are the encodings for "op x1, x2, x3"
+  val muldiv = Seq(
+    ("MUL", MUL, 0x023100b3L),
+    ("MULH", MULH, 0x023110b3L),
+    ("MULHSU", MULHSU, 0x023120b3L),
+    ("MULHU", MULHU, 0x023130b3L),
+    ("DIV", DIV, 0x023140b3L),
+    ("DIVU", DIVU, 0x023150b3L),
+    ("REM", REM, 0x023160b3L),
+    ("REMU", REMU, 0x023170b3L),
+  )
+  muldiv.foreach { case (name, inst, op) =>
+    it should s"Decode an $name instruction (type R)" in {
+      test(new Decoder) { c =>
+        c.io.op.poke(op.U)
+        c.clock.step()
+        // Divides run in the Divider, not in the ALU
+        validateResult(c, inst, 1, 2, 3, 0, name.startsWith("MUL"))
+      }
+    }
+  }
+
+  behavior of "Decoder - Bit manipulation"
+
+  // Encodings for "op x1, x2, x3" and the single source "op x1, x2" (rori x1, x2, 3), with their rs2 and imm fields
+  val bitmanip = Seq(
+    ("SH1ADD", SH1ADD, 0x203120b3L, 3, 0),
+    ("SH2ADD", SH2ADD, 0x203140b3L, 3, 0),
+    ("SH3ADD", SH3ADD, 0x203160b3L, 3, 0),
+    ("ANDN", ANDN, 0x403170b3L, 3, 0),
+    ("ORN", ORN, 0x403160b3L, 3, 0),
+    ("XNOR", XNOR, 0x403140b3L, 3, 0),
+    ("MAX", MAX, 0x0a3160b3L, 3, 0),
+    ("MAXU", MAXU, 0x0a3170b3L, 3, 0),
+    ("MIN", MIN, 0x0a3140b3L, 3, 0),
+    ("MINU", MINU, 0x0a3150b3L, 3, 0),
+    ("ZEXTH", ZEXTH, 0x080140b3L, 0, 0),
+    ("ROL", ROL, 0x603110b3L, 3, 0),
+    ("ROR", ROR, 0x603150b3L, 3, 0),
+    ("CLZ", CLZ, 0x60011093L, 0, 0x600),
+    ("CTZ", CTZ, 0x60111093L, 0, 0x601),
+    ("CPOP", CPOP, 0x60211093L, 0, 0x602),
+    ("SEXTB", SEXTB, 0x60411093L, 0, 0x604),
+    ("SEXTH", SEXTH, 0x60511093L, 0, 0x605),
+    ("RORI", RORI, 0x60315093L, 0, 0x603),
+    ("ORCB", ORCB, 0x28715093L, 0, 0x287),
+    ("REV8", REV8, 0x69815093L, 0, 0x698),
+  )
+  bitmanip.foreach { case (name, inst, op, rs2, imm) =>
+    val immediate = imm != 0
+    it should s"Decode an $name instruction (type ${if (immediate) "I" else "R"})" in {
+      test(new Decoder) { c =>
+        c.io.op.poke(op.U)
+        c.clock.step()
+        validateResult(c, inst, 1, 2, rs2, imm, toALU = true, use_imm = immediate)
+      }
+    }
+  }
+
   // --------------------- Test Helpers ---------------------
 
   def makeBin(
@@ -0,0 +1,122 @@
+package chiselv
+
+import chiseltest._
+import com.carlosedp.riscvassembler.ObjectUtils.NumericManipulation
+import org.scalatest._
+
+import Instruction._
+import flatspec._
+import matchers._
+
+class DividerSpec extends AnyFlatSpec with ChiselScalatestTester with should.Matchers {
+  val cases =
+    Array[BigInt](0, 1, 2, 3, 7, 123, -1, -2, -7, 0x7fffffffL, 0x80000000L, 0xffffffffL) ++ Seq.fill(5)(
+      BigInt(scala.util.Random.nextInt())
+    )
+
+  it should "DIV" in {
+    testCycle(DIV)
+  }
+  it should "DIVU" in {
+    testCycle(DIVU)
+  }
+  it should "REM" in {
+    testCycle(REM)
+  }
+  it should "REMU" in {
+    testCycle(REMU)
+  }
+  it should "stall for 32 cycles on a divide" in {
+    test(new Divider) { c =>
+      c.io.inst.poke(DIVU)
+      c.io.a.poke(100)
+      c.io.b.poke(7)
+      for (_ <- 0 until 32) {
+        c.io.busy.peekBoolean() should be(true)
+        c.clock.step()
+      }
+      c.io.busy.peekBoolean() should be(false)
+      c.io.x.peekInt() should be(14)
+      c.clock.step()
+      // A back-to-back divide starts again
+      c.io.busy.peekBoolean() should be(true)
+    }
+  }
+  it should "start over after a divide is killed" in {
+    test(new Divider) { c =>
+      c.io.inst.poke(DIVU)
+      c.io.a.poke(100)
+      c.io.b.poke(7)
+      c.clock.step(10)
+      c.io.kill.poke(true)
+      c.clock.step()
+      c.io.kill.poke(false)
+      c.io.a.poke(1000)
+      c.io.b.poke(3)
+      for (_ <- 0 until 32) {
+        c.io.busy.peekBoolean() should be(true)
+        c.clock.step()
+      }
+      c.io.busy.peekBoolean() should be(false)
+      c.io.x.peekInt() should be(333)
+    }
+  }
+  it should "not stall on division by zero or overflow" in {
+    test(new Divider) { c =>
+      c.io.inst.poke(DIV)
+      c.io.a.poke(123)
+      c.io.b.poke(0)
+      c.io.busy.peekBoolean() should be(false)
+      c.io.x.peekInt() should be(0xffffffffL)
+      c.io.inst.poke(REM)
+      c.io.a.poke(0x80000000L)
+      c.io.b.poke(0xffffffffL)
+      c.io.busy.peekBoolean() should be(false)
+      c.io.x.peekInt() should be(0)
+      c.io.inst.poke(ADD)
+      c.io.b.poke(5)
+      c.io.busy.peekBoolean() should be(false)
+    }
+  }
+
+  // --------------------- Test Helpers ---------------------
+  def divHelper(
+      a:  BigInt,
+      b:  BigInt,
+      op: Type,
+    ): BigInt = {
+    val (sa, sb)  = (BigInt(a.toInt), BigInt(b.toInt))
+    val (ua, ub)  = (a.to32Bit, b.to32Bit)
+    val overflows = sa == BigInt(Int.MinValue) && sb == -1
+    op match {
+      case DIV if sb == 0    => -1
+      case DIV if overflows  => sa
+      case DIV               => sa / sb // BigInt division truncates towards zero like RISC-V
+      case DIVU if ub == 0   => -1
+      case DIVU              => ua / ub
+      case REM if sb == 0    => sa
+      case REM if overflows  => 0
+      case REM               => sa % sb
+      case REMU if ub == 0   => ua
+      case REMU              => ua % ub
+      case _                 => 0 // Never happens
+    }
+  }
+
+  def testCycle(
+      op: Type
+    ) =
+    test(new Divider) { c =>
+      c.clock.setTimeout(0)
+      cases.foreach { i =>
+        cases.foreach { j =>
+          c.io.inst.poke(op)
+          c.io.a.poke(i.to32Bit)
+          c.io.b.poke(j.to32Bit)
+          while (c.io.busy.peekBoolean()) c.clock.step()
+          c.io.x.peekInt() should be(divHelper(i, j, op).to32Bit)
+          c.clock.step()
+        }
+      }
+    }
+}
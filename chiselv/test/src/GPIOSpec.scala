@@ -53,6 +53,42 @@ class GPIOSpec extends AnyFlatSpec with ChiselScalatestTester with should.Matche
     }
   }
 
+  it should "latch enabled edges as pending until cleared" in {
+    defaultDut { c =>
+      c.io.GPIOPort.writeDirection.poke(true)
+      c.io.GPIOPort.dataIn.poke("11111111".b)
+      c.clock.step()
+      c.io.GPIOPort.writeDirection.poke(false)
+      c.io.GPIOPort.writeRising.poke(true)
+      c.io.GPIOPort.dataIn.poke("00000011".b)
+      c.clock.step()
+      c.io.GPIOPort.writeRising.poke(false)
+      c.io.GPIOPort.writeFalling.poke(true)
+      c.io.GPIOPort.dataIn.poke("00000001".b)
+      c.clock.step()
+      c.io.GPIOPort.writeFalling.poke(false)
+      c.io.GPIOPort.risingOut.peekInt() should be("00000011".b)
+      c.io.GPIOPort.fallingOut.peekInt() should be("00000001".b)
+      c.io.interrupt.peekBoolean() should be(false)
+      // Outputs drive the pins, so writing the value makes the edges
+      c.io.GPIOPort.writeValue.poke(true)
+      c.io.GPIOPort.dataIn.poke("00000110".b)
+      c.clock.step(2)
+      c.io.GPIOPort.pendingOut.peekInt() should be("00000010".b)
+      c.io.interrupt.peekBoolean() should be(true)
+      c.io.GPIOPort.dataIn.poke("00000001".b)
+      c.clock.step(2)
+      c.io.GPIOPort.writeValue.poke(false)
+      c.io.GPIOPort.pendingOut.peekInt() should be("00000011".b)
+      c.io.GPIOPort.clearPending.poke(true)
+      c.io.GPIOPort.dataIn.poke("00000011".b)
+      c.clock.step()
+      c.io.GPIOPort.clearPending.poke(false)
+      c.io.GPIOPort.pendingOut.peekInt() should be(0)
+      c.io.interrupt.peekBoolean() should be(false)
+    }
+  }
+
   // Doesn't work since we can't poke the analog port
   //
   // it should "read IO data from input" in {
@@ -0,0 +1,170 @@
+package chiselv
+
+import chisel3._
+import chiseltest._
+import org.scalatest._
+
+import flatspec._
+import matchers._
+
+// The instruction cache with its flash controller, as connected in SOC
+class ICacheFlash(quad: Boolean, ways: Int, flashOffset: Long) extends Module {
+  val window = 16 * 1024 * 1024
+  val io = IO(new Bundle {
+    val fetch  = new InstructionMemPort(32, window)
+    val enable = Input(Bool())
+    val hits   = Output(UInt(32.W))
+    val misses = Output(UInt(32.W))
+    val spi    = new SPIFlashPort
+  })
+  val icache = Module(new ICache(32, window, flashOffset, sizeBytes = 256, lineBytes = 32, ways = ways))
+  val flash  = Module(new SPIFlash(32, lineWords = 8, quad = quad))
+  io.fetch <> icache.io.fetch
+  icache.io.enable := io.enable
+  icache.io.flash <> flash.io.read
+  io.spi <> flash.io.spi
+  io.hits   := icache.io.hits
+  io.misses := icache.io.misses
+}
+
+// Behavioural SPI flash answering the read commands, like verilator/spiflash.cpp
+class FlashModel(byte: Long => Int) {
+  var sclk      = false
+  var clocks    = 0
+  var cmd       = 0
+  var addr      = 0L
+  var dataStart = 0
+  var lines     = 0
+  var out       = 0
+  var reads     = 0
+
+  def cycle(sclkNow: Boolean, csn: Boolean, io: Int): Int = {
+    val rising  = sclkNow && !sclk
+    val falling = !sclkNow && sclk
+    sclk = sclkNow
+    if (csn) {
+      clocks = 0; cmd = 0; addr = 0; lines = 0
+    } else {
+      if (rising) {
+        clocks += 1
+        if (clocks <= 8) {
+          cmd = (cmd << 1 | (io & 1)) & 0xff
+          if (clocks == 8) {
+            val (l, start) = cmd match {
+              case 0x03 => (1, 32)
+              case 0x6b => (4, 40)
+              case _    => (0, 0)
+            }
+            lines = l
+            dataStart = start
+            reads += 1
+          }
+        } else if (clocks <= 32) {
+          addr = addr << 1 | (io & 1)
+        }
+      }
+      if (falling && lines > 0 && clocks >= dataStart) {
+        val n = clocks - dataStart
+        out =
+          if (lines == 4) (byte(addr + n / 2) >> (if (n % 2 == 1) 0 else 4)) & 0xf
+          else ((byte(addr + n / 8) >> (7 - n % 8)) & 1) << 1
+      }
+    }
+    out
+  }
+}
+
+class ICacheSpec extends AnyFlatSpec with ChiselScalatestTester with should.Matchers {
+  val flashOffset = 0x100L
+  def byte(addr: Long): Int = ((addr * 7 + (addr >> 8)) & 0xff).toInt
+  def word(addr: Long): BigInt = (0 until 4).map(i => BigInt(byte(flashOffset + addr + i)) << (8 * i)).sum
+
+  def step(c: ICacheFlash, flash: FlashModel, cycles: Int = 1): Unit =
+    for (_ <- 0 until cycles) {
+      c.clock.step()
+      val io = c.io.spi.dataOut.peekInt().toInt & c.io.spi.dataOE.peekInt().toInt
+      c.io.spi.dataIn.poke(flash.cycle(c.io.spi.sclk.peekBoolean(), c.io.spi.csn.peekBoolean(), io).U)
+    }
+
+  // Fetches addr, returns the cycles until the cache had the word
+  def fetch(c: ICacheFlash, flash: FlashModel, addr: Long): Int = {
+    c.io.fetch.readAddr.poke(addr.U)
+    var cycles = 0
+    while (!c.io.fetch.ready.peekBoolean()) {
+      step(c, flash)
+      cycles += 1
+      cycles should be < 1000
+    }
+    c.io.fetch.readData.peekInt() should be(word(addr))
+    step(c, flash)
+    cycles
+  }
+
+  def testRefill(quad: Boolean, maxCycles: Int) =
+    test(new ICacheFlash(quad, ways = 2, flashOffset)) { c =>
+      val flash = new FlashModel(byte)
+      c.io.enable.poke(true.B)
+      c.io.fetch.fetch.poke(true.B)
+      fetch(c, flash, 0x1008) should (be > 0 and be < maxCycles)
+      // The whole line is in the cache now
+      for (addr <- 0x1000 until 0x1020 by 4)
+        fetch(c, flash, addr) should be(0)
+      c.io.hits.peekInt() should be(9)
+      c.io.misses.peekInt() should be(1)
+      flash.reads should be(1)
+    }
+
+  it should "refill a line with quad reads and hit afterwards" in {
+    testRefill(quad = true, maxCycles = 250)
+  }
+
+  it should "refill a line with single SPI reads and hit afterwards" in {
+    testRefill(quad = false, maxCycles = 650)
+  }
+
+  it should "not access the flash for fetches outside the window" in {
+    test(new ICacheFlash(quad = true, ways = 2, flashOffset)) { c =>
+      val flash = new FlashModel(byte)
+      c.io.enable.poke(false.B)
+      c.io.fetch.fetch.poke(true.B)
+      c.io.fetch.readAddr.poke(0x40.U)
+      step(c, flash, 50)
+      c.io.spi.csn.peekBoolean() should be(true)
+      c.io.hits.peekInt() should be(0)
+      c.io.misses.peekInt() should be(0)
+    }
+  }
+
+  it should "keep two lines of a set and replace the least recently used" in {
+    test(new ICacheFlash(quad = true, ways = 2, flashOffset)) { c =>
+      val flash = new FlashModel(byte)
+      c.io.enable.poke(true.B)
+      c.io.fetch.fetch.poke(true.B)
+      // 4 sets of two 32 byte lines, these all map to set 0
+      fetch(c, flash, 0x000) should be > 0
+      fetch(c, flash, 0x080) should be > 0
+      fetch(c, flash, 0x000) should be(0)
+      fetch(c, flash, 0x080) should be(0)
+      fetch(c, flash, 0x100) should be > 0 // Replaces 0x000
+      fetch(c, flash, 0x080) should be(0)
+      fetch(c, flash, 0x000) should be > 0 // Replaces 0x100
+      fetch(c, flash, 0x080) should be(0)
+      c.io.misses.peekInt() should be(4)
+    }
+  }
+
+  it should "replace the line of the set when direct mapped" in {
+    test(new ICacheFlash(quad = true, ways = 1, flashOffset)) { c =>
+      val flash = new FlashModel(byte)
+      c.io.enable.poke(true.B)
+      c.io.fetch.fetch.poke(true.B)
+      // 8 sets of one 32 byte line
+      fetch(c, flash, 0x000) should be > 0
+      fetch(c, flash, 0x100) should be > 0
+      fetch(c, flash, 0x000) should be > 0
+      fetch(c, flash, 0x020) should be > 0
+      fetch(c, flash, 0x000) should be(0)
+      c.io.misses.peekInt() should be(4)
+    }
+  }
+}
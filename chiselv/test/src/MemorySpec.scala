@@ -15,6 +15,7 @@ class MemorySpec extends AnyFlatSpec with ChiselScalatestTester with should.Matc
       )
     ) { c =>
       c.io.writeEnable.poke(true)
+      c.io.writeMask.poke(0xf)
       c.io.writeAddress.poke(1)
       c.io.writeData.poke(1234)
       c.clock.step(1)
@@ -42,6 +43,7 @@ class MemorySpec extends AnyFlatSpec with ChiselScalatestTester with should.Matc
       addresses.foreach { address =>
         values.foreach { value =>
           c.io.writeEnable.poke(true)
+          c.io.writeMask.poke(0xf)
           c.io.writeAddress.poke(addressOffset + address)
           c.io.readAddress.poke(addressOffset + address)
           c.io.writeData.poke(value)
@@ -55,6 +57,27 @@ class MemorySpec extends AnyFlatSpec with ChiselScalatestTester with should.Matc
     }
   }
 
+  it should "write only the bytes enabled by writeMask" in {
+    test(new DualPortRAM(32, 1 * 1024)) { c =>
+      c.io.writeEnable.poke(true)
+      c.io.writeAddress.poke(0x20)
+      c.io.readAddress.poke(0x20)
+      c.io.writeMask.poke(0xf)
+      c.io.writeData.poke(0x1122_3344L)
+      c.clock.step()
+      Seq((0x1, 0xaaaa_aaaaL, 0x1122_33aaL), (0xc, 0xbbbb_bbbbL, 0xbbbb_33aaL), (0x4, 0x00cc_0000L, 0xbbcc_33aaL))
+        .foreach { case (mask, data, expected) =>
+          c.io.writeMask.poke(mask)
+          c.io.writeData.poke(data)
+          c.clock.step()
+          c.io.writeEnable.poke(false)
+          c.clock.step()
+          c.io.readData.peekInt() should be(expected)
+          c.io.writeEnable.poke(true)
+        }
+    }
+  }
+
   behavior of "InstructionMemory"
   it should "load from file and read multiple instructions" in {
     val filename = "MemorySpecTestFile.hex"
@@ -29,6 +29,16 @@ class ProgramCounterSpec extends AnyFlatSpec with ChiselScalatestTester with sho
       c.io.PC.peekInt() should be(4)
     }
   }
+  it should "walk 2 bytes" in {
+    test(new ProgramCounter) { c =>
+      c.io.PC2.peekInt() should be(2)
+      c.io.writeEnable.poke(true)
+      c.io.dataIn.poke(c.io.PC2.peek())
+      c.clock.step()
+      c.io.PC.peekInt() should be(2)
+      c.io.PC4.peekInt() should be(6)
+    }
+  }
   it should "jump to 0xbaddcafe (write)" in {
     test(new ProgramCounter) { c =>
       c.io.writeEnable.poke(true)
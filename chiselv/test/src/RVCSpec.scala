@@ -0,0 +1,98 @@
+package chiselv
+
+import chiseltest._
+import org.scalatest._
+
+import flatspec._
+import matchers._
+
+class RVCSpec extends AnyFlatSpec with ChiselScalatestTester with should.Matchers {
+  behavior of "RVCExpander"
+
+  // Compressed encoding, the instruction it expands to
+  val expansions = Seq(
+    ("c.addi ra, 1", 0x0085, 0x00108093L),          // addi ra, ra, 1
+    ("c.li a0, -1", 0x557d, 0xfff00513L),           // addi a0, zero, -1
+    ("c.lw a0, 4(a1)", 0x41c8, 0x0045a503L),        // lw a0, 4(a1)
+    ("c.j 0", 0xa001, 0x0000006fL),                 // jal zero, 0
+    ("c.j -4", 0xbff5, 0xffdff06fL),                // jal zero, -4
+    ("c.jal 16", 0x2801, 0x010000efL),              // jal ra, 16
+    ("c.mv t0, t1", 0x829a, 0x006002b3L),           // add t0, zero, t1
+    ("c.add t0, t1", 0x929a, 0x006282b3L),          // add t0, t0, t1
+    ("c.jr ra", 0x8082, 0x00008067L),               // jalr zero, 0(ra)
+    ("c.ebreak", 0x9002, 0x00100073L),              // ebreak
+    ("c.swsp ra, 12(sp)", 0xc606, 0x00112623L),     // sw ra, 12(sp)
+    ("c.lwsp ra, 12(sp)", 0x40b2, 0x00c12083L),     // lw ra, 12(sp)
+    ("c.addi16sp sp, -16", 0x717d, 0xff010113L),    // addi sp, sp, -16
+    ("c.addi4spn s0, sp, 8", 0x0020, 0x00810413L),  // addi s0, sp, 8
+    ("c.beqz s0, 8", 0xc401, 0x00040463L),          // beq s0, zero, 8
+    ("c.srai s0, 2", 0x8409, 0x40245413L),          // srai s0, s0, 2
+    ("c.sub s0, s1", 0x8c05, 0x40940433L),          // sub s0, s0, s1
+    ("c.lui a0, 0x1", 0x6505, 0x00001537L),         // lui a0, 0x1
+    ("c.lui a0, 0xfffff", 0x757d, 0xfffff537L),     // lui a0, 0xfffff
+  )
+  expansions.foreach { case (name, in, out) =>
+    it should s"expand $name" in {
+      test(new RVCExpander) { c =>
+        c.io.in.poke(in)
+        c.io.out.peekInt() should be(out)
+      }
+    }
+  }
+
+  it should "expand reserved and floating point encodings to an illegal instruction" in {
+    test(new RVCExpander) { c =>
+      // All zero, c.fld, c.lwsp x0, c.addi16sp 0, c.srli with shamt[5] set
+      for (in <- Seq(0x0000, 0x2000, 0x4002, 0x6101, 0x9005)) {
+        c.io.in.poke(in)
+        c.io.out.peekInt() should be(0)
+      }
+    }
+  }
+
+  behavior of "FetchAligner"
+
+  // Word addressed instruction memory without wait states
+  def memory(c: FetchAligner, words: Seq[Long]): Unit = {
+    c.io.mem.ready.poke(true)
+    c.io.mem.readData.poke(words((c.io.mem.readAddr.peekInt() / 4).toInt))
+  }
+
+  it should "fetch compressed and word crossing instructions one per cycle" in {
+    test(new FetchAligner) { c =>
+      // c.li a0, -1; c.addi ra, 1; c.addi ra, 1; addi gp, zero, 7 (at 0x6, crossing); c.j 0
+      val words = Seq(0x0085_557dL, 0x0193_0085L, 0xa001_0070L)
+      val steps = Seq(
+        (0x0, 0xfff00513L, true),
+        (0x2, 0x00108093L, true),
+        (0x4, 0x00108093L, true),
+        (0x6, 0x00700193L, false),
+        (0xa, 0x0000006fL, true),
+      )
+      c.io.core.fetch.poke(true)
+      for ((pc, inst, compressed) <- steps) {
+        c.io.core.pc.poke(pc)
+        memory(c, words)
+        c.io.core.ready.peekBoolean() should be(true)
+        c.io.core.inst.peekInt() should be(inst)
+        c.io.core.compressed.peekBoolean() should be(compressed)
+        c.clock.step()
+      }
+    }
+  }
+
+  it should "wait a cycle on a jump to a word crossing instruction" in {
+    test(new FetchAligner) { c =>
+      val words = Seq(0x0000_0001L, 0x0193_0001L, 0xa001_0070L)
+      c.io.core.fetch.poke(true)
+      c.io.core.pc.poke(0x6)
+      memory(c, words)
+      c.io.core.ready.peekBoolean() should be(false)
+      c.clock.step()
+      memory(c, words)
+      c.io.core.ready.peekBoolean() should be(true)
+      c.io.mem.readAddr.peekInt() should be(0x8)
+      c.io.core.inst.peekInt() should be(0x00700193L)
+    }
+  }
+}
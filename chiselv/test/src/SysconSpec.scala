@@ -64,4 +64,45 @@ class SysconSpec extends AnyFlatSpec with ChiselScalatestTester with should.Matc
       c.io.DataOut.peekInt() should be(64 * 1024)
     }
   }
+  it should "write and read back the exit status in Syscon" in {
+    defaultDut { c =>
+      c.io.Address.poke(0x40)
+      c.io.DataOut.peekInt() should be(0)
+      c.io.DataIn.poke(0x55)
+      c.io.WriteEnable.poke(true)
+      c.clock.step()
+      c.io.WriteEnable.poke(false)
+      c.io.DataOut.peekInt() should be(0x55)
+    }
+  }
+  it should "report the flash XIP window and the instruction cache counters in Syscon" in {
+    test(new Syscon(32, 50000000, 8, 0L, 64 * 1024, 64 * 1024, hasFlash = true)) { c =>
+      c.io.Address.poke(0x38)
+      c.io.DataOut.peekInt() should be(1)
+      c.icache.hits.poke(1234)
+      c.icache.misses.poke(56)
+      c.io.Address.poke(0x48)
+      c.io.DataOut.peekInt() should be(1234)
+      c.io.Address.poke(0x4c)
+      c.io.DataOut.peekInt() should be(56)
+    }
+  }
+  it should "list the MMIO bus devices in Syscon" in {
+    test(new Syscon(32, 50000000, 8, 0L, 64 * 1024, 64 * 1024, devices = MemoryIOManager.devices)) { c =>
+      c.io.Address.poke(0x50)
+      c.io.DataOut.peekInt() should be(MemoryIOManager.devices.size)
+      c.io.Address.poke(0x120) // UART0
+      c.io.DataOut.peekInt() should be(3)
+      c.io.Address.poke(0x124)
+      c.io.DataOut.peekInt() should be(0x3000_0000L)
+      c.io.Address.poke(0x128)
+      c.io.DataOut.peekInt() should be(0x1000)
+    }
+  }
+  it should "report the CLINT mtime frequency in Syscon" in {
+    test(new Syscon(32, 50000000, 8, 0L, 64 * 1024, 64 * 1024, timerTick = 50)) { c =>
+      c.io.Address.poke(0x44)
+      c.io.DataOut.peekInt() should be(1000000)
+    }
+  }
 }
@@ -80,4 +80,84 @@ class UartSpec extends AnyFlatSpec with ChiselScalatestTester with should.Matche
       u.io.dataPort.txFull.expect(true.B)
     }
   }
+
+  it should "report the FIFO levels" in {
+    test(new Uart(64, rxOverclock, simConsole = true)) { u =>
+      val sim = u.io.simPort.get
+      sim.enable.poke(false.B)
+      sim.rx.valid.poke(false.B)
+      u.io.dataPort.rxQueue.ready.poke(false.B)
+      u.io.dataPort.fifoLength.expect(64.U)
+      u.io.dataPort.txCount.expect(0.U)
+
+      /* The UART is not enabled, so TX bytes stay in the FIFO */
+      u.io.dataPort.txQueue.bits.poke("h41".U)
+      u.io.dataPort.txQueue.valid.poke(true.B)
+      u.clock.step(3)
+      u.io.dataPort.txQueue.valid.poke(false.B)
+      u.io.dataPort.txCount.expect(3.U)
+
+      sim.enable.poke(true.B)
+      sim.rx.bits.poke("h5a".U)
+      sim.rx.valid.poke(true.B)
+      u.clock.step(2)
+      sim.rx.valid.poke(false.B)
+      u.io.dataPort.rxCount.expect(2.U)
+      u.io.dataPort.rxQueue.ready.poke(true.B)
+      u.clock.step()
+      u.io.dataPort.rxCount.expect(1.U)
+    }
+  }
+
+  it should "raise the TX interrupt below the watermark" in {
+    test(new Uart(64, rxOverclock)) { u =>
+      u.io.dataPort.rxQueue.ready.poke(false.B)
+      u.io.dataPort.txInterrupt.expect(false.B) // Disabled at reset
+      u.io.dataPort.txWatermark.bits.poke(2.U)
+      u.io.dataPort.txWatermark.valid.poke(true.B)
+      u.clock.step()
+      u.io.dataPort.txWatermark.valid.poke(false.B)
+      u.io.dataPort.txInterrupt.expect(true.B)
+
+      /* The UART is not enabled, so TX bytes stay in the FIFO */
+      u.io.dataPort.txQueue.bits.poke("h41".U)
+      u.io.dataPort.txQueue.valid.poke(true.B)
+      u.clock.step()
+      u.io.dataPort.txInterrupt.expect(true.B)
+      u.clock.step()
+      u.io.dataPort.txQueue.valid.poke(false.B)
+      u.io.dataPort.txInterrupt.expect(false.B)
+    }
+  }
+
+  it should "move bytes through the simulation console port" in {
+    test(new Uart(64, rxOverclock, simConsole = true)) { u =>
+      val sim = u.io.simPort.get
+      sim.enable.poke(true.B)
+      sim.rx.valid.poke(false.B)
+      u.io.dataPort.rxQueue.ready.poke(false.B)
+
+      /* TX FIFO drains one byte per cycle without touching the serial line */
+      u.io.dataPort.txQueue.bits.poke("h41".U)
+      u.io.dataPort.txQueue.valid.poke(true.B)
+      u.clock.step()
+      u.io.dataPort.txQueue.valid.poke(false.B)
+      sim.tx.valid.expect(true.B)
+      sim.tx.bits.expect("h41".U)
+      u.io.serialPort.tx.expect(1.U)
+      u.clock.step()
+      sim.tx.valid.expect(false.B)
+      u.io.dataPort.txEmpty.expect(true.B)
+
+      /* Bytes pushed by the harness show up in the RX FIFO */
+      sim.rx.ready.expect(true.B)
+      sim.rx.bits.poke("h5a".U)
+      sim.rx.valid.poke(true.B)
+      u.clock.step()
+      sim.rx.valid.poke(false.B)
+      u.io.dataPort.rxEmpty.expect(false.B)
+      u.io.dataPort.rxQueue.valid.expect(true.B)
+      u.io.dataPort.rxQueue.bits.expect("h5a".U)
+    }
+  }
 }
@@ -0,0 +1,106 @@
+#include "io.h"
+#include "uart.h"
+#include "stdio.h"
+
+// Compute-bound workload used by the simulation benchmarks (make bench).
+// It keeps the core busy with ALU, branch, load/store and software
+// multiply/divide work and only prints a short checksum per iteration.
+
+#define BUFSIZE 256
+#define PRIMES 512
+#define MATSIZE 8
+
+unsigned char buf[BUFSIZE];
+unsigned char sieve[PRIMES];
+int sortbuf[64];
+int mata[MATSIZE][MATSIZE], matb[MATSIZE][MATSIZE], matc[MATSIZE][MATSIZE];
+
+uint32_t crc32(unsigned char *p, int len)
+{
+  uint32_t crc = 0xffffffff;
+
+  while (len--)
+  {
+    crc ^= *p++;
+    for (int k = 0; k < 8; k++)
+      crc = (crc >> 1) ^ (0xedb88320 & -(crc & 1));
+  }
+  return ~crc;
+}
+
+int count_primes(void)
+{
+  int count = 0;
+
+  memset((char *)sieve, 1, PRIMES);
+  for (int i = 2; i < PRIMES; i++)
+  {
+    if (!sieve[i])
+      continue;
+    count++;
+    for (int j = i + i; j < PRIMES; j += i)
+      sieve[j] = 0;
+  }
+  return count;
+}
+
+int sort(uint32_t seed)
+{
+  int n = sizeof(sortbuf) / sizeof(sortbuf[0]);
+
+  for (int i = 0; i < n; i++)
+  {
+    seed = seed * 1103515245 + 12345;
+    sortbuf[i] = (seed >> 16) & 0x7fff;
+  }
+  for (int i = 0; i < n - 1; i++)
+    for (int j = 0; j < n - 1 - i; j++)
+      if (sortbuf[j] > sortbuf[j + 1])
+      {
+        int t = sortbuf[j];
+        sortbuf[j] = sortbuf[j + 1];
+        sortbuf[j + 1] = t;
+      }
+  return sortbuf[n / 2];
+}
+
+int matmul(int seed)
+{
+  int sum = 0;
+
+  for (int i = 0; i < MATSIZE; i++)
+    for (int j = 0; j < MATSIZE; j++)
+    {
+      mata[i][j] = i + j + seed;
+      matb[i][j] = i - j;
+    }
+  for (int i = 0; i < MATSIZE; i++)
+    for (int j = 0; j < MATSIZE; j++)
+    {
+      int acc = 0;
+      for (int k = 0; k < MATSIZE; k++)
+        acc += mata[i][k] * matb[k][j];
+      matc[i][j] = acc;
+      sum += acc / (i + 1) % 1000;
+    }
+  return sum;
+}
+
+int main(void)
+{
+  uart_init();
+
+  for (uint32_t iter = 0;; iter++)
+  {
+    for (int i = 0; i < BUFSIZE; i++)
+      buf[i] = i + iter;
+
+    uint32_t check = crc32(buf, BUFSIZE);
+    check += count_primes();
+    check += sort(iter);
+    check += matmul(iter);
+
+    printf("%d: %x\n", iter, check);
+  }
+  return 0;
+}
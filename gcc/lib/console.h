@@ -0,0 +1,65 @@
+#include "uart.h"
+#include "string.h"
+
+#pragma once
+
+/*
+ * Buffered console on UART0. Output is collected in RAM and handed to
+ * uart_write_burst when a line ends, the buffer fills up or on
+ * console_flush(), so a log line costs one FIFO level check instead of one
+ * per character. Input is read in bulk from what already arrived.
+ */
+
+#ifndef CONSOLE_BUFSIZE
+#define CONSOLE_BUFSIZE 128
+#endif
+
+static char console_buf[CONSOLE_BUFSIZE];
+static int console_len;
+
+void console_flush(void)
+{
+	uart_write_burst(console_buf, console_len);
+	console_len = 0;
+}
+
+void console_putc(char c)
+{
+	if (c == '\n')
+		console_putc('\r');
+	if (console_len == CONSOLE_BUFSIZE)
+		console_flush();
+	console_buf[console_len++] = c;
+	if (c == '\n')
+		console_flush();
+}
+
+/* Raw bytes, no newline translation. Large writes bypass the buffer. */
+void console_write(const char *buf, int len)
+{
+	if (console_len + len > CONSOLE_BUFSIZE)
+		console_flush();
+	if (len >= CONSOLE_BUFSIZE) {
+		uart_write_burst(buf, len);
+		return;
+	}
+	memcpy(console_buf + console_len, (char *)buf, len);
+	console_len += len;
+}
+
+void console_putstr(const char *s)
+{
+	while (*s)
+		console_putc(*s++);
+}
+
+/*
+ * Reads up to len bytes that already arrived and returns how many, 0 if
+ * none. Pending output is sent first so prompts show up before waiting.
+ */
+int console_read(char *buf, int len)
+{
+	if (console_len)
+		console_flush();
+	return uart_read_burst(buf, len);
+}
@@ -37,9 +37,90 @@ _boot:
 
   lui x2, %hi(_sstack)
   addi x2, x2, %lo(_sstack)
+
+  # Traps go to _trap_entry (csrw mtvec, t0)
+  lui t0, %hi(_trap_entry)
+  addi t0, t0, %lo(_trap_entry)
+  .insn i 0x73, 1, x0, t0, 0x305
   call main
+
+  # Report main return value to the simulator exit register (Syscon 0x40)
+  slli a0, a0, 1
+  ori a0, a0, 1
+  li t0, 0x1040
+  sw a0, 0(t0)
   j _halt       # halt
 #  j _boot         # restart
 
 _halt:
   j _halt
+
+# Saves the registers a C function may clobber, calls trap_dispatch(mcause, mepc)
+# and returns with mret to the address it gives back
+.section .text
+.balign 4
+.global _trap_entry
+_trap_entry:
+  addi sp, sp, -64
+  sw ra,  0(sp)
+  sw t0,  4(sp)
+  sw t1,  8(sp)
+  sw t2,  12(sp)
+  sw a0,  16(sp)
+  sw a1,  20(sp)
+  sw a2,  24(sp)
+  sw a3,  28(sp)
+  sw a4,  32(sp)
+  sw a5,  36(sp)
+  sw a6,  40(sp)
+  sw a7,  44(sp)
+  sw t3,  48(sp)
+  sw t4,  52(sp)
+  sw t5,  56(sp)
+  sw t6,  60(sp)
+
+  .insn i 0x73, 2, a0, x0, 0x342  # csrr a0, mcause
+  .insn i 0x73, 2, a1, x0, 0x341  # csrr a1, mepc
+  call trap_dispatch
+  .insn i 0x73, 1, x0, a0, 0x341  # csrw mepc, a0
+
+  lw ra,  0(sp)
+  lw t0,  4(sp)
+  lw t1,  8(sp)
+  lw t2,  12(sp)
+  lw a0,  16(sp)
+  lw a1,  20(sp)
+  lw a2,  24(sp)
+  lw a3,  28(sp)
+  lw a4,  32(sp)
+  lw a5,  36(sp)
+  lw a6,  40(sp)
+  lw a7,  44(sp)
+  lw t3,  48(sp)
+  lw t4,  52(sp)
+  lw t5,  56(sp)
+  lw t6,  60(sp)
+  addi sp, sp, 64
+  mret
+
+# Without interrupt.h: skip ECALL and EBREAK, return to interrupted code.
+# The ROM is not on the data bus to read the instruction at mepc back, but
+# ECALL has no compressed form and EBREAK is as long as the one below: the
+# assembler emits c.ebreak for all of them when building for RV32C.
+.weak trap_dispatch
+trap_dispatch:
+  bltz a0, 2f
+  li t0, 3          # MCAUSE_BREAKPOINT
+  beq a0, t0, 1f
+  addi a1, a1, 4
+  j 2f
+1:
+  jal t0, 3f        # t0 = address of the EBREAK, which never runs
+  ebreak
+3:
+  auipc t1, 0
+  sub t1, t1, t0
+  add a1, a1, t1
+2:
+  mv a0, a1
+  ret
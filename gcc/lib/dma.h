@@ -0,0 +1,100 @@
+#include "io.h"
+#include "uart.h"
+
+#pragma once
+
+/*
+ * DMA controller (see DMA.scala). Each channel copies count elements of 1, 2
+ * or 4 bytes between RAM buffers, from RAM to the UART0 TX FIFO or from the
+ * UART0 RX FIFO to RAM, while the core keeps running. It only uses the RAM
+ * ports in cycles the core leaves free, so a copy goes fastest while the core
+ * waits on the status register or runs code that does not touch RAM. Buffers
+ * must be in the on-chip RAM and left alone until the channel is done.
+ */
+
+// Transfer modes
+#define DMA_RAM_TO_RAM 0
+#define DMA_RAM_TO_UART 1
+#define DMA_UART_TO_RAM 2
+#define DMA_MODE_MASK 3
+
+// Element sizes
+#define DMA_BYTE (0 << 2)
+#define DMA_HALF (1 << 2)
+#define DMA_WORD (2 << 2)
+
+#define DMA_CTRL_IRQ 0x10 /* Raise IRQ_DMA when done */
+#define DMA_CTRL_START 0x100
+#define DMA_STATUS_BUSY 1
+#define DMA_STATUS_DONE 2
+
+volatile uint32_t *dma_reg(int ch, uint32_t reg)
+{
+  return (volatile uint32_t *)(DMA_BASE + ch * DMA_CHANNEL_REGS + reg);
+}
+
+// Starts a transfer on an idle channel. ctrl is the mode, the element size
+// and optionally DMA_CTRL_IRQ, the strides are in bytes and may be 0 or
+// negative. A UART side ignores its address.
+void dma_start(int ch, uint32_t ctrl, void *src, int src_stride, void *dst, int dst_stride, uint32_t count)
+{
+  *dma_reg(ch, DMA_SRC) = (uint32_t)src;
+  *dma_reg(ch, DMA_DST) = (uint32_t)dst;
+  *dma_reg(ch, DMA_COUNT) = count;
+  *dma_reg(ch, DMA_SRC_STRIDE) = src_stride;
+  *dma_reg(ch, DMA_DST_STRIDE) = dst_stride;
+  *dma_reg(ch, DMA_CTRL) = ctrl | DMA_CTRL_START;
+}
+
+int dma_busy(int ch)
+{
+  return *dma_reg(ch, DMA_STATUS) & DMA_STATUS_BUSY;
+}
+
+// The channel moved bytes through the UART0 FIFOs behind the credits kept by
+// uart.h, have its functions read the FIFO levels again
+void dma_uart_sync()
+{
+  uart_tx_credits = 0;
+  uart_rx_credits = 0;
+}
+
+// Waits for the transfer to finish and clears its done bit. Polls a register,
+// so the RAM stays free for the channel.
+void dma_wait(int ch)
+{
+  while (!(*dma_reg(ch, DMA_STATUS) & DMA_STATUS_DONE))
+    ;
+  *dma_reg(ch, DMA_STATUS) = DMA_STATUS_DONE;
+  if (*dma_reg(ch, DMA_CTRL) & DMA_MODE_MASK)
+    dma_uart_sync();
+}
+
+// Starts copying len bytes, in the largest elements the alignment allows
+void dma_memcpy(int ch, void *dst, void *src, int len)
+{
+  uint32_t align = (uint32_t)dst | (uint32_t)src | len;
+
+  if (!(align & 3))
+    dma_start(ch, DMA_RAM_TO_RAM | DMA_WORD, src, 4, dst, 4, len / 4);
+  else if (!(align & 1))
+    dma_start(ch, DMA_RAM_TO_RAM | DMA_HALF, src, 2, dst, 2, len / 2);
+  else
+    dma_start(ch, DMA_RAM_TO_RAM | DMA_BYTE, src, 1, dst, 1, len);
+}
+
+// Starts sending len bytes on UART0, the channel waits while the TX FIFO is full.
+// Leave the UART to the channel until dma_wait() (or call dma_uart_sync() once
+// IRQ_DMA says it is done).
+void dma_uart_write(int ch, char *buf, int len)
+{
+  dma_uart_sync();
+  dma_start(ch, DMA_RAM_TO_UART | DMA_BYTE, buf, 1, 0, 0, len);
+}
+
+// Starts receiving len bytes from UART0 into buf, same rules as dma_uart_write()
+void dma_uart_read(int ch, char *buf, int len)
+{
+  dma_uart_sync();
+  dma_start(ch, DMA_UART_TO_RAM | DMA_BYTE, 0, 0, buf, 1, len);
+}
@@ -0,0 +1,177 @@
+#include "io.h"
+#include "uart.h"
+
+#pragma once
+
+/*
+ * Machine mode interrupts. crt.s points mtvec at _trap_entry, which saves the
+ * caller-saved registers and calls trap_dispatch() below. Handlers are plain
+ * C functions registered per interrupt, they run with interrupts disabled and
+ * must clear their source (eg. read the UART, move mtimecmp) before returning.
+ */
+
+// Interrupt numbers, the mie/mip bit and mcause of each source
+#define IRQ_SOFTWARE 3 /* CLINT msip */
+#define IRQ_TIMER 7    /* CLINT mtime >= mtimecmp */
+#define IRQ_UART_RX 16 /* UART0 RX FIFO not empty */
+#define IRQ_UART_TX 17 /* UART0 TX FIFO below the watermark */
+#define IRQ_GPIO 18    /* GPIO0 edge pending */
+#define IRQ_DMA 19     /* DMA channel done with DMA_CTRL_IRQ set */
+#define IRQ_COUNT 20
+
+#define MCAUSE_INTERRUPT 0x80000000
+#define MCAUSE_BREAKPOINT 3
+#define MCAUSE_ECALL 11
+
+typedef void (*irq_handler_t)(void);
+// Returns the address to resume at
+typedef uint32_t (*exception_handler_t)(uint32_t mcause, uint32_t mepc);
+
+static irq_handler_t irq_handlers[IRQ_COUNT];
+static exception_handler_t exception_handler;
+
+// Enables (sets mstatus.MIE) and disables all interrupts
+void irq_enable()
+{
+  __asm__ volatile(".insn i 0x73, 6, x0, x8, 0x300"); // csrrsi x0, mstatus, MIE (the rs1 field is the immediate)
+}
+
+// Returns whether they were enabled, to restore with irq_restore()
+int irq_disable()
+{
+  uint32_t mstatus;
+  __asm__ volatile(".insn i 0x73, 7, %0, x8, 0x300" : "=r"(mstatus)); // csrrci mstatus, MIE
+  return (mstatus & MSTATUS_MIE) != 0;
+}
+
+void irq_restore(int enabled)
+{
+  if (enabled)
+    irq_enable();
+}
+
+// Sleeps until an interrupt enabled in mie is pending, even with mstatus.MIE
+// clear. It may also return early, callers check their condition in a loop.
+void wfi()
+{
+  __asm__ volatile("wfi");
+}
+
+// Sets the handler of an interrupt and enables it in mie
+void irq_register(int irq, irq_handler_t handler)
+{
+  irq_handlers[irq] = handler;
+  csr_write(CSR_MIE, csr_read(CSR_MIE) | (1 << irq));
+}
+
+void irq_unregister(int irq)
+{
+  csr_write(CSR_MIE, csr_read(CSR_MIE) & ~(1 << irq));
+  irq_handlers[irq] = 0;
+}
+
+// Handles ECALL and EBREAK, without one they are skipped
+void exception_register(exception_handler_t handler)
+{
+  exception_handler = handler;
+}
+
+// Size of the ECALL or EBREAK at mepc, to skip it. The ROM is not on the data
+// bus to read it back, but ECALL has no compressed form and the assembler emits
+// c.ebreak for EBREAK when building for RV32C (as crt.s does for its own).
+uint32_t trap_insn_size(uint32_t mcause)
+{
+#ifdef __riscv_compressed
+  if (mcause == MCAUSE_BREAKPOINT)
+    return 2;
+#endif
+  return 4;
+}
+
+// Called by _trap_entry with interrupts disabled, returns the new mepc
+uint32_t trap_dispatch(uint32_t mcause, uint32_t mepc)
+{
+  if (!(mcause & MCAUSE_INTERRUPT))
+  {
+    if (exception_handler)
+      return exception_handler(mcause, mepc);
+    return mepc + trap_insn_size(mcause);
+  }
+
+  uint32_t irq = mcause & ~MCAUSE_INTERRUPT;
+  if (irq < IRQ_COUNT && irq_handlers[irq])
+    irq_handlers[irq]();
+  else // Nobody clears it, stop it from firing again
+    csr_write(CSR_MIE, csr_read(CSR_MIE) & ~(1 << irq));
+  return mepc;
+}
+
+//-- Waiting with WFI instead of busy polling --//
+
+// Waits until mtime reaches end. Takes over mtimecmp, so it can not be used
+// while an IRQ_TIMER handler is registered.
+void wfi_until(uint64_t end)
+{
+  int enabled = irq_disable();
+  uint32_t mie = csr_read(CSR_MIE);
+  set_mtimecmp(end);
+  csr_write(CSR_MIE, mie | (1 << IRQ_TIMER));
+  while (mtime() < end)
+    wfi();
+  csr_write(CSR_MIE, mie);
+  set_mtimecmp(~0ULL);
+  irq_restore(enabled);
+}
+
+// Sleeps for the specified number of milliseconds in WFI
+void wfi_sleep(unsigned int ms)
+{
+  uint32_t ticks = mtime_freq() / 1000;
+  uint64_t end = mtime();
+  while (ms--)
+    end += ticks;
+  wfi_until(end);
+}
+
+// Waits in WFI for a byte on UART0 and reads it with getchar(), which keeps
+// the RX credits of uart.h right
+char uart_wfi_read()
+{
+  int enabled = irq_disable();
+  uint32_t mie = csr_read(CSR_MIE);
+  csr_write(CSR_MIE, mie | (1 << IRQ_UART_RX));
+  while (uart_rx_empty())
+    wfi();
+  csr_write(CSR_MIE, mie);
+  irq_restore(enabled);
+  return getchar();
+}
+
+// Raises the UART TX interrupt while fewer than level bytes wait to be sent,
+// 0 disables it
+void uart_set_tx_watermark(uint32_t level)
+{
+  uart_reg_write(UART_TX_WATERMARK, level);
+}
+
+// Raises (1) or clears (0) the CLINT software interrupt
+void set_msip(int pending)
+{
+  *(volatile uint32_t *)(CLINT_BASE + CLINT_MSIP) = pending;
+}
+
+// Enables the GPIO0 edge interrupts of the pins in rising and falling
+void gpio_set_edges(uint32_t rising, uint32_t falling)
+{
+  *(volatile uint32_t *)(GPIO0_BASE + GPIO0_RISE) = rising;
+  *(volatile uint32_t *)(GPIO0_BASE + GPIO0_FALL) = falling;
+}
+
+// Returns and clears the GPIO0 pins that saw an enabled edge
+uint32_t gpio_take_edges()
+{
+  volatile uint32_t *pending = (volatile uint32_t *)(GPIO0_BASE + GPIO0_PENDING);
+  uint32_t edges = *pending;
+  *pending = edges;
+  return edges;
+}
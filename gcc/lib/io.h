@@ -4,6 +4,7 @@ typedef unsigned int uint32_t;
 typedef int int32_t;
 typedef unsigned char uint8_t;
 typedef char int8_t;
+typedef unsigned long long uint64_t;
 
 #define SYSCON_BASE 0x00001000 /* System control regs */
 #define SYS_REG_DUMMY 0x00   /* Dummy output */
@@ -16,11 +17,83 @@ typedef char int8_t;
 #define SYS_REG_BOOTADDR 0x2C   /* Boot address */
 #define SYS_REG_ROMSIZE 0x30   /* ROM Size */
 #define SYS_REG_RAMSIZE 0x34   /* RAM Size */
+#define SYS_REG_HASFLASH 0x38   /* Has the flash XIP window at FLASH_BASE */
+#define SYS_REG_SDRAMSIZE 0x3C   /* Size of the SDRAM at SDRAM_BASE, 0 without one */
+#define SYS_REG_EXIT 0x40   /* Exit status (simulation) */
+#define SYS_REG_MTIMEFREQ 0x44   /* CLINT mtime ticks per second */
+#define SYS_REG_ICACHE_HITS 0x48   /* Instruction cache hits */
+#define SYS_REG_ICACHE_MISSES 0x4C   /* Instruction cache misses (line refills) */
+#define SYS_REG_NUMDEVICES 0x50   /* Devices on the MMIO bus */
+#define SYS_REG_DEVICES 0x100   /* Device table, id, base and size every 0x10 bytes */
+
+/* MMIO bus device ids (MemoryIOManager.devices), SOC devices bring their own */
+#define DEVICE_SYSCON 1
+#define DEVICE_CLINT 2
+#define DEVICE_UART0 3
+#define DEVICE_GPIO0 4
+#define DEVICE_TIMER0 5
+#define DEVICE_DMA 6
+#define DEVICE_DCACHE 7
+
+#define FLASH_BASE 0x20000000 /* SPI flash execute in place window */
+#define SDRAM_BASE 0x40000000 /* External SDRAM, through the data cache */
 
 #define GPIO0_BASE 0x30001000
 #define GPIO0_DIR 0x00
 #define GPIO0_VAL 0x04
+#define GPIO0_RISE 0x08    /* Rising edge interrupt enable */
+#define GPIO0_FALL 0x0C    /* Falling edge interrupt enable */
+#define GPIO0_PENDING 0x10 /* Edges seen, write 1 to clear */
 #define TIMER0_BASE 0x30003000
+#define CLINT_BASE 0x02000000 /* Core local interruptor */
+#define CLINT_MSIP 0x0000     /* Software interrupt pending */
+#define CLINT_MTIMECMP 0x4000 /* 64 bit, low word first */
+#define CLINT_MTIME 0xBFF8    /* 64 bit, low word first */
+#define DCACHE_BASE 0x30005000 /* Data cache of the SDRAM */
+#define DCACHE_CTRL 0x00       /* Control (write) [invalidate|flush], status (read) [busy] */
+#define DCACHE_HITS 0x04
+#define DCACHE_MISSES 0x08
+#define DCACHE_WRITEBACKS 0x0C
+#define DCACHE_LINESIZE 0x10
+#define DCACHE_FLUSH 1
+#define DCACHE_INVALIDATE 2
+#define DMA_BASE 0x30004000 /* DMA controller (see dma.h) */
+#define DMA_CHANNELS 2
+#define DMA_CHANNEL_REGS 0x20 /* Register block of each channel */
+#define DMA_SRC 0x00
+#define DMA_DST 0x04
+#define DMA_COUNT 0x08      /* Elements left */
+#define DMA_SRC_STRIDE 0x0C /* Bytes added to the address after each element */
+#define DMA_DST_STRIDE 0x10
+#define DMA_CTRL 0x14   /* [start|..|irq|size(2)|mode(2)] */
+#define DMA_STATUS 0x18 /* [done|busy], write DMA_STATUS_DONE to clear done */
+
+/* Machine mode trap CSRs (see interrupt.h) */
+#define CSR_MSTATUS 0x300
+#define CSR_MIE 0x304
+#define CSR_MTVEC 0x305
+#define CSR_MSCRATCH 0x340
+#define CSR_MEPC 0x341
+#define CSR_MCAUSE 0x342
+#define CSR_MIP 0x344
+#define MSTATUS_MIE 0x8
+
+/* Counter CSRs (Zicntr and machine counters) */
+#define CSR_MCOUNTINHIBIT 0x320
+#define CSR_MCYCLE 0xB00
+#define CSR_MINSTRET 0xB02
+#define CSR_MHPMCOUNTER3 0xB03 /* Stall cycles */
+#define CSR_MHPMCOUNTER4 0xB04 /* Taken branches */
+#define CSR_MHPMCOUNTER5 0xB05 /* Loads */
+#define CSR_MHPMCOUNTER6 0xB06 /* Stores */
+#define CSR_CYCLE 0xC00
+#define CSR_TIME 0xC01
+#define CSR_INSTRET 0xC02
+#define CSR_HPMCOUNTER3 0xC03
+#define CSR_HPMCOUNTER4 0xC04
+#define CSR_HPMCOUNTER5 0xC05
+#define CSR_HPMCOUNTER6 0xC06
+#define CSR_HIGH 0x80 /* Offset of the upper 32 bits of a counter */
 
 #define HIGH 1
 #define LOW 0
@@ -74,6 +147,121 @@ void setTimer(unsigned int val)
   *(volatile uint32_t *)addr = val;
 }
 
+// Reports the exit code to the simulator ((code << 1) | 1) and halts
+void exit(int code)
+{
+  uint32_t addr;
+  addr = SYSCON_BASE + SYS_REG_EXIT;
+  *(volatile uint32_t *)addr = (code << 1) | 1;
+  while (1)
+    ;
+}
+
+// Reads and writes a CSR. Encoded with .insn so it also builds with
+// -march=rv32i on toolchains that need Zicsr for the csr* mnemonics.
+#define csr_read(csr)                                                       \
+  ({                                                                        \
+    uint32_t __v;                                                           \
+    __asm__ volatile(".insn i 0x73, 2, %0, x0, %1"                          \
+                     : "=r"(__v)                                            \
+                     : "i"((((csr) & 0xFFF) ^ 0x800) - 0x800));             \
+    __v;                                                                    \
+  })
+#define csr_write(csr, val)                                                 \
+  __asm__ volatile(".insn i 0x73, 1, x0, %0, %1"                            \
+                   :                                                        \
+                   : "r"((uint32_t)(val)), "i"((((csr) & 0xFFF) ^ 0x800) - 0x800))
+
+// Reads a 64 bit counter, retrying if the low half wrapped between the reads
+#define csr_read64(csr)                                                     \
+  ({                                                                        \
+    uint32_t __hi, __lo;                                                    \
+    do                                                                      \
+    {                                                                       \
+      __hi = csr_read((csr) + CSR_HIGH);                                    \
+      __lo = csr_read(csr);                                                 \
+    } while (__hi != csr_read((csr) + CSR_HIGH));                           \
+    ((uint64_t)__hi << 32) | __lo;                                          \
+  })
+
+// Clock cycles since reset
+uint64_t rdcycle()
+{
+  return csr_read64(CSR_CYCLE);
+}
+
+// The CLINT mtime, in clock cycles unless the core was built with a slower
+// tick (see SYS_REG_MTIMEFREQ for its frequency)
+uint64_t rdtime()
+{
+  return csr_read64(CSR_TIME);
+}
+
+// Instructions retired since reset
+uint64_t rdinstret()
+{
+  return csr_read64(CSR_INSTRET);
+}
+
+// Reads a hardware performance counter (3: stall cycles, 4: taken branches,
+// 5: loads, 6: stores)
+uint64_t rdhpmcounter(int n)
+{
+  switch (n)
+  {
+  case 3:
+    return csr_read64(CSR_HPMCOUNTER3);
+  case 4:
+    return csr_read64(CSR_HPMCOUNTER4);
+  case 5:
+    return csr_read64(CSR_HPMCOUNTER5);
+  case 6:
+    return csr_read64(CSR_HPMCOUNTER6);
+  }
+  return 0;
+}
+
+// Stops (1) or restarts (0) the counters selected by mask (bit 0: cycle,
+// bit 2: instret, bits 3-6: hpmcounters), eg. to exclude code from a measurement
+void counters_inhibit(uint32_t mask, int stop)
+{
+  if (stop)
+  {
+    csr_write(CSR_MCOUNTINHIBIT, csr_read(CSR_MCOUNTINHIBIT) | mask);
+  }
+  else
+  {
+    csr_write(CSR_MCOUNTINHIBIT, csr_read(CSR_MCOUNTINHIBIT) & ~mask);
+  }
+}
+
+// Writes the dirty lines of the data cache back to the SDRAM (DCACHE_FLUSH),
+// drops all lines (DCACHE_INVALIDATE, dirty data is lost unless flushed with
+// it) and waits until done. Flush before another master reads a buffer in
+// SDRAM, invalidate before reading one it wrote.
+void dcache_sync(uint32_t ops)
+{
+  volatile uint32_t *ctrl = (volatile uint32_t *)(DCACHE_BASE + DCACHE_CTRL);
+
+  *ctrl = ops;
+  while (*ctrl)
+    ;
+}
+
+// Base address of the first MMIO bus device with the id, 0 if there is none
+uint32_t device_base(uint32_t id)
+{
+  volatile uint32_t *table = (volatile uint32_t *)(SYSCON_BASE + SYS_REG_DEVICES);
+  uint32_t n = *(volatile uint32_t *)(SYSCON_BASE + SYS_REG_NUMDEVICES);
+
+  for (uint32_t i = 0; i < n; i++)
+  {
+    if (table[i * 4] == id)
+      return table[i * 4 + 1];
+  }
+  return 0;
+}
+
 //-- User facing functions --//
 // Sets the pin mode (INPUT or OUTPUT)
 void pinMode(unsigned char port, unsigned char val)
@@ -126,7 +314,7 @@ void digitalWrite(uint8_t port, uint8_t val)
   setGPIO(vals);
 }
 
-// Reads the value of the timer (in microseconds)
+// Reads the value of the timer (in milliseconds)
 unsigned int getTimer()
 {
   uint32_t addr;
@@ -142,15 +330,76 @@ void resetTimer()
   setTimer(0);
 }
 
+// CLINT mtime ticks per second (the clock frequency with the default tick of one cycle)
+uint32_t mtime_freq()
+{
+  return *(volatile uint32_t *)(SYSCON_BASE + SYS_REG_MTIMEFREQ);
+}
+
+// Reads the CLINT mtime, retrying if the low word wrapped between the reads
+uint64_t mtime()
+{
+  volatile uint32_t *t = (volatile uint32_t *)(CLINT_BASE + CLINT_MTIME);
+  uint32_t hi, lo;
+  do
+  {
+    hi = t[1];
+    lo = t[0];
+  } while (hi != t[1]);
+  return ((uint64_t)hi << 32) | lo;
+}
+
+// Sets the CLINT mtimecmp, the timer interrupt is pending while mtime >= mtimecmp.
+// The low word is written with the high word all ones so no earlier value matches.
+void set_mtimecmp(uint64_t cmp)
+{
+  volatile uint32_t *t = (volatile uint32_t *)(CLINT_BASE + CLINT_MTIMECMP);
+  t[1] = 0xFFFFFFFF;
+  t[0] = (uint32_t)cmp;
+  t[1] = (uint32_t)(cmp >> 32);
+}
+
+// Microseconds since reset, needs an mtime of at least 1 MHz. Divides in 16 bit
+// steps so it only takes 32 bit divisions.
+uint64_t micros()
+{
+  uint64_t t = mtime();
+  uint32_t d = mtime_freq() / 1000000;
+  uint32_t hi = t >> 32, lo = t;
+  uint32_t q2 = hi / d, r = hi % d;
+  uint32_t x = (r << 16) | (lo >> 16);
+  uint32_t q1 = x / d;
+  x = ((x % d) << 16) | (lo & 0xFFFF);
+  return ((uint64_t)q2 << 32) | (q1 << 16) | (x / d);
+}
+
+// Waits until mtime reaches end
+void delay_until(uint64_t end)
+{
+  while (mtime() < end)
+    ;
+}
+
+// Waits for ticks mtime ticks. With the default tick of one clock this is a
+// cycle accurate delay, plus the few cycles of the call and the last mtime read.
+void delay_ticks(uint32_t ticks)
+{
+  delay_until(mtime() + ticks);
+}
+
+// Waits for the specified number of microseconds (up to 2^32 mtime ticks)
+void delay_us(uint32_t us)
+{
+  uint32_t ticks = us * (mtime_freq() / 1000000);
+  delay_until(mtime() + ticks);
+}
+
 // Sleeps for the specified number of milliseconds (blocking)
 void sleep(unsigned int ms)
 {
-  resetTimer();
-  unsigned int startTime = getTimer();
-  unsigned int countedMs = 0;
-  while (getTimer() <= startTime + ms)
-  {
-    countedMs++;
-  }
-  resetTimer();
+  uint32_t ticks = mtime_freq() / 1000;
+  uint64_t end = mtime();
+  while (ms--)
+    end += ticks;
+  delay_until(end);
 }
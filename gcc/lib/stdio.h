@@ -31,6 +31,7 @@
 #include <stdarg.h>
 #include "io.h"
 #include "uart.h"
+#include "string.h"
 
 #ifndef __STDIO__
 #define __STDIO__
@@ -156,49 +157,6 @@ int printf(char *fmt, ...)
     return 0;
 }
 
-int strncmp(char *s1, char *s2, int len)
-{
-    while (--len && *s1 && *s2 && (*s1 == *s2))
-        s1++, s2++;
-
-    return (*s1 - *s2);
-}
-
-int strcmp(char *s1, char *s2)
-{
-    return strncmp(s1, s2, -1);
-}
-
-int strlen(char *s1)
-{
-    int len;
-
-    for (len = 0; s1 && *s1++; len++)
-        ;
-
-    return len;
-}
-
-char *memcpy(char *dptr, char *sptr, int len)
-{
-    char *ret = dptr;
-
-    while (len--)
-        *dptr++ = *sptr++;
-
-    return ret;
-}
-
-char *memset(char *dptr, int c, int len)
-{
-    char *ret = dptr;
-
-    while (len--)
-        *dptr++ = c;
-
-    return ret;
-}
-
 char *strtok(char *str, char *dptr)
 {
     static char *nxt = NULL;
@@ -271,6 +229,9 @@ int xtoi(char *s1)
 //     return acc;
 // }
 
+// Software multiply and divide for rv32i, with -march=rv32im gcc emits the
+// M extension instructions instead
+#ifndef __riscv_mul
 unsigned __umulsi3(unsigned x, unsigned y)
 {
     unsigned acc;
@@ -312,7 +273,9 @@ int __mulsi3(int x, int y)
 
     return xs ^ ys ? -acc : acc;
 }
+#endif
 
+#ifndef __riscv_div
 unsigned __udiv_umod_si3(unsigned x, unsigned y, int opt)
 {
     unsigned acc, aux;
@@ -378,6 +341,7 @@ int __modsi3(int x, int y)
 {
     return __div_mod_si3(x, y, 0);
 }
+#endif
 
 
 #endif
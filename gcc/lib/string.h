@@ -0,0 +1,185 @@
+#include "io.h"
+
+#ifndef __STRING__
+#define __STRING__
+
+// Memory and string routines that move whole words. RAM loads cost a stall
+// cycle in MemoryIOManager unless the pipelined core read them ahead, so
+// doing 32 bits per load/store instead of 8 is what matters here. Word
+// accesses are always aligned (the core has no misaligned access support):
+// the first bytes are handled one at a time until the pointers are aligned,
+// and reads past the end of a string never leave the aligned word that holds
+// its terminator.
+
+// Keeps gcc from turning the copy/fill loops below back into calls to
+// memcpy/memset, which would recurse into themselves.
+#define NO_LOOP_CALLS __attribute__((optimize("no-tree-loop-distribute-patterns")))
+
+#ifdef __riscv_zbb
+// orc.b turns every nonzero byte into 0xff and leaves the zero ones, one
+// instruction instead of the subtract and masks below (make MARCH=rv32i_zbb)
+static inline uint32_t orc_b(uint32_t w)
+{
+  uint32_t r;
+  __asm__("orc.b %0, %1" : "=r"(r) : "r"(w));
+  return r;
+}
+
+// Nonzero if any byte of w is zero
+#define HASZERO(w) (orc_b(w) != 0xffffffffU)
+#else
+// Nonzero if any byte of w is zero
+#define HASZERO(w) (((w) - 0x01010101U) & ~(w) & 0x80808080U)
+#endif
+
+#define ALIGNED(p) (((uint32_t)(p) & 3) == 0)
+
+NO_LOOP_CALLS
+char *memcpy(char *dptr, char *sptr, int len)
+{
+  char *ret = dptr;
+
+  while (len > 0 && !ALIGNED(dptr))
+  {
+    *dptr++ = *sptr++;
+    len--;
+  }
+
+  uint32_t *d = (uint32_t *)dptr;
+  if (ALIGNED(sptr))
+  {
+    uint32_t *s = (uint32_t *)sptr;
+    for (; len >= 16; len -= 16, d += 4, s += 4)
+    {
+      uint32_t w0 = s[0], w1 = s[1], w2 = s[2], w3 = s[3];
+      d[0] = w0;
+      d[1] = w1;
+      d[2] = w2;
+      d[3] = w3;
+    }
+    for (; len >= 4; len -= 4)
+      *d++ = *s++;
+    sptr = (char *)s;
+  }
+  else if (len >= 4)
+  {
+    // Source misaligned: read aligned words and shift the bytes into place
+    int shift = ((uint32_t)sptr & 3) * 8;
+    uint32_t *s = (uint32_t *)((uint32_t)sptr & ~3U);
+    uint32_t lo = *s++;
+    for (; len >= 4; len -= 4, sptr += 4)
+    {
+      uint32_t hi = *s++;
+      *d++ = (lo >> shift) | (hi << (32 - shift));
+      lo = hi;
+    }
+  }
+  dptr = (char *)d;
+
+  while (len-- > 0)
+    *dptr++ = *sptr++;
+
+  return ret;
+}
+
+NO_LOOP_CALLS
+char *memset(char *dptr, int c, int len)
+{
+  char *ret = dptr;
+
+  while (len > 0 && !ALIGNED(dptr))
+  {
+    *dptr++ = c;
+    len--;
+  }
+
+  // Replicate the byte without a multiply (no M extension on rv32i)
+  uint32_t w = c & 0xff;
+  w |= w << 8;
+  w |= w << 16;
+  uint32_t *d = (uint32_t *)dptr;
+  for (; len >= 16; len -= 16, d += 4)
+  {
+    d[0] = w;
+    d[1] = w;
+    d[2] = w;
+    d[3] = w;
+  }
+  for (; len >= 4; len -= 4)
+    *d++ = w;
+  dptr = (char *)d;
+
+  while (len-- > 0)
+    *dptr++ = c;
+
+  return ret;
+}
+
+int strlen(char *s1)
+{
+  char *p = s1;
+
+  if (!s1)
+    return 0;
+
+  for (; !ALIGNED(p); p++)
+    if (!*p)
+      return p - s1;
+
+  uint32_t *w = (uint32_t *)p;
+  uint32_t v;
+  for (v = *w; !HASZERO(v); v = *++w)
+    ;
+
+#ifdef __riscv_zbb
+  // The terminator is the lowest byte orc.b left clear
+  return (char *)w - s1 + (__builtin_ctz(~orc_b(v)) >> 3);
+#else
+  for (p = (char *)w; *p; p++)
+    ;
+  return p - s1;
+#endif
+}
+
+int strncmp(char *s1, char *s2, int len)
+{
+  if (len <= 0)
+    return 0;
+
+  // Word compares only work when both strings reach alignment together
+  if (((uint32_t)s1 & 3) == ((uint32_t)s2 & 3))
+  {
+    for (; !ALIGNED(s1); s1++, s2++)
+    {
+      if (*s1 != *s2 || !*s1)
+        return (unsigned char)*s1 - (unsigned char)*s2;
+      if (!--len)
+        return 0;
+    }
+
+    uint32_t *w1 = (uint32_t *)s1, *w2 = (uint32_t *)s2;
+    for (; len >= 4; len -= 4, w1++, w2++)
+    {
+      uint32_t v = *w1;
+      if (v != *w2 || HASZERO(v))
+        break;
+    }
+    s1 = (char *)w1;
+    s2 = (char *)w2;
+    if (!len)
+      return 0;
+  }
+
+  // Byte compare the rest, or the whole strings when their alignments differ
+  for (; *s1 == *s2 && *s1; s1++, s2++)
+    if (!--len)
+      return 0;
+  return (unsigned char)*s1 - (unsigned char)*s2;
+}
+
+int strcmp(char *s1, char *s2)
+{
+  return strncmp(s1, s2, 0x7fffffff);
+}
+
+#endif
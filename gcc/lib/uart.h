@@ -17,6 +17,10 @@
 #define UART_STATUS_RX_FULL     0x04
 #define UART_STATUS_TX_FULL     0x08
 #define UART_CLOCKDIV           0x10
+#define UART_TX_LEVEL           0x14
+#define UART_RX_LEVEL           0x18
+#define UART_FIFO_SIZE          0x1C
+#define UART_TX_WATERMARK       0x20
 
 /*
  * Core UART functions to implement for a port
@@ -82,23 +86,75 @@ void uart_init(void)
 	uart_reg_write(UART_CLOCKDIV, uart_divisor(proc_freq, UART0_BAUD));
 }
 
+/*
+ * FIFO levels. Only software fills the TX FIFO and empties the RX FIFO, so
+ * the free TX space and the pending RX bytes read here can only grow until
+ * software uses them: they are kept as credits and the registers are read
+ * again only when the credits run out, instead of the status before every
+ * byte. This holds as long as the data goes through the functions below and
+ * not through uart_read/uart_write directly. A DMA channel moving data to or
+ * from UART0 breaks it too: dma.h zeroes both credits when such a transfer
+ * starts and when dma_wait() sees it done, and the functions below must not
+ * be used while it runs.
+ */
+
+static int uart_fifo_size;
+static int uart_tx_credits;
+static int uart_rx_credits;
+
+int uart_tx_free(void)
+{
+	if (!uart_fifo_size)
+		uart_fifo_size = uart_reg_read(UART_FIFO_SIZE);
+	return uart_fifo_size - uart_reg_read(UART_TX_LEVEL);
+}
+
+int uart_rx_level(void)
+{
+	return uart_reg_read(UART_RX_LEVEL);
+}
+
+/* Writes len bytes, checking the TX free space once per burst */
+void uart_write_burst(const char *buf, int len)
+{
+	while (len > 0) {
+		while (!uart_tx_credits)
+			uart_tx_credits = uart_tx_free();
+		int n = len < uart_tx_credits ? len : uart_tx_credits;
+		uart_tx_credits -= n;
+		len -= n;
+		while (n--)
+			uart_write(*buf++);
+	}
+}
+
+/* Reads up to len bytes that already arrived, returns how many. Does not block. */
+int uart_read_burst(char *buf, int len)
+{
+	if (uart_rx_credits < len)
+		uart_rx_credits = uart_rx_level();
+	int n = len < uart_rx_credits ? len : uart_rx_credits;
+	uart_rx_credits -= n;
+	for (int i = 0; i < n; i++)
+		buf[i] = uart_read();
+	return n;
+}
+
 int getchar(void)
 {
-	while (uart_rx_empty())
-		; // Do nothing
+	while (!uart_rx_credits)
+		uart_rx_credits = uart_rx_level();
+	uart_rx_credits--;
 	return uart_read();
 }
 
 int putchar(unsigned char c)
 {
 	if (c == '\n')
-	{
-		while (uart_tx_full())
-			; // Do nothing
-		uart_write('\r');
-	}
-	while (uart_tx_full())
-		; // Do nothing
+		putchar('\r');
+	while (!uart_tx_credits)
+		uart_tx_credits = uart_tx_free();
+	uart_tx_credits--;
 	uart_write(c);
 
 	return 0;
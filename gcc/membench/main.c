@@ -0,0 +1,223 @@
+#include "io.h"
+#include "uart.h"
+#include "stdio.h"
+#include "dma.h"
+
+// Cycles per byte of the string.h routines against the plain byte loops they
+// replaced, for a few sizes and alignments, of the SDRAM through the data
+// cache when the core has one and of RAM copies by the DMA controller. Reads
+// the cycle CSR, so the numbers are the same in simulation and on a board.
+// Exits when done.
+
+#define BUFSIZE 1024
+
+char src[BUFSIZE + 8] __attribute__((aligned(4)));
+char dst[BUFSIZE + 8] __attribute__((aligned(4)));
+
+NO_LOOP_CALLS
+char *byte_memcpy(char *dptr, char *sptr, int len)
+{
+  char *ret = dptr;
+
+  while (len--)
+    *dptr++ = *sptr++;
+  return ret;
+}
+
+NO_LOOP_CALLS
+char *byte_memset(char *dptr, int c, int len)
+{
+  char *ret = dptr;
+
+  while (len--)
+    *dptr++ = c;
+  return ret;
+}
+
+int byte_strlen(char *s1)
+{
+  int len;
+
+  for (len = 0; *s1++; len++)
+    ;
+  return len;
+}
+
+int byte_strcmp(char *s1, char *s2)
+{
+  while (*s1 && *s1 == *s2)
+    s1++, s2++;
+  return *s1 - *s2;
+}
+
+// Cycles taken by stmt, without the cost of reading the counter
+#define MEASURE(stmt)                                                       \
+  ({                                                                        \
+    uint32_t __start = csr_read(CSR_CYCLE);                                 \
+    __asm__ volatile("" ::: "memory");                                      \
+    stmt;                                                                   \
+    __asm__ volatile("" ::: "memory");                                      \
+    csr_read(CSR_CYCLE) - __start - overhead;                               \
+  })
+
+uint32_t overhead;
+
+// Prints cycles/byte with two decimals
+void putcpb(uint32_t cycles, int bytes)
+{
+  uint32_t cpb = cycles * 100 / bytes;
+
+  printf("%d.", cpb / 100);
+  putchar('0' + cpb / 10 % 10);
+  putchar('0' + cpb % 10);
+}
+
+void report(char *name, int size, int offset, uint32_t bytecycles, uint32_t wordcycles)
+{
+  printf("%s %d", name, size);
+  if (offset)
+    printf("+%d", offset);
+  printf(": bytes ");
+  putcpb(bytecycles, size);
+  printf(", words ");
+  putcpb(wordcycles, size);
+  printf(" cycles/byte\n");
+}
+
+// Fills src with a NUL terminated string of len characters at offset
+void mkstring(int offset, int len)
+{
+  for (int i = 0; i < len; i++)
+    src[offset + i] = 'a' + i % 26;
+  src[offset + len] = 0;
+}
+
+#define SDRAM_BYTES (16 * 1024) // Four times the data cache
+#define SDRAM_BLOCK (2 * 1024)  // Fits in the data cache
+
+uint32_t dcache_counter(uint32_t reg)
+{
+  return *(volatile uint32_t *)(DCACHE_BASE + reg);
+}
+
+// Word stores and loads streaming through more SDRAM than the data cache
+// holds, then loads of a block that stays cached. Returns the errors.
+int sdram_bench(void)
+{
+  uint32_t *buf = (uint32_t *)SDRAM_BASE;
+  uint32_t sum = 0, expect = 0;
+  int words = SDRAM_BYTES / 4, block = SDRAM_BLOCK / 4;
+
+  for (int i = 0; i < words; i++)
+    expect += i * 0x9e3779b9;
+
+  uint32_t wc = MEASURE(for (int i = 0; i < words; i++) buf[i] = i * 0x9e3779b9);
+  uint32_t rc = MEASURE(for (int i = 0; i < words; i++) sum += buf[i]);
+  printf("sdram stream %d: stores ", SDRAM_BYTES);
+  putcpb(wc, SDRAM_BYTES);
+  printf(", loads ");
+  putcpb(rc, SDRAM_BYTES);
+  printf(" cycles/byte\n");
+
+  uint32_t fc = MEASURE(dcache_sync(DCACHE_FLUSH | DCACHE_INVALIDATE));
+  uint32_t mc = MEASURE(for (int i = 0; i < block; i++) sum += buf[i]);
+  uint32_t hc = MEASURE(for (int i = 0; i < block; i++) sum += buf[i]);
+  printf("sdram block %d: flush %d cycles, loads ", SDRAM_BLOCK, fc);
+  putcpb(mc, SDRAM_BLOCK);
+  printf(" missing, ");
+  putcpb(hc, SDRAM_BLOCK);
+  printf(" cached cycles/byte\n");
+  printf("dcache: %d hits, %d misses, %d write backs\n", dcache_counter(DCACHE_HITS),
+         dcache_counter(DCACHE_MISSES), dcache_counter(DCACHE_WRITEBACKS));
+
+  for (int i = 0; i < block; i++)
+    expect += 2 * i * 0x9e3779b9;
+  return sum != expect;
+}
+
+int main(void)
+{
+  static const int sizes[] = {16, 64, 256, BUFSIZE};
+  int n = sizeof(sizes) / sizeof(sizes[0]);
+  int errors = 0;
+
+  uart_init();
+  overhead = 0;
+  overhead = MEASURE();
+
+  for (int i = 0; i < n; i++)
+  {
+    int size = sizes[i];
+    for (int offset = 0; offset < 4; offset += 3)
+    {
+      for (int j = 0; j < size; j++)
+        src[offset + j] = j;
+      uint32_t bc = MEASURE(byte_memcpy(dst, src + offset, size));
+      uint32_t wc = MEASURE(memcpy(dst, src + offset, size));
+      report("memcpy", size, offset, bc, wc);
+      for (int j = 0; j < size; j++)
+        errors += dst[j] != (char)j;
+    }
+  }
+  for (int i = 0; i < n; i++)
+  {
+    int size = sizes[i];
+    uint32_t bc = MEASURE(byte_memset(dst, 0x5a, size));
+    uint32_t wc = MEASURE(memset(dst, 0, size));
+    report("memset", size, 0, bc, wc);
+    for (int j = 0; j < size; j++)
+      errors += dst[j] != 0;
+  }
+  for (int i = 0; i < n; i++)
+  {
+    int size = sizes[i] - 1;
+    mkstring(0, size);
+    int bl = 0, wl = 0;
+    uint32_t bc = MEASURE(bl = byte_strlen(src));
+    uint32_t wc = MEASURE(wl = strlen(src));
+    report("strlen", size + 1, 0, bc, wc);
+    errors += bl != size || wl != size;
+  }
+  for (int i = 0; i < n; i++)
+  {
+    int size = sizes[i] - 1;
+    mkstring(0, size);
+    memcpy(dst, src, size + 1);
+    int br = 1, wr = 1;
+    uint32_t bc = MEASURE(br = byte_strcmp(src, dst));
+    uint32_t wc = MEASURE(wr = strcmp(src, dst));
+    report("strcmp", size + 1, 0, bc, wc);
+    errors += br != 0 || wr != 0;
+  }
+
+  // The DMA copy includes programming the channel and polling for the end
+  for (int i = 0; i < n; i++)
+  {
+    int size = sizes[i];
+    for (int offset = 0; offset < 4; offset += 3)
+    {
+      for (int j = 0; j < size; j++)
+        src[offset + j] = j;
+      uint32_t mc = MEASURE(memcpy(dst, src + offset, size));
+      memset(dst, 0, size);
+      uint32_t dc = MEASURE(dma_memcpy(0, dst, src + offset, size); dma_wait(0));
+      printf("dma %d", size);
+      if (offset)
+        printf("+%d", offset);
+      printf(": memcpy ");
+      putcpb(mc, size);
+      printf(", dma ");
+      putcpb(dc, size);
+      printf(" cycles/byte\n");
+      for (int j = 0; j < size; j++)
+        errors += dst[j] != (char)j;
+    }
+  }
+
+  if (*(volatile uint32_t *)(SYSCON_BASE + SYS_REG_SDRAMSIZE) >= SDRAM_BYTES)
+    errors += sdram_bench();
+
+  printf("errors: %d\n", errors);
+  exit(errors != 0);
+  return 0;
+}
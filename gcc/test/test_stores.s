@@ -0,0 +1,23 @@
+.global _boot
+.text
+# Byte and halfword stores into RAM words that are read back whole, then exit through the Syscon
+_boot:                           /* x0  = 0    0x000         */
+        lui  x1,     %hi(0x80000000)   /* x1 = 0x8000_0000 (RAM)   */
+        lui  x2,     0x11223           /* x2 = 0x1122_3000         */
+        addi x2, x2, 0x344             /* x2 = 0x1122_3344         */
+        sw   x2,     0(x1)             /* [x1] = 0x1122_3344       */
+        addi x3, x0, 0xaa              /* x3 = 0xaa                */
+        sb   x3,     1(x1)             /* [x1] = 0x1122_aa44       */
+        lw   x4,     0(x1)             /* x4 = 0x1122_aa44         */
+        addi x5, x0, -1                /* x5 = 0xffff_ffff         */
+        sh   x5,     2(x1)             /* [x1] = 0xffff_aa44       */
+        lw   x6,     0(x1)             /* x6 = 0xffff_aa44         */
+        sb   x0,     0(x1)             /* [x1] = 0xffff_aa00       */
+        lw   x7,     0(x1)             /* x7 = 0xffff_aa00         */
+        sw   x2,     4(x1)             /* [x1+4] = 0x1122_3344     */
+        sh   x3,     4(x1)             /* [x1+4] = 0x1122_00aa     */
+        lw   x8,     4(x1)             /* x8 = 0x1122_00aa         */
+        lui  x9,     %hi(0x1040)       /* x9 = 0x1000 (Syscon)     */
+        addi x10, x0, 1                /* x10 = exit code 0        */
+        sw   x10,    0x40(x9)          /* [0x1040] = 1, exit       */
+        jal  x0,     0                 /* loop forever             */
@@ -0,0 +1,121 @@
+#!/usr/bin/env bash
+#
+# Simulation throughput benchmark for the Verilator model.
+#
+# Builds the Toplevel model for every combination of thread count, tracing
+# and optimization flags, runs each workload for a fixed number of cycles in
+# batch mode and appends the measured speed to a CSV results file.
+#
+# Usually called by "make bench", all knobs can be overridden from the
+# environment:
+#   BENCH_THREADS   Verilator thread counts            (default: "1 2 4")
+#   BENCH_TRACE     full-run FST tracing off/on        (default: "0 1")
+#   BENCH_OPTS      C++ optimization sets, see below   (default: "Os O2 O3native")
+#   BENCH_APPS      workloads from gcc/                (default: "helloUART blinkLED compute")
+#   BENCH_CYCLES    cycles simulated per run           (default: 2000000)
+#   BENCH_DIR       build and work directory, relative to the repository root (default: bench)
+#   BENCH_RESULTS   results file                       (default: $BENCH_DIR/results.csv)
+#   VERILATOR       command prefix to run verilator (eg. docker)
+
+set -euo pipefail
+
+ROOT=$(cd "$(dirname "$0")/.." && pwd)
+cd "$ROOT"
+
+THREADS=${BENCH_THREADS:-1 2 4}
+TRACE=${BENCH_TRACE:-0 1}
+OPTS=${BENCH_OPTS:-Os O2 O3native}
+APPS=${BENCH_APPS:-helloUART blinkLED compute}
+CYCLES=${BENCH_CYCLES:-2000000}
+DIR=${BENCH_DIR:-bench}
+RESULTS=${BENCH_RESULTS:-$DIR/results.csv}
+VERILATOR=${VERILATOR:-}
+
+SOURCES="verilator/chiselv.cpp verilator/loader.cpp verilator/hostio.cpp verilator/trace.cpp verilator/checkpoint.cpp verilator/profile.cpp verilator/disasm.cpp verilator/uart.c verilator/spiflash.cpp verilator/sdram.cpp"
+
+# Compiler flags for the generated model (OPT_FAST) and harness (OPT_SLOW)
+opt_flags() {
+	case $1 in
+	Os) echo "-Os" ;; # Verilator default, what "make verilator" builds
+	O2) echo "-O2" ;;
+	O3native) echo "-O3 -march=native" ;;
+	*)
+		echo "Unknown optimization set $1" >&2
+		exit 1
+		;;
+	esac
+}
+
+# Program arguments for a workload, building the firmware if needed
+app_args() {
+	local app=$ROOT/gcc/$1
+
+	if [ ! -f "$app/main-rom.mem" ]; then
+		make -C "$app" >&2
+	fi
+	echo "--rom $app/main-rom.mem --ram $app/main-ram.mem"
+}
+
+build() {
+	local name=$1 threads=$2 trace=$3 opt=$4
+	local mdir=$DIR/$name/obj_dir
+	local flags
+
+	flags=$(opt_flags "$opt")
+
+	echo "---- Building $name" >&2
+	rm -rf "$mdir"
+	$VERILATOR verilator -O3 --timescale 1ns/1ps --assert --threads "$threads" \
+		$([ "$trace" = 1 ] && echo --trace-fst) \
+		verilator/chiselv.vlt \
+		$(find ./generated -name "*.v" -o -name "*.sv" | sed 's/^/--cc /') \
+		$(grep -qs UART0Sim_enable generated/Toplevel.sv && echo -CFLAGS -DSIM_CONSOLE) \
+		$(grep -qs FLASH_csn generated/Toplevel.sv && echo -CFLAGS -DSIM_FLASH) \
+		$(grep -qs SDRAM_csn generated/Toplevel.sv && echo -CFLAGS -DSIM_SDRAM) \
+		--exe $SOURCES --top-module Toplevel -Mdir "$mdir" -o chiselv.bin >&2
+	make -C "$mdir" -f VToplevel.mk -j"$(nproc)" OPT_FAST="$flags" OPT_SLOW="$flags" >&2
+	cp "$mdir/chiselv.bin" "$DIR/$name/"
+}
+
+# Runs one workload and prints "cycles seconds" from the batch mode report
+run() {
+	local name=$1 app=$2 trace=$3
+
+	(
+		cd "$DIR/$name"
+		./chiselv.bin --batch --max-cycles "$CYCLES" $(app_args "$app") \
+			$([ "$trace" = 1 ] && echo --trace) \
+			</dev/null >/dev/null 2>run-$app.log || true
+		rm -f ChiselV.fst
+		tr -d '\r' <run-$app.log | awk '
+			/^cycles:/ { cycles = $2 }
+			/^wall time:/ { secs = $3 }
+			END { print cycles, secs }'
+	)
+}
+
+mkdir -p "$DIR"
+if [ ! -f "$RESULTS" ]; then
+	echo "config,threads,trace,opt,workload,cycles,seconds,cycles_per_sec" >"$RESULTS"
+fi
+
+for threads in $THREADS; do
+	for trace in $TRACE; do
+		for opt in $OPTS; do
+			name=t$threads-trace$trace-$opt
+			build "$name" "$threads" "$trace" "$opt"
+			for app in $APPS; do
+				read -r cycles secs < <(run "$name" "$app" "$trace")
+				if [ -z "$cycles" ] || [ -z "$secs" ]; then
+					echo "$name $app: no report, see $DIR/$name/run-$app.log" >&2
+					continue
+				fi
+				speed=$(awk -v c="$cycles" -v s="$secs" 'BEGIN { printf "%.0f", s > 0 ? c / s : 0 }')
+				printf "%-24s %-10s %12s cycles/s\n" "$name" "$app" "$speed"
+				echo "$name,$threads,$trace,$opt,$app,$cycles,$secs,$speed" >>"$RESULTS"
+			done
+		done
+	done
+done
+
+echo "Results written to $RESULTS"
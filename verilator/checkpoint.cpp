@@ -0,0 +1,183 @@
+/*
+ * Simulation checkpoints and fork-based snapshots.
+ *
+ * Models built with --savable (make SAVABLE=true) can write their full state
+ * to a file and resume from it later instead of going through reset, crt.s
+ * and the firmware init again. A checkpoint holds the model, the harness
+ * state handed over by chiselv.cpp (simulation time, counters, fast console
+ * handshake), the serial UART state machines from uart.c and the SPI flash
+ * and SDRAM models with their contents (spiflash.cpp, sdram.cpp) when the
+ * model has them. Bytes still queued in the host I/O rings are not part of it.
+ *
+ * Snapshots do not need a savable model: the warmed-up process forks one
+ * child per UART input file, each child continues the simulation from the
+ * very same state with its own input.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#ifdef SIM_SAVABLE
+#include "verilated_save.h"
+#endif
+#include "chiselv.h"
+
+#ifdef SIM_SAVABLE
+int checkpoint_save(VToplevel *top, const char *filename, const void *state, size_t len)
+{
+	VerilatedSave os;
+	uint64_t size = len;
+
+	os.open(filename);
+	if (!os.isOpen()) {
+		fprintf(stderr, "checkpoint: can not create %s\n", filename);
+		return -1;
+	}
+
+	os << size;
+	os.write(state, len);
+	uart_save(os);
+#ifdef SIM_FLASH
+	spiflash_save(os);
+#endif
+#ifdef SIM_SDRAM
+	sdram_save(os);
+#endif
+	os << *top;
+	os.close();
+
+	fprintf(stderr, "checkpoint: saved %s\r\n", filename);
+	return 0;
+}
+
+int checkpoint_restore(VToplevel *top, const char *filename, void *state, size_t len)
+{
+	VerilatedRestore os;
+	uint64_t size;
+
+	/* VerilatedRestore aborts on errors, check the file first */
+	if (access(filename, R_OK)) {
+		perror(filename);
+		return -1;
+	}
+
+	os.open(filename);
+	if (!os.isOpen()) {
+		fprintf(stderr, "checkpoint: can not open %s\n", filename);
+		return -1;
+	}
+
+	os >> size;
+	if (size != len) {
+		fprintf(stderr, "checkpoint: %s was written by a different harness\n", filename);
+		os.close();
+		return -1;
+	}
+	os.read(state, len);
+	uart_restore(os);
+#ifdef SIM_FLASH
+	spiflash_restore(os);
+#endif
+#ifdef SIM_SDRAM
+	sdram_restore(os);
+#endif
+	os >> *top;
+	os.close();
+
+	return 0;
+}
+#endif
+
+/* Waits for one child and reports its exit status, returns false if it failed */
+static bool reap(pid_t *pids, const char **names, int n)
+{
+	int status;
+	pid_t pid;
+
+	do {
+		pid = wait(&status);
+	} while (pid < 0 && errno == EINTR);
+	if (pid < 0)
+		return false;
+
+	for (int i = 0; i < n; i++) {
+		if (pids[i] != pid)
+			continue;
+
+		pids[i] = 0;
+		if (WIFEXITED(status)) {
+			fprintf(stderr, "snapshot: %s exited with %d\r\n", names[i], WEXITSTATUS(status));
+			return WEXITSTATUS(status) == 0;
+		}
+		fprintf(stderr, "snapshot: %s killed by signal %d\r\n", names[i], WTERMSIG(status));
+		return false;
+	}
+
+	return false;
+}
+
+/*
+ * Forks one child per comma separated input file, at most jobs at a time.
+ * Children return 0 with UART0 reading from their input file and writing to
+ * <input>.out, the parent returns 1 after all of them finished (with *failed
+ * set to the number of children that did not exit with 0), or -1 on errors.
+ * The model must be single threaded, fork() only keeps the calling thread.
+ */
+int snapshot_fork(const char *inputs, int jobs, int *failed)
+{
+	std::string list = inputs;
+	const char *names[256];
+	pid_t pids[256] = {};
+	int n = 0, running = 0;
+	char *save, *tok;
+
+	for (tok = strtok_r(&list[0], ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+		if (n == 256) {
+			fprintf(stderr, "snapshot: too many inputs\n");
+			return -1;
+		}
+		names[n++] = tok;
+	}
+
+	if (jobs < 1)
+		jobs = 1;
+	*failed = 0;
+
+	/* The I/O thread does not survive fork(), children start their own */
+	hostio_stop();
+	fflush(NULL);
+
+	for (int i = 0; i < n; i++) {
+		if (running == jobs) {
+			*failed += !reap(pids, names, n);
+			running--;
+		}
+
+		pids[i] = fork();
+		if (pids[i] < 0) {
+			perror("fork");
+			pids[i] = 0;
+			(*failed)++;
+			continue;
+		}
+
+		if (pids[i] == 0) {
+			std::string out = std::string(names[i]) + ".out";
+
+			if (hostio_start(names[i], out.c_str()))
+				exit(1);
+			return 0;
+		}
+		running++;
+	}
+
+	while (running--)
+		*failed += !reap(pids, names, n);
+
+	return 1;
+}
@@ -1,7 +1,13 @@
+#include <getopt.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
 #include "VToplevel.h"
 #include "verilated.h"
-#include "verilated_vcd_c.h"
+#include "chiselv.h"
+#include "profile.h"
 
 /*
  * Current simulation time
@@ -20,66 +26,558 @@ double sc_time_stamp(void)
 	return main_time;
 }
 
-#if VM_TRACE
-VerilatedVcdC *tfp;
-#endif
-
 void tick(VToplevel *top)
 {
 	top->clock = 1;
 	top->eval();
 #if VM_TRACE
-	if (tfp)
-		tfp->dump((double)main_time);
+	trace_dump(main_time);
 #endif
 	main_time++;
 
 	top->clock = 0;
 	top->eval();
 #if VM_TRACE
-	if (tfp)
-		tfp->dump((double)main_time);
+	trace_dump(main_time);
 #endif
 	main_time++;
 }
 
-void uart_tx(unsigned char tx);
-unsigned char uart_rx(void);
+/* Models generated with --simconsole expose the UART0Sim port (see Uart.scala) */
+#ifdef SIM_CONSOLE
+#define SIM_CONSOLE_AVAILABLE true
+#else
+#define SIM_CONSOLE_AVAILABLE false
+#endif
+
+/* Long only options */
+enum {
+	OPT_TRACE_START = 256,
+	OPT_TRACE_STOP,
+	OPT_TRACE_WINDOW,
+	OPT_TRACE_PC,
+	OPT_TRACE_MMIO,
+	OPT_TRACE_PRETRIGGER,
+	OPT_TRACE_DEPTH,
+	OPT_TRACE_SCOPE,
+	OPT_SNAPSHOT_CYCLE,
+	OPT_SNAPSHOT_MMIO,
+	OPT_SAVE,
+	OPT_RESTORE,
+	OPT_FORK,
+	OPT_JOBS,
+	OPT_PROFILE,
+	OPT_PROFILE_PERIOD,
+	OPT_PROFILE_SYMBOLS,
+};
+
+/* Exit code used when --max-cycles is reached (same as timeout(1)) */
+#define EXIT_TIMEOUT 124
+
+/* Checkpoints need a model built with --savable (make SAVABLE=true) */
+#ifdef SIM_SAVABLE
+#define SIM_SAVABLE_AVAILABLE true
+#else
+#define SIM_SAVABLE_AVAILABLE false
+#endif
+
+/* Harness state saved in checkpoints along with the model */
+struct harness_state {
+	vluint64_t time;
+	unsigned long cycles;
+	unsigned long instret;
+	bool rx_pending;
+};
+
+/* When to save a checkpoint or fork the snapshot children */
+struct snapshot_config {
+	bool enabled;
+	unsigned long cycle;	/* 0 for none */
+	bool trigger_mmio;
+	uint32_t mmio_addr;
+};
+
+static bool snapshot_due(VToplevel *top, const struct snapshot_config *snap, unsigned long cycle)
+{
+	if (!snap->cycle && !snap->trigger_mmio)
+		return true;
+	if (snap->cycle && cycle >= snap->cycle)
+		return true;
+	return snap->trigger_mmio && MMIO_WRITE(top) && MMIO_WRITE_ADDR(top) == snap->mmio_addr;
+}
+
+struct sim_stats {
+	unsigned long cycles;
+	unsigned long instret;
+	unsigned long icache_hits, icache_misses;
+	unsigned long dcache_hits, dcache_misses, dcache_writebacks;
+	struct timespec start;
+};
+
+static double elapsed(const struct timespec *start)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static void report(const struct sim_stats *stats, const char *reason, int code)
+{
+	double secs = elapsed(&stats->start);
+
+	fprintf(stderr, "\r\n------------------------------------------------------\r\n");
+	fprintf(stderr, "exit:          %s (%d)\r\n", reason, code);
+	fprintf(stderr, "cycles:        %lu\r\n", stats->cycles);
+	fprintf(stderr, "instructions:  %lu\r\n", stats->instret);
+	fprintf(stderr, "wall time:     %.3f s\r\n", secs);
+	fprintf(stderr, "sim speed:     %.1f kHz\r\n", secs > 0 ? stats->cycles / secs / 1000 : 0);
+	fprintf(stderr, "uart tx bytes: %lu\r\n", uart_tx_bytes);
+	fprintf(stderr, "uart rx bytes: %lu\r\n", uart_rx_bytes);
+#ifdef SIM_FLASH
+	fprintf(stderr, "icache hits:   %lu\r\n", stats->icache_hits);
+	fprintf(stderr, "icache misses: %lu\r\n", stats->icache_misses);
+#endif
+#ifdef SIM_SDRAM
+	fprintf(stderr, "dcache hits:   %lu\r\n", stats->dcache_hits);
+	fprintf(stderr, "dcache misses: %lu\r\n", stats->dcache_misses);
+	fprintf(stderr, "dcache writebacks: %lu\r\n", stats->dcache_writebacks);
+	fprintf(stderr, "sdram bursts:  %lu read, %lu write, %lu refreshes\r\n", sdram_reads, sdram_writes,
+		sdram_refreshes);
+	if (sdram_errors)
+		fprintf(stderr, "sdram errors:  %lu\r\n", sdram_errors);
+#endif
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr, "Usage: %s [options] [+verilator+args]\n"
+		"  -e, --elf FILE   load an ELF executable into ROM/RAM (and flash, SDRAM)\n"
+		"  -r, --rom FILE   load a raw binary (or .mem) image into ROM\n"
+		"  -m, --ram FILE   load a raw binary (or .mem) image into RAM\n"
+		"  -f, --flash FILE load a raw binary (or .mem) image into the flash XIP window at\n"
+		"                   0x20000000, needs a model generated with --xip\n"
+		"  -c, --max-cycles N  stop with exit code %d at cycle N, counted from reset\n"
+		"                   (a restored checkpoint keeps its cycles), 0: no limit\n"
+		"  -b, --batch      headless run: no UART input by default, print statistics at exit\n"
+		"  -s, --stats      print statistics at exit\n"
+		"  -C, --console MODE  UART0 console: fast (FIFO level, needs a model generated\n"
+		"                   with --simconsole) or serial (bit level), default: %s\n"
+		"  -i, --uart-in SPEC   UART0 input: - (stdin), none, pty, file or named pipe\n"
+		"  -o, --uart-out SPEC  UART0 output: - (stdout), none, pty, file or named pipe\n"
+		"  -t, --trace[=FILE]  write an FST waveform (default ChiselV.fst), needs a model\n"
+		"                   built with --trace-fst (make TRACE=true). Tracing starts at the\n"
+		"                   first trigger, or at cycle 0 when no trigger is given:\n"
+		"      --trace-start N       trigger at cycle N\n"
+		"      --trace-pc ADDR       trigger when the PC reaches ADDR\n"
+		"      --trace-mmio ADDR     trigger on a store to ADDR\n"
+		"      --trace-stop N        stop tracing at cycle N\n"
+		"      --trace-window N      stop tracing N cycles after the trigger\n"
+		"      --trace-pretrigger N  also keep at least the last N cycles before the trigger\n"
+		"      --trace-depth N       trace N hierarchy levels (default: all)\n"
+		"      --trace-scope LIST    trace only these instances, eg. TOP.Toplevel.SOC.core\n"
+		"      --save FILE      save a checkpoint at the snapshot point and stop, needs a\n"
+		"                       model built with --savable (make SAVABLE=true)\n"
+		"      --restore FILE   resume from a checkpoint instead of loading a program\n"
+		"      --fork LIST      at the snapshot point fork one child per UART input file in\n"
+		"                       the comma separated LIST, output goes to <input>.out\n"
+		"      --jobs N         children running at the same time (default: CPU count)\n"
+		"      --snapshot-cycle N    snapshot point at cycle N (default: right after reset)\n"
+		"      --snapshot-mmio ADDR  snapshot point at the first store to ADDR\n"
+		"      --profile[=FILE]      sample the PC and write a flat profile to FILE (default\n"
+		"                            chiselv.prof) and folded call stacks to FILE.folded\n"
+		"      --profile-period N    sample every N cycles (default: every retired instruction)\n"
+		"      --profile-symbols FILE  ELF, objdump -d or ld map file with the symbols\n"
+		"                            (default: the ELF, or main.dump/main.map next to the ROM)\n"
+		"  -h, --help       show this help\n"
+		"Without a program option progload.mem and progload-RAM.mem are loaded if present.\n"
+		"The simulation ends when software writes (code << 1) | 1 to the Syscon exit\n"
+		"register (0x1040), chiselv.bin then exits with that code.\n",
+		name, EXIT_TIMEOUT, SIM_CONSOLE_AVAILABLE ? "fast" : "serial");
+}
 
 int main(int argc, char **argv)
 {
+	static const struct option options[] = {
+		{ "elf", required_argument, NULL, 'e' },
+		{ "rom", required_argument, NULL, 'r' },
+		{ "ram", required_argument, NULL, 'm' },
+		{ "flash", required_argument, NULL, 'f' },
+		{ "max-cycles", required_argument, NULL, 'c' },
+		{ "batch", no_argument, NULL, 'b' },
+		{ "stats", no_argument, NULL, 's' },
+		{ "console", required_argument, NULL, 'C' },
+		{ "uart-in", required_argument, NULL, 'i' },
+		{ "uart-out", required_argument, NULL, 'o' },
+		{ "trace", optional_argument, NULL, 't' },
+		{ "trace-start", required_argument, NULL, OPT_TRACE_START },
+		{ "trace-stop", required_argument, NULL, OPT_TRACE_STOP },
+		{ "trace-window", required_argument, NULL, OPT_TRACE_WINDOW },
+		{ "trace-pc", required_argument, NULL, OPT_TRACE_PC },
+		{ "trace-mmio", required_argument, NULL, OPT_TRACE_MMIO },
+		{ "trace-pretrigger", required_argument, NULL, OPT_TRACE_PRETRIGGER },
+		{ "trace-depth", required_argument, NULL, OPT_TRACE_DEPTH },
+		{ "trace-scope", required_argument, NULL, OPT_TRACE_SCOPE },
+		{ "save", required_argument, NULL, OPT_SAVE },
+		{ "restore", required_argument, NULL, OPT_RESTORE },
+		{ "fork", required_argument, NULL, OPT_FORK },
+		{ "jobs", required_argument, NULL, OPT_JOBS },
+		{ "snapshot-cycle", required_argument, NULL, OPT_SNAPSHOT_CYCLE },
+		{ "snapshot-mmio", required_argument, NULL, OPT_SNAPSHOT_MMIO },
+		{ "profile", optional_argument, NULL, OPT_PROFILE },
+		{ "profile-period", required_argument, NULL, OPT_PROFILE_PERIOD },
+		{ "profile-symbols", required_argument, NULL, OPT_PROFILE_SYMBOLS },
+		{ "help", no_argument, NULL, 'h' },
+		{ NULL, 0, NULL, 0 }
+	};
+	const char *elffile = NULL, *romfile = NULL, *ramfile = NULL, *flashfile = NULL;
+	const char *uart_in = NULL, *uart_out = "-";
+	const char *save_file = NULL, *restore_file = NULL, *fork_inputs = NULL;
+	struct snapshot_config snap = {};
+	int jobs = sysconf(_SC_NPROCESSORS_ONLN);
+	bool rx_pending = false;
+	unsigned long max_cycles = 0;
+	bool batch = false, stats_on = false;
+	bool fast_console = SIM_CONSOLE_AVAILABLE;
+	struct trace_config trace = {};
+	struct profile_config profile = {};
+	struct sim_stats stats = {};
+	const char *reason = "finish";
+	int c, code = 0;
+
 	Verilated::commandArgs(argc, argv);
 
+	while ((c = getopt_long(argc, argv, "e:r:m:f:c:bsC:i:o:t::h", options, NULL)) != -1) {
+		switch (c) {
+		case 'e':
+			elffile = optarg;
+			break;
+		case 'r':
+			romfile = optarg;
+			break;
+		case 'm':
+			ramfile = optarg;
+			break;
+		case 'f':
+			flashfile = optarg;
+			break;
+		case 'c':
+			max_cycles = strtoul(optarg, NULL, 0);
+			break;
+		case 'b':
+			batch = true;
+			stats_on = true;
+			break;
+		case 's':
+			stats_on = true;
+			break;
+		case 'C':
+			if (!strcmp(optarg, "fast") && SIM_CONSOLE_AVAILABLE) {
+				fast_console = true;
+			} else if (!strcmp(optarg, "serial")) {
+				fast_console = false;
+			} else {
+				fprintf(stderr, "Console mode %s not available in this model\n", optarg);
+				return 1;
+			}
+			break;
+		case 'i':
+			uart_in = optarg;
+			break;
+		case 'o':
+			uart_out = optarg;
+			break;
+		case 't':
+			trace.enabled = true;
+			if (optarg)
+				trace.file = optarg;
+			break;
+		case OPT_TRACE_START:
+			trace.enabled = true;
+			trace.start = strtoul(optarg, NULL, 0);
+			break;
+		case OPT_TRACE_STOP:
+			trace.enabled = true;
+			trace.stop = strtoul(optarg, NULL, 0);
+			break;
+		case OPT_TRACE_WINDOW:
+			trace.enabled = true;
+			trace.window = strtoul(optarg, NULL, 0);
+			break;
+		case OPT_TRACE_PC:
+			trace.enabled = true;
+			trace.trigger_pc = true;
+			trace.pc = strtoul(optarg, NULL, 0);
+			break;
+		case OPT_TRACE_MMIO:
+			trace.enabled = true;
+			trace.trigger_mmio = true;
+			trace.mmio_addr = strtoul(optarg, NULL, 0);
+			break;
+		case OPT_TRACE_PRETRIGGER:
+			trace.enabled = true;
+			trace.pretrigger = strtoul(optarg, NULL, 0);
+			break;
+		case OPT_TRACE_DEPTH:
+			trace.enabled = true;
+			trace.depth = atoi(optarg);
+			break;
+		case OPT_TRACE_SCOPE:
+			trace.enabled = true;
+			trace.scopes = optarg;
+			break;
+		case OPT_SAVE:
+			snap.enabled = true;
+			save_file = optarg;
+			break;
+		case OPT_RESTORE:
+			restore_file = optarg;
+			break;
+		case OPT_FORK:
+			snap.enabled = true;
+			fork_inputs = optarg;
+			break;
+		case OPT_JOBS:
+			jobs = atoi(optarg);
+			break;
+		case OPT_SNAPSHOT_CYCLE:
+			snap.cycle = strtoul(optarg, NULL, 0);
+			break;
+		case OPT_SNAPSHOT_MMIO:
+			snap.trigger_mmio = true;
+			snap.mmio_addr = strtoul(optarg, NULL, 0);
+			break;
+		case OPT_PROFILE:
+			profile.enabled = true;
+			if (optarg)
+				profile.file = optarg;
+			break;
+		case OPT_PROFILE_PERIOD:
+			profile.enabled = true;
+			profile.period = strtoul(optarg, NULL, 0);
+			break;
+		case OPT_PROFILE_SYMBOLS:
+			profile.enabled = true;
+			profile.symbols = optarg;
+			break;
+		case 'h':
+			usage(argv[0]);
+			return 0;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if ((save_file || restore_file) && !SIM_SAVABLE_AVAILABLE) {
+		fprintf(stderr, "Checkpoints are not available, build the model with --savable (make SAVABLE=true)\n");
+		return 1;
+	}
+	if (save_file && fork_inputs) {
+		fprintf(stderr, "--save and --fork can not be used together\n");
+		return 1;
+	}
+
+#ifndef SIM_FLASH
+	if (flashfile) {
+		fprintf(stderr, "This model has no flash, generate it with --xip (make XIP=true)\n");
+		return 1;
+	}
+#endif
+
+	if (!elffile && !romfile && !ramfile && !flashfile && !restore_file) {
+		if (access("progload.mem", R_OK) == 0)
+			romfile = "progload.mem";
+		if (access("progload-RAM.mem", R_OK) == 0)
+			ramfile = "progload-RAM.mem";
+	}
+
+	if (!trace.file)
+		trace.file = "ChiselV.fst";
+#if !VM_TRACE
+	if (trace.enabled) {
+		fprintf(stderr, "Tracing is not available, build the model with --trace-fst (make TRACE=true)\n");
+		return 1;
+	}
+#endif
+
 	// init top verilog instance
 	VToplevel *top = new VToplevel;
 
 #if VM_TRACE
-	// init trace dump
-	Verilated::traceEverOn(true);
-	tfp = new VerilatedVcdC;
-	top->trace(tfp, 99);
-	tfp->open("ChiselV.vcd");
+	trace_open(top, &trace);
 #endif
 
-	// Reset
+	// Settle the model (runs initial blocks) before loading the program
 	top->reset = 1;
-	for (unsigned long i = 0; i < 5; i++)
-		tick(top);
+	top->clock = 0;
+	top->eval();
+
+	if (restore_file) {
+#ifdef SIM_SAVABLE
+		struct harness_state hs;
+
+		if (checkpoint_restore(top, restore_file, &hs, sizeof(hs))) {
+			delete top;
+			return 1;
+		}
+		main_time = hs.time;
+		stats.cycles = hs.cycles;
+		stats.instret = hs.instret;
+		rx_pending = hs.rx_pending;
+#endif
+	} else {
+		struct mem_region mem[] = {
+			{ "ROM", ROM_BASE, &ROM_ARRAY(top)[0], sizeof(ROM_ARRAY(top)) / sizeof(ROM_ARRAY(top)[0]) },
+#ifdef SIM_FLASH
+			{ "FLASH", FLASH_BASE, &spiflash_mem[FLASH_OFFSET / 4], (FLASH_SIZE - FLASH_OFFSET) / 4 },
+#endif
+#ifdef SIM_SDRAM
+			{ "SDRAM", SDRAM_BASE, sdram_mem, SDRAM_SIZE / 4 },
+#endif
+			{ "RAM", RAM_BASE, &RAM_ARRAY(top)[0], sizeof(RAM_ARRAY(top)) / sizeof(RAM_ARRAY(top)[0]) },
+		};
+		int n = sizeof(mem) / sizeof(mem[0]);
+
+		if ((elffile && load_elf(mem, n, elffile)) ||
+		    (romfile && load_image(mem, n, romfile, ROM_BASE)) ||
+		    (flashfile && load_image(mem, n, flashfile, FLASH_BASE)) ||
+		    (ramfile && load_image(mem, n, ramfile, RAM_BASE))) {
+			delete top;
+			return 1;
+		}
+
+		// Reset
+		for (unsigned long i = 0; i < 5; i++)
+			tick(top);
+	}
 	top->reset = 0;
 
+	if (profile.enabled) {
+		profile.program = elffile ? elffile : romfile;
+		profile_open(&profile, &ROM_ARRAY(top)[0], sizeof(ROM_ARRAY(top)) / sizeof(ROM_ARRAY(top)[0]));
+	}
+
+	if (!uart_in)
+		uart_in = batch ? "none" : "-";
+	if (hostio_start(uart_in, uart_out)) {
+		delete top;
+		return 1;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &stats.start);
+
+#ifndef SIM_CONSOLE
+	(void)fast_console;
+	(void)rx_pending;
+#else
+	top->UART0Sim_enable = fast_console;
+	top->UART0Sim_rx_valid = 0;
+#endif
+
 	while (!Verilated::gotFinish())
 	{
-		tick(top);
-		// VL_PRINTF("GPIO  %" VL_PRI64 "x\r\n", top->Toplevel__DOT__CPU__DOT__GPIO0__DOT__GPIO);
+		if (snap.enabled && snapshot_due(top, &snap, stats.cycles)) {
+			int failed, ret;
+
+			snap.enabled = false;
+#ifdef SIM_SAVABLE
+			if (save_file) {
+				struct harness_state hs = { main_time, stats.cycles, stats.instret, rx_pending };
+
+				code = checkpoint_save(top, save_file, &hs, sizeof(hs)) ? 1 : 0;
+				reason = "checkpoint saved";
+				break;
+			}
+#endif
+			ret = snapshot_fork(fork_inputs, jobs, &failed);
+			if (ret) {
+				// Parent: all children are done
+				reason = ret < 0 ? "fork failed" : "snapshot children finished";
+				code = ret < 0 || failed ? 1 : 0;
+				break;
+			}
+		}
+
+		stats.instret += CPU_RETIRE(top);
+		if (profile.enabled)
+			profile_cycle(CPU_PC(top), CPU_RETIRE(top));
+#if VM_TRACE
+		trace_cycle(top, stats.cycles);
+#endif
+
+#ifdef SIM_CONSOLE
+		if (fast_console) {
+			// Bytes are handed over on the next clock edge
+			unsigned char c;
+			bool rx_accepted;
 
-		uart_tx(top->UART0_tx);
-		top->UART0_rx = uart_rx();
+			if (top->UART0Sim_tx_valid)
+				console_tx(top->UART0Sim_tx_bits);
+			if (!rx_pending && console_rx(&c)) {
+				top->UART0Sim_rx_bits = c;
+				rx_pending = true;
+			}
+			top->UART0Sim_rx_valid = rx_pending;
+			rx_accepted = rx_pending && top->UART0Sim_rx_ready;
+
+			tick(top);
+			stats.cycles++;
+			if (rx_accepted)
+				rx_pending = false;
+		} else
+#endif
+		{
+			tick(top);
+			stats.cycles++;
+			// VL_PRINTF("GPIO  %" VL_PRI64 "x\r\n", top->Toplevel__DOT__CPU__DOT__GPIO0__DOT__GPIO);
+
+			uart_tx(top->UART0_tx);
+			top->UART0_rx = uart_rx();
+		}
+#ifdef SIM_FLASH
+		top->FLASH_dataIn = spiflash_cycle(top->FLASH_sclk, top->FLASH_csn, top->FLASH_dataOut & top->FLASH_dataOE);
+#endif
+#ifdef SIM_SDRAM
+		top->SDRAM_dqIn = sdram_cycle(top->SDRAM_csn << 3 | top->SDRAM_rasn << 2 | top->SDRAM_casn << 1 | top->SDRAM_wen,
+					      top->SDRAM_ba, top->SDRAM_addr, top->SDRAM_dqm, top->SDRAM_dqOut,
+					      top->SDRAM_dqOE);
+#endif
+
+		if (EXIT_STATUS(top) & 1) {
+			reason = "exit register";
+			code = EXIT_STATUS(top) >> 1;
+			break;
+		}
+		/* An absolute cycle count, a restored checkpoint may already be past it */
+		if (max_cycles && stats.cycles >= max_cycles) {
+			reason = "max cycles reached";
+			code = EXIT_TIMEOUT;
+			break;
+		}
 	}
 
+	hostio_stop();
+
+#ifdef SIM_FLASH
+	stats.icache_hits = ICACHE_HITS(top);
+	stats.icache_misses = ICACHE_MISSES(top);
+#endif
+#ifdef SIM_SDRAM
+	stats.dcache_hits = DCACHE_HITS(top);
+	stats.dcache_misses = DCACHE_MISSES(top);
+	stats.dcache_writebacks = DCACHE_WRITEBACKS(top);
+#endif
+	if (stats_on)
+		report(&stats, reason, code);
+	if (profile.enabled && profile_close())
+		code = code ? code : 1;
+
 #if VM_TRACE
-	tfp->close();
-	delete tfp;
+	trace_close();
 #endif
 
 	delete top;
+
+	return code;
 }
@@ -0,0 +1,96 @@
+#pragma once
+
+/*
+ * Shared declarations for the ChiselV Verilator harness
+ */
+
+#include <stdint.h>
+#include "VToplevel.h"
+#include "VToplevel___024root.h"
+#include "hostio.h"
+#include "loader.h"
+
+/*
+ * Generated ROM and RAM arrays. They are made visible to the harness by the
+ * public_flat_rw rules in verilator/chiselv.vlt.
+ */
+#define ROM_ARRAY(top) ((top)->rootp->Toplevel__DOT__SOC__DOT__instructionMemory__DOT__mem_ext__DOT__Memory)
+#define RAM_ARRAY(top) ((top)->rootp->Toplevel__DOT__SOC__DOT__dataMemory__DOT__mem_ext__DOT__Memory)
+
+/* Exit status register in Syscon (0x1040), written as (code << 1) | 1 */
+#define EXIT_STATUS(top) ((top)->rootp->Toplevel__DOT__SOC__DOT__syscon__DOT__exitStatus)
+/*
+ * High on the cycles an instruction retires and its address, the same for the
+ * single cycle and the pipelined core (where it is the instruction in WB)
+ */
+#define CPU_RETIRE(top) ((top)->rootp->Toplevel__DOT__SOC__DOT__core__DOT__retire)
+#define CPU_PC(top) ((top)->rootp->Toplevel__DOT__SOC__DOT__core__DOT__retirePC)
+
+/* Instruction cache counters of models generated with --xip */
+#define ICACHE_HITS(top) ((top)->rootp->Toplevel__DOT__SOC__DOT__icache__DOT__hits)
+#define ICACHE_MISSES(top) ((top)->rootp->Toplevel__DOT__SOC__DOT__icache__DOT__misses)
+
+/* Data cache counters of models generated with --sdram */
+#define DCACHE_HITS(top) ((top)->rootp->Toplevel__DOT__SOC__DOT__dcache__DOT__hits)
+#define DCACHE_MISSES(top) ((top)->rootp->Toplevel__DOT__SOC__DOT__dcache__DOT__misses)
+#define DCACHE_WRITEBACKS(top) ((top)->rootp->Toplevel__DOT__SOC__DOT__dcache__DOT__writebacks)
+
+/* Data bus stores, used by the trace triggers */
+#define MMIO_WRITE(top) ((top)->rootp->Toplevel__DOT__SOC__DOT__core__DOT__memoryIOManager__DOT__io_MemoryIOPort_writeRequest)
+#define MMIO_WRITE_ADDR(top) ((top)->rootp->Toplevel__DOT__SOC__DOT__core__DOT__memoryIOManager__DOT__io_MemoryIOPort_writeAddr)
+
+/* trace.cpp, only in models built with --trace-fst */
+struct trace_config {
+	bool enabled;
+	const char *file;
+	int depth;		/* hierarchy levels, 0 for all */
+	const char *scopes;	/* comma separated instance list, NULL for all */
+	unsigned long start;	/* trigger cycle, 0 for none */
+	unsigned long stop;	/* stop cycle, 0 for none */
+	unsigned long window;	/* cycles traced after the trigger, 0 for all */
+	unsigned long pretrigger;	/* cycles kept before the trigger */
+	bool trigger_pc;
+	uint32_t pc;
+	bool trigger_mmio;
+	uint32_t mmio_addr;
+};
+
+void trace_open(VToplevel *top, const struct trace_config *config);
+void trace_cycle(VToplevel *top, unsigned long cycle);
+void trace_dump(uint64_t time);
+void trace_close(void);
+
+/* checkpoint.cpp, save/restore only in models built with --savable */
+int checkpoint_save(VToplevel *top, const char *filename, const void *state, size_t len);
+int checkpoint_restore(VToplevel *top, const char *filename, void *state, size_t len);
+int snapshot_fork(const char *inputs, int jobs, int *failed);
+
+/* spiflash.cpp, the flash behind the XIP window at FLASH_BASE */
+#define FLASH_SIZE (16 * 1024 * 1024)
+#define FLASH_OFFSET 0x100000	/* flash address of FLASH_BASE, FlashConfig.offset in SPIFlash.scala */
+extern uint32_t spiflash_mem[FLASH_SIZE / 4];
+extern unsigned long spiflash_reads;
+uint8_t spiflash_cycle(bool sclk, bool csn, uint8_t io);
+
+/* sdram.cpp, the SDRAM behind the data cache at SDRAM_BASE (SDRAMConfig in SDRAM.scala) */
+#define SDRAM_SIZE (32 * 1024 * 1024)
+#define SDRAM_COL_BITS 9
+extern uint32_t sdram_mem[SDRAM_SIZE / 4];
+extern unsigned long sdram_reads, sdram_writes, sdram_activates, sdram_refreshes, sdram_errors;
+uint16_t sdram_cycle(uint8_t cmd, uint8_t ba, uint16_t addr, uint8_t dqm, uint16_t dq, bool dq_oe);
+
+/* uart.c */
+extern unsigned long uart_tx_bytes;
+extern unsigned long uart_rx_bytes;
+void uart_tx(unsigned char tx);
+unsigned char uart_rx(void);
+void console_tx(unsigned char c);
+bool console_rx(unsigned char *c);
+class VerilatedSerialize;
+class VerilatedDeserialize;
+void uart_save(VerilatedSerialize &os);
+void uart_restore(VerilatedDeserialize &os);
+void spiflash_save(VerilatedSerialize &os);
+void spiflash_restore(VerilatedDeserialize &os);
+void sdram_save(VerilatedSerialize &os);
+void sdram_restore(VerilatedDeserialize &os);
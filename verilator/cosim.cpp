@@ -0,0 +1,189 @@
+/*
+ * Lockstep differential co-simulation against the instruction set simulator.
+ *
+ * Every instruction retired on the RVFI port is also executed by the ISS
+ * (iss.cpp), which acts as the reference model. After each step the checker
+ * compares the next PC, the memory access (address, size and store data),
+ * the whole register file and, for RAM stores, the stored word. The first
+ * divergence stops the run with a short report and the last few retired
+ * instructions for context.
+ *
+ * MMIO has no reference: the RVFI top ties off the peripherals and only
+ * Timer0 and the CLINT count, so the reference takes MMIO load values from
+ * the DUT, and the same goes for CSR reads (counters). ECALL, EBREAK and MRET
+ * are checked, but the reference has no interrupt lines: a program that
+ * enables interrupts diverges at the first one the DUT takes. RAM written
+ * by the DMA controller is not seen by the reference either.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cosim.h"
+#include "disasm.h"
+#include "iss.h"
+
+/* Retired instructions shown before a divergence */
+#define HISTORY 8
+
+struct cosim {
+	struct iss *ref;
+	uint32_t dut_x[32];	/* DUT register file rebuilt from rd writes */
+	uint32_t mmio_rdata;	/* value of the MMIO load being checked */
+	struct ctrace_rec history[HISTORY];
+	uint64_t retired;
+};
+
+static uint32_t mmio_read(struct iss *s, uint32_t addr)
+{
+	struct cosim *c = (struct cosim *)s->priv;
+
+	(void)addr;
+	return c->mmio_rdata;
+}
+
+static void mmio_write(struct iss *s, uint32_t addr, uint32_t data)
+{
+	(void)s;
+	(void)addr;
+	(void)data;
+}
+
+struct cosim *cosim_open(const uint32_t *rom, size_t rom_words, const uint32_t *ram, size_t ram_words)
+{
+	struct cosim *c;
+
+	if (rom_words != ISS_ROM_WORDS || ram_words != ISS_RAM_WORDS) {
+		fprintf(stderr, "cosim: memory sizes differ from the reference model\n");
+		return NULL;
+	}
+
+	c = (struct cosim *)calloc(1, sizeof(*c));
+	c->ref = iss_create();
+	memcpy(c->ref->rom, rom, sizeof(c->ref->rom));
+	memcpy(c->ref->ram, ram, sizeof(c->ref->ram));
+	c->ref->pc = ROM_BASE;
+	c->ref->priv = c;
+	c->ref->mmio.read = mmio_read;
+	c->ref->mmio.write = mmio_write;
+	return c;
+}
+
+void cosim_close(struct cosim *c)
+{
+	if (!c)
+		return;
+	iss_destroy(c->ref);
+	free(c);
+}
+
+/* Memory access the instruction makes given the register values before it */
+static bool mem_access(uint32_t insn, const uint32_t *x, uint32_t *addr, uint32_t *mask, bool *store)
+{
+	uint32_t rs1 = x[(insn >> 15) & 31];
+	int32_t imm;
+
+	switch (insn & 0x7f) {
+	case 0x03:
+		imm = (int32_t)insn >> 20;
+		*store = false;
+		break;
+	case 0x23:
+		imm = ((int32_t)insn >> 25 << 5) | ((insn >> 7) & 0x1f);
+		*store = true;
+		break;
+	default:
+		return false;
+	}
+	*addr = rs1 + imm;
+	*mask = (1U << (1U << ((insn >> 12) & 3))) - 1;
+	return true;
+}
+
+static void print_insn(const char *prefix, const struct ctrace_rec *r)
+{
+	char text[64];
+
+	disasm(r->pc, r->insn, text, sizeof(text));
+	fprintf(stderr, "%s%10llu %08x %08x  %s\n", prefix, (unsigned long long)r->order, r->pc, r->insn, text);
+}
+
+static int diverged(struct cosim *c, const struct ctrace_rec *r, const char *what,
+		    uint32_t dut, uint32_t ref)
+{
+	uint64_t first = c->retired > HISTORY ? c->retired - HISTORY : 0;
+
+	fprintf(stderr, "\ncosim: divergence at instruction %llu\n", (unsigned long long)r->order);
+	for (uint64_t i = first; i < c->retired; i++)
+		print_insn("    ", &c->history[i % HISTORY]);
+	print_insn(" >> ", r);
+	fprintf(stderr, "  %-14s dut %08x  ref %08x\n", what, dut, ref);
+	return -1;
+}
+
+int cosim_step(struct cosim *c, const struct ctrace_rec *r, uint32_t pc_wdata, const uint32_t *ram)
+{
+	struct iss *ref = c->ref;
+	uint32_t addr = 0, mask = 0;
+	bool is_mem, store = false;
+	char what[32];
+
+	if (r->pc != ref->pc)
+		return diverged(c, r, "pc", r->pc, ref->pc);
+	/* The core traces compressed instructions expanded */
+	if (r->insn != iss_insn_at(ref, ref->pc, NULL))
+		return diverged(c, r, "insn", r->insn, iss_insn_at(ref, ref->pc, NULL));
+
+	is_mem = mem_access(r->insn, ref->x, &addr, &mask, &store);
+	if (is_mem) {
+		if (r->mem_addr != addr)
+			return diverged(c, r, "mem addr", r->mem_addr, addr);
+		if ((store ? r->mem_wmask : r->mem_rmask) != mask)
+			return diverged(c, r, store ? "store mask" : "load mask",
+					store ? r->mem_wmask : r->mem_rmask, mask);
+		if (store) {
+			uint32_t bits = mask == 0xf ? ~0U : (1U << (8 * __builtin_popcount(mask))) - 1;
+			uint32_t wdata = ref->x[(r->insn >> 20) & 31];
+
+			if ((r->mem_wdata & bits) != (wdata & bits))
+				return diverged(c, r, "store data", r->mem_wdata, wdata);
+		}
+	} else if (r->mem_rmask || r->mem_wmask) {
+		return diverged(c, r, "mem access", r->mem_rmask | r->mem_wmask, 0);
+	}
+	c->mmio_rdata = r->rd_wdata;
+
+	iss_run(ref, 1);
+	if (ref->illegal != r->trap)
+		return diverged(c, r, "trap", r->trap, ref->illegal);
+	if (r->trap) {
+		/* Both agree on the illegal instruction, carry on where the DUT goes */
+		ref->illegal = ref->halted = false;
+		ref->pc = pc_wdata;
+	}
+
+	if (r->rd)
+		c->dut_x[r->rd] = r->rd_wdata;
+	/* Counter values depend on timing the reference only approximates, follow the DUT */
+	if ((r->insn & 0x7f) == 0x73 && r->rd)
+		ref->x[r->rd] = r->rd_wdata;
+
+	if (pc_wdata != ref->pc)
+		return diverged(c, r, "next pc", pc_wdata, ref->pc);
+	for (int i = 1; i < 32; i++) {
+		if (c->dut_x[i] != ref->x[i])
+			return diverged(c, r, disasm_reg(i), c->dut_x[i], ref->x[i]);
+	}
+	if (is_mem && store && (addr >> 28) == (RAM_BASE >> 28)) {
+		uint32_t i = (addr >> 2) & (ISS_RAM_WORDS - 1);
+
+		if (ram[i] != ref->ram[i]) {
+			snprintf(what, sizeof(what), "ram[%08x]", addr & ~3U);
+			return diverged(c, r, what, ram[i], ref->ram[i]);
+		}
+	}
+
+	c->history[c->retired++ % HISTORY] = *r;
+	return 0;
+}
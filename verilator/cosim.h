@@ -0,0 +1,22 @@
+#pragma once
+
+/*
+ * Lockstep co-simulation checker for the RVFI harness (see cosim.cpp)
+ */
+
+#include <stdint.h>
+
+#include "ctrace.h"
+
+struct cosim;
+
+/* Starts the reference model from the same ROM and RAM contents as the DUT */
+struct cosim *cosim_open(const uint32_t *rom, size_t rom_words, const uint32_t *ram, size_t ram_words);
+/*
+ * Checks one instruction retired by the DUT: r as written to the commit
+ * trace, pc_wdata the next PC reported by RVFI and ram the DUT data memory
+ * after the instruction. Returns 0 when the reference model agrees, -1 after
+ * printing the first divergence to stderr.
+ */
+int cosim_step(struct cosim *c, const struct ctrace_rec *r, uint32_t pc_wdata, const uint32_t *ram);
+void cosim_close(struct cosim *c);
@@ -0,0 +1,174 @@
+/*
+ * Decoder for the commit traces written by chiselv_rvfi.bin (see ctrace.h).
+ *
+ * Prints one line per retired instruction with its disassembly, register
+ * write and memory access, optionally filtered by instruction range, PC range
+ * or memory address range, or only a summary of the trace.
+ */
+
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ctrace.h"
+#include "disasm.h"
+
+struct range {
+	bool set;
+	uint32_t lo, hi;
+};
+
+/* Parses ADDR or LO:HI (inclusive) */
+static bool parse_range(const char *s, struct range *r)
+{
+	char *end;
+
+	r->lo = strtoul(s, &end, 0);
+	r->hi = r->lo;
+	if (*end == ':')
+		r->hi = strtoul(end + 1, &end, 0);
+	r->set = true;
+	return *end == '\0' && r->lo <= r->hi;
+}
+
+static bool in_range(const struct range *r, uint32_t v)
+{
+	return !r->set || (v >= r->lo && v <= r->hi);
+}
+
+static void print_rec(const struct ctrace_rec *r, bool raw)
+{
+	char text[64];
+
+	printf("%10" PRIu64 " %08x %08x", r->order, r->pc, r->insn);
+	if (!raw) {
+		disasm(r->pc, r->insn, text, sizeof(text));
+		printf("  %-28s", text);
+	}
+	if (r->rd)
+		printf(" %s=%08x", disasm_reg(r->rd), r->rd_wdata);
+	if (r->mem_rmask)
+		printf(" load[%08x/%x]=%08x", r->mem_addr, r->mem_rmask, r->mem_rdata);
+	if (r->mem_wmask)
+		printf(" store[%08x/%x]=%08x", r->mem_addr, r->mem_wmask, r->mem_wdata);
+	if (r->trap)
+		printf(" TRAP");
+	putchar('\n');
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr, "Usage: %s [options] TRACE\n"
+		"  -s, --start N       skip the first N instructions\n"
+		"  -n, --count N       stop after N instructions\n"
+		"  -p, --pc LO[:HI]    only instructions in this PC range\n"
+		"  -a, --addr LO[:HI]  only loads and stores to this address range\n"
+		"  -m, --mem           only loads and stores\n"
+		"  -r, --raw           do not disassemble\n"
+		"  -S, --summary       print totals only\n"
+		"  -h, --help          show this help\n",
+		name);
+}
+
+int main(int argc, char **argv)
+{
+	static const struct option options[] = {
+		{ "start", required_argument, NULL, 's' },
+		{ "count", required_argument, NULL, 'n' },
+		{ "pc", required_argument, NULL, 'p' },
+		{ "addr", required_argument, NULL, 'a' },
+		{ "mem", no_argument, NULL, 'm' },
+		{ "raw", no_argument, NULL, 'r' },
+		{ "summary", no_argument, NULL, 'S' },
+		{ "help", no_argument, NULL, 'h' },
+		{ NULL, 0, NULL, 0 }
+	};
+	struct range pc = {}, addr = {};
+	uint64_t start = 0, count = UINT64_MAX, shown = 0;
+	uint64_t total = 0, loads = 0, stores = 0, traps = 0, jumps = 0;
+	bool mem_only = false, raw = false, summary = false;
+	struct ctrace_reader *rd;
+	struct ctrace_rec r;
+	uint32_t next_pc = 0;
+	int c, ret;
+
+	while ((c = getopt_long(argc, argv, "s:n:p:a:mrSh", options, NULL)) != -1) {
+		switch (c) {
+		case 's':
+			start = strtoull(optarg, NULL, 0);
+			break;
+		case 'n':
+			count = strtoull(optarg, NULL, 0);
+			break;
+		case 'p':
+			if (!parse_range(optarg, &pc)) {
+				fprintf(stderr, "Invalid PC range %s\n", optarg);
+				return 1;
+			}
+			break;
+		case 'a':
+			if (!parse_range(optarg, &addr)) {
+				fprintf(stderr, "Invalid address range %s\n", optarg);
+				return 1;
+			}
+			mem_only = true;
+			break;
+		case 'm':
+			mem_only = true;
+			break;
+		case 'r':
+			raw = true;
+			break;
+		case 'S':
+			summary = true;
+			break;
+		case 'h':
+			usage(argv[0]);
+			return 0;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (optind != argc - 1) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	rd = ctrace_reader_open(argv[optind]);
+	if (!rd)
+		return 1;
+
+	while (shown < count && (ret = ctrace_next(rd, &r)) == 1) {
+		bool is_mem = r.mem_rmask || r.mem_wmask;
+
+		total++;
+		loads += r.mem_rmask != 0;
+		stores += r.mem_wmask != 0;
+		traps += r.trap;
+		jumps += r.order && r.pc != next_pc;
+		next_pc = r.pc + 4;
+
+		if (summary || r.order < start || !in_range(&pc, r.pc))
+			continue;
+		if (mem_only && (!is_mem || !in_range(&addr, r.mem_addr)))
+			continue;
+
+		print_rec(&r, raw);
+		shown++;
+	}
+	ctrace_reader_close(rd);
+
+	if (summary) {
+		printf("instructions:   %" PRIu64 "\n", total);
+		printf("loads:          %" PRIu64 "\n", loads);
+		printf("stores:         %" PRIu64 "\n", stores);
+		printf("control flow:   %" PRIu64 "\n", jumps);
+		printf("traps:          %" PRIu64 "\n", traps);
+	}
+
+	return ret < 0;
+}
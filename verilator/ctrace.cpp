@@ -0,0 +1,440 @@
+/*
+ * Compact binary commit trace writer and reader.
+ *
+ * The simulation thread only encodes records into a block buffer (a few
+ * bytes per instruction, see ctrace.h for the format). Full blocks are handed
+ * to a writer thread that compresses them with zstd when enabled and writes
+ * them out, so file I/O and compression overlap with the simulation.
+ *
+ * zstd support is compiled in with -DHAVE_ZSTD (and -lzstd).
+ */
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#include "ctrace.h"
+
+/* Size of the blocks handed to the writer thread */
+#define BLOCK_SIZE (1 << 20)
+/* Blocks queued before the simulation waits for the writer */
+#define MAX_QUEUED 8
+/* Largest encoded record: flags, pc, insn, rd and two memory accesses */
+#define MAX_RECORD 64
+
+/* Encoder/decoder state that must evolve identically on both sides */
+struct ctrace_state {
+	uint32_t pc;
+	uint32_t icache[CTRACE_ICACHE];
+	bool icache_valid[CTRACE_ICACHE];
+};
+
+static inline unsigned icache_index(uint32_t pc)
+{
+	return (pc >> 2) & (CTRACE_ICACHE - 1);
+}
+
+static inline uint8_t *put_varint(uint8_t *p, uint32_t v)
+{
+	while (v >= 0x80) {
+		*p++ = v | 0x80;
+		v >>= 7;
+	}
+	*p++ = v;
+	return p;
+}
+
+static inline uint32_t zigzag(int32_t v)
+{
+	return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+static inline int32_t unzigzag(uint32_t v)
+{
+	return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+}
+
+struct ctrace_writer {
+	FILE *f;
+	bool zstd;
+#ifdef HAVE_ZSTD
+	ZSTD_CCtx *cctx;
+	std::vector<uint8_t> zbuf;
+#endif
+	struct ctrace_state st;
+
+	std::vector<uint8_t> block;
+	std::deque<std::vector<uint8_t>> queue;
+	std::mutex lock;
+	std::condition_variable cond;
+	bool done;
+	bool error;
+	std::thread thread;
+};
+
+static void write_out(struct ctrace_writer *w, const uint8_t *data, size_t len, bool last)
+{
+#ifdef HAVE_ZSTD
+	if (w->zstd) {
+		ZSTD_inBuffer in = { data, len, 0 };
+		size_t ret;
+
+		do {
+			ZSTD_outBuffer out = { w->zbuf.data(), w->zbuf.size(), 0 };
+
+			ret = ZSTD_compressStream2(w->cctx, &out, &in, last ? ZSTD_e_end : ZSTD_e_continue);
+			if (ZSTD_isError(ret)) {
+				fprintf(stderr, "ctrace: %s\n", ZSTD_getErrorName(ret));
+				w->error = true;
+				return;
+			}
+			if (fwrite(w->zbuf.data(), 1, out.pos, w->f) != out.pos)
+				w->error = true;
+		} while (last ? ret != 0 : in.pos < in.size);
+		return;
+	}
+#endif
+	(void)last;
+	if (len && fwrite(data, 1, len, w->f) != len)
+		w->error = true;
+}
+
+static void writer_loop(struct ctrace_writer *w)
+{
+	std::unique_lock<std::mutex> guard(w->lock);
+
+	for (;;) {
+		w->cond.wait(guard, [w] { return w->done || !w->queue.empty(); });
+		if (w->queue.empty())
+			break;
+
+		std::vector<uint8_t> block = std::move(w->queue.front());
+		w->queue.pop_front();
+		w->cond.notify_all();
+
+		guard.unlock();
+		write_out(w, block.data(), block.size(), false);
+		guard.lock();
+	}
+
+	guard.unlock();
+	write_out(w, NULL, 0, true);
+}
+
+struct ctrace_writer *ctrace_open(const char *filename, bool zstd)
+{
+	struct ctrace_writer *w;
+
+#ifndef HAVE_ZSTD
+	if (zstd) {
+		fprintf(stderr, "ctrace: built without zstd support\n");
+		return NULL;
+	}
+#endif
+
+	w = new ctrace_writer();
+	w->f = fopen(filename, "wb");
+	if (!w->f) {
+		perror(filename);
+		delete w;
+		return NULL;
+	}
+
+	w->zstd = zstd;
+#ifdef HAVE_ZSTD
+	if (zstd) {
+		w->cctx = ZSTD_createCCtx();
+		w->zbuf.resize(ZSTD_CStreamOutSize());
+	}
+#endif
+
+	w->block.reserve(BLOCK_SIZE);
+	w->block.insert(w->block.end(), CTRACE_MAGIC, CTRACE_MAGIC + CTRACE_MAGIC_LEN);
+	w->thread = std::thread(writer_loop, w);
+	return w;
+}
+
+static void submit(struct ctrace_writer *w)
+{
+	std::unique_lock<std::mutex> guard(w->lock);
+
+	w->cond.wait(guard, [w] { return w->queue.size() < MAX_QUEUED; });
+	w->queue.push_back(std::move(w->block));
+	w->cond.notify_all();
+	guard.unlock();
+
+	w->block = std::vector<uint8_t>();
+	w->block.reserve(BLOCK_SIZE);
+}
+
+void ctrace_put(struct ctrace_writer *w, const struct ctrace_rec *r)
+{
+	size_t used = w->block.size();
+	uint8_t *start, *p;
+	unsigned idx = icache_index(r->pc);
+	uint8_t flags = 0;
+
+	if (used + MAX_RECORD > BLOCK_SIZE) {
+		submit(w);
+		used = 0;
+	}
+	w->block.resize(used + MAX_RECORD);
+	start = p = w->block.data() + used;
+	p++;
+
+	if (r->pc != w->st.pc + 4) {
+		flags |= CT_PC;
+		p = put_varint(p, zigzag((int32_t)(r->pc - (w->st.pc + 4))));
+	}
+	w->st.pc = r->pc;
+
+	if (!w->st.icache_valid[idx] || w->st.icache[idx] != r->insn) {
+		flags |= CT_INSN;
+		memcpy(p, &r->insn, 4);
+		p += 4;
+		w->st.icache[idx] = r->insn;
+		w->st.icache_valid[idx] = true;
+	}
+
+	if (r->rd) {
+		flags |= CT_RD;
+		*p++ = r->rd;
+		p = put_varint(p, r->rd_wdata);
+	}
+	if (r->mem_rmask) {
+		flags |= CT_LOAD;
+		p = put_varint(p, r->mem_addr);
+		*p++ = r->mem_rmask;
+		p = put_varint(p, r->mem_rdata);
+	}
+	if (r->mem_wmask) {
+		flags |= CT_STORE;
+		p = put_varint(p, r->mem_addr);
+		*p++ = r->mem_wmask;
+		p = put_varint(p, r->mem_wdata);
+	}
+	if (r->trap)
+		flags |= CT_TRAP;
+
+	*start = flags;
+	w->block.resize(used + (p - start));
+}
+
+int ctrace_close(struct ctrace_writer *w)
+{
+	int ret;
+
+	if (!w->block.empty())
+		submit(w);
+	{
+		std::lock_guard<std::mutex> guard(w->lock);
+		w->done = true;
+		w->cond.notify_all();
+	}
+	w->thread.join();
+
+	if (fclose(w->f))
+		w->error = true;
+#ifdef HAVE_ZSTD
+	if (w->cctx)
+		ZSTD_freeCCtx(w->cctx);
+#endif
+	ret = w->error ? -1 : 0;
+	delete w;
+	return ret;
+}
+
+struct ctrace_reader {
+	FILE *f;
+#ifdef HAVE_ZSTD
+	ZSTD_DCtx *dctx;
+	std::vector<uint8_t> zbuf;
+	ZSTD_inBuffer in;
+#endif
+	bool zstd;
+	std::vector<uint8_t> buf;
+	size_t pos, len;
+	bool eof;
+	struct ctrace_state st;
+	uint64_t order;
+};
+
+/* Refills the decoded buffer, keeping the unread bytes */
+static void refill(struct ctrace_reader *rd)
+{
+	memmove(rd->buf.data(), rd->buf.data() + rd->pos, rd->len - rd->pos);
+	rd->len -= rd->pos;
+	rd->pos = 0;
+
+	while (!rd->eof && rd->len < rd->buf.size()) {
+#ifdef HAVE_ZSTD
+		if (rd->zstd) {
+			ZSTD_outBuffer out = { rd->buf.data() + rd->len, rd->buf.size() - rd->len, 0 };
+			size_t ret;
+
+			if (rd->in.pos == rd->in.size) {
+				rd->in.size = fread(rd->zbuf.data(), 1, rd->zbuf.size(), rd->f);
+				rd->in.pos = 0;
+				if (rd->in.size == 0) {
+					rd->eof = true;
+					break;
+				}
+			}
+			ret = ZSTD_decompressStream(rd->dctx, &out, &rd->in);
+			if (ZSTD_isError(ret)) {
+				fprintf(stderr, "ctrace: %s\n", ZSTD_getErrorName(ret));
+				rd->eof = true;
+			}
+			rd->len += out.pos;
+			continue;
+		}
+#endif
+		size_t n = fread(rd->buf.data() + rd->len, 1, rd->buf.size() - rd->len, rd->f);
+
+		if (n == 0)
+			rd->eof = true;
+		rd->len += n;
+	}
+}
+
+struct ctrace_reader *ctrace_reader_open(const char *filename)
+{
+	static const uint8_t zstd_magic[4] = { 0x28, 0xb5, 0x2f, 0xfd };
+	struct ctrace_reader *rd;
+	uint8_t magic[4];
+
+	rd = new ctrace_reader();
+	rd->f = fopen(filename, "rb");
+	if (!rd->f) {
+		perror(filename);
+		delete rd;
+		return NULL;
+	}
+
+	if (fread(magic, 1, 4, rd->f) == 4 && !memcmp(magic, zstd_magic, 4)) {
+#ifdef HAVE_ZSTD
+		rd->zstd = true;
+		rd->dctx = ZSTD_createDCtx();
+		rd->zbuf.resize(ZSTD_DStreamInSize());
+		rd->in = { rd->zbuf.data(), 0, 0 };
+#else
+		fprintf(stderr, "ctrace: %s is zstd compressed, rebuild with zstd support\n", filename);
+		ctrace_reader_close(rd);
+		return NULL;
+#endif
+	}
+	rewind(rd->f);
+
+	rd->buf.resize(BLOCK_SIZE);
+	refill(rd);
+	if (rd->len < CTRACE_MAGIC_LEN || memcmp(rd->buf.data(), CTRACE_MAGIC, CTRACE_MAGIC_LEN)) {
+		fprintf(stderr, "ctrace: %s is not a commit trace\n", filename);
+		ctrace_reader_close(rd);
+		return NULL;
+	}
+	rd->pos = CTRACE_MAGIC_LEN;
+	return rd;
+}
+
+static inline bool get_varint(struct ctrace_reader *rd, uint32_t *v)
+{
+	uint32_t val = 0;
+
+	for (int shift = 0; shift < 35; shift += 7) {
+		uint8_t b;
+
+		if (rd->pos == rd->len)
+			return false;
+		b = rd->buf[rd->pos++];
+		val |= (uint32_t)(b & 0x7f) << shift;
+		if (!(b & 0x80)) {
+			*v = val;
+			return true;
+		}
+	}
+	return false;
+}
+
+static inline bool get_byte(struct ctrace_reader *rd, uint8_t *v)
+{
+	if (rd->pos == rd->len)
+		return false;
+	*v = rd->buf[rd->pos++];
+	return true;
+}
+
+int ctrace_next(struct ctrace_reader *rd, struct ctrace_rec *r)
+{
+	uint8_t flags;
+	uint32_t v;
+	unsigned idx;
+
+	if (rd->len - rd->pos < MAX_RECORD)
+		refill(rd);
+	if (rd->pos == rd->len)
+		return 0;
+
+	memset(r, 0, sizeof(*r));
+	r->order = rd->order++;
+	flags = rd->buf[rd->pos++];
+
+	r->pc = rd->st.pc + 4;
+	if (flags & CT_PC) {
+		if (!get_varint(rd, &v))
+			goto truncated;
+		r->pc += unzigzag(v);
+	}
+	rd->st.pc = r->pc;
+
+	idx = icache_index(r->pc);
+	if (flags & CT_INSN) {
+		if (rd->len - rd->pos < 4)
+			goto truncated;
+		memcpy(&r->insn, rd->buf.data() + rd->pos, 4);
+		rd->pos += 4;
+		rd->st.icache[idx] = r->insn;
+		rd->st.icache_valid[idx] = true;
+	} else {
+		r->insn = rd->st.icache[idx];
+	}
+
+	if (flags & CT_RD) {
+		if (!get_byte(rd, &r->rd) || !get_varint(rd, &r->rd_wdata))
+			goto truncated;
+	}
+	if (flags & CT_LOAD) {
+		if (!get_varint(rd, &r->mem_addr) || !get_byte(rd, &r->mem_rmask) ||
+		    !get_varint(rd, &r->mem_rdata))
+			goto truncated;
+	}
+	if (flags & CT_STORE) {
+		if (!get_varint(rd, &r->mem_addr) || !get_byte(rd, &r->mem_wmask) ||
+		    !get_varint(rd, &r->mem_wdata))
+			goto truncated;
+	}
+	r->trap = flags & CT_TRAP;
+	return 1;
+
+truncated:
+	fprintf(stderr, "ctrace: truncated record %llu\n", (unsigned long long)r->order);
+	return -1;
+}
+
+void ctrace_reader_close(struct ctrace_reader *rd)
+{
+	fclose(rd->f);
+#ifdef HAVE_ZSTD
+	if (rd->dctx)
+		ZSTD_freeDCtx(rd->dctx);
+#endif
+	delete rd;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+/*
+ * Compact binary commit trace (see ctrace.cpp)
+ *
+ * File layout: an 8 byte magic "CVCTRC01" followed by one record per retired
+ * instruction. The whole file may be a zstd frame instead, the decoder
+ * detects it.
+ *
+ * Record: a flags byte, then the fields selected by the flags in this order:
+ *   CT_PC     zigzag varint of pc - (previous pc + 4), omitted when sequential
+ *   CT_INSN   instruction word, 4 bytes little-endian. Omitted when it equals
+ *             the word last seen at the same pc (a small direct mapped cache
+ *             kept identically by writer and reader)
+ *   CT_RD     rd number (1 byte) and varint of the written value
+ *   CT_LOAD   varint address, mask byte, varint loaded data
+ *   CT_STORE  varint address, mask byte, varint stored data
+ * CT_TRAP has no payload. Varints are unsigned LEB128.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define CTRACE_MAGIC "CVCTRC01"
+#define CTRACE_MAGIC_LEN 8
+
+enum {
+	CT_PC = 0x01,
+	CT_INSN = 0x02,
+	CT_RD = 0x04,
+	CT_LOAD = 0x08,
+	CT_STORE = 0x10,
+	CT_TRAP = 0x20,
+};
+
+/* Instruction cache entries, must be a power of two */
+#define CTRACE_ICACHE 4096
+
+struct ctrace_rec {
+	uint64_t order;
+	uint32_t pc;
+	uint32_t insn;
+	bool trap;
+	uint8_t rd;		/* 0 when no register is written */
+	uint32_t rd_wdata;
+	uint32_t mem_addr;
+	uint8_t mem_rmask;
+	uint8_t mem_wmask;
+	uint32_t mem_rdata;
+	uint32_t mem_wdata;
+};
+
+/* Writer, buffers records and hands full blocks to a background thread */
+struct ctrace_writer;
+struct ctrace_writer *ctrace_open(const char *filename, bool zstd);
+void ctrace_put(struct ctrace_writer *w, const struct ctrace_rec *r);
+/* Flushes, stops the writer thread and closes the file, returns -1 on write errors */
+int ctrace_close(struct ctrace_writer *w);
+
+/* Reader */
+struct ctrace_reader;
+struct ctrace_reader *ctrace_reader_open(const char *filename);
+/* Returns 1 with the next record, 0 at the end of the trace or -1 on errors */
+int ctrace_next(struct ctrace_reader *rd, struct ctrace_rec *r);
+void ctrace_reader_close(struct ctrace_reader *rd);
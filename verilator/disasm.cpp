@@ -0,0 +1,301 @@
+/*
+ * RV32IMC (plus Zba and Zbb) disassembler for the host tools. Prints the
+ * base instructions, mret and wfi as objdump does with -M no-aliases, with ABI
+ * register names.
+ * Compressed instructions are printed as the instruction they expand to.
+ */
+
+#include <stdio.h>
+
+#include "disasm.h"
+
+static const char *const regs[32] = {
+	"zero", "ra", "sp", "gp", "tp", "t0", "t1", "t2",
+	"s0", "s1", "a0", "a1", "a2", "a3", "a4", "a5",
+	"a6", "a7", "s2", "s3", "s4", "s5", "s6", "s7",
+	"s8", "s9", "s10", "s11", "t3", "t4", "t5", "t6",
+};
+
+const char *disasm_reg(unsigned r)
+{
+	return regs[r & 31];
+}
+
+static int32_t imm_i(uint32_t insn)
+{
+	return (int32_t)insn >> 20;
+}
+
+static int32_t imm_s(uint32_t insn)
+{
+	return ((int32_t)insn >> 25 << 5) | ((insn >> 7) & 0x1f);
+}
+
+static int32_t imm_b(uint32_t insn)
+{
+	return ((int32_t)insn >> 31 << 12) | ((insn & 0x80) << 4) |
+	       ((insn >> 20) & 0x7e0) | ((insn >> 7) & 0x1e);
+}
+
+static int32_t imm_j(uint32_t insn)
+{
+	return ((int32_t)insn >> 31 << 20) | (insn & 0xff000) |
+	       ((insn >> 9) & 0x800) | ((insn >> 20) & 0x7fe);
+}
+
+static uint32_t enc_r(unsigned funct7, unsigned rs2, unsigned rs1, unsigned funct3, unsigned rd)
+{
+	return funct7 << 25 | rs2 << 20 | rs1 << 15 | funct3 << 12 | rd << 7 | 0x33;
+}
+
+static uint32_t enc_i(int32_t imm, unsigned rs1, unsigned funct3, unsigned rd, unsigned opcode)
+{
+	return (uint32_t)imm << 20 | rs1 << 15 | funct3 << 12 | rd << 7 | opcode;
+}
+
+static uint32_t enc_sw(int32_t imm, unsigned rs2, unsigned rs1)
+{
+	return (imm >> 5) << 25 | rs2 << 20 | rs1 << 15 | 2 << 12 | (imm & 31) << 7 | 0x23;
+}
+
+static uint32_t enc_b(int32_t off, unsigned rs1, unsigned funct3)
+{
+	return ((off >> 12) & 1) << 31 | ((off >> 5) & 0x3f) << 25 | rs1 << 15 | funct3 << 12 |
+	       ((off >> 1) & 0xf) << 8 | ((off >> 11) & 1) << 7 | 0x63;
+}
+
+static uint32_t enc_j(int32_t off, unsigned rd)
+{
+	return ((off >> 20) & 1) << 31 | ((off >> 1) & 0x3ff) << 21 | ((off >> 11) & 1) << 20 |
+	       ((off >> 12) & 0xff) << 12 | rd << 7 | 0x6f;
+}
+
+#define BIT(x, b) (((x) >> (b)) & 1)
+
+uint32_t rvc_expand(uint16_t c)
+{
+	unsigned rd = (c >> 7) & 31, rs2 = (c >> 2) & 31;
+	unsigned rdp = 8 + ((c >> 2) & 7), rs1p = 8 + ((c >> 7) & 7);
+	int32_t imm6 = (BIT(c, 12) ? ~31 : 0) | rs2;
+	int32_t joff = (BIT(c, 12) ? ~0x7ff : 0) | BIT(c, 8) << 10 | ((c >> 9) & 3) << 8 | BIT(c, 6) << 7 |
+		       BIT(c, 7) << 6 | BIT(c, 2) << 5 | BIT(c, 11) << 4 | ((c >> 3) & 7) << 1;
+	int32_t boff = (BIT(c, 12) ? ~0xff : 0) | ((c >> 5) & 3) << 6 | BIT(c, 2) << 5 |
+		       ((c >> 10) & 3) << 3 | ((c >> 3) & 3) << 1;
+	int32_t lw = BIT(c, 5) << 6 | ((c >> 10) & 7) << 3 | BIT(c, 6) << 2;
+	int32_t imm;
+
+	/* Quadrant and funct3 as two octal digits */
+	switch ((c & 3) << 3 | c >> 13) {
+	case 000: /* c.addi4spn */
+		imm = ((c >> 7) & 15) << 6 | ((c >> 11) & 3) << 4 | BIT(c, 5) << 3 | BIT(c, 6) << 2;
+		return imm ? enc_i(imm, 2, 0, rdp, 0x13) : 0;
+	case 002: /* c.lw */
+		return enc_i(lw, rs1p, 2, rdp, 0x03);
+	case 006: /* c.sw */
+		return enc_sw(lw, rdp, rs1p);
+	case 010: /* c.addi */
+		return enc_i(imm6, rd, 0, rd, 0x13);
+	case 011: /* c.jal */
+		return enc_j(joff, 1);
+	case 012: /* c.li */
+		return enc_i(imm6, 0, 0, rd, 0x13);
+	case 013: /* c.addi16sp, c.lui */
+		if (!BIT(c, 12) && !rs2)
+			return 0;
+		if (rd == 2) {
+			imm = (BIT(c, 12) ? ~0x1ff : 0) | ((c >> 3) & 3) << 7 | BIT(c, 5) << 6 | BIT(c, 2) << 5 |
+			      BIT(c, 6) << 4;
+			return enc_i(imm, 2, 0, 2, 0x13);
+		}
+		return (uint32_t)imm6 << 12 | rd << 7 | 0x37;
+	case 014:
+		switch ((c >> 10) & 3) {
+		case 0: /* c.srli */
+			return BIT(c, 12) ? 0 : enc_i(rs2, rs1p, 5, rs1p, 0x13);
+		case 1: /* c.srai */
+			return BIT(c, 12) ? 0 : enc_i(0x400 | rs2, rs1p, 5, rs1p, 0x13);
+		case 2: /* c.andi */
+			return enc_i(imm6, rs1p, 7, rs1p, 0x13);
+		}
+		if (BIT(c, 12))
+			return 0;
+		switch ((c >> 5) & 3) {
+		case 0: /* c.sub */
+			return enc_r(0x20, rdp, rs1p, 0, rs1p);
+		case 1: /* c.xor */
+			return enc_r(0, rdp, rs1p, 4, rs1p);
+		case 2: /* c.or */
+			return enc_r(0, rdp, rs1p, 6, rs1p);
+		}
+		return enc_r(0, rdp, rs1p, 7, rs1p); /* c.and */
+	case 015: /* c.j */
+		return enc_j(joff, 0);
+	case 016: /* c.beqz */
+		return enc_b(boff, rs1p, 0);
+	case 017: /* c.bnez */
+		return enc_b(boff, rs1p, 1);
+	case 020: /* c.slli */
+		return BIT(c, 12) ? 0 : enc_i(rs2, rd, 1, rd, 0x13);
+	case 022: /* c.lwsp */
+		imm = ((c >> 2) & 3) << 6 | BIT(c, 12) << 5 | ((c >> 4) & 7) << 2;
+		return rd ? enc_i(imm, 2, 2, rd, 0x03) : 0;
+	case 024:
+		if (!BIT(c, 12)) {
+			if (rs2) /* c.mv */
+				return enc_r(0, rs2, 0, 0, rd);
+			return rd ? enc_i(0, rd, 0, 0, 0x67) : 0; /* c.jr */
+		}
+		if (rs2) /* c.add */
+			return enc_r(0, rs2, rd, 0, rd);
+		return rd ? enc_i(0, rd, 0, 1, 0x67) : 0x00100073; /* c.jalr, c.ebreak */
+	case 026: /* c.swsp */
+		imm = ((c >> 7) & 3) << 6 | ((c >> 9) & 15) << 2;
+		return enc_sw(imm, rs2, 2);
+	}
+	return 0;
+}
+
+#undef BIT
+
+/* Trap and counter CSR names as printed by objdump, the number for the others */
+static const char *csr_name(uint32_t csr, char *buf, size_t len)
+{
+	static const char *const base[3] = { "cycle", "time", "instret" };
+	static const char *const trap[8] = { "mstatus", NULL, NULL, NULL, "mie", "mtvec", NULL, NULL };
+	static const char *const trap_handling[5] = { "mscratch", "mepc", "mcause", "mtval", "mip" };
+	unsigned i = csr & 0x1f;
+	const char *prefix = (csr & 0xf00) == 0xb00 ? "m" : "";
+	const char *suffix = csr & 0x80 ? "h" : "";
+
+	if (csr >= 0x300 && csr < 0x308 && trap[csr - 0x300])
+		return trap[csr - 0x300];
+	if (csr >= 0x340 && csr < 0x345)
+		return trap_handling[csr - 0x340];
+	if (csr == 0x320)
+		return "mcountinhibit";
+	if (((csr & 0xf60) != 0xb00 && (csr & 0xf60) != 0xc00) || (*prefix && i == 1)) {
+		snprintf(buf, len, "0x%x", csr);
+		return buf;
+	}
+	if (i < 3)
+		snprintf(buf, len, "%s%s%s", prefix, base[i], suffix);
+	else
+		snprintf(buf, len, "%shpmcounter%u%s", prefix, i, suffix);
+	return buf;
+}
+
+int disasm(uint32_t pc, uint32_t insn, char *buf, size_t len)
+{
+	static const char *const branch[8] = { "beq", "bne", NULL, NULL, "blt", "bge", "bltu", "bgeu" };
+	static const char *const load[8] = { "lb", "lh", "lw", NULL, "lbu", "lhu", NULL, NULL };
+	static const char *const store[8] = { "sb", "sh", "sw", NULL, NULL, NULL, NULL, NULL };
+	static const char *const alui[8] = { "addi", "slli", "slti", "sltiu", "xori", "srli", "ori", "andi" };
+	static const char *const alu[8] = { "add", "sll", "slt", "sltu", "xor", "srl", "or", "and" };
+	static const char *const muldiv[8] = { "mul", "mulh", "mulhsu", "mulhu", "div", "divu", "rem", "remu" };
+	static const char *const negate[8] = { "sub", NULL, NULL, NULL, "xnor", "sra", "orn", "andn" };
+	static const char *const shadd[8] = { NULL, NULL, "sh1add", NULL, "sh2add", NULL, "sh3add", NULL };
+	static const char *const minmax[8] = { NULL, NULL, NULL, NULL, "min", "minu", "max", "maxu" };
+	static const char *const rotate[8] = { NULL, "rol", NULL, NULL, NULL, "ror", NULL, NULL };
+	static const char *const unary[8] = { "clz", "ctz", "cpop", NULL, "sext.b", "sext.h", NULL, NULL };
+	static const char *const csr[8] = { NULL, "csrrw", "csrrs", "csrrc", NULL, "csrrwi", "csrrsi", "csrrci" };
+	const char *rd, *rs1, *rs2;
+	unsigned funct3, funct7;
+	const char *op;
+	char name[24];
+
+	if ((insn & 3) != 3) {
+		uint16_t half = insn & 0xffff;
+
+		if (!(insn = rvc_expand(half)))
+			return snprintf(buf, len, ".short 0x%04x", half);
+	}
+	rd = regs[(insn >> 7) & 31];
+	rs1 = regs[(insn >> 15) & 31];
+	rs2 = regs[(insn >> 20) & 31];
+	funct3 = (insn >> 12) & 7;
+	funct7 = insn >> 25;
+
+	switch (insn & 0x7f) {
+	case 0x37:
+		return snprintf(buf, len, "lui %s,0x%x", rd, insn >> 12);
+	case 0x17:
+		return snprintf(buf, len, "auipc %s,0x%x", rd, insn >> 12);
+	case 0x6f:
+		return snprintf(buf, len, "jal %s,%x", rd, pc + imm_j(insn));
+	case 0x67:
+		if (funct3)
+			break;
+		return snprintf(buf, len, "jalr %s,%d(%s)", rd, imm_i(insn), rs1);
+	case 0x63:
+		if (!(op = branch[funct3]))
+			break;
+		return snprintf(buf, len, "%s %s,%s,%x", op, rs1, rs2, pc + imm_b(insn));
+	case 0x03:
+		if (!(op = load[funct3]))
+			break;
+		return snprintf(buf, len, "%s %s,%d(%s)", op, rd, imm_i(insn), rs1);
+	case 0x23:
+		if (!(op = store[funct3]))
+			break;
+		return snprintf(buf, len, "%s %s,%d(%s)", op, rs2, imm_s(insn), rs1);
+	case 0x13:
+		op = alui[funct3];
+		if (funct3 == 1 && funct7 == 0x30) {
+			if (((insn >> 20) & 31) > 5 || !(op = unary[(insn >> 20) & 31]))
+				break;
+			return snprintf(buf, len, "%s %s,%s", op, rd, rs1);
+		}
+		if (funct3 == 5 && (insn >> 20) == 0x287)
+			return snprintf(buf, len, "orc.b %s,%s", rd, rs1);
+		if (funct3 == 5 && (insn >> 20) == 0x698)
+			return snprintf(buf, len, "rev8 %s,%s", rd, rs1);
+		if (funct3 == 1 || funct3 == 5) {
+			if (funct7 == 0x20 && funct3 == 5)
+				op = "srai";
+			else if (funct7 == 0x30 && funct3 == 5)
+				op = "rori";
+			else if (funct7)
+				break;
+			return snprintf(buf, len, "%s %s,%s,0x%x", op, rd, rs1, (insn >> 20) & 31);
+		}
+		return snprintf(buf, len, "%s %s,%s,%d", op, rd, rs1, imm_i(insn));
+	case 0x33:
+		op = alu[funct3];
+		if (funct7 == 0x04 && funct3 == 4 && !((insn >> 20) & 31))
+			return snprintf(buf, len, "zext.h %s,%s", rd, rs1);
+		if (funct7 == 0x20)
+			op = negate[funct3];
+		else if (funct7 == 1)
+			op = muldiv[funct3];
+		else if (funct7 == 0x10)
+			op = shadd[funct3];
+		else if (funct7 == 0x05)
+			op = minmax[funct3];
+		else if (funct7 == 0x30)
+			op = rotate[funct3];
+		else if (funct7)
+			break;
+		if (!op)
+			break;
+		return snprintf(buf, len, "%s %s,%s,%s", op, rd, rs1, rs2);
+	case 0x0f:
+		return snprintf(buf, len, funct3 == 1 ? "fence.i" : "fence");
+	case 0x73:
+		if (insn == 0x00000073)
+			return snprintf(buf, len, "ecall");
+		if (insn == 0x00100073)
+			return snprintf(buf, len, "ebreak");
+		if (insn == 0x30200073)
+			return snprintf(buf, len, "mret");
+		if (insn == 0x10500073)
+			return snprintf(buf, len, "wfi");
+		if (!(op = csr[funct3]))
+			break;
+		if (funct3 & 4)
+			return snprintf(buf, len, "%s %s,%s,%u", op, rd, csr_name(insn >> 20, name, sizeof(name)),
+					(insn >> 15) & 31);
+		return snprintf(buf, len, "%s %s,%s,%s", op, rd, csr_name(insn >> 20, name, sizeof(name)), rs1);
+	}
+
+	return snprintf(buf, len, ".word 0x%08x", insn);
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+/*
+ * RV32IMC (plus Zba and Zbb) disassembler used by the host tools (see disasm.cpp)
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Formats insn located at pc into buf, returns the snprintf() length */
+int disasm(uint32_t pc, uint32_t insn, char *buf, size_t len);
+/* ABI name of register r */
+const char *disasm_reg(unsigned r);
+/* The 32 bit instruction a compressed one expands to, 0 (illegal) for the reserved ones */
+uint32_t rvc_expand(uint16_t insn);
@@ -0,0 +1,289 @@
+/*
+ * Host side of the simulated UART.
+ *
+ * A dedicated thread moves bytes between the host and two single-producer,
+ * single-consumer lock-free rings. The simulation loop only touches the rings
+ * (hostio_putc/hostio_getc), so printing or polling for input never costs a
+ * syscall in the tick loop and scripted input can be fed at full speed.
+ *
+ * Back ends, selected independently for input and output:
+ *   -        stdin/stdout (stdin in raw mode when it is a terminal)
+ *   none     no input / discard output
+ *   pty      a pseudo terminal, its name is printed at startup
+ *   PATH     a file or a named pipe
+ */
+
+#include <atomic>
+#include <thread>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "hostio.h"
+
+/* Should we exit simulation on ctrl-c or pass it through? */
+#define EXIT_ON_CTRL_C
+
+/* Ring size in bytes, must be a power of two */
+#define RING_SIZE 65536
+
+/* How long the I/O thread sleeps when there is nothing to do (ms) */
+#define IDLE_MS 1
+
+struct ring {
+	alignas(64) std::atomic<size_t> head; /* written by the producer */
+	alignas(64) std::atomic<size_t> tail; /* written by the consumer */
+	alignas(64) unsigned char buf[RING_SIZE];
+};
+
+static struct ring tx_ring, rx_ring;
+
+static int in_fd = -1, out_fd = -1, pty_fd = -1;
+static bool in_is_fifo;
+static std::atomic<bool> stopping;
+static std::thread io_thread;
+
+static struct termios oldt;
+static bool raw_mode;
+
+/* Producer side, false if the ring is full */
+static inline bool ring_push(struct ring *r, unsigned char c)
+{
+	size_t head = r->head.load(std::memory_order_relaxed);
+
+	if (head - r->tail.load(std::memory_order_acquire) == RING_SIZE)
+		return false;
+
+	r->buf[head & (RING_SIZE - 1)] = c;
+	r->head.store(head + 1, std::memory_order_release);
+	return true;
+}
+
+/* Consumer side, false if the ring is empty */
+static inline bool ring_pop(struct ring *r, unsigned char *c)
+{
+	size_t tail = r->tail.load(std::memory_order_relaxed);
+
+	if (r->head.load(std::memory_order_acquire) == tail)
+		return false;
+
+	*c = r->buf[tail & (RING_SIZE - 1)];
+	r->tail.store(tail + 1, std::memory_order_release);
+	return true;
+}
+
+void hostio_putc(unsigned char c)
+{
+	/* Only waits if the host side can not keep up (eg. nobody reads the pty) */
+	while (!ring_push(&tx_ring, c))
+		std::this_thread::yield();
+}
+
+bool hostio_getc(unsigned char *c)
+{
+	return ring_pop(&rx_ring, c);
+}
+
+/* Writes everything queued in the TX ring, in contiguous chunks */
+static void flush_tx(void)
+{
+	size_t tail = tx_ring.tail.load(std::memory_order_relaxed);
+	size_t head = tx_ring.head.load(std::memory_order_acquire);
+
+	while (tail != head) {
+		size_t off = tail & (RING_SIZE - 1);
+		size_t len = head - tail;
+		ssize_t ret;
+
+		if (len > RING_SIZE - off)
+			len = RING_SIZE - off;
+		ret = len;
+
+		if (out_fd >= 0) {
+			ret = write(out_fd, tx_ring.buf + off, len);
+			if (ret < 0) {
+				if (errno == EINTR || errno == EAGAIN || errno == EIO)
+					break; /* retry later, EIO is a pty without reader */
+				perror("hostio: write");
+				out_fd = -1;
+				ret = len;
+			}
+		}
+
+		tail += ret;
+		tx_ring.tail.store(tail, std::memory_order_release);
+	}
+}
+
+/* Reads whatever input is available into the RX ring, waits up to IDLE_MS */
+static void fill_rx(void)
+{
+	size_t head = rx_ring.head.load(std::memory_order_relaxed);
+	size_t tail = rx_ring.tail.load(std::memory_order_acquire);
+	size_t off = head & (RING_SIZE - 1);
+	size_t len = RING_SIZE - (head - tail);
+	struct pollfd pfd = { in_fd, POLLIN, 0 };
+	ssize_t ret;
+
+	if (in_fd < 0 || len == 0 || poll(&pfd, 1, IDLE_MS) <= 0) {
+		if (in_fd < 0 || len == 0)
+			usleep(IDLE_MS * 1000);
+		return;
+	}
+
+	if (len > RING_SIZE - off)
+		len = RING_SIZE - off;
+
+	ret = read(in_fd, rx_ring.buf + off, len);
+	if (ret > 0) {
+		rx_ring.head.store(head + ret, std::memory_order_release);
+	} else if (ret == 0 && !in_is_fifo) {
+		/* End of file, stop reading */
+		in_fd = -1;
+	} else if (ret < 0 && errno == EIO) {
+		/* pty without a reader attached, try again later */
+		usleep(IDLE_MS * 1000);
+	} else if (ret < 0 && errno != EINTR && errno != EAGAIN) {
+		perror("hostio: read");
+		in_fd = -1;
+	}
+}
+
+static void hostio_loop(void)
+{
+	while (!stopping.load(std::memory_order_acquire)) {
+		flush_tx();
+		fill_rx();
+	}
+	flush_tx();
+}
+
+static void disable_raw_mode(void)
+{
+	if (raw_mode)
+		tcsetattr(STDIN_FILENO, TCSANOW, &oldt);
+	raw_mode = false;
+}
+
+static void enable_raw_mode(void)
+{
+	struct termios newt;
+
+	if (!isatty(STDIN_FILENO))
+		return;
+
+	tcgetattr(STDIN_FILENO, &oldt);
+	newt = oldt;
+	cfmakeraw(&newt);
+#ifdef EXIT_ON_CTRL_C
+	newt.c_lflag |= ISIG;
+#endif
+	tcsetattr(STDIN_FILENO, TCSANOW, &newt);
+	raw_mode = true;
+	atexit(disable_raw_mode);
+}
+
+static int open_pty(void)
+{
+	struct termios t;
+
+	if (pty_fd >= 0)
+		return pty_fd;
+
+	pty_fd = posix_openpt(O_RDWR | O_NOCTTY);
+	if (pty_fd < 0 || grantpt(pty_fd) || unlockpt(pty_fd)) {
+		perror("hostio: pty");
+		return -1;
+	}
+
+	tcgetattr(pty_fd, &t);
+	cfmakeraw(&t);
+	tcsetattr(pty_fd, TCSANOW, &t);
+
+	fprintf(stderr, "UART0 is connected to %s\n", ptsname(pty_fd));
+	return pty_fd;
+}
+
+static bool is_fifo(const char *path)
+{
+	struct stat st;
+
+	return stat(path, &st) == 0 && S_ISFIFO(st.st_mode);
+}
+
+static int open_backend(const char *spec, bool input)
+{
+	int fd;
+
+	if (!spec || !strcmp(spec, "none"))
+		return -1;
+
+	if (!strcmp(spec, "-")) {
+		if (!input)
+			return STDOUT_FILENO;
+		enable_raw_mode();
+		return STDIN_FILENO;
+	}
+
+	if (!strcmp(spec, "pty"))
+		return open_pty();
+
+	/*
+	 * Named pipes are opened read-write so open() does not block waiting
+	 * for the other side and readers never see EOF between writers.
+	 */
+	if (is_fifo(spec)) {
+		if (input)
+			in_is_fifo = true;
+		fd = open(spec, O_RDWR);
+	} else if (input) {
+		fd = open(spec, O_RDONLY);
+	} else {
+		fd = open(spec, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	}
+
+	if (fd < 0)
+		perror(spec);
+	return fd;
+}
+
+int hostio_start(const char *in, const char *out)
+{
+	stopping.store(false, std::memory_order_relaxed);
+	in_is_fifo = false;
+
+	in_fd = open_backend(in, true);
+	if (in && strcmp(in, "none") && in_fd < 0)
+		return -1;
+
+	out_fd = open_backend(out, false);
+	if (out && strcmp(out, "none") && out_fd < 0)
+		return -1;
+
+	io_thread = std::thread(hostio_loop);
+	return 0;
+}
+
+void hostio_stop(void)
+{
+	if (!io_thread.joinable())
+		return;
+
+	stopping.store(true, std::memory_order_release);
+	io_thread.join();
+	disable_raw_mode();
+
+	/* Can be started again with other back ends (see snapshot_fork()) */
+	if (in_fd > STDERR_FILENO && in_fd != pty_fd)
+		close(in_fd);
+	if (out_fd > STDERR_FILENO && out_fd != pty_fd)
+		close(out_fd);
+	in_fd = out_fd = -1;
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+/*
+ * Host side of the simulated UART (see hostio.cpp)
+ */
+
+int hostio_start(const char *in, const char *out);
+void hostio_stop(void);
+void hostio_putc(unsigned char c);
+bool hostio_getc(unsigned char *c);
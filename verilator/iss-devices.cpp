@@ -0,0 +1,361 @@
+/*
+ * Peripheral models for the instruction set simulator, following the
+ * registers decoded in MemoryIOManager.scala and Syscon.scala. UART0 talks to
+ * the host through hostio.cpp like the Verilator harness does. DMA transfers
+ * complete as soon as they are started, the UART RX ones when their bytes
+ * have arrived.
+ */
+
+#include <stdio.h>
+
+#include "hostio.h"
+#include "iss.h"
+
+/* Timer0 counts milliseconds of simulated time */
+static uint32_t timer_now(struct iss *s, struct iss_devices *dev)
+{
+	return dev->timer_value + (iss_cycles(s) - dev->timer_base) / (dev->clock_freq / 1000);
+}
+
+/* CLINT mtime ticks every cycle, it is the time counter of the ISS */
+static uint64_t mtime(struct iss *s)
+{
+	return iss_cycles(s) + s->counter_offset[1];
+}
+
+static uint32_t clint_read(struct iss *s, struct iss_devices *dev, uint32_t reg)
+{
+	switch (reg) {
+	case 0x0000: return dev->msip;
+	case 0x4000: return dev->mtimecmp;
+	case 0x4004: return dev->mtimecmp >> 32;
+	case 0xbff8: return mtime(s);
+	case 0xbffc: return mtime(s) >> 32;
+	}
+	return 0;
+}
+
+static void clint_write(struct iss *s, struct iss_devices *dev, uint32_t reg, uint32_t data)
+{
+	uint64_t t = mtime(s);
+
+	switch (reg) {
+	case 0x0000:
+		dev->msip = data & 1;
+		break;
+	case 0x4000:
+		dev->mtimecmp = (dev->mtimecmp & ~0xffffffffULL) | data;
+		break;
+	case 0x4004:
+		dev->mtimecmp = (dev->mtimecmp & 0xffffffffULL) | (uint64_t)data << 32;
+		break;
+	case 0xbff8:
+		s->counter_offset[1] += (uint32_t)data - (uint32_t)t;
+		break;
+	case 0xbffc:
+		s->counter_offset[1] += ((uint64_t)data - (t >> 32)) << 32;
+		break;
+	}
+}
+
+/* MMIO bus devices reported by Syscon: id, base and size (MemoryIOManager.devices) */
+static const uint32_t bus_devices[][3] = {
+	{ 1, ISS_SYSCON, 0x1000 },
+	{ 2, ISS_CLINT, 0x10000 },
+	{ 3, ISS_UART0, 0x1000 },
+	{ 4, ISS_GPIO0, 0x1000 },
+	{ 5, ISS_TIMER0, 0x1000 },
+	{ 6, ISS_DMA, 0x1000 },
+	{ 7, 0x30005000, 0x1000 },
+};
+#define BUS_DEVICES (sizeof(bus_devices) / sizeof(bus_devices[0]))
+
+static uint32_t syscon_read(struct iss *s, struct iss_devices *dev, uint32_t reg)
+{
+	(void)s;
+
+	if (reg >= 0x100 && (reg - 0x100) / 0x10 < BUS_DEVICES && (reg & 0xf) < 0xc)
+		return bus_devices[(reg - 0x100) / 0x10][(reg & 0xf) / 4];
+
+	switch (reg) {
+	case 0x00: return 0xbaadcafe;
+	case 0x08: return dev->clock_freq;
+	case 0x10: return 1;		/* Has UART0 */
+	case 0x18: return 1;		/* Has GPIO0 */
+	case 0x20: return 0;		/* Has PWM0 */
+	case 0x24: return 1;		/* Has Timer0 */
+	case 0x28: return dev->num_gpio;
+	case 0x2c: return ROM_BASE;	/* Boot address */
+	case 0x30: return ISS_ROM_WORDS * 4;
+	case 0x34: return ISS_RAM_WORDS * 4;
+	case 0x40: return dev->exit_status;
+	case 0x44: return dev->clock_freq;	/* mtime ticks every cycle */
+	case 0x50: return BUS_DEVICES;
+	}
+	return 0;
+}
+
+static bool uart_rx_ready(struct iss_devices *dev)
+{
+	unsigned char c;
+
+	if (dev->uart_rx < 0 && hostio_getc(&c))
+		dev->uart_rx = c;
+	return dev->uart_rx >= 0;
+}
+
+/* DMA element of 1, 2 or 4 bytes in RAM, placed in the byte lanes like the controller does */
+static uint32_t dma_load(struct iss *s, uint32_t addr, int size)
+{
+	uint32_t word = s->ram[(addr >> 2) & (ISS_RAM_WORDS - 1)] >> (addr & 3) * 8;
+
+	return size == 4 ? word : word & ((1U << (size * 8)) - 1);
+}
+
+static void dma_store(struct iss *s, uint32_t addr, uint32_t data, int size)
+{
+	uint32_t *word = &s->ram[(addr >> 2) & (ISS_RAM_WORDS - 1)];
+	uint32_t shift = (addr & (4 - size)) * 8;
+	uint32_t mask = size == 4 ? ~0U : ((1U << (size * 8)) - 1) << shift;
+
+	*word = (*word & ~mask) | ((data << shift) & mask);
+}
+
+/* Moves the elements of a busy channel, UART RX ones while bytes are waiting */
+static void dma_run(struct iss *s, struct iss_devices *dev, struct iss_dma_channel *ch)
+{
+	static const int sizes[4] = { 1, 2, 4, 4 };
+	int size = sizes[(ch->ctrl >> 2) & 3];
+	uint32_t data;
+
+	while (ch->busy && ch->count) {
+		if ((ch->ctrl & 3) == 2) {
+			if (!uart_rx_ready(dev))
+				return;
+			data = dev->uart_rx;
+			dev->uart_rx = -1;
+			dev->uart_rx_bytes++;
+		} else {
+			data = dma_load(s, ch->src, size);
+		}
+		if ((ch->ctrl & 3) == 1) {
+			hostio_putc(data & 0xff);
+			dev->uart_tx_bytes++;
+		} else {
+			dma_store(s, ch->dst, data, size);
+		}
+		ch->src += ch->src_stride;
+		ch->dst += ch->dst_stride;
+		ch->count--;
+	}
+	if (ch->busy) {
+		ch->busy = false;
+		ch->done = true;
+	}
+}
+
+static void dma_poll(struct iss *s, struct iss_devices *dev)
+{
+	for (int i = 0; i < ISS_DMA_CHANNELS; i++)
+		dma_run(s, dev, &dev->dma[i]);
+}
+
+static uint32_t dma_read(struct iss *s, struct iss_devices *dev, uint32_t reg)
+{
+	struct iss_dma_channel *ch;
+
+	if (reg / 0x20 >= ISS_DMA_CHANNELS)
+		return 0;
+	dma_poll(s, dev);
+	ch = &dev->dma[reg / 0x20];
+	switch (reg & 0x1f) {
+	case 0x00: return ch->src;
+	case 0x04: return ch->dst;
+	case 0x08: return ch->count;
+	case 0x0c: return ch->src_stride;
+	case 0x10: return ch->dst_stride;
+	case 0x14: return ch->ctrl;
+	case 0x18: return ch->done << 1 | ch->busy;
+	}
+	return 0;
+}
+
+static void dma_write(struct iss *s, struct iss_devices *dev, uint32_t reg, uint32_t data)
+{
+	struct iss_dma_channel *ch;
+
+	if (reg / 0x20 >= ISS_DMA_CHANNELS)
+		return;
+	ch = &dev->dma[reg / 0x20];
+	switch (reg & 0x1f) {
+	case 0x00:
+		ch->src = data;
+		break;
+	case 0x04:
+		ch->dst = data;
+		break;
+	case 0x08:
+		ch->count = data;
+		break;
+	case 0x0c:
+		ch->src_stride = data;
+		break;
+	case 0x10:
+		ch->dst_stride = data;
+		break;
+	case 0x14:
+		/* A start while the channel is busy is ignored */
+		if (ch->busy)
+			break;
+		ch->ctrl = data & 0x1f;
+		if (data & 0x100) {
+			ch->busy = true;
+			ch->done = false;
+			dma_run(s, dev, ch);
+		}
+		break;
+	case 0x18:
+		if (data & 2)
+			ch->done = false;
+		break;
+	}
+}
+
+static uint32_t mmio_read(struct iss *s, uint32_t addr)
+{
+	struct iss_devices *dev = (struct iss_devices *)s->priv;
+	uint32_t reg = addr & 0xff;
+	uint32_t c;
+
+	if ((addr & ~0xffffU) == ISS_CLINT)
+		return clint_read(s, dev, addr & 0xffff);
+
+	switch (addr & ~0xfffU) {
+	case ISS_SYSCON:
+		return syscon_read(s, dev, addr & 0xfff);
+	case ISS_UART0:
+		if (reg == 0x04) {
+			if (!uart_rx_ready(dev))
+				return 0;
+			c = dev->uart_rx;
+			dev->uart_rx = -1;
+			dev->uart_rx_bytes++;
+			return c;
+		}
+		/* Status: txFull | rxFull | txEmpty | rxEmpty, TX never fills up */
+		if (reg == 0x0c)
+			return (1 << 1) | !uart_rx_ready(dev);
+		/* FIFO levels and size, one byte is buffered from the host at a time */
+		if (reg == 0x14)
+			return 0;
+		if (reg == 0x18)
+			return uart_rx_ready(dev);
+		if (reg == 0x1c)
+			return ISS_UART_FIFO;
+		return 0;
+	case ISS_GPIO0:
+		if (reg == 0x00)
+			return dev->gpio_dir;
+		if (reg == 0x04)
+			return dev->gpio_value & dev->gpio_dir;
+		if (reg == 0x08)
+			return dev->gpio_rising;
+		if (reg == 0x0c)
+			return dev->gpio_falling;
+		if (reg == 0x10)
+			return dev->gpio_pending;
+		return 0;
+	case ISS_TIMER0:
+		return timer_now(s, dev);
+	case ISS_DMA:
+		return dma_read(s, dev, addr & 0xfff);
+	}
+	return 0;
+}
+
+static void mmio_write(struct iss *s, uint32_t addr, uint32_t data)
+{
+	struct iss_devices *dev = (struct iss_devices *)s->priv;
+	uint32_t reg = addr & 0xff;
+	uint32_t pins;
+
+	if ((addr & ~0xffffU) == ISS_CLINT) {
+		clint_write(s, dev, addr & 0xffff, data);
+		return;
+	}
+
+	switch (addr & ~0xfffU) {
+	case ISS_SYSCON:
+		if ((addr & 0xfff) == 0x40) {
+			dev->exit_status = data;
+			if (data & 1)
+				s->halted = true;
+		}
+		break;
+	case ISS_UART0:
+		if (reg == 0x00) {
+			hostio_putc(data & 0xff);
+			dev->uart_tx_bytes++;
+		} else if (reg == 0x20) {
+			dev->uart_tx_watermark = data & 0xffff;
+		}
+		break;
+	case ISS_GPIO0:
+		/* Only the outputs change, the inputs read as 0 like in simulation */
+		pins = dev->gpio_value & dev->gpio_dir;
+		if (reg == 0x00)
+			dev->gpio_dir = data;
+		else if (reg == 0x04)
+			dev->gpio_value = data;
+		else if (reg == 0x08)
+			dev->gpio_rising = data;
+		else if (reg == 0x0c)
+			dev->gpio_falling = data;
+		else if (reg == 0x10)
+			dev->gpio_pending &= ~data;
+		dev->gpio_pending |= (~pins & dev->gpio_value & dev->gpio_dir & dev->gpio_rising) |
+				     (pins & ~(dev->gpio_value & dev->gpio_dir) & dev->gpio_falling);
+		if (dev->log_gpio && reg <= 0x04)
+			fprintf(stderr, "[GPIO0 dir %08x value %08x]\r\n", dev->gpio_dir, dev->gpio_value);
+		break;
+	case ISS_TIMER0:
+		dev->timer_value = data;
+		dev->timer_base = iss_cycles(s);
+		break;
+	case ISS_DMA:
+		dma_write(s, dev, addr & 0xfff, data);
+		break;
+	}
+}
+
+/* The TX FIFO never fills up, so it is always below a non-zero watermark */
+static uint32_t interrupts(struct iss *s)
+{
+	struct iss_devices *dev = (struct iss_devices *)s->priv;
+	uint32_t dma_done = 0;
+
+	dma_poll(s, dev);
+	for (int i = 0; i < ISS_DMA_CHANNELS; i++)
+		dma_done |= dev->dma[i].done && (dev->dma[i].ctrl & 0x10);
+
+	return dev->msip << ISS_IRQ_SOFTWARE |
+	       (mtime(s) >= dev->mtimecmp) << ISS_IRQ_TIMER |
+	       uart_rx_ready(dev) << ISS_IRQ_UART_RX |
+	       (dev->uart_tx_watermark > 0) << ISS_IRQ_UART_TX |
+	       (dev->gpio_pending != 0) << ISS_IRQ_GPIO |
+	       dma_done << ISS_IRQ_DMA;
+}
+
+void iss_devices_init(struct iss *s, struct iss_devices *dev, uint32_t clock_freq)
+{
+	*dev = {};
+	dev->clock_freq = clock_freq;
+	dev->num_gpio = 8;
+	dev->uart_rx = -1;
+	dev->mtimecmp = ~0ULL;
+
+	s->priv = dev;
+	s->mmio.read = mmio_read;
+	s->mmio.write = mmio_write;
+	s->mmio.interrupts = interrupts;
+}
@@ -0,0 +1,179 @@
+/*
+ * Command line front end for the instruction set simulator (make iss).
+ *
+ * Loads programs like chiselv.bin does and runs them against the peripheral
+ * models in iss-devices.cpp, many times faster than the RTL simulation.
+ */
+
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "disasm.h"
+#include "hostio.h"
+#include "iss.h"
+
+/* Exit code used when --max-instructions is reached (same as timeout(1)) */
+#define EXIT_TIMEOUT 124
+
+/* Instructions per iss_run() call, between checks of the instruction limit */
+#define CHUNK (1 << 20)
+
+static void usage(const char *name)
+{
+	fprintf(stderr, "Usage: %s [options]\n"
+		"  -e, --elf FILE             load an ELF executable into ROM/RAM\n"
+		"  -r, --rom FILE             load a raw binary (or .mem) image into ROM\n"
+		"  -m, --ram FILE             load a raw binary (or .mem) image into RAM\n"
+		"  -c, --max-instructions N   stop with exit code %d after N instructions\n"
+		"  -i, --uart-in SRC          UART input: - (default), none, pty or a file/FIFO\n"
+		"  -o, --uart-out DST         UART output: - (default), none or a file/FIFO\n"
+		"  -f, --freq HZ              clock frequency reported by Syscon (default 50000000)\n"
+		"  -g, --gpio                 log GPIO0 writes to stderr\n"
+		"  -b, --batch                no UART input, print statistics\n"
+		"  -s, --stats                print statistics on exit\n"
+		"  -h, --help                 show this help\n"
+		"Without -e/-r/-m, progload.mem and progload-RAM.mem are loaded when present.\n",
+		name, EXIT_TIMEOUT);
+}
+
+int main(int argc, char **argv)
+{
+	static const struct option options[] = {
+		{ "elf", required_argument, NULL, 'e' },
+		{ "rom", required_argument, NULL, 'r' },
+		{ "ram", required_argument, NULL, 'm' },
+		{ "max-instructions", required_argument, NULL, 'c' },
+		{ "uart-in", required_argument, NULL, 'i' },
+		{ "uart-out", required_argument, NULL, 'o' },
+		{ "freq", required_argument, NULL, 'f' },
+		{ "gpio", no_argument, NULL, 'g' },
+		{ "batch", no_argument, NULL, 'b' },
+		{ "stats", no_argument, NULL, 's' },
+		{ "help", no_argument, NULL, 'h' },
+		{ NULL, 0, NULL, 0 }
+	};
+	const char *elffile = NULL, *romfile = NULL, *ramfile = NULL;
+	const char *uart_in = "-", *uart_out = "-";
+	const char *reason = "max instructions reached";
+	uint64_t max_insns = UINT64_MAX;
+	uint32_t freq = 50000000;
+	bool log_gpio = false, stats = false;
+	struct mem_region mem[2];
+	struct iss_devices dev;
+	struct timespec start, end;
+	struct iss *s;
+	int c, code = EXIT_TIMEOUT;
+	double secs;
+
+	while ((c = getopt_long(argc, argv, "e:r:m:c:i:o:f:gbsh", options, NULL)) != -1) {
+		switch (c) {
+		case 'e':
+			elffile = optarg;
+			break;
+		case 'r':
+			romfile = optarg;
+			break;
+		case 'm':
+			ramfile = optarg;
+			break;
+		case 'c':
+			max_insns = strtoull(optarg, NULL, 0);
+			break;
+		case 'i':
+			uart_in = optarg;
+			break;
+		case 'o':
+			uart_out = optarg;
+			break;
+		case 'f':
+			freq = strtoul(optarg, NULL, 0);
+			if (freq < 1000) {
+				fprintf(stderr, "Invalid clock frequency %s\n", optarg);
+				return 1;
+			}
+			break;
+		case 'g':
+			log_gpio = true;
+			break;
+		case 'b':
+			uart_in = "none";
+			stats = true;
+			break;
+		case 's':
+			stats = true;
+			break;
+		case 'h':
+			usage(argv[0]);
+			return 0;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (!elffile && !romfile && !ramfile) {
+		if (access("progload.mem", R_OK) == 0)
+			romfile = "progload.mem";
+		if (access("progload-RAM.mem", R_OK) == 0)
+			ramfile = "progload-RAM.mem";
+		if (!romfile) {
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	s = iss_create();
+	iss_mem_regions(s, mem);
+	if ((elffile && load_elf(mem, 2, elffile)) ||
+	    (romfile && load_image(mem, 2, romfile, ROM_BASE)) ||
+	    (ramfile && load_image(mem, 2, ramfile, RAM_BASE)))
+		return 1;
+
+	iss_devices_init(s, &dev, freq);
+	dev.log_gpio = log_gpio;
+	s->pc = ROM_BASE;
+
+	if (hostio_start(uart_in, uart_out))
+		return 1;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	while (!s->halted && s->instret < max_insns) {
+		uint64_t n = max_insns - s->instret;
+
+		iss_run(s, n < CHUNK ? n : CHUNK);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	hostio_stop();
+
+	if (s->illegal) {
+		char text[64];
+		uint32_t insn = iss_insn_at(s, s->pc, NULL);
+
+		disasm(s->pc, insn, text, sizeof(text));
+		fprintf(stderr, "Illegal instruction at %08x: %08x %s\n", s->pc, insn, text);
+		reason = "illegal instruction";
+		code = 1;
+	} else if (s->halted) {
+		reason = "exit register";
+		code = dev.exit_status >> 1;
+	}
+
+	if (stats) {
+		secs = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+		fprintf(stderr, "\n------------------------------------------------------\n");
+		fprintf(stderr, "exit:          %s (%d)\n", reason, code);
+		fprintf(stderr, "instructions:  %" PRIu64 "\n", s->instret);
+		fprintf(stderr, "cycles:        %" PRIu64 " (approximate)\n", iss_cycles(s));
+		fprintf(stderr, "wall time:     %.3f s\n", secs);
+		fprintf(stderr, "speed:         %.1f MIPS\n", secs > 0 ? s->instret / secs / 1e6 : 0);
+		fprintf(stderr, "UART:          %lu bytes out, %lu bytes in\n", dev.uart_tx_bytes, dev.uart_rx_bytes);
+	}
+
+	iss_destroy(s);
+	return code;
+}
@@ -0,0 +1,694 @@
+/*
+ * Functional RV32IMC (plus Zba and Zbb) instruction set simulator.
+ *
+ * Not cycle accurate: it runs the same programs as the Verilator model, with
+ * the same memory map, for firmware development. Instructions are decoded
+ * once into a predecoded cache with one entry per ROM halfword (the core only
+ * fetches from ROM), compressed ones expanded, and executed with threaded
+ * dispatch (computed goto), so the hot loop never looks at instruction
+ * encodings again.
+ *
+ * Loads and stores follow MemoryIOManager: RAM at 0x8000_0000 (byte and
+ * halfword accesses use the address low bits), everything else goes to the
+ * MMIO handlers. ROM is not visible on the data bus.
+ *
+ * The counter CSRs are derived from the run statistics. ECALL, EBREAK and
+ * interrupts trap to mtvec like in CSRFile.scala. The interrupt lines are
+ * only looked at every ISS_IRQ_POLL instructions while mstatus.MIE is set
+ * and at WFI, which does not wait.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "disasm.h"
+#include "iss.h"
+
+struct iss_insn {
+	void *op;
+	uint8_t rd;	/* 32 for x0, writes go to a scratch register */
+	uint8_t rs1;
+	uint8_t rs2;
+	uint8_t len;	/* 2 for compressed instructions, 4 for the others */
+	int32_t imm;
+};
+
+#define ROM_MASK (ISS_ROM_WORDS * 4 - 1)
+#define RAM_MASK (ISS_RAM_WORDS * 4 - 1)
+
+#define MSTATUS_MIE (1U << 3)
+#define MSTATUS_MPIE (1U << 7)
+#define MSTATUS_MPP (3U << 11)	/* always machine mode */
+#define MCAUSE_INTERRUPT (1U << 31)
+#define MCAUSE_BREAKPOINT 3
+#define MCAUSE_ECALL 11
+#define IRQ_MASK ((1U << ISS_IRQ_SOFTWARE) | (1U << ISS_IRQ_TIMER) | \
+		  (1U << ISS_IRQ_UART_RX) | (1U << ISS_IRQ_UART_TX) | (1U << ISS_IRQ_GPIO) | \
+		  (1U << ISS_IRQ_DMA))
+
+struct iss *iss_create(void)
+{
+	struct iss *s = (struct iss *)calloc(1, sizeof(*s));
+
+	/* Last entries are sentinels that wrap the PC around the ROM */
+	s->icache = (struct iss_insn *)calloc(ISS_ROM_WORDS * 2 + 2, sizeof(*s->icache));
+	return s;
+}
+
+void iss_destroy(struct iss *s)
+{
+	free(s->icache);
+	free(s);
+}
+
+void iss_mem_regions(struct iss *s, struct mem_region regions[2])
+{
+	regions[0] = { "ROM", ROM_BASE, s->rom, ISS_ROM_WORDS };
+	regions[1] = { "RAM", RAM_BASE, s->ram, ISS_RAM_WORDS };
+}
+
+static inline uint32_t rom_half(const struct iss *s, uint32_t i)
+{
+	return (s->rom[(i >> 1) & (ISS_ROM_WORDS - 1)] >> ((i & 1) * 16)) & 0xffff;
+}
+
+uint32_t iss_insn_at(const struct iss *s, uint32_t pc, unsigned *len)
+{
+	uint32_t i = (pc & ROM_MASK) >> 1;
+	uint32_t lo = rom_half(s, i);
+
+	if ((lo & 3) != 3) {
+		if (len)
+			*len = 2;
+		return rvc_expand(lo);
+	}
+	if (len)
+		*len = 4;
+	return lo | rom_half(s, i + 1) << 16;
+}
+
+static inline bool is_ram(uint32_t addr)
+{
+	return (addr >> 28) == 0x8;
+}
+
+static inline uint32_t load(struct iss *s, uint32_t addr, int size)
+{
+	uint32_t word;
+
+	s->loads++;
+	if (!is_ram(addr)) {
+		word = s->mmio.read ? s->mmio.read(s, addr) : 0;
+		return size == 4 ? word : word & ((1U << (size * 8)) - 1);
+	}
+
+	s->stalls++;
+	word = s->ram[(addr & RAM_MASK) >> 2];
+	if (size == 4)
+		return word;
+	word >>= (addr & (4 - size)) * 8;
+	return word & ((1U << (size * 8)) - 1);
+}
+
+static inline void store(struct iss *s, uint32_t addr, uint32_t data, int size)
+{
+	uint32_t *word, shift, mask;
+
+	s->stores++;
+	if (!is_ram(addr)) {
+		if (s->mmio.write)
+			s->mmio.write(s, addr, size == 4 ? data : data & ((1U << (size * 8)) - 1));
+		return;
+	}
+
+	word = &s->ram[(addr & RAM_MASK) >> 2];
+	if (size == 4) {
+		*word = data;
+		return;
+	}
+	shift = (addr & (4 - size)) * 8;
+	mask = ((1U << (size * 8)) - 1) << shift;
+	*word = (*word & ~mask) | ((data << shift) & mask);
+}
+
+/* Counter index as in the CSR addresses, -1 if the CSR is not a counter */
+static int counter_index(uint32_t csr, bool *high, bool *machine)
+{
+	unsigned i = csr & 0x1f;
+
+	*high = csr & 0x80;
+	*machine = (csr & 0xf00) == 0xb00;
+	if ((csr & 0xf60) != 0xb00 && (csr & 0xf60) != 0xc00)
+		return -1;
+	if (i > 6 || (i == 1 && *machine))
+		return -1;
+	return i;
+}
+
+static uint64_t counter_raw(struct iss *s, int i)
+{
+	switch (i) {
+	case 0: /* cycle */
+	case 1: /* time */
+		return iss_cycles(s);
+	case 2:
+		return s->instret;
+	case 3:
+		return s->stalls;
+	case 4:
+		return s->branches;
+	case 5:
+		return s->loads;
+	}
+	return s->stores;
+}
+
+static uint64_t counter(struct iss *s, int i)
+{
+	if (s->mcountinhibit & (1U << i))
+		return s->counter_frozen[i];
+	return counter_raw(s, i) + s->counter_offset[i];
+}
+
+/*
+ * Sets a counter as seen by the next instruction. cycle and instret still
+ * count the CSR instruction itself, like in the core.
+ */
+static void counter_set(struct iss *s, int i, uint64_t value)
+{
+	if (s->mcountinhibit & (1U << i))
+		s->counter_frozen[i] = value;
+	else
+		s->counter_offset[i] = value - counter_raw(s, i) - (i == 0 || i == 2);
+}
+
+static uint32_t irq_lines(struct iss *s)
+{
+	return s->mmio.interrupts ? s->mmio.interrupts(s) & IRQ_MASK : 0;
+}
+
+static void irq_update(struct iss *s)
+{
+	s->irq_enabled = (s->mstatus & MSTATUS_MIE) && s->mie;
+}
+
+/* Highest priority interrupt pending and enabled in mie, -1 if none */
+static int irq_pending(struct iss *s)
+{
+	static const int priority[] = {
+		ISS_IRQ_SOFTWARE, ISS_IRQ_TIMER, ISS_IRQ_UART_RX, ISS_IRQ_UART_TX, ISS_IRQ_GPIO,
+		ISS_IRQ_DMA,
+	};
+	uint32_t pending = irq_lines(s) & s->mie;
+
+	for (int irq : priority)
+		if (pending & (1U << irq))
+			return irq;
+	return -1;
+}
+
+/* Takes a trap, returns the handler address */
+static uint32_t trap(struct iss *s, uint32_t cause, uint32_t epc)
+{
+	uint32_t base = s->mtvec & ~3U;
+
+	s->mepc = epc;
+	s->mcause = cause;
+	s->mstatus = s->mstatus & MSTATUS_MIE ? MSTATUS_MPIE : 0;
+	irq_update(s);
+	if ((s->mtvec & 1) && (cause & MCAUSE_INTERRUPT))
+		base += (cause & 31) * 4;
+	return base;
+}
+
+/* MRET, returns to mepc */
+static uint32_t trap_return(struct iss *s)
+{
+	s->mstatus = MSTATUS_MPIE | (s->mstatus & MSTATUS_MPIE ? MSTATUS_MIE : 0);
+	irq_update(s);
+	return s->mepc;
+}
+
+static uint32_t csr_read(struct iss *s, uint32_t csr)
+{
+	bool high, machine;
+	int i = counter_index(csr, &high, &machine);
+
+	switch (csr) {
+	case 0x300: return s->mstatus | MSTATUS_MPP;
+	case 0x304: return s->mie;
+	case 0x305: return s->mtvec;
+	case 0x320: return s->mcountinhibit;
+	case 0x340: return s->mscratch;
+	case 0x341: return s->mepc;
+	case 0x342: return s->mcause;
+	case 0x344: return irq_lines(s);
+	}
+	if (i < 0)
+		return 0;
+	return counter(s, i) >> (high ? 32 : 0);
+}
+
+static void csr_write(struct iss *s, uint32_t csr, uint32_t data)
+{
+	bool high, machine;
+	int i = counter_index(csr, &high, &machine);
+	uint64_t value;
+
+	switch (csr) {
+	case 0x300:
+		s->mstatus = data & (MSTATUS_MIE | MSTATUS_MPIE);
+		irq_update(s);
+		return;
+	case 0x304:
+		s->mie = data & IRQ_MASK;
+		irq_update(s);
+		return;
+	case 0x305:
+		s->mtvec = data & ~2U;
+		return;
+	case 0x340:
+		s->mscratch = data;
+		return;
+	case 0x341:
+		s->mepc = data & ~1U;
+		return;
+	case 0x342:
+		s->mcause = data;
+		return;
+	}
+	if (csr == 0x320) {
+		data &= 0x7d;	/* time can not be stopped */
+		for (i = 0; i < 7; i++) {
+			uint32_t bit = 1U << i;
+
+			if ((data & bit) && !(s->mcountinhibit & bit))
+				s->counter_frozen[i] = counter(s, i) + (i == 0 || i == 2);
+			else if (!(data & bit) && (s->mcountinhibit & bit))
+				s->counter_offset[i] = s->counter_frozen[i] - counter_raw(s, i) - (i == 0 || i == 2);
+		}
+		s->mcountinhibit = data;
+		return;
+	}
+	if (i < 0 || !machine)
+		return;
+	value = counter(s, i);
+	if (high)
+		value = (uint64_t)data << 32 | (uint32_t)value;
+	else
+		value = (value & ~0xffffffffULL) | data;
+	counter_set(s, i, value);
+}
+
+/* CSRRW/S/C and the immediate variants, returns the value for rd */
+static uint32_t csr_access(struct iss *s, uint32_t csr, unsigned funct3, uint32_t src)
+{
+	uint32_t old = csr_read(s, csr);
+
+	switch (funct3 & 3) {
+	case 1:
+		csr_write(s, csr, src);
+		break;
+	case 2:
+		if (src)
+			csr_write(s, csr, old | src);
+		break;
+	case 3:
+		if (src)
+			csr_write(s, csr, old & ~src);
+		break;
+	}
+	return old;
+}
+
+/*
+ * DIV/DIVU/REM/REMU with the spec results for division by zero and overflow.
+ * The core's divider stalls for 32 cycles except in those two cases.
+ */
+static uint32_t divide(struct iss *s, uint32_t a, uint32_t b, bool sign, bool rem)
+{
+	if (b == 0)
+		return rem ? a : UINT32_MAX;
+	if (sign && a == 0x80000000U && b == UINT32_MAX)
+		return rem ? 0 : a;
+	s->stalls += ISS_DIV_STALLS;
+	if (sign)
+		return rem ? (uint32_t)((int32_t)a % (int32_t)b) : (uint32_t)((int32_t)a / (int32_t)b);
+	return rem ? a % b : a / b;
+}
+
+static inline int32_t imm_i(uint32_t insn)
+{
+	return (int32_t)insn >> 20;
+}
+
+static inline int32_t imm_s(uint32_t insn)
+{
+	return ((int32_t)insn >> 25 << 5) | ((insn >> 7) & 0x1f);
+}
+
+static inline int32_t imm_b(uint32_t insn)
+{
+	return ((int32_t)insn >> 31 << 12) | ((insn & 0x80) << 4) |
+	       ((insn >> 20) & 0x7e0) | ((insn >> 7) & 0x1e);
+}
+
+static inline int32_t imm_j(uint32_t insn)
+{
+	return ((int32_t)insn >> 31 << 20) | (insn & 0xff000) |
+	       ((insn >> 9) & 0x800) | ((insn >> 20) & 0x7fe);
+}
+
+static inline uint32_t rotate_right(uint32_t v, uint32_t shamt)
+{
+	shamt &= 31;
+	return shamt ? (v >> shamt) | (v << (32 - shamt)) : v;
+}
+
+/* Each byte becomes 0xff if any of its bits is set, 0 otherwise */
+static inline uint32_t or_combine(uint32_t v)
+{
+	v |= (v >> 1) & 0x7f7f7f7f;
+	v |= (v >> 2) & 0x3f3f3f3f;
+	v |= (v >> 4) & 0x0f0f0f0f;
+	return (v & 0x01010101) * 0xff;
+}
+
+uint64_t iss_run(struct iss *s, uint64_t n)
+{
+	/* Indexed by the OP_* values below, filled in by decode */
+	enum {
+		OP_DECODE, OP_WRAP, OP_ILLEGAL, OP_NOP,
+		OP_LUI, OP_AUIPC, OP_JAL, OP_JALR,
+		OP_BEQ, OP_BNE, OP_BLT, OP_BGE, OP_BLTU, OP_BGEU,
+		OP_LB, OP_LH, OP_LW, OP_LBU, OP_LHU, OP_SB, OP_SH, OP_SW,
+		OP_ADDI, OP_SLTI, OP_SLTIU, OP_XORI, OP_ORI, OP_ANDI, OP_SLLI, OP_SRLI, OP_SRAI,
+		OP_ADD, OP_SUB, OP_SLL, OP_SLT, OP_SLTU, OP_XOR, OP_SRL, OP_SRA, OP_OR, OP_AND,
+		OP_MUL, OP_MULH, OP_MULHSU, OP_MULHU, OP_DIV, OP_DIVU, OP_REM, OP_REMU,
+		OP_SH1ADD, OP_SH2ADD, OP_SH3ADD, OP_ANDN, OP_ORN, OP_XNOR,
+		OP_MIN, OP_MINU, OP_MAX, OP_MAXU, OP_ROL, OP_ROR, OP_ZEXTH,
+		OP_CLZ, OP_CTZ, OP_CPOP, OP_SEXTB, OP_SEXTH, OP_RORI, OP_ORCB, OP_REV8,
+		OP_CSR, OP_ECALL, OP_EBREAK, OP_MRET, OP_WFI,
+	};
+	static void *const ops[] = {
+		&&decode, &&wrap, &&illegal, &&nop,
+		&&lui, &&auipc, &&jal, &&jalr,
+		&&beq, &&bne, &&blt, &&bge, &&bltu, &&bgeu,
+		&&lb, &&lh, &&lw, &&lbu, &&lhu, &&sb, &&sh, &&sw,
+		&&addi, &&slti, &&sltiu, &&xori, &&ori, &&andi, &&slli, &&srli, &&srai,
+		&&add, &&sub, &&sll, &&slt, &&sltu, &&xor_, &&srl, &&sra, &&or_, &&and_,
+		&&mul, &&mulh, &&mulhsu, &&mulhu, &&div, &&divu, &&rem, &&remu,
+		&&sh1add, &&sh2add, &&sh3add, &&andn, &&orn, &&xnor,
+		&&min, &&minu, &&max, &&maxu, &&rol, &&ror, &&zexth,
+		&&clz, &&ctz, &&cpop, &&sextb, &&sexth, &&rori, &&orcb, &&rev8,
+		&&csr, &&ecall, &&ebreak, &&mret, &&wfi,
+	};
+	uint32_t *x = s->x;
+	uint32_t pc = s->pc;
+	uint64_t budget = n;
+	struct iss_insn *d;
+
+	if (!n || s->halted)
+		return 0;
+
+	if (!s->icache_ready) {
+		for (int i = 0; i < ISS_ROM_WORDS * 2; i++)
+			s->icache[i].op = ops[OP_DECODE];
+		s->icache[ISS_ROM_WORDS * 2].op = ops[OP_WRAP];
+		s->icache[ISS_ROM_WORDS * 2 + 1].op = ops[OP_WRAP];
+		s->icache_ready = true;
+	}
+
+#define RD x[d->rd]
+#define RS1 x[d->rs1]
+#define RS2 x[d->rs2]
+#define DISPATCH() goto *d->op
+#define RETIRE() do { \
+	s->instret++; \
+	if (--budget == 0 || s->halted) goto out; \
+	if (s->irq_enabled && !(s->instret % ISS_IRQ_POLL)) goto irq; \
+} while (0)
+#define NEXT() do { pc += d->len; d += d->len >> 1; RETIRE(); DISPATCH(); } while (0)
+#define JUMP(target) do { pc = (target); d = &s->icache[(pc & ROM_MASK) >> 1]; RETIRE(); DISPATCH(); } while (0)
+#define BRANCH(cond) do { if (cond) { s->branches++; JUMP(pc + d->imm); } NEXT(); } while (0)
+
+	d = &s->icache[(pc & ROM_MASK) >> 1];
+	DISPATCH();
+
+decode: {
+	unsigned len;
+	uint32_t insn = iss_insn_at(s, (d - s->icache) * 2, &len);
+	unsigned funct3 = (insn >> 12) & 7;
+	unsigned funct7 = insn >> 25;
+	int op = OP_ILLEGAL;
+
+	d->len = len;
+	d->rd = (insn >> 7) & 31;
+	if (d->rd == 0)
+		d->rd = 32;
+	d->rs1 = (insn >> 15) & 31;
+	d->rs2 = (insn >> 20) & 31;
+	d->imm = imm_i(insn);
+
+	switch (insn & 0x7f) {
+	case 0x37:
+		op = OP_LUI;
+		d->imm = insn & 0xfffff000;
+		break;
+	case 0x17:
+		op = OP_AUIPC;
+		d->imm = insn & 0xfffff000;
+		break;
+	case 0x6f:
+		op = OP_JAL;
+		d->imm = imm_j(insn);
+		break;
+	case 0x67:
+		if (funct3 == 0)
+			op = OP_JALR;
+		break;
+	case 0x63:
+		if (funct3 != 2 && funct3 != 3)
+			op = OP_BEQ + (funct3 < 2 ? funct3 : funct3 - 2);
+		d->imm = imm_b(insn);
+		break;
+	case 0x03:
+		switch (funct3) {
+		case 0: op = OP_LB; break;
+		case 1: op = OP_LH; break;
+		case 2: op = OP_LW; break;
+		case 4: op = OP_LBU; break;
+		case 5: op = OP_LHU; break;
+		}
+		break;
+	case 0x23:
+		if (funct3 < 3)
+			op = OP_SB + funct3;
+		d->imm = imm_s(insn);
+		break;
+	case 0x13:
+		switch (funct3) {
+		case 0: op = OP_ADDI; break;
+		case 2: op = OP_SLTI; break;
+		case 3: op = OP_SLTIU; break;
+		case 4: op = OP_XORI; break;
+		case 6: op = OP_ORI; break;
+		case 7: op = OP_ANDI; break;
+		case 1:
+			if (funct7 == 0)
+				op = OP_SLLI;
+			else if (funct7 == 0x30 && d->rs2 <= 5 && d->rs2 != 3)
+				op = OP_CLZ + d->rs2 - (d->rs2 > 3);
+			break;
+		case 5:
+			if (funct7 == 0)
+				op = OP_SRLI;
+			else if (funct7 == 0x20)
+				op = OP_SRAI;
+			else if (funct7 == 0x30)
+				op = OP_RORI;
+			else if ((insn >> 20) == 0x287)
+				op = OP_ORCB;
+			else if ((insn >> 20) == 0x698)
+				op = OP_REV8;
+			break;
+		}
+		if (funct3 == 1 || funct3 == 5)
+			d->imm &= 31;
+		break;
+	case 0x33:
+		if (funct7 == 0) {
+			static const int alu[8] = { OP_ADD, OP_SLL, OP_SLT, OP_SLTU, OP_XOR, OP_SRL, OP_OR, OP_AND };
+			op = alu[funct3];
+		} else if (funct7 == 0x20 && funct3 == 0) {
+			op = OP_SUB;
+		} else if (funct7 == 0x20 && funct3 == 5) {
+			op = OP_SRA;
+		} else if (funct7 == 1) {
+			op = OP_MUL + funct3;
+		} else if (funct7 == 0x10 && (funct3 & 1) == 0 && funct3 != 0) {
+			op = OP_SH1ADD + funct3 / 2 - 1;
+		} else if (funct7 == 0x20 && (funct3 == 4 || funct3 >= 6)) {
+			op = funct3 == 4 ? OP_XNOR : funct3 == 6 ? OP_ORN : OP_ANDN;
+		} else if (funct7 == 0x05 && funct3 >= 4) {
+			op = OP_MIN + funct3 - 4;
+		} else if (funct7 == 0x30 && (funct3 == 1 || funct3 == 5)) {
+			op = funct3 == 1 ? OP_ROL : OP_ROR;
+		} else if (funct7 == 0x04 && funct3 == 4 && d->rs2 == 0) {
+			op = OP_ZEXTH;
+		}
+		break;
+	case 0x0f: /* FENCE, FENCE.I */
+		op = OP_NOP;
+		break;
+	case 0x73:
+		if (funct3 != 0 && funct3 != 4) {
+			op = OP_CSR;
+			d->imm &= 0xfff;
+			d->rs2 = funct3;
+		} else if (insn == 0x00000073) {
+			op = OP_ECALL;
+		} else if (insn == 0x00100073) {
+			op = OP_EBREAK;
+		} else if (insn == 0x30200073) {
+			op = OP_MRET;
+		} else if (insn == 0x10500073) {
+			op = OP_WFI;
+		}
+		break;
+	}
+
+	d->op = ops[op];
+	DISPATCH();
+}
+
+wrap:
+	d = &s->icache[(pc & ROM_MASK) >> 1];
+	DISPATCH();
+
+	/* Interrupts are taken between instructions, mepc is the next one */
+irq: {
+	int irq = irq_pending(s);
+
+	if (irq >= 0) {
+		pc = trap(s, MCAUSE_INTERRUPT | irq, pc);
+		d = &s->icache[(pc & ROM_MASK) >> 1];
+	}
+	DISPATCH();
+}
+
+illegal:
+	s->illegal = true;
+	s->halted = true;
+	goto out;
+
+nop:	NEXT();
+
+lui:	RD = d->imm; NEXT();
+auipc:	RD = pc + d->imm; NEXT();
+jal:	RD = pc + d->len; JUMP(pc + d->imm);
+jalr: {
+	uint32_t target = (RS1 + d->imm) & ~1U;
+
+	RD = pc + d->len;
+	JUMP(target);
+}
+
+beq:	BRANCH(RS1 == RS2);
+bne:	BRANCH(RS1 != RS2);
+blt:	BRANCH((int32_t)RS1 < (int32_t)RS2);
+bge:	BRANCH((int32_t)RS1 >= (int32_t)RS2);
+bltu:	BRANCH(RS1 < RS2);
+bgeu:	BRANCH(RS1 >= RS2);
+
+lb:	RD = (int32_t)(int8_t)load(s, RS1 + d->imm, 1); NEXT();
+lh:	RD = (int32_t)(int16_t)load(s, RS1 + d->imm, 2); NEXT();
+lw:	RD = load(s, RS1 + d->imm, 4); NEXT();
+lbu:	RD = load(s, RS1 + d->imm, 1); NEXT();
+lhu:	RD = load(s, RS1 + d->imm, 2); NEXT();
+sb:	store(s, RS1 + d->imm, RS2, 1); NEXT();
+sh:	store(s, RS1 + d->imm, RS2, 2); NEXT();
+sw:	store(s, RS1 + d->imm, RS2, 4); NEXT();
+
+addi:	RD = RS1 + d->imm; NEXT();
+slti:	RD = (int32_t)RS1 < d->imm; NEXT();
+sltiu:	RD = RS1 < (uint32_t)d->imm; NEXT();
+xori:	RD = RS1 ^ d->imm; NEXT();
+ori:	RD = RS1 | d->imm; NEXT();
+andi:	RD = RS1 & d->imm; NEXT();
+slli:	RD = RS1 << d->imm; NEXT();
+srli:	RD = RS1 >> d->imm; NEXT();
+srai:	RD = (int32_t)RS1 >> d->imm; NEXT();
+
+add:	RD = RS1 + RS2; NEXT();
+sub:	RD = RS1 - RS2; NEXT();
+sll:	RD = RS1 << (RS2 & 31); NEXT();
+slt:	RD = (int32_t)RS1 < (int32_t)RS2; NEXT();
+sltu:	RD = RS1 < RS2; NEXT();
+xor_:	RD = RS1 ^ RS2; NEXT();
+srl:	RD = RS1 >> (RS2 & 31); NEXT();
+sra:	RD = (int32_t)RS1 >> (RS2 & 31); NEXT();
+or_:	RD = RS1 | RS2; NEXT();
+and_:	RD = RS1 & RS2; NEXT();
+
+mul:	RD = RS1 * RS2; NEXT();
+mulh:	RD = (uint64_t)((int64_t)(int32_t)RS1 * (int32_t)RS2) >> 32; NEXT();
+mulhsu:	RD = (uint64_t)((int64_t)(int32_t)RS1 * (uint64_t)RS2) >> 32; NEXT();
+mulhu:	RD = ((uint64_t)RS1 * RS2) >> 32; NEXT();
+div:	RD = divide(s, RS1, RS2, true, false); NEXT();
+divu:	RD = divide(s, RS1, RS2, false, false); NEXT();
+rem:	RD = divide(s, RS1, RS2, true, true); NEXT();
+remu:	RD = divide(s, RS1, RS2, false, true); NEXT();
+
+sh1add:	RD = (RS1 << 1) + RS2; NEXT();
+sh2add:	RD = (RS1 << 2) + RS2; NEXT();
+sh3add:	RD = (RS1 << 3) + RS2; NEXT();
+andn:	RD = RS1 & ~RS2; NEXT();
+orn:	RD = RS1 | ~RS2; NEXT();
+xnor:	RD = ~(RS1 ^ RS2); NEXT();
+min:	RD = (int32_t)RS1 < (int32_t)RS2 ? RS1 : RS2; NEXT();
+minu:	RD = RS1 < RS2 ? RS1 : RS2; NEXT();
+max:	RD = (int32_t)RS1 < (int32_t)RS2 ? RS2 : RS1; NEXT();
+maxu:	RD = RS1 < RS2 ? RS2 : RS1; NEXT();
+rol:	RD = rotate_right(RS1, -RS2); NEXT();
+ror:	RD = rotate_right(RS1, RS2); NEXT();
+zexth:	RD = RS1 & 0xffff; NEXT();
+clz:	RD = RS1 ? __builtin_clz(RS1) : 32; NEXT();
+ctz:	RD = RS1 ? __builtin_ctz(RS1) : 32; NEXT();
+cpop:	RD = __builtin_popcount(RS1); NEXT();
+sextb:	RD = (int8_t)RS1; NEXT();
+sexth:	RD = (int16_t)RS1; NEXT();
+rori:	RD = rotate_right(RS1, d->imm); NEXT();
+orcb:	RD = or_combine(RS1); NEXT();
+rev8:	RD = __builtin_bswap32(RS1); NEXT();
+
+	/* The immediate variants take the rs1 field */
+csr:	RD = csr_access(s, d->imm, d->rs2, d->rs2 & 4 ? d->rs1 : RS1); NEXT();
+
+ecall:	JUMP(trap(s, MCAUSE_ECALL, pc));
+ebreak:	JUMP(trap(s, MCAUSE_BREAKPOINT, pc));
+mret:	JUMP(trap_return(s));
+	/* Nothing to wait for, but check for the interrupt that ends it now */
+wfi:
+	pc += d->len;
+	d += d->len >> 1;
+	s->instret++;
+	if (--budget == 0 || s->halted)
+		goto out;
+	if (s->irq_enabled)
+		goto irq;
+	DISPATCH();
+
+#undef RD
+#undef RS1
+#undef RS2
+#undef DISPATCH
+#undef RETIRE
+#undef NEXT
+#undef JUMP
+#undef BRANCH
+
+out:
+	s->pc = pc;
+	return n - budget;
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+/*
+ * Functional RV32IMC (plus Zba and Zbb) instruction set simulator (see iss.cpp)
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "loader.h"
+
+/* Memory sizes as in Toplevel.scala and gcc/lib/riscv.ld */
+#define ISS_ROM_WORDS (64 * 1024 / 4)
+#define ISS_RAM_WORDS (64 * 1024 / 4)
+
+/* Peripheral registers (see MemoryIOManager.scala and Syscon.scala) */
+#define ISS_SYSCON 0x00001000UL
+#define ISS_CLINT 0x02000000UL
+#define ISS_UART0 0x30000000UL
+#define ISS_GPIO0 0x30001000UL
+#define ISS_TIMER0 0x30003000UL
+#define ISS_DMA 0x30004000UL
+
+/* DMA channels (DMA.scala) */
+#define ISS_DMA_CHANNELS 2
+
+/* UART0 FIFO entries (fifoLength in SOC.scala) */
+#define ISS_UART_FIFO 128
+
+/* Cycles the iterative divider (Divider.scala) stalls the core per divide */
+#define ISS_DIV_STALLS 32
+
+/* Interrupt numbers, the mip bits (Interrupt in CSRFile.scala) */
+#define ISS_IRQ_SOFTWARE 3
+#define ISS_IRQ_TIMER 7
+#define ISS_IRQ_UART_RX 16
+#define ISS_IRQ_UART_TX 17
+#define ISS_IRQ_GPIO 18
+#define ISS_IRQ_DMA 19
+
+/* Instructions between two looks at the interrupt lines while interrupts are enabled */
+#define ISS_IRQ_POLL 64
+
+struct iss_insn;
+struct iss;
+
+/*
+ * Accesses to anything but RAM. Reads return the whole 32 bit register,
+ * byte and halfword loads use its low bits like the core does.
+ */
+struct iss_mmio {
+	uint32_t (*read)(struct iss *s, uint32_t addr);
+	void (*write)(struct iss *s, uint32_t addr, uint32_t data);
+	/* Levels of the interrupt lines as mip bits, none if not set */
+	uint32_t (*interrupts)(struct iss *s);
+};
+
+struct iss {
+	uint32_t x[33];		/* x[32] takes the writes to x0 */
+	uint32_t pc;
+	uint64_t instret;
+	uint64_t stalls;	/* RAM loads and divides, like the core */
+	uint64_t branches, loads, stores;	/* taken branches and memory accesses */
+
+	/*
+	 * Counter CSRs (see CSRFile.scala): offsets set by writes to the machine
+	 * counters. time is the CLINT mtime, its offset is set by mtime writes.
+	 */
+	uint64_t counter_offset[7];
+	uint64_t counter_frozen[7];	/* value of the counters stopped by mcountinhibit */
+	uint32_t mcountinhibit;
+
+	/* Machine mode trap CSRs, mip comes from mmio.interrupts */
+	uint32_t mstatus, mie, mtvec, mscratch, mepc, mcause;
+	bool irq_enabled;	/* mstatus.MIE with some interrupt enabled in mie */
+
+	uint32_t rom[ISS_ROM_WORDS];
+	uint32_t ram[ISS_RAM_WORDS];
+
+	struct iss_mmio mmio;
+	void *priv;
+
+	/* Set by the MMIO handlers to stop iss_run() after the current instruction */
+	bool halted;
+	/* Illegal instruction that stopped the simulation */
+	bool illegal;
+
+	struct iss_insn *icache;	/* one predecoded entry per ROM halfword */
+	bool icache_ready;
+};
+
+struct iss *iss_create(void);
+void iss_destroy(struct iss *s);
+/* Memory regions for the program loader */
+void iss_mem_regions(struct iss *s, struct mem_region regions[2]);
+/* Runs at most n instructions, returns the number of instructions retired */
+uint64_t iss_run(struct iss *s, uint64_t n);
+/* Instruction at pc in ROM, expanded if compressed. len gets its size in bytes when not NULL. */
+uint32_t iss_insn_at(const struct iss *s, uint32_t pc, unsigned *len);
+
+static inline uint64_t iss_cycles(const struct iss *s)
+{
+	return s->instret + s->stalls;
+}
+
+/* DMA channel registers, see DMA.scala */
+struct iss_dma_channel {
+	uint32_t src, dst, count, src_stride, dst_stride, ctrl;
+	bool busy, done;
+};
+
+/* Peripheral models (iss-devices.cpp): Syscon, CLINT, UART0 over hostio, GPIO0, Timer0, DMA */
+struct iss_devices {
+	uint32_t clock_freq;
+	int num_gpio;
+	bool log_gpio;
+	uint32_t exit_status;
+	uint32_t gpio_dir, gpio_value;
+	uint32_t gpio_rising, gpio_falling, gpio_pending;	/* edge interrupts */
+	uint32_t uart_tx_watermark;
+	uint32_t timer_value;
+	uint64_t timer_base;
+	uint64_t mtimecmp;
+	uint32_t msip;
+	int uart_rx;		/* pending received byte, -1 if none */
+	unsigned long uart_tx_bytes, uart_rx_bytes;
+	struct iss_dma_channel dma[ISS_DMA_CHANNELS];
+};
+
+void iss_devices_init(struct iss *s, struct iss_devices *dev, uint32_t clock_freq);
@@ -0,0 +1,205 @@
+/*
+ * Program loader for the Verilator simulation.
+ *
+ * Writes firmware straight into the ROM (InstructionMemory) and RAM
+ * (DualPortRAM) arrays of the model before reset is released, so a single
+ * chiselv.bin can run any program without $readmemh parsing at startup or
+ * copying progload files around. Harnesses without the SOC memories (the
+ * RVFI one) pass their own arrays.
+ *
+ * Supported inputs:
+ *  - ELF32 little-endian RISC-V executables (PT_LOAD segments, .bss zeroed)
+ *  - raw binary images (as produced by objcopy -O binary)
+ *  - readmemh 32 bit word files (*.mem) as produced by the gcc/ Makefiles
+ */
+
+#include <ctype.h>
+#include <elf.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "loader.h"
+
+/*
+ * Write len bytes (or zeros if data is NULL) at byte offset of a word
+ * addressed memory array. Words are stored little-endian like the core sees
+ * them.
+ */
+static int mem_write(const struct mem_region *mem, uint32_t offset, const uint8_t *data, size_t len)
+{
+	if ((size_t)offset + len > mem->size * 4) {
+		fprintf(stderr, "loader: %zu bytes at 0x%08x do not fit in %s (%zu bytes)\n",
+			len, offset, mem->name, mem->size * 4);
+		return -1;
+	}
+
+	for (size_t i = 0; i < len; i++) {
+		uint32_t addr = offset + i;
+		uint32_t shift = (addr & 3) * 8;
+		uint32_t byte = data ? data[i] : 0;
+
+		mem->words[addr >> 2] = (mem->words[addr >> 2] & ~(0xffU << shift)) | (byte << shift);
+	}
+
+	return 0;
+}
+
+/* Writes to the highest region starting at or below addr */
+static int write_bytes(const struct mem_region *regions, int n, uint32_t addr,
+		       const uint8_t *data, size_t len)
+{
+	for (int i = n - 1; i >= 0; i--)
+		if (addr >= regions[i].base)
+			return mem_write(&regions[i], addr - regions[i].base, data, len);
+
+	fprintf(stderr, "loader: no memory at 0x%08x\n", addr);
+	return -1;
+}
+
+static const uint8_t *map_file(const char *filename, size_t *size)
+{
+	struct stat st;
+	void *p;
+	int fd;
+
+	fd = open(filename, O_RDONLY);
+	if (fd < 0) {
+		perror(filename);
+		return NULL;
+	}
+
+	if (fstat(fd, &st) < 0) {
+		perror(filename);
+		close(fd);
+		return NULL;
+	}
+
+	*size = st.st_size;
+	if (*size == 0) {
+		close(fd);
+		return (const uint8_t *)"";
+	}
+
+	p = mmap(NULL, *size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (p == MAP_FAILED) {
+		perror(filename);
+		return NULL;
+	}
+
+	return (const uint8_t *)p;
+}
+
+static void unmap_file(const uint8_t *p, size_t size)
+{
+	if (size)
+		munmap((void *)p, size);
+}
+
+int load_elf(const struct mem_region *regions, int n, const char *filename)
+{
+	const Elf32_Ehdr *eh;
+	const uint8_t *p;
+	size_t size;
+	int ret = -1;
+
+	p = map_file(filename, &size);
+	if (!p)
+		return -1;
+
+	eh = (const Elf32_Ehdr *)p;
+	if (size < sizeof(*eh) || memcmp(eh->e_ident, ELFMAG, SELFMAG) ||
+	    eh->e_ident[EI_CLASS] != ELFCLASS32 || eh->e_ident[EI_DATA] != ELFDATA2LSB ||
+	    eh->e_machine != EM_RISCV) {
+		fprintf(stderr, "loader: %s is not a RV32 little-endian ELF\n", filename);
+		goto out;
+	}
+
+	if (eh->e_phoff + (size_t)eh->e_phnum * sizeof(Elf32_Phdr) > size) {
+		fprintf(stderr, "loader: %s has a truncated program header table\n", filename);
+		goto out;
+	}
+
+	for (int i = 0; i < eh->e_phnum; i++) {
+		const Elf32_Phdr *ph = (const Elf32_Phdr *)(p + eh->e_phoff) + i;
+
+		if (ph->p_type != PT_LOAD || ph->p_memsz == 0)
+			continue;
+
+		if ((size_t)ph->p_offset + ph->p_filesz > size) {
+			fprintf(stderr, "loader: %s segment %d is truncated\n", filename, i);
+			goto out;
+		}
+
+		if (write_bytes(regions, n, ph->p_paddr, p + ph->p_offset, ph->p_filesz))
+			goto out;
+
+		/* .bss and friends */
+		if (ph->p_memsz > ph->p_filesz &&
+		    write_bytes(regions, n, ph->p_paddr + ph->p_filesz, NULL, ph->p_memsz - ph->p_filesz))
+			goto out;
+	}
+
+	ret = 0;
+out:
+	unmap_file(p, size);
+	return ret;
+}
+
+/* Parse a readmemh file with one 32 bit word per line */
+static int load_mem(const struct mem_region *regions, int n, const uint8_t *p, size_t size, uint32_t base)
+{
+	const char *s = (const char *)p;
+	const char *end = s + size;
+	uint32_t addr = base;
+
+	while (s < end) {
+		uint32_t word = 0;
+		uint8_t bytes[4];
+		int digits = 0;
+
+		while (s < end && !isxdigit((unsigned char)*s))
+			s++;
+		while (s < end && isxdigit((unsigned char)*s)) {
+			char c = *s++;
+			word = (word << 4) | (c <= '9' ? c - '0' : (c | 0x20) - 'a' + 10);
+			digits++;
+		}
+		if (!digits)
+			break;
+
+		bytes[0] = word;
+		bytes[1] = word >> 8;
+		bytes[2] = word >> 16;
+		bytes[3] = word >> 24;
+		if (write_bytes(regions, n, addr, bytes, 4))
+			return -1;
+		addr += 4;
+	}
+
+	return 0;
+}
+
+int load_image(const struct mem_region *regions, int n, const char *filename, uint32_t base)
+{
+	const uint8_t *p;
+	size_t size, len = strlen(filename);
+	int ret;
+
+	p = map_file(filename, &size);
+	if (!p)
+		return -1;
+
+	if (len > 4 && !strcmp(filename + len - 4, ".mem"))
+		ret = load_mem(regions, n, p, size, base);
+	else
+		ret = write_bytes(regions, n, base, p, size);
+
+	unmap_file(p, size);
+	return ret;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+/*
+ * Program loader shared by the simulation harnesses (see loader.cpp)
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Memory map as seen by the core (see MemoryIOManager.scala) */
+#define ROM_BASE 0x00000000UL
+#define FLASH_BASE 0x20000000UL
+#define SDRAM_BASE 0x40000000UL
+#define RAM_BASE 0x80000000UL
+
+/* A word addressed memory array mapped at base */
+struct mem_region {
+	const char *name;
+	uint32_t base;
+	uint32_t *words;
+	size_t size;	/* in words */
+};
+
+/* Regions must be sorted by base address */
+int load_elf(const struct mem_region *regions, int n, const char *filename);
+int load_image(const struct mem_region *regions, int n, const char *filename, uint32_t base);
@@ -0,0 +1,432 @@
+/*
+ * Statistical PC-sampling profiler.
+ *
+ * Samples the core PC on every retired instruction or every N cycles into a
+ * flat array of counters, one per ROM halfword. Calls and returns (JAL/JALR
+ * linking through ra or t0, JALR back through them) are followed on every
+ * retired instruction to keep a shadow call stack, stored as a tree of call
+ * sites so a sample only bumps the counter of the current node.
+ *
+ * At exit the counters are resolved against the firmware symbols, read from
+ * the ELF symbol table, an objdump -d listing (main.dump) or a linker map
+ * (main.map), and two reports are written: a flat profile per function with
+ * the hottest instructions disassembled, and <file>.folded with one line per
+ * call stack in the format taken by flamegraph.pl and speedscope.
+ */
+
+#include <ctype.h>
+#include <elf.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "disasm.h"
+#include "loader.h"
+#include "profile.h"
+
+/* Deeper calls are counted in the deepest frame */
+#define MAX_DEPTH 256
+/* Instructions listed in the flat profile */
+#define HOT_PCS 25
+
+struct frame {
+	uint32_t parent;
+	uint32_t func;		/* call target */
+	uint32_t depth;
+	uint64_t samples;
+};
+
+struct symbol {
+	uint32_t addr;
+	std::string name;
+};
+
+static struct profile_config cfg;
+static const uint32_t *rom;
+static size_t rom_words;
+static std::vector<uint64_t> flat;
+static uint64_t total, countdown;
+static std::vector<struct frame> frames;
+static std::unordered_map<uint64_t, uint32_t> children;
+static uint32_t cur;		/* current frame */
+static uint32_t overflow;	/* calls not pushed past MAX_DEPTH */
+static bool indirect_call;	/* JALR call retired, the target is the next PC */
+static std::vector<struct symbol> symbols;
+
+int profile_open(const struct profile_config *config, const uint32_t *rom_words_p, size_t words)
+{
+	cfg = *config;
+	if (!cfg.file)
+		cfg.file = "chiselv.prof";
+	rom = rom_words_p;
+	rom_words = words;
+	flat.assign(words * 2, 0);
+	frames.assign(1, { 0, (uint32_t)ROM_BASE, 0, 0 });
+	children.clear();
+	cur = 0;
+	overflow = 0;
+	indirect_call = false;
+	total = 0;
+	countdown = cfg.period;
+	return 0;
+}
+
+static void call(uint32_t target)
+{
+	uint64_t key = (uint64_t)cur << 32 | target;
+	auto it = children.find(key);
+
+	if (frames[cur].depth >= MAX_DEPTH) {
+		overflow++;
+		return;
+	}
+	if (it != children.end()) {
+		cur = it->second;
+		return;
+	}
+	frames.push_back({ cur, target, frames[cur].depth + 1, 0 });
+	cur = frames.size() - 1;
+	children.emplace(key, cur);
+}
+
+static void ret(void)
+{
+	if (overflow)
+		overflow--;
+	else if (cur)
+		cur = frames[cur].parent;
+}
+
+static bool is_link(unsigned r)
+{
+	return r == 1 || r == 5;
+}
+
+/* Instruction at pc, compressed ones expanded */
+static uint32_t insn_at(uint32_t pc)
+{
+	size_t i = ((pc - ROM_BASE) >> 1) % flat.size();
+	size_t next = (i + 1) % flat.size();
+	uint32_t lo = (rom[i >> 1] >> ((i & 1) * 16)) & 0xffff;
+
+	if ((lo & 3) != 3)
+		return rvc_expand(lo);
+	return lo | ((rom[next >> 1] >> ((next & 1) * 16)) & 0xffff) << 16;
+}
+
+/* Follows calls and returns, see the RISC-V return address stack hints */
+static void retire(uint32_t pc, uint32_t insn)
+{
+	unsigned rd = (insn >> 7) & 31, rs1 = (insn >> 15) & 31;
+
+	switch (insn & 0x7f) {
+	case 0x6f: /* JAL */
+		if (is_link(rd)) {
+			int32_t imm = ((int32_t)insn >> 31 << 20) | (insn & 0xff000) |
+				      ((insn >> 9) & 0x800) | ((insn >> 20) & 0x7fe);
+
+			call(pc + imm);
+		}
+		break;
+	case 0x67: /* JALR */
+		if (is_link(rd))
+			indirect_call = true;
+		else if (rd == 0 && is_link(rs1))
+			ret();
+		break;
+	}
+}
+
+void profile_cycle(uint32_t pc, bool retired)
+{
+	size_t i = ((pc - ROM_BASE) >> 1) % flat.size();
+
+	if (retired && indirect_call) {
+		call(pc);
+		indirect_call = false;
+	}
+
+	if (cfg.period ? --countdown == 0 : retired) {
+		countdown = cfg.period;
+		flat[i]++;
+		frames[cur].samples++;
+		total++;
+	}
+
+	if (retired)
+		retire(pc, insn_at(pc));
+}
+
+/* Symbols */
+
+static bool add_symbol(uint32_t addr, const char *name)
+{
+	if (addr < ROM_BASE || addr - ROM_BASE >= rom_words * 4 || !*name)
+		return false;
+	/* Local labels and mapping symbols */
+	if (!strncmp(name, ".L", 2) || name[0] == '$')
+		return false;
+	symbols.push_back({ addr, name });
+	return true;
+}
+
+static int load_elf_symbols(FILE *f)
+{
+	Elf32_Ehdr eh;
+	std::vector<Elf32_Shdr> sh;
+	int n = 0;
+
+	if (fread(&eh, sizeof(eh), 1, f) != 1 || eh.e_shentsize != sizeof(Elf32_Shdr))
+		return -1;
+	sh.resize(eh.e_shnum);
+	if (fseek(f, eh.e_shoff, SEEK_SET) || fread(sh.data(), sizeof(Elf32_Shdr), sh.size(), f) != sh.size())
+		return -1;
+
+	for (const auto &s : sh) {
+		std::vector<Elf32_Sym> syms(s.sh_size / sizeof(Elf32_Sym));
+		std::vector<char> strtab;
+
+		if (s.sh_type != SHT_SYMTAB || s.sh_link >= sh.size())
+			continue;
+		strtab.resize(sh[s.sh_link].sh_size + 1);
+		if (fseek(f, s.sh_offset, SEEK_SET) ||
+		    fread(syms.data(), sizeof(Elf32_Sym), syms.size(), f) != syms.size() ||
+		    fseek(f, sh[s.sh_link].sh_offset, SEEK_SET) ||
+		    fread(strtab.data(), 1, strtab.size() - 1, f) != strtab.size() - 1)
+			return -1;
+
+		/* Functions first, so they win over other labels at the same address */
+		for (int pass = 0; pass < 2; pass++) {
+			for (const auto &sym : syms) {
+				int type = ELF32_ST_TYPE(sym.st_info);
+
+				if ((pass == 0) != (type == STT_FUNC) || (type != STT_FUNC && type != STT_NOTYPE))
+					continue;
+				if (sym.st_shndx == SHN_UNDEF || sym.st_name >= strtab.size())
+					continue;
+				n += add_symbol(sym.st_value, &strtab[sym.st_name]);
+			}
+		}
+	}
+	return n;
+}
+
+/* objdump -d: "00000094 <setDirection>:" */
+static int load_dump_symbols(FILE *f)
+{
+	char line[512], name[256];
+	unsigned addr;
+	int n = 0;
+
+	while (fgets(line, sizeof(line), f))
+		if (sscanf(line, "%x <%255[^>]>:", &addr, name) == 2)
+			n += add_symbol(addr, name);
+	return n;
+}
+
+/* ld -Map: "                0x00000094                setDirection" */
+static int load_map_symbols(FILE *f)
+{
+	char line[512], name[256], rest[8];
+	unsigned addr;
+	int n = 0;
+
+	while (fgets(line, sizeof(line), f)) {
+		if (!isspace((unsigned char)line[0]))
+			continue;
+		if (sscanf(line, " 0x%x %255s %7s", &addr, name, rest) != 2)
+			continue;
+		if (isalpha((unsigned char)name[0]) || name[0] == '_')
+			n += add_symbol(addr, name);
+	}
+	return n;
+}
+
+static int load_symbols(const char *file)
+{
+	char magic[SELFMAG];
+	size_t len = strlen(file);
+	FILE *f = fopen(file, "r");
+	int n;
+
+	if (!f)
+		return -1;
+	if (fread(magic, 1, SELFMAG, f) == SELFMAG && !memcmp(magic, ELFMAG, SELFMAG)) {
+		rewind(f);
+		n = load_elf_symbols(f);
+	} else {
+		rewind(f);
+		if (len > 4 && !strcmp(file + len - 4, ".map"))
+			n = load_map_symbols(f);
+		else
+			n = load_dump_symbols(f);
+	}
+	fclose(f);
+
+	std::stable_sort(symbols.begin(), symbols.end(),
+			 [](const struct symbol &a, const struct symbol &b) { return a.addr < b.addr; });
+	symbols.erase(std::unique(symbols.begin(), symbols.end(),
+				  [](const struct symbol &a, const struct symbol &b) { return a.addr == b.addr; }),
+		      symbols.end());
+	return n;
+}
+
+/* The ELF itself, or main.dump/main.map next to the ROM image */
+static std::string find_symbols(void)
+{
+	std::string dir;
+	const char *slash;
+
+	if (cfg.symbols)
+		return cfg.symbols;
+	if (!cfg.program)
+		return "";
+
+	slash = strrchr(cfg.program, '/');
+	dir = slash ? std::string(cfg.program, slash + 1 - cfg.program) : "";
+	for (const char *name : { cfg.program, "main.dump", "main.map" }) {
+		std::string path = name == cfg.program ? name : dir + name;
+		FILE *f = fopen(path.c_str(), "r");
+		char magic[SELFMAG];
+		bool ok;
+
+		if (!f)
+			continue;
+		/* The program itself only when it is an ELF file */
+		ok = name != cfg.program ||
+		     (fread(magic, 1, SELFMAG, f) == SELFMAG && !memcmp(magic, ELFMAG, SELFMAG));
+		fclose(f);
+		if (ok)
+			return path;
+	}
+	return "";
+}
+
+static std::string symbolize(uint32_t addr, bool offset)
+{
+	char buf[64];
+	auto it = std::upper_bound(symbols.begin(), symbols.end(), addr,
+				   [](uint32_t a, const struct symbol &s) { return a < s.addr; });
+
+	if (it == symbols.begin()) {
+		snprintf(buf, sizeof(buf), "0x%08x", addr);
+		return buf;
+	}
+	--it;
+	if (!offset || addr == it->addr)
+		return it->name;
+	snprintf(buf, sizeof(buf), "+0x%x", addr - it->addr);
+	return it->name + buf;
+}
+
+/* Reports */
+
+static void write_flat(FILE *f, const std::string &source)
+{
+	std::vector<std::pair<std::string, uint64_t>> funcs;
+	std::unordered_map<std::string, size_t> index;
+	std::vector<size_t> hot;
+	double cumul = 0;
+
+	for (size_t i = 0; i < flat.size(); i++) {
+		std::string name;
+
+		if (!flat[i])
+			continue;
+		hot.push_back(i);
+		name = symbolize(ROM_BASE + i * 2, false);
+		auto it = index.find(name);
+		if (it == index.end()) {
+			index.emplace(name, funcs.size());
+			funcs.push_back({ name, flat[i] });
+		} else {
+			funcs[it->second].second += flat[i];
+		}
+	}
+	std::sort(funcs.begin(), funcs.end(),
+		  [](const auto &a, const auto &b) { return a.second > b.second; });
+	std::sort(hot.begin(), hot.end(), [](size_t a, size_t b) { return flat[a] > flat[b]; });
+	if (hot.size() > HOT_PCS)
+		hot.resize(HOT_PCS);
+
+	fprintf(f, "# %llu samples, ", (unsigned long long)total);
+	if (cfg.period)
+		fprintf(f, "one every %lu cycles\n", cfg.period);
+	else
+		fprintf(f, "one per retired instruction\n");
+	fprintf(f, "# symbols: %s\n\n", source.empty() ? "none" : source.c_str());
+
+	fprintf(f, "     samples       %%   cumul%%  function\n");
+	for (const auto &fn : funcs) {
+		double pct = 100.0 * fn.second / total;
+
+		cumul += pct;
+		fprintf(f, "%12llu  %6.2f  %6.2f  %s\n", (unsigned long long)fn.second, pct, cumul,
+			fn.first.c_str());
+	}
+
+	fprintf(f, "\nHottest instructions:\n\n");
+	fprintf(f, "     samples       %%  address   instruction                   location\n");
+	for (size_t i : hot) {
+		uint32_t pc = ROM_BASE + i * 2;
+		char text[64];
+
+		disasm(pc, insn_at(pc), text, sizeof(text));
+		fprintf(f, "%12llu  %6.2f  %08x  %-28s  %s\n", (unsigned long long)flat[i],
+			100.0 * flat[i] / total, pc, text, symbolize(pc, true).c_str());
+	}
+}
+
+static void write_folded(FILE *f)
+{
+	std::vector<std::string> names(frames.size());
+
+	/* Parents are always created before their children */
+	for (size_t i = 0; i < frames.size(); i++) {
+		std::string name = symbolize(frames[i].func, false);
+
+		names[i] = i ? names[frames[i].parent] + ";" + name : name;
+		if (frames[i].samples)
+			fprintf(f, "%s %llu\n", names[i].c_str(), (unsigned long long)frames[i].samples);
+	}
+}
+
+int profile_close(void)
+{
+	std::string source = find_symbols(), folded = std::string(cfg.file) + ".folded";
+	FILE *f;
+	int ret = 0;
+
+	if (!cfg.enabled)
+		return 0;
+
+	if (!source.empty() && load_symbols(source.c_str()) < 0) {
+		fprintf(stderr, "profile: can not read symbols from %s\r\n", source.c_str());
+		source.clear();
+	}
+
+	f = fopen(cfg.file, "w");
+	if (!f) {
+		perror(cfg.file);
+		return -1;
+	}
+	write_flat(f, source);
+	ret |= fclose(f);
+
+	f = fopen(folded.c_str(), "w");
+	if (!f) {
+		perror(folded.c_str());
+		return -1;
+	}
+	write_folded(f);
+	ret |= fclose(f);
+
+	fprintf(stderr, "profile: %llu samples written to %s and %s\r\n", (unsigned long long)total,
+		cfg.file, folded.c_str());
+	cfg.enabled = false;
+	return ret ? -1 : 0;
+}
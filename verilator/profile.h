@@ -0,0 +1,23 @@
+#pragma once
+
+/*
+ * PC-sampling profiler for the simulation harness (see profile.cpp)
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct profile_config {
+	bool enabled;
+	const char *file;	/* flat profile, folded stacks go to <file>.folded */
+	unsigned long period;	/* sample every N cycles, 0 for every retired instruction */
+	const char *symbols;	/* ELF, objdump -d or ld map file, NULL to guess from program */
+	const char *program;	/* ELF or ROM image that was loaded */
+};
+
+/* rom is read again when writing the report to disassemble the hottest PCs */
+int profile_open(const struct profile_config *config, const uint32_t *rom, size_t rom_words);
+/* Called once per cycle with the current PC, retired when an instruction completes */
+void profile_cycle(uint32_t pc, bool retired);
+/* Symbolizes the samples and writes the reports */
+int profile_close(void);
@@ -0,0 +1,283 @@
+/*
+ * Commit trace harness for the RVFI build (make verilator-rvfi).
+ *
+ * Runs the RVFI top (RVFI_Wrapper.scala) with the ROM and RAM modelled here
+ * and streams every retired instruction from the RVFI port to a compact
+ * binary trace (see ctrace.h), decoded with verilator/ctrace-dump.
+ *
+ * With --cosim every retired instruction is also checked in lockstep
+ * against the instruction set simulator (see cosim.cpp) and the run stops at
+ * the first divergence. The trace is then only written when --output is given.
+ *
+ * The RVFI top has no UART or Syscon: stores to the UART0 TX register are
+ * printed to stdout and a store of (code << 1) | 1 to the Syscon exit
+ * register ends the run, both taken from the retirement records.
+ */
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "VRVFI.h"
+#include "verilated.h"
+#include "cosim.h"
+#include "ctrace.h"
+#include "loader.h"
+
+/* Same sizes as the RVFICPUWrapper defaults */
+#define ROM_WORDS (64 * 1024 / 4)
+#define RAM_WORDS (64 * 1024 / 4)
+
+#define UART0_TX 0x30000000UL
+#define SYSCON_EXIT 0x00001040UL
+
+/* Exit code used when --max-cycles is reached (same as timeout(1)) */
+#define EXIT_TIMEOUT 124
+/* Exit code when the DUT diverges from the reference model */
+#define EXIT_DIVERGED 125
+
+static uint32_t rom[ROM_WORDS];
+static uint32_t ram[RAM_WORDS];
+/* DualPortRAM is a SyncReadMem, read data shows up one cycle later */
+static uint32_t dmem_rdata;
+
+vluint64_t main_time = 0;
+
+double sc_time_stamp(void)
+{
+	return main_time;
+}
+
+/* The wrapper reports the rd field of every instruction, keep real writes only */
+static bool writes_rd(uint32_t insn)
+{
+	switch (insn & 0x7f) {
+	case 0x37: /* LUI */
+	case 0x17: /* AUIPC */
+	case 0x6f: /* JAL */
+	case 0x67: /* JALR */
+	case 0x03: /* LOAD */
+	case 0x13: /* OP-IMM */
+	case 0x33: /* OP */
+		return true;
+	case 0x73: /* SYSTEM, CSR instructions only */
+		return (insn >> 12) & 3;
+	}
+	return false;
+}
+
+/* Drives the memories for the current cycle and settles the model */
+static void eval(VRVFI *top)
+{
+	top->eval();
+	top->io_imem_ready = 1;
+	top->io_imem_rdata = rom[(top->io_imem_addr >> 2) & (ROM_WORDS - 1)];
+	top->io_dmem_rdata = dmem_rdata;
+	top->eval();
+}
+
+static void tick(VRVFI *top)
+{
+	uint32_t raddr = (top->io_dmem_raddr >> 2) & (RAM_WORDS - 1);
+
+	dmem_rdata = ram[raddr];
+	if (top->io_dmem_wen) {
+		/* Sub-word stores only enable their byte lanes, wdata is already shifted to them */
+		uint32_t *w = &ram[(top->io_dmem_waddr >> 2) & (RAM_WORDS - 1)];
+		uint32_t mask = 0;
+
+		for (int i = 0; i < 4; i++)
+			if (top->io_dmem_wmask & (1 << i))
+				mask |= 0xffU << (8 * i);
+		*w = (*w & ~mask) | (top->io_dmem_wdata & mask);
+	}
+
+	top->clock = 1;
+	top->eval();
+	main_time++;
+
+	top->clock = 0;
+	eval(top);
+	main_time++;
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr, "Usage: %s [options] [+verilator+args]\n"
+		"  -e, --elf FILE     load an ELF executable into ROM/RAM\n"
+		"  -r, --rom FILE     load a raw binary (or .mem) image into ROM\n"
+		"  -m, --ram FILE     load a raw binary (or .mem) image into RAM\n"
+		"  -c, --max-cycles N stop with exit code %d after N cycles\n"
+		"  -o, --output FILE  commit trace file (default: chiselv.ctrace)\n"
+		"  -z, --zstd         compress the trace with zstd\n"
+		"  -k, --cosim        check every instruction against the reference model,\n"
+		"                     exit code %d on divergence (no trace without -o)\n"
+		"  -h, --help         show this help\n",
+		name, EXIT_TIMEOUT, EXIT_DIVERGED);
+}
+
+int main(int argc, char **argv)
+{
+	static const struct option options[] = {
+		{ "elf", required_argument, NULL, 'e' },
+		{ "rom", required_argument, NULL, 'r' },
+		{ "ram", required_argument, NULL, 'm' },
+		{ "max-cycles", required_argument, NULL, 'c' },
+		{ "output", required_argument, NULL, 'o' },
+		{ "zstd", no_argument, NULL, 'z' },
+		{ "cosim", no_argument, NULL, 'k' },
+		{ "help", no_argument, NULL, 'h' },
+		{ NULL, 0, NULL, 0 }
+	};
+	struct mem_region mem[] = {
+		{ "ROM", ROM_BASE, rom, ROM_WORDS },
+		{ "RAM", RAM_BASE, ram, RAM_WORDS },
+	};
+	const char *elffile = NULL, *romfile = NULL, *ramfile = NULL;
+	const char *output = NULL;
+	unsigned long max_cycles = 0, cycles = 0, instret = 0;
+	struct ctrace_writer *trace = NULL;
+	struct cosim *cosim = NULL;
+	struct timespec start, end;
+	const char *reason = "max cycles reached";
+	bool zstd = false, check = false;
+	int c, code = EXIT_TIMEOUT;
+	double secs;
+
+	Verilated::commandArgs(argc, argv);
+
+	while ((c = getopt_long(argc, argv, "e:r:m:c:o:zkh", options, NULL)) != -1) {
+		switch (c) {
+		case 'e':
+			elffile = optarg;
+			break;
+		case 'r':
+			romfile = optarg;
+			break;
+		case 'm':
+			ramfile = optarg;
+			break;
+		case 'c':
+			max_cycles = strtoul(optarg, NULL, 0);
+			break;
+		case 'o':
+			output = optarg;
+			break;
+		case 'z':
+			zstd = true;
+			break;
+		case 'k':
+			check = true;
+			break;
+		case 'h':
+			usage(argv[0]);
+			return 0;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (!elffile && !romfile && !ramfile) {
+		usage(argv[0]);
+		return 1;
+	}
+	if ((elffile && load_elf(mem, 2, elffile)) ||
+	    (romfile && load_image(mem, 2, romfile, ROM_BASE)) ||
+	    (ramfile && load_image(mem, 2, ramfile, RAM_BASE)))
+		return 1;
+
+	if (check) {
+		cosim = cosim_open(rom, ROM_WORDS, ram, RAM_WORDS);
+		if (!cosim)
+			return 1;
+	} else if (!output) {
+		output = "chiselv.ctrace";
+	}
+	if (output) {
+		trace = ctrace_open(output, zstd);
+		if (!trace)
+			return 1;
+	}
+
+	VRVFI *top = new VRVFI;
+
+	// Reset
+	top->reset = 1;
+	top->clock = 0;
+	eval(top);
+	for (unsigned long i = 0; i < 5; i++)
+		tick(top);
+	top->reset = 0;
+	eval(top);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	while (!Verilated::gotFinish() && cycles != max_cycles) {
+		struct ctrace_rec r;
+		uint32_t pc_wdata;
+
+		// Combinational view of the instruction executing in this cycle
+		r.pc = top->rvfi_pc_rdata;
+		r.insn = top->rvfi_insn;
+		r.trap = top->rvfi_trap;
+		r.rd = writes_rd(r.insn) ? top->rvfi_rd_addr : 0;
+		r.rd_wdata = r.rd ? top->rvfi_rd_wdata : 0;
+		r.mem_addr = top->rvfi_mem_addr;
+		r.mem_rmask = top->rvfi_mem_rmask;
+		r.mem_wmask = top->rvfi_mem_wmask;
+		r.mem_rdata = top->rvfi_mem_rdata;
+		r.mem_wdata = top->rvfi_mem_wmask ? top->rvfi_rs2_rdata : 0;
+		pc_wdata = top->rvfi_pc_wdata;
+
+		tick(top);
+		cycles++;
+
+		// rvfi_valid is registered: set when that instruction did not stall
+		if (!top->rvfi_valid)
+			continue;
+
+		r.order = instret++;
+		if (trace)
+			ctrace_put(trace, &r);
+		if (cosim && cosim_step(cosim, &r, pc_wdata, ram)) {
+			reason = "diverged from the reference model";
+			code = EXIT_DIVERGED;
+			break;
+		}
+
+		if (r.mem_wmask && r.mem_addr == UART0_TX)
+			putchar(r.mem_wdata & 0xff);
+		if (r.mem_wmask && r.mem_addr == SYSCON_EXIT && (r.mem_wdata & 1)) {
+			reason = "exit register";
+			code = r.mem_wdata >> 1;
+			break;
+		}
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	fflush(stdout);
+
+	if (trace && ctrace_close(trace)) {
+		fprintf(stderr, "%s: write error\n", output);
+		code = 1;
+	}
+
+	secs = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+	fprintf(stderr, "\n------------------------------------------------------\n");
+	fprintf(stderr, "exit:          %s (%d)\n", reason, code);
+	fprintf(stderr, "cycles:        %lu\n", cycles);
+	fprintf(stderr, "instructions:  %lu\n", instret);
+	fprintf(stderr, "wall time:     %.3f s\n", secs);
+	if (trace)
+		fprintf(stderr, "trace:         %s\n", output);
+	if (cosim)
+		fprintf(stderr, "cosim:         %s\n", code == EXIT_DIVERGED ? "FAILED" : "passed");
+	cosim_close(cosim);
+
+	top->final();
+	delete top;
+
+	return code;
+}
@@ -0,0 +1,181 @@
+/*
+ * Behavioural SDR SDRAM on the SDRAM port of models generated with --sdram.
+ *
+ * The harness calls sdram_cycle() after every clock with the pins driven by
+ * the controller (SDRAM.scala), which are registered, so the command seen
+ * here is the one the SDRAM takes on the next rising edge. Read bursts come
+ * back on the returned DQ CAS latency calls later, a beat per call, write
+ * bursts take a beat per call starting with the command. Banks, rows, the
+ * mode register (burst length and CAS latency) and auto precharge are
+ * modelled, the analog timings are not: a command to a bank in the wrong
+ * state is reported once and counted.
+ */
+
+#include <stdio.h>
+
+#include "verilated_save.h"
+#include "chiselv.h"
+
+uint32_t sdram_mem[SDRAM_SIZE / 4];
+unsigned long sdram_reads, sdram_writes, sdram_activates, sdram_refreshes, sdram_errors;
+
+enum sdram_cmd {	/* {CS#, RAS#, CAS#, WE#} */
+	CMD_LOAD_MODE = 0x0,
+	CMD_REFRESH = 0x1,
+	CMD_PRECHARGE = 0x2,
+	CMD_ACTIVE = 0x3,
+	CMD_WRITE = 0x4,
+	CMD_READ = 0x5,
+};
+
+#define BANKS 4
+#define BURST_MAX 8
+#define CAS_MAX 3
+
+static struct {
+	bool active[BANKS];	/* a row is open */
+	uint16_t row[BANKS];
+	uint16_t mode;
+	bool mode_set;
+	unsigned burst;		/* burst length from the mode register */
+	unsigned cas;		/* CAS latency from the mode register */
+	/* Read beats in flight, indexed by the call that returns them */
+	uint32_t read_addr[CAS_MAX + BURST_MAX];
+	bool read_valid[CAS_MAX + BURST_MAX];
+	unsigned long calls;
+	uint32_t write_addr;	/* next half word of the write burst */
+	unsigned write_beats;	/* left in the write burst */
+	uint16_t out;
+	bool warned;
+} sdram;
+
+static uint16_t read_half(uint32_t half)
+{
+	half &= SDRAM_SIZE / 2 - 1;
+	return sdram_mem[half >> 1] >> ((half & 1) * 16);
+}
+
+static void write_half(uint32_t half, uint16_t value, uint8_t dqm)
+{
+	uint32_t *word = &sdram_mem[(half & (SDRAM_SIZE / 2 - 1)) >> 1];
+	unsigned shift = (half & 1) * 16;
+	uint32_t mask = 0;
+
+	if (!(dqm & 1))
+		mask |= 0x00ff;
+	if (!(dqm & 2))
+		mask |= 0xff00;
+	*word = (*word & ~(mask << shift)) | ((uint32_t)(value & mask) << shift);
+}
+
+static void error(const char *what, unsigned bank)
+{
+	sdram_errors++;
+	if (!sdram.warned)
+		fprintf(stderr, "sdram: %s (bank %u), further errors are only counted\r\n", what, bank);
+	sdram.warned = true;
+}
+
+/* Half word address of a column in the open row of bank, like SDRAMController splits the byte address */
+static uint32_t column_address(unsigned bank, uint16_t addr)
+{
+	return ((uint32_t)sdram.row[bank] << (SDRAM_COL_BITS + 2)) | (bank << SDRAM_COL_BITS) |
+	       (addr & ((1 << SDRAM_COL_BITS) - 1));
+}
+
+uint16_t sdram_cycle(uint8_t cmd, uint8_t ba, uint16_t addr, uint8_t dqm, uint16_t dq, bool dq_oe)
+{
+	unsigned slot = sdram.calls % (CAS_MAX + BURST_MAX);
+	bool auto_precharge = addr & (1 << 10);
+
+	if (sdram.write_beats) {
+		if (dq_oe)
+			write_half(sdram.write_addr, dq, dqm);
+		sdram.write_addr++;
+		sdram.write_beats--;
+	}
+
+	switch (cmd) {
+	case CMD_ACTIVE:
+		if (sdram.active[ba])
+			error("ACTIVE to an open bank", ba);
+		sdram.active[ba] = true;
+		sdram.row[ba] = addr;
+		sdram_activates++;
+		break;
+	case CMD_READ:
+	case CMD_WRITE:
+		if (!sdram.active[ba] || !sdram.mode_set) {
+			error("READ/WRITE to a precharged bank", ba);
+			break;
+		}
+		if (cmd == CMD_READ) {
+			for (unsigned i = 0; i < sdram.burst; i++) {
+				unsigned s = (slot + sdram.cas + i) % (CAS_MAX + BURST_MAX);
+
+				sdram.read_addr[s] = column_address(ba, addr) + i;
+				sdram.read_valid[s] = true;
+			}
+			sdram_reads++;
+		} else {
+			sdram.write_addr = column_address(ba, addr);
+			sdram.write_beats = sdram.burst - 1;
+			if (dq_oe)
+				write_half(sdram.write_addr++, dq, dqm);
+			sdram_writes++;
+		}
+		if (auto_precharge)
+			sdram.active[ba] = false;
+		break;
+	case CMD_PRECHARGE:
+		for (unsigned b = 0; b < BANKS; b++)
+			if (auto_precharge || b == ba)
+				sdram.active[b] = false;
+		break;
+	case CMD_REFRESH:
+		for (unsigned b = 0; b < BANKS; b++)
+			if (sdram.active[b])
+				error("REFRESH with an open bank", b);
+		sdram_refreshes++;
+		break;
+	case CMD_LOAD_MODE:
+		sdram.mode = addr;
+		sdram.mode_set = true;
+		sdram.burst = 1 << (addr & 7);
+		sdram.cas = (addr >> 4) & 7;
+		if (sdram.burst > BURST_MAX || sdram.cas < 2 || sdram.cas > CAS_MAX) {
+			fprintf(stderr, "sdram: mode 0x%03x not supported\r\n", addr);
+			sdram.mode_set = false;
+		}
+		break;
+	}
+
+	if (sdram.read_valid[slot]) {
+		sdram.out = read_half(sdram.read_addr[slot]);
+		sdram.read_valid[slot] = false;
+	}
+	sdram.calls++;
+	return sdram.out;
+}
+
+void sdram_save(VerilatedSerialize &os)
+{
+	os.write(&sdram, sizeof(sdram));
+	os.write(&sdram_reads, sizeof(sdram_reads));
+	os.write(&sdram_writes, sizeof(sdram_writes));
+	os.write(&sdram_activates, sizeof(sdram_activates));
+	os.write(&sdram_refreshes, sizeof(sdram_refreshes));
+	os.write(&sdram_errors, sizeof(sdram_errors));
+	os.write(sdram_mem, sizeof(sdram_mem));
+}
+
+void sdram_restore(VerilatedDeserialize &os)
+{
+	os.read(&sdram, sizeof(sdram));
+	os.read(&sdram_reads, sizeof(sdram_reads));
+	os.read(&sdram_writes, sizeof(sdram_writes));
+	os.read(&sdram_activates, sizeof(sdram_activates));
+	os.read(&sdram_refreshes, sizeof(sdram_refreshes));
+	os.read(&sdram_errors, sizeof(sdram_errors));
+	os.read(sdram_mem, sizeof(sdram_mem));
+}
@@ -0,0 +1,118 @@
+/*
+ * Behavioural SPI flash on the FLASH port of models generated with --xip.
+ *
+ * The harness calls spiflash_cycle() after every clock with the lines driven
+ * by the controller (SPIFlash.scala) and feeds the returned lines back. The
+ * flash samples on the rising SCLK edges and shifts its data out on the
+ * falling ones (SPI mode 0). Only the read commands are modelled: Read Data
+ * (0x03), Fast Read (0x0B) and Fast Read Quad Output (0x6B). The contents
+ * are loaded by the harness like the ROM and RAM, nothing writes them.
+ */
+
+#include <stdio.h>
+
+#include "verilated_save.h"
+#include "chiselv.h"
+
+uint32_t spiflash_mem[FLASH_SIZE / 4];
+unsigned long spiflash_reads;
+
+enum flash_cmd {
+	CMD_READ = 0x03,
+	CMD_FAST_READ = 0x0b,
+	CMD_QUAD_READ = 0x6b,
+};
+
+static struct {
+	bool sclk;
+	unsigned clocks;	/* rising edges since CS# went low */
+	uint8_t cmd;
+	uint32_t addr;
+	unsigned data_start;	/* clocks before the first data bit */
+	unsigned lines;		/* 1 => MISO (IO1), 4 => IO0-IO3, 0 => ignore the command */
+	uint8_t out;
+	bool warned;
+} flash;
+
+static uint8_t flash_byte(uint32_t addr)
+{
+	addr &= FLASH_SIZE - 1;
+	return spiflash_mem[addr >> 2] >> ((addr & 3) * 8);
+}
+
+static void decode(void)
+{
+	switch (flash.cmd) {
+	case CMD_READ:
+		flash.lines = 1;
+		flash.data_start = 32;
+		break;
+	case CMD_FAST_READ:
+		flash.lines = 1;
+		flash.data_start = 40;
+		break;
+	case CMD_QUAD_READ:
+		flash.lines = 4;
+		flash.data_start = 40;
+		break;
+	default:
+		flash.lines = 0;
+		if (!flash.warned)
+			fprintf(stderr, "spiflash: command 0x%02x not supported\r\n", flash.cmd);
+		flash.warned = true;
+		break;
+	}
+	if (flash.lines)
+		spiflash_reads++;
+}
+
+uint8_t spiflash_cycle(bool sclk, bool csn, uint8_t io)
+{
+	bool rising = sclk && !flash.sclk, falling = !sclk && flash.sclk;
+
+	flash.sclk = sclk;
+	if (csn) {
+		flash.clocks = 0;
+		flash.cmd = 0;
+		flash.addr = 0;
+		flash.lines = 0;
+		return flash.out;
+	}
+
+	if (rising) {
+		flash.clocks++;
+		if (flash.clocks <= 8) {
+			flash.cmd = flash.cmd << 1 | (io & 1);
+			if (flash.clocks == 8)
+				decode();
+		} else if (flash.clocks <= 32) {
+			flash.addr = flash.addr << 1 | (io & 1);
+		}
+	}
+
+	// The next bit (or nibble) goes out on the falling edge after the address and dummy clocks
+	if (falling && flash.lines && flash.clocks >= flash.data_start) {
+		unsigned n = flash.clocks - flash.data_start;
+
+		if (flash.lines == 4)
+			flash.out = (flash_byte(flash.addr + n / 2) >> (n % 2 ? 0 : 4)) & 0xf;
+		else
+			flash.out = ((flash_byte(flash.addr + n / 8) >> (7 - n % 8)) & 1) << 1;
+	}
+
+	return flash.out;
+}
+
+void spiflash_save(VerilatedSerialize &os)
+{
+	os.write(&flash, sizeof(flash));
+	os.write(&spiflash_reads, sizeof(spiflash_reads));
+	os.write(spiflash_mem, sizeof(spiflash_mem));
+}
+
+void spiflash_restore(VerilatedDeserialize &os)
+{
+	os.read(&flash, sizeof(flash));
+	os.read(&spiflash_reads, sizeof(spiflash_reads));
+	os.read(spiflash_mem, sizeof(spiflash_mem));
+}
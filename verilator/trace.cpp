@@ -0,0 +1,153 @@
+/*
+ * Triggered, windowed waveform tracing.
+ *
+ * Models built with --trace-fst (make TRACE=true) do not dump anything until
+ * a trigger fires: a start cycle, the PC reaching an address or a store to an
+ * MMIO address. Tracing then runs until the stop cycle or for a window of
+ * cycles, limited to a scope depth and/or a list of module instances.
+ *
+ * Optionally the last N cycles before the trigger are kept too. While waiting
+ * for the trigger the trace is written in segments of N cycles that rotate
+ * between two files, <name>-pre.fst (previous segment) and <name>.fst
+ * (current segment), so at most 2N cycles are ever kept and the waveform that
+ * leads to the trigger, or to the end of the run, is always available.
+ */
+
+#if VM_TRACE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+#include "verilated.h"
+#include "verilated_fst_c.h"
+#include "chiselv.h"
+
+enum trace_state {
+	TRACE_WAIT,	/* waiting for the trigger, dumping only with a pre-trigger ring */
+	TRACE_ON,	/* triggered, dumping */
+	TRACE_DONE,	/* window finished, file closed */
+};
+
+static struct trace_config cfg;
+static enum trace_state state = TRACE_DONE;
+static VerilatedFstC *tfp;
+static std::string cur_name, pre_name;
+static unsigned long segment_start, trigger_cycle;
+
+static void open_segment(unsigned long cycle)
+{
+	tfp->open(cur_name.c_str());
+	segment_start = cycle;
+}
+
+/* Rotates the pre-trigger ring: the current segment becomes the previous one */
+static void rotate(unsigned long cycle)
+{
+	tfp->close();
+	if (rename(cur_name.c_str(), pre_name.c_str()))
+		perror(pre_name.c_str());
+	open_segment(cycle);
+}
+
+static void trigger(unsigned long cycle, const char *why)
+{
+	fprintf(stderr, "trace: triggered by %s at cycle %lu\r\n", why, cycle);
+	trigger_cycle = cycle;
+	state = TRACE_ON;
+	if (!tfp->isOpen())
+		open_segment(cycle);
+}
+
+void trace_open(VToplevel *top, const struct trace_config *config)
+{
+	const char *ext;
+
+	cfg = *config;
+	if (!cfg.enabled)
+		return;
+
+	cur_name = cfg.file;
+	ext = strrchr(cfg.file, '.');
+	if (ext && !strchr(ext, '/'))
+		pre_name = cur_name.substr(0, ext - cfg.file) + "-pre" + ext;
+	else
+		pre_name = cur_name + "-pre";
+	/* Do not leave a stale pre-trigger segment from an earlier run around */
+	remove(pre_name.c_str());
+
+	Verilated::traceEverOn(true);
+	tfp = new VerilatedFstC;
+	if (cfg.scopes) {
+		std::string scopes = cfg.scopes;
+		size_t pos = 0;
+
+		while (pos <= scopes.size()) {
+			size_t end = scopes.find(',', pos);
+
+			if (end == std::string::npos)
+				end = scopes.size();
+			if (end > pos)
+				tfp->dumpvars(cfg.depth, scopes.substr(pos, end - pos));
+			pos = end + 1;
+		}
+	} else if (cfg.depth) {
+		/* trace() ignores its levels argument, the depth only applies through dumpvars() */
+		tfp->dumpvars(cfg.depth, "TOP");
+	}
+	top->trace(tfp, cfg.depth ? cfg.depth : 99);
+
+	state = TRACE_WAIT;
+	if (!cfg.trigger_pc && !cfg.trigger_mmio && cfg.start == 0)
+		trigger(0, "start");
+	else if (cfg.pretrigger)
+		open_segment(0);
+}
+
+/* Called once per cycle, before the clock edge, to evaluate the triggers */
+void trace_cycle(VToplevel *top, unsigned long cycle)
+{
+	switch (state) {
+	case TRACE_WAIT:
+		if (cfg.start && cycle >= cfg.start)
+			trigger(cycle, "start cycle");
+		else if (cfg.trigger_pc && CPU_RETIRE(top) && CPU_PC(top) == cfg.pc)
+			trigger(cycle, "PC");
+		else if (cfg.trigger_mmio && MMIO_WRITE(top) && MMIO_WRITE_ADDR(top) == cfg.mmio_addr)
+			trigger(cycle, "MMIO write");
+		else if (cfg.pretrigger && cycle - segment_start >= cfg.pretrigger)
+			rotate(cycle);
+		break;
+	case TRACE_ON:
+		if ((cfg.stop && cycle >= cfg.stop) ||
+		    (cfg.window && cycle - trigger_cycle >= cfg.window)) {
+			fprintf(stderr, "trace: stopped at cycle %lu\r\n", cycle);
+			tfp->close();
+			state = TRACE_DONE;
+		}
+		break;
+	case TRACE_DONE:
+		break;
+	}
+}
+
+void trace_dump(uint64_t time)
+{
+	if (state != TRACE_DONE && tfp->isOpen())
+		tfp->dump(time);
+}
+
+void trace_close(void)
+{
+	if (!tfp)
+		return;
+
+	if (tfp->isOpen())
+		tfp->close();
+	delete tfp;
+	tfp = NULL;
+	state = TRACE_DONE;
+}
+
+#endif
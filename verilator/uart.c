@@ -2,16 +2,15 @@
 // core created by Anton Blanchard:
 // https://github.com/antonblanchard/chiselwatt/blob/master/uart.c
 
-#include <signal.h>
-#include <poll.h>
-#include <unistd.h>
-#include <string.h>
 #include <stdio.h>
-#include <termios.h>
-#include <stdlib.h>
 
-/* Should we exit simulation on ctrl-c or pass it through? */
-#define EXIT_ON_CTRL_C
+#include "verilated_save.h"
+#include "chiselv.h"
+
+/*
+ * Host I/O (stdin/stdout, files, pipes or a pty) is done by a separate
+ * thread in hostio.cpp, here we only push and pop bytes from its rings.
+ */
 
 #define CLOCK 50000000L
 #define BAUD 115200
@@ -30,6 +29,10 @@ enum state {
 	IDLE, START_BIT, BITS, STOP_BIT, ERROR
 };
 
+/* Bytes moved through the UART, reported at the end of the simulation */
+unsigned long uart_tx_bytes;
+unsigned long uart_rx_bytes;
+
 static enum state tx_state = IDLE;
 static unsigned long tx_countbits;
 static unsigned char tx_bits;
@@ -114,12 +117,14 @@ void uart_tx(unsigned char tx)
 					break;
 				}
 				/* Go straight to idle */
-				write(STDOUT_FILENO, &tx_byte, 1);
+				hostio_putc(tx_byte);
+				uart_tx_bytes++;
 				tx_state = IDLE;
 			}
 
 			if (tx_countbits == 0) {
-				write(STDOUT_FILENO, &tx_byte, 1);
+				hostio_putc(tx_byte);
+				uart_tx_bytes++;
 				tx_state = IDLE;
 			}
 			break;
@@ -136,61 +141,28 @@ void uart_tx(unsigned char tx)
 	tx_prev = tx;
 }
 
-static struct termios oldt;
-
-static void disable_raw_mode(void)
+static bool nonblocking_read(unsigned char *c)
 {
-	tcsetattr(STDIN_FILENO, TCSANOW, &oldt);
+	if (!hostio_getc(c))
+		return false;
+
+	uart_rx_bytes++;
+	return true;
 }
 
-static void enable_raw_mode(void)
+/*
+ * Fast console: bytes are exchanged directly with the UART FIFOs through the
+ * simulation port, nothing is serialized on the tx/rx lines.
+ */
+void console_tx(unsigned char c)
 {
-	static bool initialized = false;
-
-	if (!initialized) {
-		static struct termios newt;
-
-		tcgetattr(STDIN_FILENO, &oldt);
-		newt = oldt;
-		cfmakeraw(&newt);
-#ifdef EXIT_ON_CTRL_C
-		newt.c_lflag |= ISIG;
-#endif
-		tcsetattr(STDIN_FILENO, TCSANOW, &newt);
-		initialized = true;
-		atexit(disable_raw_mode);
-	}
+	hostio_putc(c);
+	uart_tx_bytes++;
 }
 
-static int nonblocking_read(unsigned char *c)
+bool console_rx(unsigned char *c)
 {
-	int ret;
-	unsigned long val = 0;
-	struct pollfd fdset[1];
-
-	enable_raw_mode();
-
-	memset(fdset, 0, sizeof(fdset));
-
-	fdset[0].fd = STDIN_FILENO;
-	fdset[0].events = POLLIN;
-
-	ret = poll(fdset, 1, 0);
-	if (ret == 0)
-		return false;
-
-	ret = read(STDIN_FILENO, &val, 1);
-	if (ret != 1) {
-		fprintf(stderr, "%s: read of stdin returns %d\n", __func__, ret);
-		exit(1);
-	}
-
-	if (ret == 1) {
-		*c = val;
-		return true;
-	} else {
-		return false;
-	}
+	return nonblocking_read(c);
 }
 
 static enum state rx_state = IDLE;
@@ -199,26 +171,18 @@ static unsigned long rx_countbits;
 static unsigned char rx_bit;
 static unsigned char rx = 1;
 
-/* Avoid calling poll() too much */
-#define RX_INTERVAL 10000
-static unsigned long rx_sometimes;
-
 unsigned char uart_rx(void)
 {
 	unsigned char c;
 
 	switch (rx_state) {
 		case IDLE:
-			if (rx_sometimes++ >= RX_INTERVAL) {
-				rx_sometimes = 0;
-
-				if (nonblocking_read(&c)) {
-					rx_state = START_BIT;
-					rx_char = c;
-					rx_countbits = BITWIDTH;
-					rx_bit = 0;
-					rx = 0;
-				}
+			if (nonblocking_read(&c)) {
+				rx_state = START_BIT;
+				rx_char = c;
+				rx_countbits = BITWIDTH;
+				rx_bit = 0;
+				rx = 0;
 			}
 
 			break;
@@ -258,3 +222,34 @@ unsigned char uart_rx(void)
 
 	return rx;
 }
+
+/* Everything above that has to survive a checkpoint (see checkpoint.cpp) */
+static const struct {
+	void *p;
+	size_t size;
+} uart_vars[] = {
+	{ &uart_tx_bytes, sizeof(uart_tx_bytes) },
+	{ &uart_rx_bytes, sizeof(uart_rx_bytes) },
+	{ &tx_state, sizeof(tx_state) },
+	{ &tx_countbits, sizeof(tx_countbits) },
+	{ &tx_bits, sizeof(tx_bits) },
+	{ &tx_byte, sizeof(tx_byte) },
+	{ &tx_prev, sizeof(tx_prev) },
+	{ &rx_state, sizeof(rx_state) },
+	{ &rx_char, sizeof(rx_char) },
+	{ &rx_countbits, sizeof(rx_countbits) },
+	{ &rx_bit, sizeof(rx_bit) },
+	{ &rx, sizeof(rx) },
+};
+
+void uart_save(VerilatedSerialize &os)
+{
+	for (auto &v : uart_vars)
+		os.write(v.p, v.size);
+}
+
+void uart_restore(VerilatedDeserialize &os)
+{
+	for (auto &v : uart_vars)
+		os.read(v.p, v.size);
+}